@@ -21,11 +21,13 @@
 #include <cstdlib>
 #include <assert.h>
 #include <iostream>
+#include <algorithm>
 
 #include <QDir>
 #include <QMap>
 #include <QRegExp>
 #include <QStringList>
+#include <QThread>
 
 #include "Dpi.h"
 #include "ImageId.h"
@@ -166,6 +168,8 @@ CommandLine::setup()
 	m_deskewAngle = fetchDeskewAngle();
 	m_startFilterIdx = fetchStartFilterIdx();
 	m_endFilterIdx = fetchEndFilterIdx();
+	m_threads = fetchThreads();
+	m_tiffOptions = fetchTiffOptions();
 }
 
 
@@ -233,6 +237,12 @@ CommandLine::printHelp()
 	std::cout << "\t--start-filter=<1...6>\t\t\t-- default: 4" << "\n";
 	std::cout << "\t--end-filter=<1...6>\t\t\t-- default: 6" << "\n";
 	std::cout << "\t--output-project=, -o=<project_name>" << "\n";
+	std::cout << "\t--threads=<auto|number>\t\t\t-- pages processed in parallel; default: 1" << "\n";
+	std::cout << "\t--tiff-compression=<lzw|deflate|zstd>\t-- color and grayscale output; default: lzw" << "\n";
+	std::cout << "\t--tiff-compression-bw=<lzw|g4>\t\t-- black and white output; default: lzw" << "\n";
+	std::cout << "\t--tiff-rows-per-strip=<number>\t\t-- default: 0 (chosen automatically)" << "\n";
+	std::cout << "\t--scratch-dir=<dir>\t\t\t-- keep large black and white images in memory-mapped files there" << "\n";
+	std::cout << "\t--trace=<file>\t\t\t\t-- write per-stage timings there, in Chrome trace format" << "\n";
 	std::cout << "\n";
 }
 
@@ -485,6 +495,74 @@ CommandLine::fetchDepthPerception()
 	return output::DepthPerception(m_options.value("depth-perception"));
 }
 
+int
+CommandLine::fetchThreads()
+{
+	if (!hasThreads())
+		return 1;
+
+	QString const threads = m_options.value("threads").toLower();
+	if (threads == "auto" || threads == "true")
+		return std::max(1, QThread::idealThreadCount());
+
+	int const n = threads.toInt();
+	if (n < 1) {
+		std::cout << "invalid --threads=" << threads.toAscii().constData() << "\n";
+		exit(1);
+	}
+
+	return n;
+}
+
+TiffWriter::Options
+CommandLine::fetchTiffOptions()
+{
+	TiffWriter::Options options;
+
+	if (contains("tiff-compression")) {
+		QString const value = m_options.value("tiff-compression").toLower();
+		TiffWriter::ContoneCompression compression = options.contoneCompression();
+		if (!TiffWriter::Options::contoneCompressionFromString(value, compression)) {
+			std::cout << "invalid --tiff-compression=" << value.toAscii().constData() << "\n";
+			exit(1);
+		}
+		options.setContoneCompression(compression);
+	}
+
+	if (contains("tiff-compression-bw")) {
+		QString const value = m_options.value("tiff-compression-bw").toLower();
+		TiffWriter::BilevelCompression compression = options.bilevelCompression();
+		if (!TiffWriter::Options::bilevelCompressionFromString(value, compression)) {
+			std::cout << "invalid --tiff-compression-bw=" << value.toAscii().constData() << "\n";
+			exit(1);
+		}
+		options.setBilevelCompression(compression);
+	}
+
+	if (contains("tiff-rows-per-strip")) {
+		bool ok = false;
+		int const rows = m_options.value("tiff-rows-per-strip").toInt(&ok);
+		if (!ok || rows < 0) {
+			std::cout << "invalid --tiff-rows-per-strip="
+				<< m_options.value("tiff-rows-per-strip").toAscii().constData() << "\n";
+			exit(1);
+		}
+		options.setRowsPerStrip(rows);
+	}
+
+	return options;
+}
+
+bool
+CommandLine::hasTiffOptions() const
+{
+	return(
+		m_options.contains("tiff-compression") ||
+		m_options.contains("tiff-compression-bw") ||
+		m_options.contains("tiff-rows-per-strip")
+	);
+}
+
 bool
 CommandLine::hasMargins() const
 {
@@ -35,6 +35,7 @@
 #include "ImageFileInfo.h"
 #include "Margins.h"
 #include "Despeckle.h"
+#include "TiffWriter.h"
 
 /**
  * CommandLine is a singleton simulation.
@@ -81,6 +82,10 @@ public:
 	bool hasDespeckle() const { return contains("despeckle"); }
 	bool hasDewarping() const { return contains("dewarping"); }
 	bool hasDepthPerception() const { return contains("dewarping"); }
+	bool hasThreads() const { return contains("threads"); }
+	bool hasTiffOptions() const;
+	bool hasScratchDir() const { return contains("scratch-dir"); }
+	bool hasTraceFile() const { return contains("trace"); }
 
 	page_split::LayoutType getLayout() const { return m_layoutType; }
 	Qt::LayoutDirection getLayoutDirection() const { return m_layoutDirection; }
@@ -99,6 +104,10 @@ public:
 	output::DewarpingMode getDewarpingMode() const { return m_dewarpingMode; }
 	output::DespeckleLevel getDespeckleLevel() const { return m_despeckleLevel; }
 	output::DepthPerception getDepthPerception() const { return m_depthPerception; }
+	int getThreads() const { return m_threads; }
+	TiffWriter::Options const& getTiffOptions() const { return m_tiffOptions; }
+	QString getScratchDir() const { return m_options.value("scratch-dir"); }
+	QString getTraceFile() const { return m_options.value("trace"); }
 
 	bool help() { return m_options.contains("help"); }
 	void printHelp();
@@ -140,6 +149,8 @@ private:
 	output::DewarpingMode m_dewarpingMode;
 	output::DespeckleLevel m_despeckleLevel;
 	output::DepthPerception m_depthPerception;
+	int m_threads;
+	TiffWriter::Options m_tiffOptions;
 
 	void parseCli(QStringList const& argv);
 	void addImage(QString const& path);
@@ -161,6 +172,8 @@ private:
 	output::DewarpingMode fetchDewarpingMode();
 	output::DespeckleLevel fetchDespeckleLevel();
 	output::DepthPerception fetchDepthPerception();
+	int fetchThreads();
+	TiffWriter::Options fetchTiffOptions();
 };
 
 #endif
@@ -19,7 +19,10 @@
 */
 
 #include <vector>
+#include <memory>
+#include <string>
 #include <iostream>
+#include <stdexcept>
 #include <assert.h>
 
 #include "Utils.h"
@@ -40,6 +43,10 @@
 #include "ProjectReader.h"
 #include "OrthogonalRotation.h"
 #include "SelectedPage.h"
+#include "FilterData.h"
+#include "CompositeCacheDrivenTask.h"
+#include "filter_dc/UpToDateCollector.h"
+#include "NonCopyable.h"
 
 #include "filters/fix_orientation/Settings.h"
 #include "filters/fix_orientation/Filter.h"
@@ -67,7 +74,12 @@
 #include "filters/output/Task.h"
 #include "filters/output/CacheDrivenTask.h"
 
+#include <boost/foreach.hpp>
 #include <QMap>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QRunnable>
+#include <QThreadPool>
 #include <QDomDocument>
 
 #include "ConsoleBatch.h"
@@ -122,7 +134,7 @@ ConsoleBatch::ConsoleBatch(QString const project_file)
 }
 
 
-BackgroundTaskPtr
+IntrusivePtr<LoadFileTask>
 ConsoleBatch::createCompositeTask(
 		PageInfo const& page,
 		int const last_filter_idx)
@@ -176,7 +188,7 @@ ConsoleBatch::createCompositeTask(
 	}
 	assert(fix_orientation_task);
 	
-	return BackgroundTaskPtr(
+	return IntrusivePtr<LoadFileTask>(
 		new LoadFileTask(
 			BackgroundTask::BATCH,
 			page, m_ptrThumbnailCache, m_ptrPages, fix_orientation_task
@@ -184,6 +196,143 @@ ConsoleBatch::createCompositeTask(
 	);
 }
 
+IntrusivePtr<CompositeCacheDrivenTask>
+ConsoleBatch::createCompositeCacheDrivenTask(int const last_filter_idx)
+{
+	IntrusivePtr<fix_orientation::CacheDrivenTask> fix_orientation_task;
+	IntrusivePtr<page_split::CacheDrivenTask> page_split_task;
+	IntrusivePtr<deskew::CacheDrivenTask> deskew_task;
+	IntrusivePtr<select_content::CacheDrivenTask> select_content_task;
+	IntrusivePtr<page_layout::CacheDrivenTask> page_layout_task;
+	IntrusivePtr<output::CacheDrivenTask> output_task;
+
+	if (last_filter_idx >= m_ptrStages->outputFilterIdx()) {
+		output_task = m_ptrStages->outputFilter()
+				->createCacheDrivenTask(m_outFileNameGen);
+	}
+	if (last_filter_idx >= m_ptrStages->pageLayoutFilterIdx()) {
+		page_layout_task = m_ptrStages->pageLayoutFilter()
+				->createCacheDrivenTask(output_task);
+	}
+	if (last_filter_idx >= m_ptrStages->selectContentFilterIdx()) {
+		select_content_task = m_ptrStages->selectContentFilter()
+				->createCacheDrivenTask(page_layout_task);
+	}
+	if (last_filter_idx >= m_ptrStages->deskewFilterIdx()) {
+		deskew_task = m_ptrStages->deskewFilter()
+				->createCacheDrivenTask(select_content_task);
+	}
+	if (last_filter_idx >= m_ptrStages->pageSplitFilterIdx()) {
+		page_split_task = m_ptrStages->pageSplitFilter()
+				->createCacheDrivenTask(deskew_task);
+	}
+	if (last_filter_idx >= m_ptrStages->fixOrientationFilterIdx()) {
+		fix_orientation_task = m_ptrStages->fixOrientationFilter()
+				->createCacheDrivenTask(page_split_task);
+	}
+
+	assert(fix_orientation_task);
+
+	return fix_orientation_task;
+}
+
+
+class ConsoleBatch::ProgressReporter
+{
+	DECLARE_NON_COPYABLE(ProgressReporter)
+public:
+	ProgressReporter(std::vector<IntrusivePtr<LoadFileTask> > const& tasks, bool verbose)
+	: m_tasks(tasks), m_numFinished(0), m_verbose(verbose) {}
+
+	void pageStarted(PageInfo const& page) {
+		QMutexLocker const locker(&m_mutex);
+		if (m_verbose) {
+			std::cout << "\tProcessing: " << page.imageId().filePath().toAscii().constData() << "\n";
+		}
+	}
+
+	void pageFinished(PageInfo const& page, char const* status = "Processed") {
+		QMutexLocker const locker(&m_mutex);
+		++m_numFinished;
+		if (m_verbose) {
+			std::cout << "\t" << status << ": " << page.imageId().filePath().toAscii().constData()
+				<< " (" << m_numFinished << "/" << m_tasks.size() << ")\n";
+		}
+	}
+
+	/**
+	 * Remembers the first error and cancels the tasks that are still
+	 * pending, so the remaining workers finish quickly.
+	 */
+	void pageFailed(std::string const& error) {
+		QMutexLocker const locker(&m_mutex);
+		if (m_error.empty()) {
+			m_error = error;
+			for (unsigned i = 0; i < m_tasks.size(); ++i) {
+				m_tasks[i]->cancel();
+			}
+		}
+	}
+
+	void throwIfFailed() const {
+		QMutexLocker const locker(&m_mutex);
+		if (!m_error.empty()) {
+			throw std::runtime_error(m_error);
+		}
+	}
+private:
+	mutable QMutex m_mutex;
+	std::vector<IntrusivePtr<LoadFileTask> > m_tasks;
+	std::string m_error;
+	unsigned m_numFinished;
+	bool m_verbose;
+};
+
+
+/**
+ * Processes the pages sharing a source image, decoding that image only once.
+ */
+class ConsoleBatch::ImageRunner : public QRunnable
+{
+public:
+	ImageRunner(ProgressReporter& reporter) : m_rReporter(reporter) {}
+
+	void addPage(PageInfo const& page, IntrusivePtr<LoadFileTask> const& task) {
+		m_pages.push_back(page);
+		m_tasks.push_back(task);
+	}
+
+	virtual void run() {
+		try {
+			m_rReporter.pageStarted(m_pages.front());
+			std::auto_ptr<FilterData> const data(m_tasks.front()->loadFilterData());
+			for (unsigned i = 0; i < m_tasks.size(); ++i) {
+				m_tasks[i]->process(data.get());
+				m_rReporter.pageFinished(m_pages[i]);
+			}
+		} catch (std::exception const& e) {
+			m_rReporter.pageFailed(e.what());
+		}
+	}
+private:
+	ProgressReporter& m_rReporter;
+	std::vector<PageInfo> m_pages;
+	std::vector<IntrusivePtr<LoadFileTask> > m_tasks;
+};
+
+
+class ConsoleBatch::UpToDateChecker : public UpToDateCollector
+{
+public:
+	UpToDateChecker() : m_upToDate(false) {}
+
+	virtual void processUpToDate() { m_upToDate = true; }
+
+	bool upToDate() const { return m_upToDate; }
+private:
+	bool m_upToDate;
+};
+
 
 // process the image vector **images** and save output to **output_dir**
 void
@@ -207,20 +356,104 @@ ConsoleBatch::process()
 		endFilterIdx = ef;
 	}
 
-	for (int j=startFilterIdx; j<=endFilterIdx; j++) {
-		if (cli.isVerbose())
-			std::cout << "Filter: " << (j+1) << "\n";
+	int const num_threads = cli.getThreads();
 
+	int first = startFilterIdx;
+	while (first <= endFilterIdx) {
+		int const last = lastFilterOfPass(first, endFilterIdx);
+
+		// Page splitting may change the set of pages, so it has to be
+		// re-evaluated for every pass rather than once.
 		PageSequence page_sequence = m_ptrPages->toPageSequence(PAGE_VIEW);
-		setupFilter(j, page_sequence.selectAll());
-		for (unsigned i=0; i<page_sequence.numPages(); i++) {
-			PageInfo page = page_sequence.pageAt(i);
+		for (int j = first; j <= last; ++j) {
 			if (cli.isVerbose())
-				std::cout << "\tProcessing: " << page.imageId().filePath().toAscii().constData() << "\n";
-			BackgroundTaskPtr bgTask = createCompositeTask(page, j);
-			(*bgTask)();
+				std::cout << "Filter: " << (j+1) << "\n";
+			setupFilter(j, page_sequence.selectAll());
+		}
+
+		processPages(page_sequence, last, num_threads);
+		first = last + 1;
+	}
+}
+
+int
+ConsoleBatch::lastFilterOfPass(int const first_filter_idx, int const end_filter_idx) const
+{
+	int const barriers[] = {
+		m_ptrStages->pageSplitFilterIdx(),
+		m_ptrStages->pageLayoutFilterIdx()
+	};
+
+	int last = end_filter_idx;
+	for (unsigned i = 0; i < sizeof(barriers)/sizeof(barriers[0]); ++i) {
+		if (barriers[i] >= first_filter_idx && barriers[i] < last) {
+			last = barriers[i];
+		}
+	}
+
+	return last;
+}
+
+void
+ConsoleBatch::processPages(
+	PageSequence const& page_sequence, int const last_filter_idx, int const num_threads)
+{
+	CommandLine const& cli = CommandLine::get();
+
+	// Pages whose parameters are valid for every filter in this pass
+	// don't need their image to be decoded at all.  The output filter
+	// always needs pixels, so don't bother checking it.
+	IntrusivePtr<CompositeCacheDrivenTask> cache_driven_task;
+	if (last_filter_idx < m_ptrStages->outputFilterIdx()) {
+		cache_driven_task = createCompositeCacheDrivenTask(last_filter_idx);
+	}
+
+	// Tasks are created up-front and in page order, as createCompositeTask()
+	// is not thread-safe and the resulting output must not depend on
+	// the order the workers happen to finish in.
+	std::vector<PageInfo> pages;
+	std::vector<IntrusivePtr<LoadFileTask> > tasks;
+	for (unsigned i=0; i<page_sequence.numPages(); i++) {
+		PageInfo const page(page_sequence.pageAt(i));
+		if (cache_driven_task.get()) {
+			UpToDateChecker checker;
+			cache_driven_task->process(page, &checker);
+			if (checker.upToDate()) {
+				if (cli.isVerbose())
+					std::cout << "\tUp to date: " << page.imageId().filePath().toAscii().constData() << "\n";
+				continue;
+			}
 		}
+		pages.push_back(page);
+		tasks.push_back(createCompositeTask(page, last_filter_idx));
 	}
+
+	ProgressReporter reporter(tasks, cli.isVerbose());
+
+	// Pages of the same image follow each other in a page sequence.
+	std::vector<ImageRunner*> runners;
+	for (unsigned i=0; i<pages.size(); i++) {
+		if (i == 0 || pages[i].imageId() != pages[i-1].imageId()) {
+			runners.push_back(new ImageRunner(reporter));
+		}
+		runners.back()->addPage(pages[i], tasks[i]);
+	}
+
+	if (num_threads <= 1) {
+		BOOST_FOREACH(ImageRunner* runner, runners) {
+			runner->run();
+			delete runner;
+		}
+	} else {
+		QThreadPool pool;
+		pool.setMaxThreadCount(num_threads);
+		BOOST_FOREACH(ImageRunner* runner, runners) {
+			pool.start(runner);
+		}
+		pool.waitForDone();
+	}
+
+	reporter.throwIfFailed();
 }
 
 void
@@ -365,6 +598,11 @@ ConsoleBatch::setupOutput(std::set<PageId> allPages)
 	IntrusivePtr<output::Filter> output = m_ptrStages->outputFilter(); 
 	CommandLine const& cli = CommandLine::get();
 
+	// This makes previously written files out of date, if the options change.
+	if (cli.hasTiffOptions()) {
+		output->getSettings()->setTiffOptions(cli.getTiffOptions());
+	}
+
 	for (std::set<PageId>::iterator i=allPages.begin(); i!=allPages.end(); i++) {
 		PageId page = *i;
 
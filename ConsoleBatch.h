@@ -30,6 +30,7 @@
 #include "OutputFileNameGenerator.h"
 #include "PageId.h"
 #include "PageInfo.h"
+#include "PageSequence.h"
 #include "PageView.h"
 #include "ProjectPages.h"
 #include "ImageFileInfo.h"
@@ -38,6 +39,8 @@
 #include "StageSequence.h"
 #include "PageSelectionAccessor.h"
 #include "ProjectReader.h"
+#include "LoadFileTask.h"
+#include "CompositeCacheDrivenTask.h"
 
 
 class ConsoleBatch
@@ -71,10 +74,28 @@ private:
 	void setupPageLayout(std::set<PageId> allPages);
 	void setupOutput(std::set<PageId> allPages);
 
-	BackgroundTaskPtr createCompositeTask(
+	IntrusivePtr<LoadFileTask> createCompositeTask(
 		PageInfo const& page,
 		int const last_filter_idx
 	);
+
+	IntrusivePtr<CompositeCacheDrivenTask>
+	createCompositeCacheDrivenTask(int last_filter_idx);
+
+	/**
+	 * \brief Returns the last filter that may run in the same pass as \p first_filter_idx.
+	 *
+	 * A pass ends where a later stage needs data that only becomes available
+	 * once every page went through the pass: the page set after page_split
+	 * and the aggregate page size computed by page_layout.
+	 */
+	int lastFilterOfPass(int first_filter_idx, int end_filter_idx) const;
+
+	void processPages(PageSequence const& pages, int last_filter_idx, int num_threads);
+
+	class ProgressReporter;
+	class ImageRunner;
+	class UpToDateChecker;
 };
 
 #endif
@@ -23,6 +23,9 @@
 #include "FastQueue.h"
 #include "imageproc/BinaryImage.h"
 #include "imageproc/ConnectivityMap.h"
+#include "imageproc/RunLengthLabeler.h"
+#include "imageproc/ConnComp.h"
+#include "imageproc/BWColor.h"
 #include "imageproc/Connectivity.h"
 #ifndef Q_MOC_RUN
 #include <boost/foreach.hpp>
@@ -171,30 +174,6 @@ uint32_t const Component::ANCHORED_TO_BIG;
 uint32_t const Component::ANCHORED_TO_SMALL;
 uint32_t const Component::TAG_MASK;
 
-struct BoundingBox
-{
-	int top;
-	int left;
-	int bottom;
-	int right;
-
-	BoundingBox() {
-		top = left = std::numeric_limits<int>::max();
-		bottom = right = std::numeric_limits<int>::min();
-	}
-
-	int width() const { return right - left + 1; }
-
-	int height() const { return bottom - top + 1; }
-
-	void extend(int x, int y) {
-		top = std::min(top, y);
-		left = std::min(left, x);
-		bottom = std::max(bottom, y);
-		right = std::max(right, x);
-	}
-};
-
 struct Vector
 {
 	int16_t x;
@@ -296,20 +275,30 @@ struct TargetSourceConn
 /**
  * \brief If the association didn't exist, create it,
  *        otherwise the minimum distance.
+ *
+ * \param hint An association that may be the one we are looking for,
+ *        or conns.end().  If it is, the map lookup is skipped.
+ * \return The created or updated association.
  */
-void updateDistance(
+std::map<Connection, uint32_t>::iterator updateDistance(
 	std::map<Connection, uint32_t>& conns,
+	std::map<Connection, uint32_t>::iterator hint,
 	uint32_t label1, uint32_t label2, uint32_t sqdist)
 {
 	typedef std::map<Connection, uint32_t> Connections;
 	
 	Connection const conn(label1, label2);
-	Connections::iterator it(conns.lower_bound(conn));
-	if (it == conns.end() || conn < it->first) {
-		conns.insert(Connections::value_type(conn, sqdist));
-	} else if (sqdist < it->second) {
+	Connections::iterator it(hint);
+	if (it == conns.end() || it->first < conn || conn < it->first) {
+		it = conns.lower_bound(conn);
+		if (it == conns.end() || conn < it->first) {
+			return conns.insert(it, Connections::value_type(conn, sqdist));
+		}
+	}
+	if (sqdist < it->second) {
 		it->second = sqdist;
 	}
+	return it;
 }
 
 /**
@@ -661,7 +650,17 @@ void voronoiDistances(
 	int const width = cmap.size().width();
 	int const height = cmap.size().height();
 	
-	int const offsets[] = { -cmap.stride(), -1, 1, cmap.stride() };
+	// The distance computed for a pair of neighboring pixels doesn't
+	// depend on which of them is the central one, so looking at
+	// the right and bottom neighbors is enough to see every pair.
+	int const offsets[] = { 1, cmap.stride() };
+	// The border between two Voronoi regions produces a candidate distance
+	// for each of its pixels.  Remembering the recently updated associations
+	// in a small direct-mapped cache saves most of the map lookups.
+	int const cache_bits = 10;
+	std::vector<std::map<Connection, uint32_t>::iterator> cache(
+		1 << cache_bits, conns.end()
+	);
 	
 	uint32_t const* const cmap_data = cmap.data();
 	Distance const* const distance_data = &distance_matrix[0] + width + 3;
@@ -673,7 +672,7 @@ void voronoiDistances(
 			int const x1 = x + distance_data[offset].vec.x;
 			int const y1 = y + distance_data[offset].vec.y;
 			
-			for (int i = 0; i < 4; ++i) {
+			for (int i = 0; i < 2; ++i) {
 				int const nbh_offset = offset + offsets[i];
 				uint32_t const nbh_label = cmap_data[nbh_offset];
 				if (nbh_label == 0 || nbh_label == label) {
@@ -688,7 +687,10 @@ void voronoiDistances(
 				int const dy = y1 - y2;
 				uint32_t const sqdist = dx * dx + dy * dy;
 				
-				updateDistance(conns, label, nbh_label, sqdist);
+				uint32_t const hash = (label ^ nbh_label) * uint32_t(2654435761u);
+				std::map<Connection, uint32_t>::iterator& hint =
+						cache[hash >> (32 - cache_bits)];
+				hint = updateDistance(conns, hint, label, nbh_label, sqdist);
 			}
 		}
 	}
@@ -714,73 +716,68 @@ Despeckle::despeckleInPlace(
 {
 	Settings const settings(Settings::get(level, dpi));
 
-	ConnectivityMap cmap(image, CONN8);
-	if (cmap.maxLabel() == 0) {
+	// Pixel counts and bounding boxes are collected from the runs
+	// the labeler works with, rather than from a label map.
+	RunLengthLabeler const labeler(image, CONN8);
+	uint32_t const num_labels = labeler.numComponents();
+	if (num_labels == 0) {
 		// Completely white image?
 		return;
 	}
 
 	status.throwIfCancelled();
-	
-	std::vector<Component> components(cmap.maxLabel() + 1);
-	std::vector<BoundingBox> bounding_boxes(cmap.maxLabel() + 1);
 
 	int const width = image.width();
 	int const height = image.height();
 
-	uint32_t* const cmap_data = cmap.data();
-	
-	// Count the number of pixels and a bounding rect of each component.
-	uint32_t* cmap_line = cmap_data;
-	int const cmap_stride = cmap.stride();
-	for (int y = 0; y < height; ++y) {
-		for (int x = 0; x < width; ++x) {
-			uint32_t const label = cmap_line[x];
-			++components[label].num_pixels;
-			bounding_boxes[label].extend(x, y);
-		}
-		cmap_line += cmap_stride;
-	}
-	
-	status.throwIfCancelled();
+	std::vector<Component> components(num_labels + 1);
 
 	// Unify big components into one.
-	std::vector<uint32_t> remapping_table(components.size());
+	std::vector<uint32_t> remapping_table(num_labels + 1, 0);
 	uint32_t unified_big_component = 0;
 	uint32_t next_avail_component = 1;
-	for (uint32_t label = 1; label <= cmap.maxLabel(); ++label) {
-		if (bounding_boxes[label].width() < settings.bigObjectThreshold &&
-				bounding_boxes[label].height() < settings.bigObjectThreshold) {
-			components[next_avail_component] = components[label];
-			remapping_table[label] = next_avail_component;
-			++next_avail_component;
-		} else {
-			if (unified_big_component == 0) {
-				unified_big_component = next_avail_component;
+	{
+		std::vector<ConnComp> const stats(labeler.components());
+		for (uint32_t label = 1; label <= num_labels; ++label) {
+			ConnComp const& cc = stats[label - 1];
+			if (cc.width() < settings.bigObjectThreshold &&
+					cc.height() < settings.bigObjectThreshold) {
+				components[next_avail_component].num_pixels = cc.pixCount();
+				remapping_table[label] = next_avail_component;
 				++next_avail_component;
-				components[unified_big_component] = components[label];
-				// Set num_pixels to a large value so that canBeAttachedTo()
-				// always allows attaching to any such component.
-				components[unified_big_component].num_pixels = width * height;
+			} else {
+				if (unified_big_component == 0) {
+					unified_big_component = next_avail_component;
+					++next_avail_component;
+					// Set num_pixels to a large value so that canBeAttachedTo()
+					// always allows attaching to any such component.
+					components[unified_big_component].num_pixels = width * height;
+				}
+				remapping_table[label] = unified_big_component;
 			}
-			remapping_table[label] = unified_big_component;
 		}
 	}
 	components.resize(next_avail_component);
-	std::vector<BoundingBox>().swap(bounding_boxes); // We don't need them any more.
-	
+
+	if (unified_big_component == 0) {
+		// Nothing to anchor to, so everything goes.
+		image.fill(WHITE);
+		return;
+	} else if (next_avail_component == 2) {
+		// Big components only.  Those are never removed.
+		return;
+	}
+
 	status.throwIfCancelled();
 
 	uint32_t const max_label = next_avail_component - 1;
 	
-	// Remapping individual pixels.
-	cmap_line = cmap_data;
-	for (int y = 0; y < height; ++y) {
-		for (int x = 0; x < width; ++x) {
-			cmap_line[x] = remapping_table[cmap_line[x]];
-		}
-		cmap_line += cmap_stride;
-	}
+	// Labels of big components are remapped as they are written.
+	ConnectivityMap cmap(image.size());
+	labeler.writeLabels(cmap.data(), cmap.stride(), remapping_table);
+	cmap.setMaxLabel(max_label);
+	uint32_t* const cmap_data = cmap.data();
+
 	if (dbg) {
 		dbg->add(cmap.visualized(), "big_components_unified");
 	}
@@ -955,17 +952,10 @@ Despeckle::despeckleInPlace(
 	status.throwIfCancelled();
 
 	// Remove unmarked components from the binary image.
-	uint32_t const msb = uint32_t(1) << 31;
-	uint32_t* image_line = image.data();
-	int const image_stride = image.wordsPerLine();
-	cmap_line = cmap_data;
-	for (int y = 0; y < height; ++y) {
-		for (int x = 0; x < width; ++x) {
-			if (!components[cmap_line[x]].anchoredToBig()) {
-				image_line[x >> 5] &= ~(msb >> (x & 31));
-			}
-		}
-		image_line += image_stride;
-		cmap_line += cmap_stride;
+	// Only the runs of removed components are touched.
+	std::vector<uint8_t> erase(num_labels + 1, 0);
+	for (uint32_t label = 1; label <= num_labels; ++label) {
+		erase[label] = !components[remapping_table[label]].anchoredToBig();
 	}
+	labeler.eraseComponents(image, erase);
 }
@@ -49,6 +49,9 @@ public:
 
 	/**
 	 * \brief A slightly faster, in-place version of despeckle().
+	 *
+	 * Memory use is proportional to the image size: a 32-bit label and
+	 * a 32-bit Voronoi distance vector are kept for every pixel.
 	 */
 	static void despeckleInPlace(
 		imageproc::BinaryImage& image, Dpi const& dpi,
@@ -0,0 +1,124 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+    Copyright (C)  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "FilterDataCache.h"
+#include "ImageId.h"
+#include "ImageMetadata.h"
+#include <QMutexLocker>
+#include <QFileInfo>
+#include <QDateTime>
+#include <QStringList>
+#include <QImage>
+#include <algorithm>
+
+FilterDataCache&
+FilterDataCache::instance()
+{
+	static FilterDataCache object;
+	return object;
+}
+
+FilterDataCache::FilterDataCache()
+:	m_cache(DEFAULT_MAX_SIZE_MB)
+{
+}
+
+std::auto_ptr<FilterData>
+FilterDataCache::find(ImageId const& image_id, ImageMetadata const& metadata) const
+{
+	QString const key(makeKey(image_id, metadata));
+
+	QMutexLocker const locker(&m_mutex);
+
+	FilterData const* data = m_cache.object(key);
+	if (!data) {
+		return std::auto_ptr<FilterData>();
+	}
+
+	// Images are implicitly shared, so this copy is cheap.
+	return std::auto_ptr<FilterData>(new FilterData(*data));
+}
+
+void
+FilterDataCache::insert(
+	ImageId const& image_id, ImageMetadata const& metadata, FilterData const& data)
+{
+	QString const key(makeKey(image_id, metadata));
+
+	qint64 const bytes = qint64(data.origImage().byteCount())
+		+ qint64(data.grayImage().stride()) * data.grayImage().height();
+	int const cost_mb = int(std::max<qint64>(1, bytes >> 20));
+
+	QMutexLocker const locker(&m_mutex);
+
+	// There is no point in keeping entries for an outdated version of the file.
+	removeByPrefixLocked(makeKeyPrefix(image_id));
+
+	// QCache takes ownership.  If the entry doesn't fit,
+	// it's deleted right away, which is fine.
+	m_cache.insert(key, new FilterData(data), cost_mb);
+}
+
+void
+FilterDataCache::remove(ImageId const& image_id)
+{
+	QMutexLocker const locker(&m_mutex);
+	removeByPrefixLocked(makeKeyPrefix(image_id));
+}
+
+void
+FilterDataCache::clear()
+{
+	QMutexLocker const locker(&m_mutex);
+	m_cache.clear();
+}
+
+void
+FilterDataCache::setMaxSizeMB(int const size_mb)
+{
+	QMutexLocker const locker(&m_mutex);
+	m_cache.setMaxCost(size_mb);
+}
+
+void
+FilterDataCache::removeByPrefixLocked(QString const& prefix)
+{
+	QStringList const keys(m_cache.keys());
+	for (int i = 0; i < keys.size(); ++i) {
+		if (keys[i].startsWith(prefix)) {
+			m_cache.remove(keys[i]);
+		}
+	}
+}
+
+QString
+FilterDataCache::makeKeyPrefix(ImageId const& image_id)
+{
+	return QString("%1\n%2\n").arg(image_id.filePath()).arg(image_id.page());
+}
+
+QString
+FilterDataCache::makeKey(ImageId const& image_id, ImageMetadata const& metadata)
+{
+	QFileInfo const file_info(image_id.filePath());
+	return makeKeyPrefix(image_id) + QString("%1\n%2\n%3x%4").arg(
+		file_info.lastModified().toTime_t()
+	).arg(file_info.size()).arg(
+		metadata.dpi().horizontal()
+	).arg(metadata.dpi().vertical());
+}
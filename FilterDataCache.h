@@ -0,0 +1,102 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+    Copyright (C)  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef FILTER_DATA_CACHE_H_
+#define FILTER_DATA_CACHE_H_
+
+#include "NonCopyable.h"
+#include "FilterData.h"
+#include <QCache>
+#include <QMutex>
+#include <QString>
+#include <memory>
+
+class ImageId;
+class ImageMetadata;
+
+/**
+ * \brief Keeps recently decoded images along with their grayscale versions.
+ *
+ * Switching between filters or going back and forth between pages makes
+ * LoadFileTask load the same image again and again.  This cache lets it
+ * skip both decoding and grayscale conversion in such cases.
+ *
+ * An entry is keyed by the image id, the file's size and modification time
+ * and the DPI it's going to be presented with.  Replacing the file on disk
+ * or changing its DPI therefore won't produce stale data.
+ *
+ * Only decoding and grayscale conversion are saved this way.  The pixel work
+ * of later stages is skipped by the stages themselves, when the parameters
+ * they stored still match their Dependencies.  There is no on-disk tier,
+ * as reading back a decoded raster is no faster than decoding it again.
+ *
+ * All methods are thread-safe.
+ */
+class FilterDataCache
+{
+	DECLARE_NON_COPYABLE(FilterDataCache)
+public:
+	/**
+	 * The budget unless overridden with the "settings/image_cache_mb" setting.
+	 */
+	static int const DEFAULT_MAX_SIZE_MB = 256;
+
+	static FilterDataCache& instance();
+
+	/**
+	 * \brief Looks up an entry.
+	 *
+	 * \return The cached data or a null pointer if there is no
+	 *         up-to-date entry.
+	 */
+	std::auto_ptr<FilterData> find(
+		ImageId const& image_id, ImageMetadata const& metadata) const;
+
+	void insert(
+		ImageId const& image_id, ImageMetadata const& metadata,
+		FilterData const& data);
+
+	/**
+	 * \brief Removes all entries for an image, regardless of their version.
+	 *
+	 * To be called when an image leaves the project.
+	 */
+	void remove(ImageId const& image_id);
+
+	void clear();
+
+	/**
+	 * \brief Sets the memory budget, in megabytes.
+	 *
+	 * Zero disables caching.
+	 */
+	void setMaxSizeMB(int size_mb);
+private:
+	FilterDataCache();
+
+	static QString makeKey(ImageId const& image_id, ImageMetadata const& metadata);
+
+	static QString makeKeyPrefix(ImageId const& image_id);
+
+	void removeByPrefixLocked(QString const& prefix);
+
+	mutable QMutex m_mutex;
+	mutable QCache<QString, FilterData> m_cache;
+};
+
+#endif
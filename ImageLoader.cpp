@@ -19,10 +19,37 @@
 #include "ImageLoader.h"
 #include "TiffReader.h"
 #include "ImageId.h"
+#include "ImageMetadata.h"
+#include "ImageMetadataLoader.h"
 #include <QImage>
+#include <QImageReader>
 #include <QString>
 #include <QIODevice>
 #include <QFile>
+#include <QSize>
+#include <Qt>
+
+namespace
+{
+
+class PageSizeCollector
+{
+public:
+	PageSizeCollector(int page_num, QSize& size)
+	: m_pageNum(page_num), m_curPage(0), m_rSize(size) {}
+
+	void operator()(ImageMetadata const& metadata) {
+		if (m_curPage++ == m_pageNum) {
+			m_rSize = metadata.size();
+		}
+	}
+private:
+	int m_pageNum;
+	int m_curPage;
+	QSize& m_rSize;
+};
+
+} // anonymous namespace
 
 QImage
 ImageLoader::load(ImageId const& image_id)
@@ -56,3 +83,89 @@ ImageLoader::load(QIODevice& io_dev, int const page_num)
 	image.load(&io_dev, 0);
 	return image;
 }
+
+QImage
+ImageLoader::loadReduced(QIODevice& io_dev, int const page_num, int const reduction)
+{
+	if (TiffReader::canRead(io_dev)) {
+		return TiffReader::readImage(io_dev, page_num, reduction);
+	}
+	
+	if (page_num != 0) {
+		// Qt can only load the first page of multi-page images.
+		return QImage();
+	}
+
+	QImageReader reader(&io_dev);
+	QSize const full_size(reader.size());
+	if (!full_size.isValid()) {
+		// The image plugin can't tell the size without decoding the image,
+		// which means it won't be able to scale it either.
+		QImage image(reader.read());
+		if (image.isNull() || reduction <= 0) {
+			return image;
+		}
+		int const block = 1 << reduction;
+		QSize const size(
+			(image.width() + block - 1) >> reduction,
+			(image.height() + block - 1) >> reduction
+		);
+		int const dpm_x = image.dotsPerMeterX();
+		int const dpm_y = image.dotsPerMeterY();
+		image = image.scaled(size, Qt::IgnoreAspectRatio, Qt::SmoothTransformation);
+		image.setDotsPerMeterX(dpm_x >> reduction);
+		image.setDotsPerMeterY(dpm_y >> reduction);
+		return image;
+	}
+
+	if (reduction > 0) {
+		int const block = 1 << reduction;
+		reader.setScaledSize(
+			QSize(
+				(full_size.width() + block - 1) >> reduction,
+				(full_size.height() + block - 1) >> reduction
+			)
+		);
+	}
+
+	QImage image(reader.read());
+	if (!image.isNull() && reduction > 0) {
+		// Both the plugins and QImageReader itself
+		// keep the original physical resolution.
+		image.setDotsPerMeterX(image.dotsPerMeterX() >> reduction);
+		image.setDotsPerMeterY(image.dotsPerMeterY() >> reduction);
+	}
+	return image;
+}
+
+QImage
+ImageLoader::loadDownscaled(ImageId const& image_id, QSize const& target_size)
+{
+	QSize full_size;
+	ImageMetadataLoader::load(
+		image_id.filePath(),
+		PageSizeCollector(image_id.zeroBasedPage(), full_size)
+	);
+	if (!full_size.isValid() || target_size.isEmpty()) {
+		return load(image_id);
+	}
+
+	int reduction = 0;
+	for (; reduction < 10; ++reduction) {
+		int const next = reduction + 1;
+		if ((full_size.width() >> next) < target_size.width() &&
+				(full_size.height() >> next) < target_size.height()) {
+			break;
+		}
+	}
+
+	if (reduction == 0) {
+		return load(image_id);
+	}
+
+	QFile file(image_id.filePath());
+	if (!file.open(QIODevice::ReadOnly)) {
+		return QImage();
+	}
+	return loadReduced(file, image_id.zeroBasedPage(), reduction);
+}
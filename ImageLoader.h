@@ -23,6 +23,7 @@ class ImageId;
 class QImage;
 class QString;
 class QIODevice;
+class QSize;
 
 class ImageLoader
 {
@@ -32,6 +33,30 @@ public:
 	static QImage load(ImageId const& image_id);
 	
 	static QImage load(QIODevice& io_dev, int page_num);
+
+	/**
+	 * \brief Loads a whole image, reduced as much as possible while
+	 *        still being able to produce a \p target_size image from it.
+	 *
+	 * That is, the image is reduced by the largest power of two that keeps
+	 * it at least as large as it would be after fitting it into
+	 * \p target_size with aspect ratio preserved.
+	 *
+	 * Only thumbnails are loaded this way.  Processing stages, skew and
+	 * page split detection included, get the full resolution image, as
+	 * it's passed on to later stages and their results are stored in its
+	 * pixel coordinates.
+	 */
+	static QImage loadDownscaled(ImageId const& image_id, QSize const& target_size);
+private:
+	/**
+	 * Loads an image downscaled by 2^reduction in both directions.
+	 * TIFF files are decoded band by band, making use of embedded reduced
+	 * resolution subfiles.  Other formats go through QImageReader, whose
+	 * JPEG plugin does the reduction in the DCT domain.  The pixel format
+	 * of the result may differ from what a full resolution load would produce.
+	 */
+	static QImage loadReduced(QIODevice& io_dev, int page_num, int reduction);
 };
 
 #endif
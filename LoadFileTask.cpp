@@ -30,6 +30,7 @@
 #include "Dpi.h"
 #include "Dpm.h"
 #include "FilterData.h"
+#include "FilterDataCache.h"
 #include "ImageLoader.h"
 #include <QCoreApplication>
 #include <QFile>
@@ -80,18 +81,54 @@ LoadFileTask::~LoadFileTask()
 FilterResultPtr
 LoadFileTask::operator()()
 {
+	std::auto_ptr<FilterData> const data(loadFilterData());
+	return process(data.get());
+}
+
+std::auto_ptr<FilterData>
+LoadFileTask::loadFilterData()
+{
+	// Batch processing visits every image once, so caching
+	// would only waste memory there.
+	bool const use_cache = type() == INTERACTIVE;
+
+	if (use_cache) {
+		std::auto_ptr<FilterData> data(
+			FilterDataCache::instance().find(m_imageId, m_imageMetadata)
+		);
+		if (data.get()) {
+			updateImageSizeIfChanged(data->origImage());
+			m_ptrThumbnailCache->ensureThumbnailExists(m_imageId, data->origImage());
+			return data;
+		}
+	}
+
 	QImage image(ImageLoader::load(m_imageId));
-	
+	if (image.isNull() || isCancelled()) {
+		return std::auto_ptr<FilterData>();
+	}
+
+	updateImageSizeIfChanged(image);
+	overrideDpi(image);
+	m_ptrThumbnailCache->ensureThumbnailExists(m_imageId, image);
+
+	std::auto_ptr<FilterData> data(new FilterData(image));
+	if (use_cache) {
+		FilterDataCache::instance().insert(m_imageId, m_imageMetadata, *data);
+	}
+	return data;
+}
+
+FilterResultPtr
+LoadFileTask::process(FilterData const* data)
+{
 	try {
 		throwIfCancelled();
 		
-		if (image.isNull()) {
+		if (!data) {
 			return FilterResultPtr(new ErrorResult(m_imageId.filePath()));
 		} else {
-			updateImageSizeIfChanged(image);
-			overrideDpi(image);
-			m_ptrThumbnailCache->ensureThumbnailExists(m_imageId, image);
-			return m_ptrNextTask->process(*this, FilterData(image));
+			return m_ptrNextTask->process(*this, *data);
 		}
 	} catch (CancelledException const&) {
 		return FilterResultPtr();
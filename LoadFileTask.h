@@ -25,10 +25,12 @@
 #include "IntrusivePtr.h"
 #include "ImageId.h"
 #include "ImageMetadata.h"
+#include <memory>
 
 class ThumbnailPixmapCache;
 class PageInfo;
 class ProjectPages;
+class FilterData;
 class QImage;
 
 namespace fix_orientation
@@ -48,6 +50,25 @@ public:
 	virtual ~LoadFileTask();
 	
 	virtual FilterResultPtr operator()();
+
+	/**
+	 * \brief Decodes the image and builds the data the filter chain starts from.
+	 *
+	 * Returns a null pointer if the image couldn't be loaded.
+	 * operator()() is equivalent to process(loadFilterData().get()).
+	 * The two steps are exposed separately so that several pages
+	 * of the same image can share a single decoded copy.
+	 */
+	std::auto_ptr<FilterData> loadFilterData();
+
+	/**
+	 * \brief Runs the filter chain on data previously produced by
+	 *        loadFilterData() of a task for the same image.
+	 *
+	 * A null \p data produces an error result, like a failure
+	 * to load the image would.
+	 */
+	FilterResultPtr process(FilterData const* data);
 private:
 	class ErrorResult;
 	
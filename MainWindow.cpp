@@ -31,6 +31,7 @@
 #include "PageOrderProvider.h"
 #include "ProcessingTaskQueue.h"
 #include "FileNameDisambiguator.h"
+#include "FilterDataCache.h"
 #include "OutputFileNameGenerator.h"
 #include "ImageInfo.h"
 #include "PageInfo.h"
@@ -303,6 +304,12 @@ MainWindow::MainWindow()
 	updateMainArea();
 
 	QSettings settings;
+	FilterDataCache::instance().setMaxSizeMB(
+		settings.value(
+			"settings/image_cache_mb", FilterDataCache::DEFAULT_MAX_SIZE_MB
+		).toInt()
+	);
+
 	if (settings.value("mainWindow/maximized") == false) {
 		QVariant const geom(
 			settings.value("mainWindow/nonMaximizedGeometry")
@@ -321,6 +328,9 @@ MainWindow::~MainWindow()
 		m_ptrBatchQueue->cancelAndClear();
 	}
 	m_ptrWorkerThread->shutdown();
+	BOOST_FOREACH(boost::shared_ptr<WorkerThread> const& worker, m_extraBatchWorkers) {
+		worker->shutdown();
+	}
 	
 	removeWidgetsFromLayout(m_pImageFrameLayout);
 	removeWidgetsFromLayout(m_pOptionsFrameLayout);
@@ -353,6 +363,7 @@ MainWindow::switchToNewProject(
 {
 	stopBatchProcessing(CLEAR_MAIN_AREA);
 	m_ptrInteractiveQueue->cancelAndClear();
+	FilterDataCache::instance().clear();
 
 	Utils::maybeCreateCacheDir(out_dir);
 	
@@ -882,6 +893,9 @@ MainWindow::performRelinking(IntrusivePtr<AbstractRelinker> const& relinker)
 	m_ptrStages->performRelinking(*relinker);
 	m_outFileNameGen.performRelinking(*relinker);
 
+	// Images are now found under different paths.
+	FilterDataCache::instance().clear();
+
 	Utils::maybeCreateCacheDir(m_outFileNameGen.outDir());
 
 	m_ptrThumbnailCache->setThumbDir(Utils::outputDirToThumbDir(m_outFileNameGen.outDir()));
@@ -1184,9 +1198,17 @@ MainWindow::startBatchProcessing()
 	filterList->setBatchProcessingInProgress(true);
 	filterList->setEnabled(false);
 
-	BackgroundTaskPtr const task(m_ptrBatchQueue->takeForProcessing());
-	if (task) {
-		m_ptrWorkerThread->performTask(task);
+	int const num_workers = std::max(
+		1, QSettings().value("settings/batch_processing_threads", 1).toInt()
+	);
+	ensureBatchWorkers(num_workers);
+
+	if (dispatchBatchTask(m_ptrWorkerThread.get())) {
+		for (int i = 0; i < num_workers - 1; ++i) {
+			if (!dispatchBatchTask(m_extraBatchWorkers[i].get())) {
+				break;
+			}
+		}
 	} else {
 		stopBatchProcessing();
 	}
@@ -1228,6 +1250,32 @@ MainWindow::stopBatchProcessing(MainAreaAction main_area)
 	}
 }
 
+void
+MainWindow::ensureBatchWorkers(int const num_workers)
+{
+	while ((int)m_extraBatchWorkers.size() < num_workers - 1) {
+		boost::shared_ptr<WorkerThread> worker(new WorkerThread);
+		connect(
+			worker.get(),
+			SIGNAL(taskResult(BackgroundTaskPtr const&, FilterResultPtr const&)),
+			this, SLOT(filterResult(BackgroundTaskPtr const&, FilterResultPtr const&))
+		);
+		m_extraBatchWorkers.push_back(worker);
+	}
+}
+
+bool
+MainWindow::dispatchBatchTask(WorkerThread* worker)
+{
+	BackgroundTaskPtr const task(m_ptrBatchQueue->takeForProcessing());
+	if (!task) {
+		return false;
+	}
+
+	worker->performTask(task);
+	return true;
+}
+
 void
 MainWindow::filterResult(BackgroundTaskPtr const& task, FilterResultPtr const& result)
 {
@@ -1276,9 +1324,9 @@ MainWindow::filterResult(BackgroundTaskPtr const& task, FilterResultPtr const& r
 			return;
 		}
 
-		BackgroundTaskPtr const task(m_ptrBatchQueue->takeForProcessing());
-		if (task) {
-			m_ptrWorkerThread->performTask(task);
+		// Keep the worker that has just become free busy.
+		if (WorkerThread* worker = qobject_cast<WorkerThread*>(sender())) {
+			dispatchBatchTask(worker);
 		}
 
 		PageInfo const page(m_ptrBatchQueue->selectedPage());
@@ -2008,6 +2056,10 @@ MainWindow::removeFromProject(std::set<PageId> const& pages)
 
 	m_ptrPages->removePages(pages);
 	m_ptrThumbSequence->removePages(pages);
+
+	BOOST_FOREACH(PageId const& page_id, pages) {
+		FilterDataCache::instance().remove(page_id.imageId());
+	}
 	
 	if (m_ptrThumbSequence->selectionLeader().isNull()) {
 		m_ptrThumbSequence->setSelection(m_ptrThumbSequence->firstPage().id());
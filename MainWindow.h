@@ -35,6 +35,7 @@
 #include "BeforeOrAfter.h"
 #ifndef Q_MOC_RUN
 #include <boost/function.hpp>
+#include <boost/shared_ptr.hpp>
 #endif
 #include <QMainWindow>
 #include <QString>
@@ -218,6 +219,22 @@ private:
 	
 	bool isBatchProcessingInProgress() const;
 
+	/**
+	 * \brief Makes sure there are at least \p num_workers threads
+	 *        available for batch processing.
+	 *
+	 * The first one is always m_ptrWorkerThread, which is shared
+	 * with interactive processing.
+	 */
+	void ensureBatchWorkers(int num_workers);
+
+	/**
+	 * \brief Hands the next pending batch task to \p worker.
+	 *
+	 * \return false if there are no more tasks to take.
+	 */
+	bool dispatchBatchTask(WorkerThread* worker);
+
 	bool isProjectLoaded() const;
 	
 	bool isBelowSelectContent() const;
@@ -280,6 +297,7 @@ private:
 	IntrusivePtr<ThumbnailPixmapCache> m_ptrThumbnailCache;
 	std::auto_ptr<ThumbnailSequence> m_ptrThumbSequence;
 	std::auto_ptr<WorkerThread> m_ptrWorkerThread;
+	std::vector<boost::shared_ptr<WorkerThread> > m_extraBatchWorkers;
 	std::auto_ptr<ProcessingTaskQueue> m_ptrBatchQueue;
 	std::auto_ptr<ProcessingTaskQueue> m_ptrInteractiveQueue;
 	QStackedLayout* m_pImageFrameLayout;
@@ -23,7 +23,8 @@ ProcessingTaskQueue::Entry::Entry(
 	PageInfo const& page_info, BackgroundTaskPtr const& tsk)
 :	pageInfo(page_info),
 	task(tsk),
-	takenForProcessing(false)
+	takenForProcessing(false),
+	finished(false)
 {
 }
 
@@ -77,22 +78,27 @@ ProcessingTaskQueue::processingFinished(BackgroundTaskPtr const& task)
 			return;
 		}
 
-		if (it->task == task) {
+		if (it->task == task && !it->finished) {
 			break;
 		}
 	}
 
 	// If we reached this point, it means we've found our entry and
 	// have <it> pointing to it. 
-
-	if (m_order == SEQUENTIAL_ORDER) {
-		// In this mode we select the page that was just processed,
-		// rather than the one currently being processed.  This way
-		// we can avoid question marks on selected pages.
-		m_selectedPage = it->pageInfo;
+	it->finished = true;
+
+	// Several tasks may be in flight at the same time, and they may finish
+	// in any order.  We only retire the finished entries at the front of the
+	// queue, so that the selection never jumps backwards.
+	while (!m_queue.empty() && m_queue.front().finished) {
+		if (m_order == SEQUENTIAL_ORDER) {
+			// In this mode we select the page that was just processed,
+			// rather than the one currently being processed.  This way
+			// we can avoid question marks on selected pages.
+			m_selectedPage = m_queue.front().pageInfo;
+		}
+		m_queue.pop_front();
 	}
-
-	m_queue.erase(it);
 }
 
 PageInfo
@@ -114,7 +120,7 @@ ProcessingTaskQueue::cancelAndRemove(std::set<PageId> const& pages)
 	std::list<Entry>::iterator const end(m_queue.end());
 	while (it != end) {
 		if (pages.find(it->pageInfo.id()) != pages.end()) {
-			if (it->takenForProcessing) {
+			if (it->takenForProcessing && !it->finished) {
 				it->task->cancel();
 			}
 			if (m_selectedPage.id() == it->pageInfo.id()) {
@@ -132,7 +138,7 @@ ProcessingTaskQueue::cancelAndClear()
 {
 	while (!m_queue.empty()) {
 		Entry& ent = m_queue.front();
-		if (ent.takenForProcessing) {
+		if (ent.takenForProcessing && !ent.finished) {
 			ent.task->cancel();
 		}
 		m_queue.pop_front();
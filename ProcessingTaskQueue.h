@@ -45,9 +45,17 @@ public:
 	 * The first task among those that haven't been already taken for processing
 	 * is marked as taken and returned.  A null task will be returned if there
 	 * are no such tasks.
+	 *
+	 * It's fine to call this method again before the previously taken tasks
+	 * are finished.  That's how several workers are fed from the same queue.
 	 */
 	BackgroundTaskPtr takeForProcessing();
 
+	/**
+	 * Tasks may finish in any order.  Finished tasks are retired from the
+	 * queue only when all the tasks before them are finished too, so that
+	 * selectedPage() advances monotonically.
+	 */
 	void processingFinished(BackgroundTaskPtr const& task);
 
 	/**
@@ -70,6 +78,7 @@ private:
 		PageInfo pageInfo;
 		BackgroundTaskPtr task;
 		bool takenForProcessing;
+		bool finished;
 
 		Entry(PageInfo const& page_info, BackgroundTaskPtr const& task);
 	};
@@ -19,6 +19,7 @@
 #include "SystemLoadWidget.h"
 #include "SystemLoadWidget.h.moc"
 #include "ThreadPriority.h"
+#include <QSettings>
 #include <QToolTip>
 
 SystemLoadWidget::SystemLoadWidget(QWidget* parent)
@@ -30,11 +31,15 @@ SystemLoadWidget::SystemLoadWidget(QWidget* parent)
 	ui.slider->setRange(ThreadPriority::Minimum, ThreadPriority::Maximum);
 	ui.slider->setValue(prio.value());
 
+	QSettings settings;
+	ui.threadsSpinBox->setValue(settings.value("settings/batch_processing_threads", 1).toInt());
+
 	connect(ui.slider, SIGNAL(sliderPressed()), SLOT(sliderPressed()));
 	connect(ui.slider, SIGNAL(sliderMoved(int)), SLOT(sliderMoved(int)));
 	connect(ui.slider, SIGNAL(valueChanged(int)), SLOT(valueChanged(int)));
 	connect(ui.minusBtn, SIGNAL(clicked()), SLOT(decreasePriority()));
 	connect(ui.plusBtn, SIGNAL(clicked()), SLOT(increasePriority()));
+	connect(ui.threadsSpinBox, SIGNAL(valueChanged(int)), SLOT(threadsChanged(int)));
 }
 
 void
@@ -55,6 +60,12 @@ SystemLoadWidget::valueChanged(int prio)
 	ThreadPriority((ThreadPriority::Priority)prio).save("settings/batch_processing_priority");
 }
 
+void
+SystemLoadWidget::threadsChanged(int num_threads)
+{
+	QSettings().setValue("settings/batch_processing_threads", num_threads);
+}
+
 void
 SystemLoadWidget::decreasePriority()
 {
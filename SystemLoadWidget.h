@@ -34,6 +34,8 @@ private slots:
 
 	void valueChanged(int prio);
 
+	void threadsChanged(int num_threads);
+
 	void decreasePriority();
 
 	void increasePriority();
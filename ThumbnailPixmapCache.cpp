@@ -679,7 +679,8 @@ ThumbnailPixmapCache::Impl::loadSaveThumbnail(
 		return image;
 	}
 	
-	image = ImageLoader::load(image_id);
+	// No need to decode the full resolution image just to scale it down.
+	image = ImageLoader::loadDownscaled(image_id, max_thumb_size);
 	if (image.isNull()) {
 		return QImage();
 	}
@@ -29,9 +29,11 @@
 #include <QSize>
 #include <QDebug>
 #include <algorithm>
+#include <vector>
 #include <tiff.h>
 #include <tiffio.h>
 #include <new>
+#include <stdint.h>
 #include <assert.h>
 
 class TiffReader::TiffHeader
@@ -265,6 +267,129 @@ TiffReader::readMetadata(
 	return ImageMetadataLoader::LOADED;
 }
 
+namespace
+{
+
+class RgbaImageCleanup
+{
+	DECLARE_NON_COPYABLE(RgbaImageCleanup)
+public:
+	RgbaImageCleanup(TIFFRGBAImage& img) : m_rImage(img) {}
+
+	~RgbaImageCleanup() { TIFFRGBAImageEnd(&m_rImage); }
+private:
+	TIFFRGBAImage& m_rImage;
+};
+
+
+/**
+ * Downscales a sequence of lines in libtiff's packed ABGR format
+ * by averaging square blocks of 2^shift by 2^shift pixels.
+ * Blocks on the right and bottom edges may be partial.
+ */
+class LineReducer
+{
+	DECLARE_NON_COPYABLE(LineReducer)
+public:
+	/**
+	 * \param dst A grayscale Format_Indexed8, a Format_RGB32 or
+	 *        a Format_ARGB32 image of a matching size.
+	 * \param src_width The width of source lines.
+	 * \param shift Blocks are 2^shift pixels wide and high.
+	 */
+	LineReducer(QImage& dst, int src_width, int shift);
+
+	void addLine(uint32 const* abgr);
+
+	/**
+	 * Writes out a partially accumulated bottom row of blocks, if any.
+	 */
+	void finish();
+private:
+	void flush();
+
+	QImage& m_rDst;
+	std::vector<uint32> m_sums; // R, G, B and A for every block in a row.
+	int m_srcWidth;
+	int m_shift;
+	int m_linesAccumulated;
+	int m_dstY;
+};
+
+
+LineReducer::LineReducer(QImage& dst, int const src_width, int const shift)
+:	m_rDst(dst),
+	m_sums(dst.width() * 4, 0),
+	m_srcWidth(src_width),
+	m_shift(shift),
+	m_linesAccumulated(0),
+	m_dstY(0)
+{
+}
+
+void
+LineReducer::addLine(uint32 const* abgr)
+{
+	uint32* const sums = &m_sums[0];
+	for (int x = 0; x < m_srcWidth; ++x) {
+		uint32 const pixel = abgr[x];
+		uint32* sum = sums + ((x >> m_shift) << 2);
+		sum[0] += TIFFGetR(pixel);
+		sum[1] += TIFFGetG(pixel);
+		sum[2] += TIFFGetB(pixel);
+		sum[3] += TIFFGetA(pixel);
+	}
+
+	if (++m_linesAccumulated == (1 << m_shift)) {
+		flush();
+	}
+}
+
+void
+LineReducer::finish()
+{
+	if (m_linesAccumulated > 0) {
+		flush();
+	}
+}
+
+void
+LineReducer::flush()
+{
+	if (m_dstY >= m_rDst.height()) {
+		return;
+	}
+
+	int const dst_width = m_rDst.width();
+	int const block = 1 << m_shift;
+	bool const gray = m_rDst.format() == QImage::Format_Indexed8;
+	uint8_t* const gray_line = m_rDst.scanLine(m_dstY);
+	uint32* const color_line = (uint32*)gray_line;
+	uint32 const* sum = &m_sums[0];
+
+	for (int x = 0; x < dst_width; ++x, sum += 4) {
+		int const block_width = std::min(block, m_srcWidth - (x << m_shift));
+		uint32 const count = block_width * m_linesAccumulated;
+		uint32 const half = count >> 1;
+		uint32 const r = (sum[0] + half) / count;
+		if (gray) {
+			// libtiff sets R = G = B for grayscale images.
+			gray_line[x] = static_cast<uint8_t>(r);
+		} else {
+			uint32 const g = (sum[1] + half) / count;
+			uint32 const b = (sum[2] + half) / count;
+			uint32 const a = (sum[3] + half) / count;
+			color_line[x] = qRgba(r, g, b, a);
+		}
+	}
+
+	std::fill(m_sums.begin(), m_sums.end(), 0);
+	m_linesAccumulated = 0;
+	++m_dstY;
+}
+
+} // anonymous namespace
+
 static void convertAbgrToArgb(uint32 const* src, uint32* dst, int count)
 {
 	for (int i = 0; i < count; ++i) {
@@ -279,6 +404,12 @@ static void convertAbgrToArgb(uint32 const* src, uint32* dst, int count)
 
 QImage
 TiffReader::readImage(QIODevice& device, int const page_num)
+{
+	return readImage(device, page_num, 0);
+}
+
+QImage
+TiffReader::readImage(QIODevice& device, int const page_num, int const reduction)
 {
 	if (!device.isReadable()) {
 		return QImage();
@@ -311,62 +442,189 @@ TiffReader::readImage(QIODevice& device, int const page_num)
 	TiffInfo const info(tif, header);
 	
 	ImageMetadata const metadata(currentPageMetadata(tif));
+
+	// Keeps the per-pixel sums in LineReducer from overflowing.
+	int const shift = qBound(0, reduction, 10);
 	
 	QImage image;
+	if (shift == 0) {
+		image = readFullImage(tif, info);
+	} else {
+		image = readReducedImage(tif, header, shift);
+	}
+	if (image.isNull()) {
+		return QImage();
+	}
+	
+	if (!metadata.dpi().isNull()) {
+		Dpm const dpm(metadata.dpi());
+		image.setDotsPerMeterX(dpm.horizontal() >> shift);
+		image.setDotsPerMeterY(dpm.vertical() >> shift);
+	}
 	
+	return image;
+}
+
+QImage
+TiffReader::readFullImage(TiffHandle const& tif, TiffInfo const& info)
+{
 	if (info.mapsToBinaryOrIndexed8()) {
 		// Common case optimization.
-		image = extractBinaryOrIndexed8Image(tif, info);
-	} else {
-		// General case.
-		image = QImage(
-			info.width, info.height,
-			info.samples_per_pixel == 3
-			? QImage::Format_RGB32 : QImage::Format_ARGB32
-		);
-		if (image.isNull()) {
-			throw std::bad_alloc();
-		}
+		return extractBinaryOrIndexed8Image(tif, info);
+	}
 
-		// For ABGR -> ARGB conversion.
-		TiffBuffer<uint32> tmp_buffer;
-		uint32 const* src_line = 0;
+	// General case.
+	QImage image(
+		info.width, info.height,
+		info.samples_per_pixel == 3
+		? QImage::Format_RGB32 : QImage::Format_ARGB32
+	);
+	if (image.isNull()) {
+		throw std::bad_alloc();
+	}
 
-		if (image.bytesPerLine() == 4 * info.width) {
-			// We can avoid creating a temporary buffer in this case.
-			if (!TIFFReadRGBAImageOriented(tif.handle(), info.width, info.height,
-			                               (uint32*)image.bits(), ORIENTATION_TOPLEFT, 0)) {
-				return QImage();
-			}
-			src_line = (uint32 const*)image.bits();
-		} else {
-			TiffBuffer<uint32>(info.width * info.height).swap(tmp_buffer);
-			if (!TIFFReadRGBAImageOriented(tif.handle(), info.width, info.height,
-				                           tmp_buffer.data(), ORIENTATION_TOPLEFT, 0)) {
-				return QImage();
-			}
-			src_line = tmp_buffer.data();
+	// For ABGR -> ARGB conversion.
+	TiffBuffer<uint32> tmp_buffer;
+	uint32 const* src_line = 0;
+
+	if (image.bytesPerLine() == 4 * info.width) {
+		// We can avoid creating a temporary buffer in this case.
+		if (!TIFFReadRGBAImageOriented(tif.handle(), info.width, info.height,
+		                               (uint32*)image.bits(), ORIENTATION_TOPLEFT, 0)) {
+			return QImage();
 		}
-		
-		uint32* dst_line = (uint32*)image.bits();
-		assert(image.bytesPerLine() % 4 == 0);
-		int const dst_stride = image.bytesPerLine() / 4;
-		for (int y = 0; y < info.height; ++y) {
-			convertAbgrToArgb(src_line, dst_line, info.width);
-			src_line += info.width;
-			dst_line += dst_stride;
+		src_line = (uint32 const*)image.bits();
+	} else {
+		TiffBuffer<uint32>(info.width * info.height).swap(tmp_buffer);
+		if (!TIFFReadRGBAImageOriented(tif.handle(), info.width, info.height,
+			                           tmp_buffer.data(), ORIENTATION_TOPLEFT, 0)) {
+			return QImage();
 		}
+		src_line = tmp_buffer.data();
 	}
 	
-	if (!metadata.dpi().isNull()) {
-		Dpm const dpm(metadata.dpi());
-		image.setDotsPerMeterX(dpm.horizontal());
-		image.setDotsPerMeterY(dpm.vertical());
+	uint32* dst_line = (uint32*)image.bits();
+	assert(image.bytesPerLine() % 4 == 0);
+	int const dst_stride = image.bytesPerLine() / 4;
+	for (int y = 0; y < info.height; ++y) {
+		convertAbgrToArgb(src_line, dst_line, info.width);
+		src_line += info.width;
+		dst_line += dst_stride;
 	}
-	
+
 	return image;
 }
 
+QImage
+TiffReader::readReducedImage(
+	TiffHandle const& tif, TiffHeader const& header, int const reduction)
+{
+	int const level = selectReducedSubfile(
+		tif, TiffInfo(tif, header).width, reduction
+	);
+	TiffInfo const info(tif, header);
+	int const shift = reduction - level;
+
+	int const block = 1 << shift;
+	QSize const dst_size(
+		(info.width + block - 1) >> shift,
+		(info.height + block - 1) >> shift
+	);
+
+	QImage::Format format = QImage::Format_ARGB32;
+	if (info.samples_per_pixel == 1 && (info.photometric == PHOTOMETRIC_MINISBLACK
+			|| info.photometric == PHOTOMETRIC_MINISWHITE)) {
+		format = QImage::Format_Indexed8;
+	} else if (info.samples_per_pixel == 3 || info.photometric == PHOTOMETRIC_PALETTE) {
+		format = QImage::Format_RGB32;
+	}
+
+	QImage image(dst_size, format);
+	if (image.isNull()) {
+		throw std::bad_alloc();
+	}
+	if (format == QImage::Format_Indexed8) {
+		image.setNumColors(256);
+		for (int i = 0; i < 256; ++i) {
+			image.setColor(i, qRgb(i, i, i));
+		}
+	}
+
+	char emsg[1024] = "";
+	if (!TIFFRGBAImageOK(tif.handle(), emsg)) {
+		return QImage();
+	}
+	TIFFRGBAImage rgba;
+	if (!TIFFRGBAImageBegin(&rgba, tif.handle(), 0, emsg)) {
+		return QImage();
+	}
+	RgbaImageCleanup const cleanup(rgba);
+	rgba.req_orientation = ORIENTATION_TOPLEFT;
+
+	// Bands are a whole number of blocks high, so blocks never straddle them.
+	int const band_height = ((64 + block - 1) / block) * block;
+	TiffBuffer<uint32> band(info.width * band_height);
+	LineReducer reducer(image, info.width, shift);
+
+	for (int y = 0; y < info.height; y += band_height) {
+		int const rows = std::min(band_height, info.height - y);
+		rgba.row_offset = y;
+		if (!TIFFRGBAImageGet(&rgba, band.data(), info.width, rows)) {
+			return QImage();
+		}
+
+		uint32 const* line = band.data();
+		for (int i = 0; i < rows; ++i, line += info.width) {
+			reducer.addLine(line);
+		}
+	}
+	reducer.finish();
+
+	return image;
+}
+
+/**
+ * Looks for reduced resolution versions of the current page, which are
+ * stored in the directories following it.  The one closest to, but
+ * not below 2^-max_level resolution becomes the current directory.
+ * If there are none, the current directory stays the same.
+ *
+ * \return The number of times (as a power of 2) the resolution of
+ *         the current directory is reduced.
+ */
+int
+TiffReader::selectReducedSubfile(
+	TiffHandle const& tif, int const full_width, int const max_level)
+{
+	tdir_t const page_dir = TIFFCurrentDirectory(tif.handle());
+	tdir_t best_dir = page_dir;
+	int best_level = 0;
+
+	for (tdir_t dir = page_dir + 1; TIFFSetDirectory(tif.handle(), dir); ++dir) {
+		uint32 subfile_type = 0;
+		TIFFGetField(tif.handle(), TIFFTAG_SUBFILETYPE, &subfile_type);
+		if (!(subfile_type & FILETYPE_REDUCEDIMAGE)) {
+			break;
+		}
+
+		uint32 width = 0;
+		TIFFGetField(tif.handle(), TIFFTAG_IMAGEWIDTH, &width);
+		for (int level = best_level + 1; level <= max_level; ++level) {
+			// Different writers round differently.
+			int const rounded_up = (full_width + (1 << level) - 1) >> level;
+			int const rounded_down = full_width >> level;
+			if (int(width) == rounded_up || int(width) == rounded_down) {
+				best_dir = dir;
+				best_level = level;
+				break;
+			}
+		}
+	}
+
+	TIFFSetDirectory(tif.handle(), best_dir);
+	return best_level;
+}
+
 TiffReader::TiffHeader
 TiffReader::readHeader(QIODevice& device)
 {
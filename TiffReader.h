@@ -46,6 +46,26 @@ public:
 	 * \return The resulting image, or a null image in case of failure.
 	 */
 	static QImage readImage(QIODevice& device, int page_num = 0);
+
+	/**
+	 * \brief Reads an image at a reduced resolution.
+	 *
+	 * \param device The device to read from.  This device must be
+	 *        opened for reading and must be seekable.
+	 * \param page_num A zero-based page number within a multi-page
+	 *        TIFF file.
+	 * \param reduction The image is downscaled by 2^reduction in both
+	 *        directions, by averaging the pixels being merged.
+	 * \return The resulting image, or a null image in case of failure.
+	 *
+	 * Unless \p reduction is zero, the image is decoded band by band,
+	 * without ever holding it at full resolution.  If the page is followed
+	 * by reduced resolution versions of itself (subfiles of
+	 * FILETYPE_REDUCEDIMAGE type), the best matching one is decoded instead.
+	 * The result is then either a grayscale Format_Indexed8, Format_RGB32
+	 * or Format_ARGB32 image of about size / 2^reduction pixels.
+	 */
+	static QImage readImage(QIODevice& device, int page_num, int reduction);
 private:
 	class TiffHeader;
 	class TiffHandle;
@@ -60,6 +80,14 @@ private:
 	
 	static Dpi getDpi(float xres, float yres, unsigned res_unit);
 	
+	static QImage readFullImage(TiffHandle const& tif, TiffInfo const& info);
+
+	static QImage readReducedImage(
+		TiffHandle const& tif, TiffHeader const& header, int reduction);
+
+	static int selectReducedSubfile(
+		TiffHandle const& tif, int full_width, int max_level);
+	
 	static QImage extractBinaryOrIndexed8Image(
 		TiffHandle const& tif, TiffInfo const& info);
 	
@@ -18,18 +18,26 @@
 
 #include "TiffWriter.h"
 #include "Dpm.h"
+#include "ParallelFor.h"
+#include "Trace.h"
 #include "imageproc/Constants.h"
 #include <QtGlobal>
 #include <QFile>
+#include <QBuffer>
+#include <QByteArray>
 #include <QIODevice>
 #include <QImage>
 #include <QColor>
 #include <QVector>
 #include <QSize>
+#include <QDomDocument>
+#include <QDomElement>
 #include <QDebug>
 #include <vector>
+#include <algorithm>
 #include <tiff.h>
 #include <tiffio.h>
+#include <zlib.h>
 #include <string.h>
 #include <math.h>
 #include <assert.h>
@@ -87,6 +95,79 @@ private:
 };
 
 
+/**
+ * Converts and compresses a range of strips with zlib.  Called concurrently
+ * for non-overlapping ranges.
+ */
+class TiffWriter::DeflateStripEncoder
+{
+public:
+	DeflateStripEncoder(
+		QImage const& image, LineFormat format, int bytes_per_line,
+		int rows_per_strip, int samples_per_pixel, bool predictor,
+		std::vector<std::vector<uint8_t> >& strips)
+	:	m_rImage(image),
+		m_format(format),
+		m_bytesPerLine(bytes_per_line),
+		m_rowsPerStrip(rows_per_strip),
+		m_samplesPerPixel(samples_per_pixel),
+		m_predictor(predictor),
+		m_rStrips(strips) {}
+
+	void operator()(int begin, int end) const;
+private:
+	QImage const& m_rImage;
+	LineFormat m_format;
+	int m_bytesPerLine;
+	int m_rowsPerStrip;
+	int m_samplesPerPixel;
+	bool m_predictor;
+	std::vector<std::vector<uint8_t> >& m_rStrips;
+};
+
+
+/**
+ * Converts and compresses a range of strips with any libtiff codec.
+ * Called concurrently for non-overlapping ranges.
+ *
+ * The strips are written into a TIFF of their own, held in memory,
+ * which has the same rows per strip and therefore the same strip
+ * boundaries as the real one.  The compressed strips are then taken
+ * from there as they are.  That works because TIFF strips are
+ * compressed independently of each other.
+ */
+class TiffWriter::CodecStripEncoder
+{
+public:
+	CodecStripEncoder(
+		QImage const& image, LineFormat format, int bytes_per_line,
+		int rows_per_strip, uint16 bits_per_sample, uint16 samples_per_pixel,
+		uint16 compression, bool predictor,
+		std::vector<std::vector<uint8_t> >& strips)
+	:	m_rImage(image),
+		m_format(format),
+		m_bytesPerLine(bytes_per_line),
+		m_rowsPerStrip(rows_per_strip),
+		m_bitsPerSample(bits_per_sample),
+		m_samplesPerPixel(samples_per_pixel),
+		m_compression(compression),
+		m_predictor(predictor),
+		m_rStrips(strips) {}
+
+	void operator()(int begin, int end) const;
+private:
+	QImage const& m_rImage;
+	LineFormat m_format;
+	int m_bytesPerLine;
+	int m_rowsPerStrip;
+	uint16 m_bitsPerSample;
+	uint16 m_samplesPerPixel;
+	uint16 m_compression;
+	bool m_predictor;
+	std::vector<std::vector<uint8_t> >& m_rStrips;
+};
+
+
 static tsize_t deviceRead(thandle_t context, tdata_t data, tsize_t size)
 {
 	// Not implemented.
@@ -142,8 +223,125 @@ static void deviceUnmap(thandle_t, tdata_t, toff_t)
 	// Not implemented.
 }
 
+/*============================ TiffWriter::Options ==========================*/
+
+TiffWriter::Options::Options()
+:	m_bilevelCompression(BILEVEL_LZW),
+	m_contoneCompression(CONTONE_LZW),
+	m_rowsPerStrip(0)
+{
+}
+
+TiffWriter::Options::Options(QDomElement const& el)
+:	m_bilevelCompression(BILEVEL_LZW),
+	m_contoneCompression(CONTONE_LZW),
+	m_rowsPerStrip(0)
+{
+	bilevelCompressionFromString(el.attribute("bilevel"), m_bilevelCompression);
+	contoneCompressionFromString(el.attribute("contone"), m_contoneCompression);
+	setRowsPerStrip(el.attribute("rowsPerStrip").toInt());
+}
+
+QDomElement
+TiffWriter::Options::toXml(QDomDocument& doc, QString const& name) const
+{
+	QDomElement el(doc.createElement(name));
+	el.setAttribute("bilevel", bilevelCompressionToString(m_bilevelCompression));
+	el.setAttribute("contone", contoneCompressionToString(m_contoneCompression));
+	el.setAttribute("rowsPerStrip", m_rowsPerStrip);
+	return el;
+}
+
+bool
+TiffWriter::Options::operator==(Options const& other) const
+{
+	if (m_bilevelCompression != other.m_bilevelCompression) {
+		return false;
+	}
+
+	if (m_contoneCompression != other.m_contoneCompression) {
+		return false;
+	}
+
+	if (m_rowsPerStrip != other.m_rowsPerStrip) {
+		return false;
+	}
+
+	return true;
+}
+
+bool
+TiffWriter::Options::operator!=(Options const& other) const
+{
+	return !(*this == other);
+}
+
+QString
+TiffWriter::Options::bilevelCompressionToString(BilevelCompression const compression)
+{
+	switch (compression) {
+		case BILEVEL_LZW:
+			return "lzw";
+		case BILEVEL_CCITT_G4:
+			return "g4";
+	}
+
+	return QString();
+}
+
+bool
+TiffWriter::Options::bilevelCompressionFromString(
+	QString const& str, BilevelCompression& compression)
+{
+	if (str == "lzw") {
+		compression = BILEVEL_LZW;
+	} else if (str == "g4") {
+		compression = BILEVEL_CCITT_G4;
+	} else {
+		return false;
+	}
+
+	return true;
+}
+
+QString
+TiffWriter::Options::contoneCompressionToString(ContoneCompression const compression)
+{
+	switch (compression) {
+		case CONTONE_LZW:
+			return "lzw";
+		case CONTONE_DEFLATE:
+			return "deflate";
+		case CONTONE_ZSTD:
+			return "zstd";
+	}
+
+	return QString();
+}
+
+bool
+TiffWriter::Options::contoneCompressionFromString(
+	QString const& str, ContoneCompression& compression)
+{
+	if (str == "lzw") {
+		compression = CONTONE_LZW;
+	} else if (str == "deflate") {
+		compression = CONTONE_DEFLATE;
+	} else if (str == "zstd") {
+		compression = CONTONE_ZSTD;
+	} else {
+		return false;
+	}
+
+	return true;
+}
+
+
+/*================================ TiffWriter ===============================*/
+
 bool
-TiffWriter::writeImage(QString const& file_path, QImage const& image)
+TiffWriter::writeImage(
+	QString const& file_path, QImage const& image, Options const& options)
 {
 	if (image.isNull()) {
 		return false;
@@ -154,7 +352,7 @@ TiffWriter::writeImage(QString const& file_path, QImage const& image)
 		return false;
 	}
 	
-	if (!writeImage(file, image)) {
+	if (!writeImage(file, image, options)) {
 		file.remove();
 		return false;
 	}
@@ -163,8 +361,11 @@ TiffWriter::writeImage(QString const& file_path, QImage const& image)
 }
 
 bool
-TiffWriter::writeImage(QIODevice& device, QImage const& image)
+TiffWriter::writeImage(
+	QIODevice& device, QImage const& image, Options const& options)
 {
+	TraceSpan const span("write TIFF");
+
 	if (image.isNull()) {
 		return false;
 	}
@@ -199,17 +400,17 @@ TiffWriter::writeImage(QIODevice& device, QImage const& image)
 		case QImage::Format_Mono:
 		case QImage::Format_MonoLSB:
 		case QImage::Format_Indexed8:
-			return writeBitonalOrIndexed8Image(tif, image);
+			return writeBitonalOrIndexed8Image(tif, image, options);
 		default:;
 	}
 	
 	if (image.hasAlphaChannel()) {
 		return writeARGB32Image(
-			tif, image.convertToFormat(QImage::Format_ARGB32)
+			tif, image.convertToFormat(QImage::Format_ARGB32), options
 		);
 	} else {
 		return writeRGB32Image(
-			tif, image.convertToFormat(QImage::Format_RGB32)
+			tif, image.convertToFormat(QImage::Format_RGB32), options
 		);
 	}
 }
@@ -250,11 +451,10 @@ TiffWriter::setDpm(TiffHandle const& tif, Dpm const& dpm)
 
 bool
 TiffWriter::writeBitonalOrIndexed8Image(
-	TiffHandle const& tif, QImage const& image)
+	TiffHandle const& tif, QImage const& image, Options const& options)
 {
 	TIFFSetField(tif.handle(), TIFFTAG_SAMPLESPERPIXEL, uint16(1));
 	
-	uint16 compression = COMPRESSION_LZW;
 	uint16 bits_per_sample = 8;
 	uint16 photometric = PHOTOMETRIC_PALETTE;
 	if (image.isGrayscale()) {
@@ -264,9 +464,6 @@ TiffWriter::writeBitonalOrIndexed8Image(
 	switch (image.format()) {
 		case QImage::Format_Mono:
 		case QImage::Format_MonoLSB:
-			// Don't use CCITTFAX4 compression, as Photoshop
-			// has problems with it.
-			//compression = COMPRESSION_CCITTFAX4;
 			bits_per_sample = 1;
 			if (image.numColors() < 2) {
 				photometric = PHOTOMETRIC_MINISWHITE;
@@ -285,8 +482,24 @@ TiffWriter::writeBitonalOrIndexed8Image(
 			break;
 		default:;
 	}
+
+	Encoding encoding;
+	if (bits_per_sample == 1) {
+		encoding.compression = COMPRESSION_LZW;
+		encoding.predictor = false;
+		encoding.rowsPerStrip = options.rowsPerStrip();
+
+		// CCITT G4 is off by default, as Photoshop has problems with it.
+		// It's also not defined for palettized images.
+		if (options.bilevelCompression() == BILEVEL_CCITT_G4 &&
+				photometric != PHOTOMETRIC_PALETTE) {
+			encoding.compression = COMPRESSION_CCITTFAX4;
+		}
+	} else {
+		// Differencing palette indices makes no sense.
+		encoding = contoneEncoding(options, photometric != PHOTOMETRIC_PALETTE);
+	}
 	
-	TIFFSetField(tif.handle(), TIFFTAG_COMPRESSION, compression);
 	TIFFSetField(tif.handle(), TIFFTAG_BITSPERSAMPLE, bits_per_sample);
 	TIFFSetField(tif.handle(), TIFFTAG_PHOTOMETRIC, photometric);
 	
@@ -309,157 +522,316 @@ TiffWriter::writeBitonalOrIndexed8Image(
 	}
 	
 	if (image.format() == QImage::Format_Indexed8) {
-		return write8bitLines(tif, image);
+		return writeLines(tif, image, LINES_8BIT, image.width(), encoding);
+	}
+
+	int const bpl = (image.width() + 7) / 8;
+	if (image.format() == QImage::Format_MonoLSB) {
+		return writeLines(tif, image, LINES_BINARY_REVERSED, bpl, encoding);
 	} else {
-		if (image.format() == QImage::Format_MonoLSB) {
-			return writeBinaryLinesReversed(tif, image);
-		} else {
-			return writeBinaryLinesAsIs(tif, image);
-		}
+		return writeLines(tif, image, LINES_BINARY_AS_IS, bpl, encoding);
 	}
 }
 
 bool
 TiffWriter::writeRGB32Image(
-	TiffHandle const& tif, QImage const& image)
+	TiffHandle const& tif, QImage const& image, Options const& options)
 {
 	assert(image.format() == QImage::Format_RGB32);
 	
 	TIFFSetField(tif.handle(), TIFFTAG_SAMPLESPERPIXEL, uint16(3));
-	TIFFSetField(tif.handle(), TIFFTAG_COMPRESSION, COMPRESSION_LZW);
 	TIFFSetField(tif.handle(), TIFFTAG_BITSPERSAMPLE, uint16(8));
 	TIFFSetField(tif.handle(), TIFFTAG_PHOTOMETRIC, PHOTOMETRIC_RGB);
 	
-	int const width = image.width();
-	int const height = image.height();
-	
-	std::vector<uint8_t> tmp_line(width * 3);
-	
-	// Libtiff expects "RR GG BB" sequences regardless of CPU byte order.
-	
-	for (int y = 0; y < height; ++y) {
-		uint32_t const* p_src = (uint32_t const*)image.scanLine(y);
-		uint8_t* p_dst = &tmp_line[0];
-		for (int x = 0; x < width; ++x) {
-			uint32_t const ARGB = *p_src;
-			p_dst[0] = static_cast<uint8_t>(ARGB >> 16);
-			p_dst[1] = static_cast<uint8_t>(ARGB >> 8);
-			p_dst[2] = static_cast<uint8_t>(ARGB);
-			++p_src;
-			p_dst += 3;
-		}
-		if (TIFFWriteScanline(tif.handle(), &tmp_line[0], y) == -1) {
-			return false;
-		}
-	}
-	
-	return true;
+	return writeLines(
+		tif, image, LINES_RGB32, image.width() * 3,
+		contoneEncoding(options, true)
+	);
 }
 
 bool
 TiffWriter::writeARGB32Image(
-	TiffHandle const& tif, QImage const& image)
+	TiffHandle const& tif, QImage const& image, Options const& options)
 {
 	assert(image.format() == QImage::Format_ARGB32);
 	
 	TIFFSetField(tif.handle(), TIFFTAG_SAMPLESPERPIXEL, uint16(4));
-	TIFFSetField(tif.handle(), TIFFTAG_COMPRESSION, COMPRESSION_LZW);
 	TIFFSetField(tif.handle(), TIFFTAG_BITSPERSAMPLE, uint16(8));
 	TIFFSetField(tif.handle(), TIFFTAG_PHOTOMETRIC, PHOTOMETRIC_RGB);
 	
-	int const width = image.width();
-	int const height = image.height();
-	
-	std::vector<uint8_t> tmp_line(width * 4);
-	
-	// Libtiff expects "RR GG BB AA" sequences regardless of CPU byte order.
-	
-	for (int y = 0; y < height; ++y) {
-		uint32_t const* p_src = (uint32_t const*)image.scanLine(y);
-		uint8_t* p_dst = &tmp_line[0];
-		for (int x = 0; x < width; ++x) {
-			uint32_t const ARGB = *p_src;
-			p_dst[0] = static_cast<uint8_t>(ARGB >> 16);
-			p_dst[1] = static_cast<uint8_t>(ARGB >> 8);
-			p_dst[2] = static_cast<uint8_t>(ARGB);
-			p_dst[3] = static_cast<uint8_t>(ARGB >> 24);
-			++p_src;
-			p_dst += 4;
+	return writeLines(
+		tif, image, LINES_ARGB32, image.width() * 4,
+		contoneEncoding(options, true)
+	);
+}
+
+TiffWriter::Encoding
+TiffWriter::contoneEncoding(Options const& options, bool const use_predictor)
+{
+	Encoding encoding;
+	encoding.compression = COMPRESSION_LZW;
+	encoding.predictor = false;
+	encoding.rowsPerStrip = options.rowsPerStrip();
+
+	switch (options.contoneCompression()) {
+		case CONTONE_LZW:
+			break;
+		case CONTONE_ZSTD:
+#ifdef COMPRESSION_ZSTD
+			if (TIFFIsCODECConfigured(COMPRESSION_ZSTD)) {
+				encoding.compression = COMPRESSION_ZSTD;
+				encoding.predictor = use_predictor;
+				break;
+			}
+#endif
+			// libtiff was built without ZSTD support.
+			// Fall back to Deflate.
+		case CONTONE_DEFLATE:
+			encoding.compression = COMPRESSION_ADOBE_DEFLATE;
+			encoding.predictor = use_predictor;
+			break;
+	}
+
+	return encoding;
+}
+
+bool
+TiffWriter::writeLines(
+	TiffHandle const& tif, QImage const& image, LineFormat const format,
+	int const bytes_per_line, Encoding const& encoding)
+{
+	TIFFSetField(tif.handle(), TIFFTAG_COMPRESSION, encoding.compression);
+	if (encoding.predictor) {
+		TIFFSetField(tif.handle(), TIFFTAG_PREDICTOR, PREDICTOR_HORIZONTAL);
+	}
+
+	int const rows_per_strip = rowsPerStrip(image, bytes_per_line, encoding);
+	TIFFSetField(tif.handle(), TIFFTAG_ROWSPERSTRIP, uint32(rows_per_strip));
+
+	uint16 bits_per_sample = 1;
+	uint16 samples_per_pixel = 1;
+	TIFFGetFieldDefaulted(tif.handle(), TIFFTAG_BITSPERSAMPLE, &bits_per_sample);
+	TIFFGetFieldDefaulted(tif.handle(), TIFFTAG_SAMPLESPERPIXEL, &samples_per_pixel);
+
+	int const num_strips = (image.height() + rows_per_strip - 1) / rows_per_strip;
+	std::vector<std::vector<uint8_t> > strips(num_strips);
+
+	// Strips are compressed in parallel, in chunks of at least 256K
+	// of uncompressed data.  Each chunk encoded by libtiff has some
+	// fixed overhead, so chunks shouldn't be too small.
+	qint64 const strip_bytes = qint64(rows_per_strip) * bytes_per_line;
+	int const min_chunk = (int)std::max<qint64>(1, (256 << 10) / strip_bytes);
+
+	if (encoding.compression == COMPRESSION_ADOBE_DEFLATE) {
+		// This one we do ourselves, which is cheaper.
+		ParallelFor::run(
+			0, num_strips, min_chunk, DeflateStripEncoder(
+				image, format, bytes_per_line, rows_per_strip,
+				samples_per_pixel, encoding.predictor, strips
+			)
+		);
+	} else {
+		ParallelFor::run(
+			0, num_strips, min_chunk, CodecStripEncoder(
+				image, format, bytes_per_line, rows_per_strip,
+				bits_per_sample, samples_per_pixel,
+				encoding.compression, encoding.predictor, strips
+			)
+		);
+	}
+
+	// Strips have to be written in order.
+	for (int i = 0; i < num_strips; ++i) {
+		std::vector<uint8_t>& strip = strips[i];
+		if (strip.empty()) {
+			return false;
 		}
-		if (TIFFWriteScanline(tif.handle(), &tmp_line[0], y) == -1) {
+		if (TIFFWriteRawStrip(tif.handle(), i, &strip[0], strip.size()) == -1) {
 			return false;
 		}
+		std::vector<uint8_t>().swap(strip);
 	}
-	
+
 	return true;
 }
 
-bool
-TiffWriter::write8bitLines(
-	TiffHandle const& tif, QImage const& image)
+int
+TiffWriter::rowsPerStrip(
+	QImage const& image, int const bytes_per_line, Encoding const& encoding)
+{
+	// Keeps the uncompressed size of a strip within 32 bits,
+	// which is what zlib and TIFF strip byte counts can handle.
+	int const max_strip_bytes = 1 << 30;
+
+	int rows = encoding.rowsPerStrip;
+	if (rows <= 0) {
+		// Go for strips of about 64K of uncompressed data.
+		// That's large enough not to hurt the compression ratio
+		// and small enough to keep all cores busy.
+		rows = (64 << 10) / std::max(1, bytes_per_line);
+	}
+
+	rows = std::min(rows, max_strip_bytes / std::max(1, bytes_per_line));
+	rows = std::min(rows, image.height());
+	return std::max(rows, 1);
+}
+
+void
+TiffWriter::convertLine(
+	QImage const& image, LineFormat const format, int const y, uint8_t* dst)
 {
 	int const width = image.width();
-	int const height = image.height();
-	
-	// TIFFWriteScanline() can actually modify the data you pass it,
-	// so we have to use a temporary buffer even when no coversion
-	// is required.
-	std::vector<uint8_t> tmp_line(width, 0);
-	
-	for (int y = 0; y < height; ++y) {
-		uint8_t const* src_line = image.scanLine(y);
-		memcpy(&tmp_line[0], src_line, tmp_line.size());
-		if (TIFFWriteScanline(tif.handle(), &tmp_line[0], y) == -1) {
-			return false;
+	uint8_t const* src_line = image.scanLine(y);
+
+	switch (format) {
+		case LINES_8BIT:
+			memcpy(dst, src_line, width);
+			break;
+		case LINES_BINARY_AS_IS:
+			memcpy(dst, src_line, (width + 7) / 8);
+			break;
+		case LINES_BINARY_REVERSED: {
+			int const bpl = (width + 7) / 8;
+			for (int i = 0; i < bpl; ++i) {
+				dst[i] = m_reverseBitsLUT[src_line[i]];
+			}
+			break;
+		}
+		case LINES_RGB32: {
+			// Libtiff expects "RR GG BB" sequences regardless of CPU byte order.
+			uint32_t const* p_src = (uint32_t const*)src_line;
+			for (int x = 0; x < width; ++x) {
+				uint32_t const ARGB = *p_src;
+				dst[0] = static_cast<uint8_t>(ARGB >> 16);
+				dst[1] = static_cast<uint8_t>(ARGB >> 8);
+				dst[2] = static_cast<uint8_t>(ARGB);
+				++p_src;
+				dst += 3;
+			}
+			break;
+		}
+		case LINES_ARGB32: {
+			// Libtiff expects "RR GG BB AA" sequences regardless of CPU byte order.
+			uint32_t const* p_src = (uint32_t const*)src_line;
+			for (int x = 0; x < width; ++x) {
+				uint32_t const ARGB = *p_src;
+				dst[0] = static_cast<uint8_t>(ARGB >> 16);
+				dst[1] = static_cast<uint8_t>(ARGB >> 8);
+				dst[2] = static_cast<uint8_t>(ARGB);
+				dst[3] = static_cast<uint8_t>(ARGB >> 24);
+				++p_src;
+				dst += 4;
+			}
+			break;
 		}
 	}
-	
-	return true;
 }
 
-bool
-TiffWriter::writeBinaryLinesAsIs(
-	TiffHandle const& tif, QImage const& image)
+
+/*===================== TiffWriter::DeflateStripEncoder =====================*/
+
+void
+TiffWriter::DeflateStripEncoder::operator()(int const begin, int const end) const
 {
-	int const width = image.width();
-	int const height = image.height();
-	
-	// TIFFWriteScanline() can actually modify the data you pass it,
-	// so we have to use a temporary buffer even when no coversion
-	// is required.
-	int const bpl = (width + 7) / 8;
-	std::vector<uint8_t> tmp_line(bpl, 0);
-	
-	for (int y = 0; y < height; ++y) {
-		uint8_t const* src_line = image.scanLine(y);
-		memcpy(&tmp_line[0], src_line, bpl);
-		if (TIFFWriteScanline(tif.handle(), &tmp_line[0], y) == -1) {
-			return false;
+	int const height = m_rImage.height();
+	std::vector<uint8_t> raw(size_t(m_rowsPerStrip) * size_t(m_bytesPerLine));
+
+	for (int strip = begin; strip < end; ++strip) {
+		int const y0 = strip * m_rowsPerStrip;
+		int const y1 = std::min(height, y0 + m_rowsPerStrip);
+
+		uint8_t* line = &raw[0];
+		for (int y = y0; y < y1; ++y, line += m_bytesPerLine) {
+			convertLine(m_rImage, m_format, y, line);
+			if (m_predictor) {
+				// Horizontal differencing of 8-bit samples,
+				// the same thing libtiff's PREDICTOR_HORIZONTAL does.
+				for (int i = m_bytesPerLine - 1; i >= m_samplesPerPixel; --i) {
+					line[i] = uint8_t(line[i] - line[i - m_samplesPerPixel]);
+				}
+			}
+		}
+
+		uLong const raw_size = uLong(size_t(y1 - y0) * size_t(m_bytesPerLine));
+		uLongf compressed_size = compressBound(raw_size);
+		std::vector<uint8_t>& compressed = m_rStrips[strip];
+		compressed.resize(compressed_size);
+		if (compress2(&compressed[0], &compressed_size,
+				&raw[0], raw_size, Z_DEFAULT_COMPRESSION) != Z_OK) {
+			// An empty strip tells the caller we failed.
+			compressed.clear();
+			continue;
 		}
+		compressed.resize(compressed_size);
 	}
-	
-	return true;
 }
 
-bool
-TiffWriter::writeBinaryLinesReversed(
-	TiffHandle const& tif, QImage const& image)
+
+/*====================== TiffWriter::CodecStripEncoder ======================*/
+
+void
+TiffWriter::CodecStripEncoder::operator()(int const begin, int const end) const
 {
-	int const width = image.width();
-	int const height = image.height();
-	
-	int const bpl = (width + 7) / 8;
-	std::vector<uint8_t> tmp_line(bpl, 0);
-	
-	for (int y = 0; y < height; ++y) {
-		uint8_t const* src_line = image.scanLine(y);
-		for (int i = 0; i < bpl; ++i) {
-			tmp_line[i] = m_reverseBitsLUT[src_line[i]];
+	int const y0 = begin * m_rowsPerStrip;
+	int const y1 = std::min(m_rImage.height(), end * m_rowsPerStrip);
+
+	QBuffer buffer;
+	buffer.open(QIODevice::ReadWrite);
+
+	// Failing to fill in a strip tells the caller we failed,
+	// so there is nothing to report from here.
+	TiffHandle tif(
+		TIFFClientOpen(
+			// The same fill order as the real file, which matters for G4.
+			"strips", "wBm", &buffer, &deviceRead, &deviceWrite,
+			&deviceSeek, &deviceClose, &deviceSize,
+			&deviceMap, &deviceUnmap
+		)
+	);
+	if (!tif.handle()) {
+		return;
+	}
+
+	TIFFSetField(tif.handle(), TIFFTAG_IMAGEWIDTH, uint32(m_rImage.width()));
+	TIFFSetField(tif.handle(), TIFFTAG_IMAGELENGTH, uint32(y1 - y0));
+	TIFFSetField(tif.handle(), TIFFTAG_BITSPERSAMPLE, m_bitsPerSample);
+	TIFFSetField(tif.handle(), TIFFTAG_SAMPLESPERPIXEL, m_samplesPerPixel);
+	TIFFSetField(tif.handle(), TIFFTAG_PLANARCONFIG, PLANARCONFIG_CONTIG);
+	// None of the codecs we use look at the photometric interpretation,
+	// and the real one may need a color map we don't have here.
+	TIFFSetField(tif.handle(), TIFFTAG_PHOTOMETRIC, PHOTOMETRIC_MINISBLACK);
+	TIFFSetField(tif.handle(), TIFFTAG_COMPRESSION, m_compression);
+	if (m_predictor) {
+		TIFFSetField(tif.handle(), TIFFTAG_PREDICTOR, PREDICTOR_HORIZONTAL);
+	}
+	TIFFSetField(tif.handle(), TIFFTAG_ROWSPERSTRIP, uint32(m_rowsPerStrip));
+
+	// TIFFWriteScanline() can modify the data you pass it.
+	std::vector<uint8_t> tmp_line(m_bytesPerLine, 0);
+	for (int y = y0; y < y1; ++y) {
+		convertLine(m_rImage, m_format, y, &tmp_line[0]);
+		if (TIFFWriteScanline(tif.handle(), &tmp_line[0], y - y0) == -1) {
+			return;
 		}
-		if (TIFFWriteScanline(tif.handle(), &tmp_line[0], y) == -1) {
-			return false;
+	}
+	if (!TIFFFlushData(tif.handle())) {
+		return;
+	}
+
+	toff_t* offsets = 0;
+	toff_t* byte_counts = 0;
+	if (!TIFFGetField(tif.handle(), TIFFTAG_STRIPOFFSETS, &offsets) ||
+			!TIFFGetField(tif.handle(), TIFFTAG_STRIPBYTECOUNTS, &byte_counts)) {
+		return;
+	}
+
+	QByteArray const& data = buffer.data();
+	for (int strip = begin; strip < end; ++strip) {
+		int const i = strip - begin;
+		if (offsets[i] + byte_counts[i] > toff_t(data.size())) {
+			return;
 		}
+		uint8_t const* p = (uint8_t const*)data.constData() + offsets[i];
+		m_rStrips[strip].assign(p, p + byte_counts[i]);
 	}
-	
-	return true;
 }
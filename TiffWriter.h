@@ -19,25 +19,109 @@
 #ifndef TIFFWRITER_H_
 #define TIFFWRITER_H_
 
+#include <QString>
 #include <stdint.h>
 #include <stddef.h>
 
 class QIODevice;
-class QString;
 class QImage;
+class QDomDocument;
+class QDomElement;
 class Dpm;
 
 class TiffWriter
 {
 public:
+	/**
+	 * \brief Compression of black and white images.
+	 */
+	enum BilevelCompression
+	{
+		BILEVEL_LZW,
+		BILEVEL_CCITT_G4
+	};
+
+	/**
+	 * \brief Compression of grayscale, palette and color images.
+	 */
+	enum ContoneCompression
+	{
+		CONTONE_LZW,
+		CONTONE_DEFLATE,
+		CONTONE_ZSTD
+	};
+
+	class Options
+	{
+		// Member-wise copying is OK.
+	public:
+		/**
+		 * The defaults use the same compression as older versions did.
+		 */
+		Options();
+
+		Options(QDomElement const& el);
+
+		QDomElement toXml(QDomDocument& doc, QString const& name) const;
+
+		BilevelCompression bilevelCompression() const { return m_bilevelCompression; }
+
+		void setBilevelCompression(BilevelCompression compression) {
+			m_bilevelCompression = compression;
+		}
+
+		ContoneCompression contoneCompression() const { return m_contoneCompression; }
+
+		void setContoneCompression(ContoneCompression compression) {
+			m_contoneCompression = compression;
+		}
+
+		/**
+		 * The number of rows per strip.  Zero means strips of about 64 KB
+		 * of uncompressed data.  Whatever is set here, a strip won't be
+		 * taller than the image or larger than 1 GB uncompressed.
+		 */
+		int rowsPerStrip() const { return m_rowsPerStrip; }
+
+		void setRowsPerStrip(int rows) { m_rowsPerStrip = rows < 0 ? 0 : rows; }
+
+		bool operator==(Options const& other) const;
+
+		bool operator!=(Options const& other) const;
+
+		static QString bilevelCompressionToString(BilevelCompression compression);
+
+		/**
+		 * \return false if \p str doesn't name a known compression,
+		 *         in which case \p compression is left unchanged.
+		 */
+		static bool bilevelCompressionFromString(
+			QString const& str, BilevelCompression& compression);
+
+		static QString contoneCompressionToString(ContoneCompression compression);
+
+		/**
+		 * \return false if \p str doesn't name a known compression,
+		 *         in which case \p compression is left unchanged.
+		 */
+		static bool contoneCompressionFromString(
+			QString const& str, ContoneCompression& compression);
+	private:
+		BilevelCompression m_bilevelCompression;
+		ContoneCompression m_contoneCompression;
+		int m_rowsPerStrip;
+	};
+
 	/**
 	 * \brief Writes a QImage in TIFF format to a file.
 	 *
 	 * \param file_path The full path to the file.
 	 * \param image The image to write.  Writing a null image will fail.
+	 * \param options Compression and layout options.
 	 * \return True on success, false on failure.
 	 */
-	static bool writeImage(QString const& file_path, QImage const& image);
+	static bool writeImage(QString const& file_path, QImage const& image,
+		Options const& options = Options());
 	
 	/**
 	 * \brief Writes a QImage in TIFF format to an IO device.
@@ -45,31 +129,59 @@ public:
 	 * \param device The device to write to.  This device must be
 	 *        opened for writing and seekable.
 	 * \param image The image to write.  Writing a null image will fail.
+	 * \param options Compression and layout options.
 	 * \return True on success, false on failure.
 	 */
-	static bool writeImage(QIODevice& device, QImage const& image);
+	static bool writeImage(QIODevice& device, QImage const& image,
+		Options const& options = Options());
 private:
 	class TiffHandle;
+	class DeflateStripEncoder;
+	class CodecStripEncoder;
+
+	/**
+	 * How scan lines of a QImage are converted to TIFF scan lines.
+	 */
+	enum LineFormat
+	{
+		LINES_8BIT,
+		LINES_BINARY_AS_IS,
+		LINES_BINARY_REVERSED,
+		LINES_RGB32,
+		LINES_ARGB32
+	};
+
+	/**
+	 * How the pixel data is going to be compressed.
+	 */
+	struct Encoding
+	{
+		uint16_t compression;
+		bool predictor;
+		int rowsPerStrip;
+	};
 	
 	static void setDpm(TiffHandle const& tif, Dpm const& dpm);
 	
 	static bool writeBitonalOrIndexed8Image(
-		TiffHandle const& tif, QImage const& image);
+		TiffHandle const& tif, QImage const& image, Options const& options);
 	
 	static bool writeRGB32Image(
-		TiffHandle const& tif, QImage const& image);
+		TiffHandle const& tif, QImage const& image, Options const& options);
 	
 	static bool writeARGB32Image(
-		TiffHandle const& tif, QImage const& image);
-	
-	static bool write8bitLines(
-		TiffHandle const& tif, QImage const& image);
-	
-	static bool writeBinaryLinesAsIs(
-		TiffHandle const& tif, QImage const& image);
-	
-	static bool writeBinaryLinesReversed(
-		TiffHandle const& tif, QImage const& image);
+		TiffHandle const& tif, QImage const& image, Options const& options);
+
+	static Encoding contoneEncoding(Options const& options, bool use_predictor);
+
+	static bool writeLines(TiffHandle const& tif, QImage const& image,
+		LineFormat format, int bytes_per_line, Encoding const& encoding);
+
+	static int rowsPerStrip(QImage const& image,
+		int bytes_per_line, Encoding const& encoding);
+
+	static void convertLine(QImage const& image, LineFormat format,
+		int y, uint8_t* dst);
 	
 	static uint8_t const m_reverseBitsLUT[256];
 };
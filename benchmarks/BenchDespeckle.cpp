@@ -0,0 +1,88 @@
+/*
+	Scan Tailor - Interactive post-processing tool for scanned pages.
+	Copyright (C)  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "Benchmarks.h"
+#include "Despeckle.h"
+#include "TaskStatus.h"
+#include "Dpi.h"
+#include "imageproc/BinaryImage.h"
+#include "imageproc/benchmarks/Runner.h"
+#include "imageproc/benchmarks/SyntheticPages.h"
+#include <stddef.h>
+
+namespace Benchmarks
+{
+
+using namespace imageproc;
+using namespace imageproc::benchmarks;
+
+namespace
+{
+
+class NeverCancelled : public TaskStatus
+{
+public:
+	virtual void cancel() {}
+
+	virtual bool isCancelled() const { return false; }
+
+	virtual void throwIfCancelled() const {}
+};
+
+class DespeckleKernel
+{
+public:
+	DespeckleKernel(BinaryImage const& page, int dpi, Despeckle::Level level)
+	: m_rPage(page), m_dpi(dpi), m_level(level) {}
+
+	void operator()() const {
+		Despeckle::despeckle(m_rPage, Dpi(m_dpi, m_dpi), m_level, NeverCancelled());
+	}
+private:
+	BinaryImage const& m_rPage;
+	int m_dpi;
+	Despeckle::Level m_level;
+};
+
+} // anonymous namespace
+
+void benchDespeckle(Runner& runner)
+{
+	if (!runner.wants("despeckleCautious") && !runner.wants("despeckleNormal")
+			&& !runner.wants("despeckleAggressive")) {
+		return;
+	}
+
+	for (size_t i = 0; i < runner.dpis().size(); ++i) {
+		int const dpi = runner.dpis()[i];
+		BinaryImage const page(syntheticBinaryPage(dpi));
+		runner.run(
+			"despeckleCautious", dpi, page.size(),
+			DespeckleKernel(page, dpi, Despeckle::CAUTIOUS)
+		);
+		runner.run(
+			"despeckleNormal", dpi, page.size(),
+			DespeckleKernel(page, dpi, Despeckle::NORMAL)
+		);
+		runner.run(
+			"despeckleAggressive", dpi, page.size(),
+			DespeckleKernel(page, dpi, Despeckle::AGGRESSIVE)
+		);
+	}
+}
+
+} // namespace Benchmarks
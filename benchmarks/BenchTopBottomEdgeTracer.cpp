@@ -0,0 +1,92 @@
+/*
+	Scan Tailor - Interactive post-processing tool for scanned pages.
+	Copyright (C)  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "Benchmarks.h"
+#include "TaskStatus.h"
+#include "VecNT.h"
+#include "dewarping/TopBottomEdgeTracer.h"
+#include "dewarping/DistortionModelBuilder.h"
+#include "imageproc/GrayImage.h"
+#include "imageproc/benchmarks/Runner.h"
+#include "imageproc/benchmarks/SyntheticPages.h"
+#include <QLineF>
+#include <QPointF>
+#include <utility>
+#include <stddef.h>
+
+namespace Benchmarks
+{
+
+using namespace imageproc;
+using namespace imageproc::benchmarks;
+
+namespace
+{
+
+class NeverCancelled : public TaskStatus
+{
+public:
+	virtual void cancel() {}
+
+	virtual bool isCancelled() const { return false; }
+
+	virtual void throwIfCancelled() const {}
+};
+
+class TraceKernel
+{
+public:
+	TraceKernel(GrayImage const& page) : m_rPage(page) {}
+
+	void operator()() const {
+		double const left = 0.15 * m_rPage.width();
+		double const right = 0.85 * m_rPage.width();
+		std::pair<QLineF, QLineF> const bounds(
+			QLineF(QPointF(left, 0), QPointF(left, m_rPage.height())),
+			QLineF(QPointF(right, 0), QPointF(right, m_rPage.height()))
+		);
+		dewarping::DistortionModelBuilder builder(Vec2d(0, 1));
+		dewarping::TopBottomEdgeTracer::trace(m_rPage, bounds, builder, NeverCancelled());
+	}
+private:
+	GrayImage const& m_rPage;
+};
+
+} // anonymous namespace
+
+void benchTopBottomEdgeTracer(Runner& runner)
+{
+	bool const flat = runner.wants("topBottomEdgeTracerFlat");
+	bool const curved = runner.wants("topBottomEdgeTracerCurved");
+	if (!flat && !curved) {
+		return;
+	}
+
+	for (size_t i = 0; i < runner.dpis().size(); ++i) {
+		int const dpi = runner.dpis()[i];
+		if (flat) {
+			GrayImage const page(syntheticCurvedPage(dpi, 0.0));
+			runner.run("topBottomEdgeTracerFlat", dpi, page.size(), TraceKernel(page));
+		}
+		if (curved) {
+			GrayImage const page(syntheticCurvedPage(dpi, 0.2));
+			runner.run("topBottomEdgeTracerCurved", dpi, page.size(), TraceKernel(page));
+		}
+	}
+}
+
+} // namespace Benchmarks
@@ -0,0 +1,48 @@
+/*
+	Scan Tailor - Interactive post-processing tool for scanned pages.
+	Copyright (C)  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef BENCHMARKS_BENCHMARKS_H_
+#define BENCHMARKS_BENCHMARKS_H_
+
+namespace imageproc
+{
+	namespace benchmarks
+	{
+		class Runner;
+	}
+}
+
+/**
+ * Benchmarks of code above the imageproc level.  They are timed by the same
+ * Runner as imageproc_benchmarks and take the same options.
+ */
+namespace Benchmarks
+{
+
+/**
+ * \brief Despeckle::despeckle() at each of its levels.
+ */
+void benchDespeckle(imageproc::benchmarks::Runner& runner);
+
+/**
+ * \brief dewarping::TopBottomEdgeTracer::trace() on flat and curved pages.
+ */
+void benchTopBottomEdgeTracer(imageproc::benchmarks::Runner& runner);
+
+} // namespace Benchmarks
+
+#endif
@@ -28,6 +28,7 @@
 #include <boost/foreach.hpp>
 #endif
 #include <algorithm>
+#include <vector>
 #include <math.h>
 #include <assert.h>
 
@@ -86,6 +87,55 @@ private:
 	double m_nextPlnX2;
 };
 
+/**
+ * Generatrixes sampled at regular crv X intervals.  A generatrix is
+ * represented by the image points corresponding to pln Y of 0 and 1, plus
+ * its normalized 1D homography.  All of those change smoothly with crv X,
+ * so linear interpolation between neighbouring samples works well.
+ */
+class CylindricalSurfaceDewarper::GeneratrixTable
+{
+public:
+	struct Sample
+	{
+		Vec2d imgTop;
+		Vec2d imgBottom;
+		Vec4d pln2img;
+
+		Sample() {}
+
+		explicit Sample(Generatrix const& gtx)
+			: imgTop(gtx.imgLine.p1()), imgBottom(gtx.imgLine.p2()),
+			pln2img(gtx.pln2img.mat()) {}
+
+		Generatrix toGeneratrix() const {
+			return Generatrix(
+				QLineF(imgTop, imgBottom), HomographicTransform<1, double>(pln2img)
+			);
+		}
+
+		static Sample interpolate(Sample const& s1, Sample const& s2, double fraction);
+	};
+
+	/**
+	 * \param samples Generatrixes at crv_x_from, crv_x_to and at regular
+	 *        intervals in between.  Will be swapped with an empty vector.
+	 */
+	GeneratrixTable(double crv_x_from, double crv_x_to, std::vector<Sample>& samples);
+
+	bool contains(double crv_x) const {
+		return crv_x >= m_crvXFrom && crv_x <= m_crvXTo;
+	}
+
+	Generatrix interpolate(double crv_x) const;
+private:
+	std::vector<Sample> m_samples;
+	double m_crvXFrom;
+	double m_crvXTo;
+	double m_intervalsPerUnit;
+};
+
+
 CylindricalSurfaceDewarper::CylindricalSurfaceDewarper(
 	std::vector<QPointF> const& img_directrix1,
 	std::vector<QPointF> const& img_directrix2, double depth_perception)
@@ -104,6 +154,16 @@ CylindricalSurfaceDewarper::CylindricalSurfaceDewarper(
 
 CylindricalSurfaceDewarper::Generatrix
 CylindricalSurfaceDewarper::mapGeneratrix(double crv_x, State& state) const
+{
+	if (m_ptrGeneratrixTable.get() && m_ptrGeneratrixTable->contains(crv_x)) {
+		return m_ptrGeneratrixTable->interpolate(crv_x);
+	}
+
+	return mapGeneratrixExact(crv_x, state);
+}
+
+CylindricalSurfaceDewarper::Generatrix
+CylindricalSurfaceDewarper::mapGeneratrixExact(double crv_x, State& state) const
 {
 	double const pln_x = m_arcLengthMapper.arcLenToX(crv_x, state.m_arcLengthHint);
 	
@@ -145,6 +205,17 @@ CylindricalSurfaceDewarper::mapToDewarpedSpace(QPointF const& img_pt) const
 	double const pln_x = m_img2pln(img_pt)[0];
 	double const crv_x = m_arcLengthMapper.xToArcLen(pln_x, state.m_arcLengthHint);
 
+	if (m_ptrGeneratrixTable.get() && m_ptrGeneratrixTable->contains(crv_x)) {
+		Generatrix const gtx(m_ptrGeneratrixTable->interpolate(crv_x));
+		double const img_pt_proj(ToLineProjector(gtx.imgLine).projectionScalar(img_pt));
+
+		// Apply the inverse of gtx.pln2img.
+		double const* m = gtx.pln2img.mat().data();
+		double const crv_y = (img_pt_proj * m[3] - m[2]) / (m[0] - img_pt_proj * m[1]);
+
+		return QPointF(crv_x, crv_y);
+	}
+
 	Vec2d const pln_top_pt(pln_x, 0);
 	Vec2d const pln_bottom_pt(pln_x, 1);
 	Vec2d const img_top_pt(m_pln2img(pln_top_pt));
@@ -186,6 +257,86 @@ CylindricalSurfaceDewarper::mapToWarpedSpace(QPointF const& crv_pt) const
 	return gtx.imgLine.pointAt(gtx.pln2img(crv_pt.y()));
 }
 
+void
+CylindricalSurfaceDewarper::buildGeneratrixTable(
+	double const crv_x_from, double const crv_x_to, double const max_img_error)
+{
+	typedef GeneratrixTable::Sample Sample;
+	
+	// Both are numbers of intervals rather than samples.
+	int const min_intervals = 64;
+	int const max_intervals = 1 << 14;
+
+	m_ptrGeneratrixTable.reset();
+
+	if (!(crv_x_from < crv_x_to)) {
+		return;
+	}
+
+	double const max_sqdist = max_img_error * max_img_error;
+	double const crv_ys[] = { 0.0, 0.5, 1.0 };
+
+	std::vector<Sample> samples;
+	std::vector<Sample> mid_samples;
+	std::vector<Sample> merged;
+
+	int num_intervals = min_intervals;
+	double step = (crv_x_to - crv_x_from) / num_intervals;
+	State state;
+	for (int i = 0; i <= num_intervals; ++i) {
+		samples.push_back(Sample(mapGeneratrixExact(crv_x_from + step * i, state)));
+	}
+
+	for (;;) {
+		// Compare interpolated generatrixes with exact ones, at the points
+		// where the interpolation error is expected to be the largest.
+		// The exact ones are kept, as they will be needed if we have to
+		// subdivide further.
+		mid_samples.clear();
+		State mid_state;
+		bool within_bounds = true;
+		for (int i = 0; i < num_intervals; ++i) {
+			Generatrix const exact(
+				mapGeneratrixExact(crv_x_from + step * (i + 0.5), mid_state)
+			);
+			Generatrix const approx(
+				Sample::interpolate(samples[i], samples[i + 1], 0.5).toGeneratrix()
+			);
+			for (int j = 0; j < 3 && within_bounds; ++j) {
+				Vec2d const exact_pt(exact.imgLine.pointAt(exact.pln2img(crv_ys[j])));
+				Vec2d const approx_pt(approx.imgLine.pointAt(approx.pln2img(crv_ys[j])));
+				if ((exact_pt - approx_pt).squaredNorm() > max_sqdist) {
+					within_bounds = false;
+				}
+			}
+			mid_samples.push_back(Sample(exact));
+		}
+
+		if (within_bounds) {
+			break;
+		}
+
+		if (num_intervals >= max_intervals) {
+			// Not worth it.  We'll keep doing exact computations.
+			return;
+		}
+
+		merged.clear();
+		merged.reserve(num_intervals * 2 + 1);
+		for (int i = 0; i < num_intervals; ++i) {
+			merged.push_back(samples[i]);
+			merged.push_back(mid_samples[i]);
+		}
+		merged.push_back(samples.back());
+		samples.swap(merged);
+
+		num_intervals *= 2;
+		step *= 0.5;
+	}
+
+	m_ptrGeneratrixTable.reset(new GeneratrixTable(crv_x_from, crv_x_to, samples));
+}
+
 HomographicTransform<2, double>
 CylindricalSurfaceDewarper::calcPlnToImgHomography(
 	std::vector<QPointF> const& img_directrix1,
@@ -464,4 +615,40 @@ CylindricalSurfaceDewarper::CoupledPolylinesIterator::advance2()
 	m_nextPlnX2 = m_img2pln(m_nextImgPt2)[0];
 }
 
+
+/*============================ GeneratrixTable ==============================*/
+
+CylindricalSurfaceDewarper::GeneratrixTable::GeneratrixTable(
+	double const crv_x_from, double const crv_x_to, std::vector<Sample>& samples)
+:	m_crvXFrom(crv_x_from),
+	m_crvXTo(crv_x_to),
+	m_intervalsPerUnit((samples.size() - 1) / (crv_x_to - crv_x_from))
+{
+	assert(samples.size() >= 2);
+	m_samples.swap(samples);
+}
+
+CylindricalSurfaceDewarper::Generatrix
+CylindricalSurfaceDewarper::GeneratrixTable::interpolate(double const crv_x) const
+{
+	double const pos = (crv_x - m_crvXFrom) * m_intervalsPerUnit;
+	int const last_interval = (int)m_samples.size() - 2;
+	int const idx = qBound(0, (int)pos, last_interval);
+	
+	return Sample::interpolate(
+		m_samples[idx], m_samples[idx + 1], pos - idx
+	).toGeneratrix();
+}
+
+CylindricalSurfaceDewarper::GeneratrixTable::Sample
+CylindricalSurfaceDewarper::GeneratrixTable::Sample::interpolate(
+	Sample const& s1, Sample const& s2, double const fraction)
+{
+	Sample res;
+	res.imgTop = s1.imgTop + (s2.imgTop - s1.imgTop) * fraction;
+	res.imgBottom = s1.imgBottom + (s2.imgBottom - s1.imgBottom) * fraction;
+	res.pln2img = s1.pln2img + (s2.pln2img - s1.pln2img) * fraction;
+	return res;
+}
+
 } // namespace dewarping
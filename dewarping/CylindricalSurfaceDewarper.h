@@ -24,6 +24,7 @@
 #include "ArcLengthMapper.h"
 #ifndef Q_MOC_RUN
 #include <boost/array.hpp>
+#include <boost/shared_ptr.hpp>
 #endif
 #include <vector>
 #include <utility>
@@ -88,8 +89,30 @@ public:
 	 * systems we owork with.
 	 */
 	QPointF mapToWarpedSpace(QPointF const& crv_pt) const;
+
+	/**
+	 * \brief Precomputes generatrixes for a range of crv X coordinates.
+	 *
+	 * Afterwards, mapGeneratrix(), mapToDewarpedSpace() and mapToWarpedSpace()
+	 * interpolate between precomputed generatrixes for crv X coordinates
+	 * within [crv_x_from, crv_x_to], rather than computing them from scratch.
+	 * That makes mapping of arbitrary (as opposed to sequential) points
+	 * a lot cheaper.
+	 *
+	 * Sampling is made dense enough for interpolated generatrixes to map
+	 * crv Y coordinates of 0, 0.5 and 1 within \p max_img_error of the exact
+	 * positions in image coordinates, as verified halfway between samples.
+	 * If that can't be achieved with a reasonable number of samples,
+	 * no table is built and exact computations continue to be used.
+	 *
+	 * The table is shared between copies of this object.
+	 */
+	void buildGeneratrixTable(double crv_x_from, double crv_x_to, double max_img_error);
 private:
 	class CoupledPolylinesIterator;
+	class GeneratrixTable;
+
+	Generatrix mapGeneratrixExact(double crv_x, State& state) const;
 	
 	static HomographicTransform<2, double> calcPlnToImgHomography(
 		std::vector<QPointF> const& img_directrix1,
@@ -119,6 +142,7 @@ private:
 	ArcLengthMapper m_arcLengthMapper;
 	PolylineIntersector m_imgDirectrix1Intersector;
 	PolylineIntersector m_imgDirectrix2Intersector;
+	boost::shared_ptr<GeneratrixTable const> m_ptrGeneratrixTable;
 };
 
 } // namespace dewarping
@@ -54,6 +54,11 @@ DewarpingPointMapper::DewarpingPointMapper(
 	m_modelDomainTop = model_domain.top();
 	m_modelYScaleFromNormalized = model_domain.bottom() - model_domain.top();
 	m_modelYScaleToNormalized = 1.0 / m_modelYScaleFromNormalized;
+
+	// We are used for mapping large numbers of unrelated points (zones,
+	// picture masks), so precomputing generatrixes pays off.
+	// A tenth of a pixel of error is not going to be noticeable there.
+	m_dewarper.buildGeneratrixTable(0.0, 1.0, 0.1);
 }
 
 QPointF
@@ -20,6 +20,7 @@
 #include "CylindricalSurfaceDewarper.h"
 #include "HomographicTransform.h"
 #include "VecNT.h"
+#include "ParallelFor.h"
 #include "imageproc/ColorMixer.h"
 #include "imageproc/GrayImage.h"
 #include <QtGlobal>
@@ -341,11 +342,7 @@ void areaMapGeneratrix(
 				unsigned const right_area = vert_fraction * right_fraction;
 				
 				mixer.add(src_line[src_left], left_area);
-				
-				for (int sx = src_left + 1; sx < src_right; ++sx) {
-					mixer.add(src_line[sx], middle_area);
-				}
-				
+				mixer.addRun(src_line + src_left + 1, src_right - src_left - 1, middle_area);
 				mixer.add(src_line[src_right], right_area);
 			}
 		} else if (src_left == src_right) {
@@ -381,9 +378,7 @@ void areaMapGeneratrix(
 			mixer.add(src_line[src_left], topleft_area);
 			
 			// process the top line (without corners)
-			for (int sx = src_left + 1; sx < src_right; ++sx) {
-				mixer.add(src_line[sx], top_area);
-			}
+			mixer.addRun(src_line + src_left + 1, src_right - src_left - 1, top_area);
 			
 			// process the top-right corner
 			mixer.add(src_line[src_right], topright_area);
@@ -393,11 +388,7 @@ void areaMapGeneratrix(
 			// process middle lines
 			for (int sy = src_top + 1; sy < src_bottom; ++sy) {
 				mixer.add(src_line[src_left], left_area);
-				
-				for (int sx = src_left + 1; sx < src_right; ++sx) {
-					mixer.add(src_line[sx], 32*32);
-				}
-				
+				mixer.addRun(src_line + src_left + 1, src_right - src_left - 1, 32*32);
 				mixer.add(src_line[src_right], right_area);
 				
 				src_line += src_stride;
@@ -407,9 +398,7 @@ void areaMapGeneratrix(
 			mixer.add(src_line[src_left], bottomleft_area);
 			
 			// process the bottom line (without corners)
-			for (int sx = src_left + 1; sx < src_right; ++sx) {
-				mixer.add(src_line[sx], bottom_area);
-			}
+			mixer.addRun(src_line + src_left + 1, src_right - src_left - 1, bottom_area);
 			
 			// process the bottom-right corner
 			mixer.add(src_line[src_right], bottomright_area);
@@ -420,34 +409,61 @@ void areaMapGeneratrix(
 	}
 }
 
+/**
+ * Dewarps a range of destination columns.  Different ranges
+ * may be processed concurrently.
+ */
 template<typename ColorMixer, typename PixelType>
-void dewarpGeneric(
-	PixelType const* const src_data, QSize const src_size,
-	int const src_stride, PixelType* const dst_data,
-	QSize const dst_size, int const dst_stride,
-	CylindricalSurfaceDewarper const& distortion_model,
-	QRectF const& model_domain, PixelType const bg_color)
+class ColumnRangeDewarper
 {
-	int const src_width = src_size.width();
-	int const src_height = src_size.height();
-	int const dst_width = dst_size.width();
-	int const dst_height = dst_size.height();
+public:
+	ColumnRangeDewarper(
+		PixelType const* src_data, QSize src_size,
+		int src_stride, PixelType* dst_data,
+		QSize dst_size, int dst_stride,
+		CylindricalSurfaceDewarper const& distortion_model,
+		QRectF const& model_domain, PixelType bg_color)
+	:	m_pSrcData(src_data), m_srcSize(src_size), m_srcStride(src_stride),
+		m_pDstData(dst_data), m_dstSize(dst_size), m_dstStride(dst_stride),
+		m_rDistortionModel(distortion_model), m_modelDomain(model_domain),
+		m_bgColor(bg_color) {}
+
+	void operator()(int dst_x_begin, int dst_x_end) const;
+private:
+	PixelType const* m_pSrcData;
+	QSize m_srcSize;
+	int m_srcStride;
+	PixelType* m_pDstData;
+	QSize m_dstSize;
+	int m_dstStride;
+	CylindricalSurfaceDewarper const& m_rDistortionModel;
+	QRectF m_modelDomain;
+	PixelType m_bgColor;
+};
+
+template<typename ColorMixer, typename PixelType>
+void
+ColumnRangeDewarper<ColorMixer, PixelType>::operator()(
+	int const dst_x_begin, int const dst_x_end) const
+{
+	int const dst_height = m_dstSize.height();
 
 	CylindricalSurfaceDewarper::State state;
 
-	double const model_domain_left = model_domain.left();
-	double const model_x_scale = 1.0 / (model_domain.right() - model_domain.left());
+	double const model_domain_left = m_modelDomain.left();
+	double const model_x_scale = 1.0 / (m_modelDomain.right() - m_modelDomain.left());
 
-	float const model_domain_top = model_domain.top();
-	float const model_y_scale = 1.0 / (model_domain.bottom() - model_domain.top());
+	float const model_domain_top = m_modelDomain.top();
+	float const model_y_scale = 1.0 / (m_modelDomain.bottom() - m_modelDomain.top());
 
 	std::vector<Vec2f> prev_grid_column(dst_height + 1);
 	std::vector<Vec2f> next_grid_column(dst_height + 1);
 
-	for (int dst_x = 0; dst_x <= dst_width; ++dst_x) {
+	// Destination column dst_x is bounded by grid columns dst_x and dst_x + 1.
+	for (int dst_x = dst_x_begin; dst_x <= dst_x_end; ++dst_x) {
 		double const model_x = (dst_x - model_domain_left) * model_x_scale;
 		CylindricalSurfaceDewarper::Generatrix const generatrix(
-			distortion_model.mapGeneratrix(model_x, state)
+			m_rDistortionModel.mapGeneratrix(model_x, state)
 		);
 
 		HomographicTransform<1, float> const homog(generatrix.pln2img.mat());
@@ -458,11 +474,11 @@ void dewarpGeneric(
 			next_grid_column[dst_y] = origin + vec * homog(model_y);
 		}
 
-		if (dst_x != 0) {
+		if (dst_x != dst_x_begin) {
 			areaMapGeneratrix<ColorMixer, PixelType>(
-				src_data, src_size, src_stride,
-				dst_data + dst_x - 1, dst_size, dst_stride,
-				bg_color, prev_grid_column, next_grid_column
+				m_pSrcData, m_srcSize, m_srcStride,
+				m_pDstData + dst_x - 1, m_dstSize, m_dstStride,
+				m_bgColor, prev_grid_column, next_grid_column
 			);
 		}
 
@@ -470,6 +486,26 @@ void dewarpGeneric(
 	}
 }
 
+template<typename ColorMixer, typename PixelType>
+void dewarpGeneric(
+	PixelType const* const src_data, QSize const src_size,
+	int const src_stride, PixelType* const dst_data,
+	QSize const dst_size, int const dst_stride,
+	CylindricalSurfaceDewarper const& distortion_model,
+	QRectF const& model_domain, PixelType const bg_color)
+{
+	// Each destination column only depends on the two grid columns
+	// bounding it, so disjoint column ranges are processed concurrently.
+	// With a single thread, it's one range covering everything.
+	ParallelFor::run(
+		0, dst_size.width(), 16,
+		ColumnRangeDewarper<ColorMixer, PixelType>(
+			src_data, src_size, src_stride, dst_data, dst_size, dst_stride,
+			distortion_model, model_domain, bg_color
+		)
+	);
+}
+
 #endif // INTERPOLATION_METHOD
 
 #if INTERPOLATION_METHOD == INTERP_BILLINEAR
@@ -21,6 +21,7 @@
 #include "VecNT.h"
 #include "NumericTraits.h"
 #include "DebugImages.h"
+#include "ParallelFor.h"
 #include "imageproc/GrayImage.h"
 #include "imageproc/GaussBlur.h"
 #include "imageproc/Sobel.h"
@@ -110,6 +111,32 @@ private:
 };
 
 
+class TextLineRefiner::SnakeRangeEvolver
+{
+public:
+	SnakeRangeEvolver(
+		TextLineRefiner const& refiner, std::vector<Snake>& snakes,
+		Grid<float> const& gradient, OnConvergence on_convergence)
+	: m_rRefiner(refiner)
+	, m_rSnakes(snakes)
+	, m_rGradient(gradient)
+	, m_onConvergence(on_convergence)
+	{
+	}
+
+	void operator()(int begin, int end) const {
+		for (int i = begin; i < end; ++i) {
+			m_rRefiner.evolveSnake(m_rSnakes[i], m_rGradient, m_onConvergence);
+		}
+	}
+private:
+	TextLineRefiner const& m_rRefiner;
+	std::vector<Snake>& m_rSnakes;
+	Grid<float> const& m_rGradient;
+	OnConvergence m_onConvergence;
+};
+
+
 TextLineRefiner::TextLineRefiner(
 	GrayImage const& image, Dpi const& dpi,
 	Vec2f const& unit_down_vector)
@@ -147,9 +174,7 @@ TextLineRefiner::refine(
 	float v_sigma = (4.0f / 200.f) * m_dpi.vertical();
 	calcBlurredGradient(gradient, h_sigma, v_sigma);
 	
-	BOOST_FOREACH(Snake& snake, snakes) {
-		evolveSnake(snake, gradient, ON_CONVERGENCE_STOP);
-	}
+	evolveSnakes(snakes, gradient, ON_CONVERGENCE_STOP);
 	if (dbg) { 
 		dbg->add(visualizeSnakes(snakes, &gradient), "evolved_snakes1");
 	}
@@ -159,9 +184,7 @@ TextLineRefiner::refine(
 	v_sigma *= 0.5f;
 	calcBlurredGradient(gradient, h_sigma, v_sigma);
 	
-	BOOST_FOREACH(Snake& snake, snakes) {
-		evolveSnake(snake, gradient, ON_CONVERGENCE_GO_FINER);
-	}
+	evolveSnakes(snakes, gradient, ON_CONVERGENCE_GO_FINER);
 	if (dbg) { 
 		dbg->add(visualizeSnakes(snakes, &gradient), "evolved_snakes2");
 	}
@@ -354,6 +377,19 @@ TextLineRefiner::evolveSnake(Snake& snake, Grid<float> const& gradient,
 	}
 }
 
+void
+TextLineRefiner::evolveSnakes(
+	std::vector<Snake>& snakes, Grid<float> const& gradient,
+	OnConvergence const on_convergence) const
+{
+	// Snakes differ a lot in length and in the number of iterations
+	// they take to converge, so let's have small chunks for better balance.
+	ParallelFor::run(
+		0, (int)snakes.size(), /*min_chunk=*/1,
+		SnakeRangeEvolver(*this, snakes, gradient, on_convergence)
+	);
+}
+
 QImage
 TextLineRefiner::visualizeGradient(Grid<float> const& gradient) const
 {
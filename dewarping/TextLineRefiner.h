@@ -51,6 +51,7 @@ private:
 	class SnakeLength;
 	struct FrenetFrame;
 	class Optimizer;
+	class SnakeRangeEvolver;
 
 	struct SnakeNode
 	{
@@ -86,6 +87,13 @@ private:
 
 	void evolveSnake(Snake& snake, Grid<float> const& gradient, OnConvergence on_convergence) const;
 
+	/**
+	 * Evolves every snake independently.  Snakes don't interact with
+	 * each other, so they are distributed across threads.
+	 */
+	void evolveSnakes(std::vector<Snake>& snakes,
+		Grid<float> const& gradient, OnConvergence on_convergence) const;
+
 	QImage visualizeGradient(Grid<float> const& gradient) const;
 
 	QImage visualizeSnakes(std::vector<Snake> const& snakes, Grid<float> const* gradient = 0) const;
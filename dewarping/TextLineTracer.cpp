@@ -24,6 +24,7 @@
 #include "Dpi.h"
 #include "TaskStatus.h"
 #include "DebugImages.h"
+#include "Trace.h"
 #include "NumericTraits.h"
 #include "VecNT.h"
 #include "Grid.h"
@@ -88,7 +89,11 @@ TextLineTracer::trace(
 {
 	using namespace boost::lambda;
 
-	GrayImage downscaled(downscale(input, dpi));
+	GrayImage downscaled;
+	{
+		TraceSpan const span("downscale");
+		downscaled = downscale(input, dpi);
+	}
 	if (dbg) {
 		dbg->add(downscaled, "downscaled");
 	}
@@ -107,24 +112,38 @@ TextLineTracer::trace(
 		qRound(dpi.vertical() * downscale_y_factor)
 	);
 
-	BinaryImage binarized(binarizeWolf(downscaled, QSize(31, 31)));
+	BinaryImage binarized;
+	{
+		TraceSpan const span("binarize");
+		binarized = binarizeWolf(downscaled, QSize(31, 31));
+	}
 	if (dbg) {
 		dbg->add(binarized, "binarized");
 	}
 
 	// detectVertContentBounds() is sensitive to clutter and speckles, so let's try to remove it.
-	sanitizeBinaryImage(binarized, downscaled_content_rect);
+	{
+		TraceSpan const span("sanitize");
+		sanitizeBinaryImage(binarized, downscaled_content_rect);
+	}
 	if (dbg) {
 		dbg->add(binarized, "sanitized");
 	}
 
-	std::pair<QLineF, QLineF> vert_bounds(detectVertContentBounds(binarized, dbg));
+	std::pair<QLineF, QLineF> vert_bounds;
+	{
+		TraceSpan const span("vert bounds");
+		vert_bounds = detectVertContentBounds(binarized, dbg);
+	}
 	if (dbg) {
 		dbg->add(visualizeVerticalBounds(binarized.toQImage(), vert_bounds), "vert_bounds");
 	}
 	
 	std::list<std::vector<QPointF> > polylines;
-	extractTextLines(polylines, stretchGrayRange(downscaled), vert_bounds, dbg);
+	{
+		TraceSpan const span("extract lines");
+		extractTextLines(polylines, stretchGrayRange(downscaled), vert_bounds, dbg);
+	}
 	if (dbg) {
 		dbg->add(visualizePolylines(downscaled, polylines), "traced");
 	}
@@ -140,8 +159,11 @@ TextLineTracer::trace(
 	if (unit_down_vector[1] < 0) {
 		unit_down_vector = -unit_down_vector;
 	}
-	TextLineRefiner refiner(downscaled, Dpi(200, 200), unit_down_vector);
-	refiner.refine(polylines, /*iterations=*/100, dbg);
+	{
+		TraceSpan const span("refine lines");
+		TextLineRefiner refiner(downscaled, Dpi(200, 200), unit_down_vector);
+		refiner.refine(polylines, /*iterations=*/100, dbg);
+	}
 
 	filterEdgyCurves(polylines);
 	if (dbg) {
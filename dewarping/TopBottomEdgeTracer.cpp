@@ -21,7 +21,6 @@
 #include "TaskStatus.h"
 #include "DebugImages.h"
 #include "NumericTraits.h"
-#include "PriorityQueue.h"
 #include "ToLineProjector.h"
 #include "LineBoundedByRect.h"
 #include "GridLineTraverser.h"
@@ -58,19 +57,19 @@ namespace dewarping
 struct TopBottomEdgeTracer::GridNode
 {
 private:
-	static uint32_t const HEAP_IDX_BITS = 28;
+	static uint32_t const BUCKET_IDX_BITS = 28;
 	static uint32_t const PREV_NEIGHBOUR_BITS = 3;
 	static uint32_t const PATH_CONTINUATION_BITS = 1;
 
-	static uint32_t const HEAP_IDX_SHIFT = 0;
-	static uint32_t const PREV_NEIGHBOUR_SHIFT = HEAP_IDX_SHIFT + HEAP_IDX_BITS;
+	static uint32_t const BUCKET_IDX_SHIFT = 0;
+	static uint32_t const PREV_NEIGHBOUR_SHIFT = BUCKET_IDX_SHIFT + BUCKET_IDX_BITS;
 	static uint32_t const PATH_CONTINUATION_SHIFT = PREV_NEIGHBOUR_SHIFT + PREV_NEIGHBOUR_BITS;
 
-	static uint32_t const HEAP_IDX_MASK = ((uint32_t(1) << HEAP_IDX_BITS) - uint32_t(1)) << HEAP_IDX_SHIFT;
+	static uint32_t const BUCKET_IDX_MASK = ((uint32_t(1) << BUCKET_IDX_BITS) - uint32_t(1)) << BUCKET_IDX_SHIFT;
 	static uint32_t const PREV_NEIGHBOUR_MASK = ((uint32_t(1) << PREV_NEIGHBOUR_BITS) - uint32_t(1)) << PREV_NEIGHBOUR_SHIFT;
 	static uint32_t const PATH_CONTINUATION_MASK = ((uint32_t(1) << PATH_CONTINUATION_BITS) - uint32_t(1)) << PATH_CONTINUATION_SHIFT;
 public:
-	static uint32_t const INVALID_HEAP_IDX = HEAP_IDX_MASK >> HEAP_IDX_SHIFT;
+	static uint32_t const INVALID_BUCKET_IDX = BUCKET_IDX_MASK >> BUCKET_IDX_SHIFT;
 
 	union {
 		float dirDeriv; // Directional derivative.
@@ -92,7 +91,7 @@ public:
 	void setupForPadding() {
 		dirDeriv = 0;
 		pathCost = -1;
-		packedData = INVALID_HEAP_IDX;
+		packedData = INVALID_BUCKET_IDX;
 	}
 
 	/**
@@ -100,16 +99,20 @@ public:
 	 */
 	void setupForInterior() {
 		pathCost = NumericTraits<float>::max();
-		packedData = INVALID_HEAP_IDX;
+		packedData = INVALID_BUCKET_IDX;
 	}
 
-	uint32_t heapIdx() const {
-		return (packedData & HEAP_IDX_MASK) >> HEAP_IDX_SHIFT;
+	/**
+	 * The BucketQueue bucket this node is waiting in,
+	 * or INVALID_BUCKET_IDX if it's not queued.
+	 */
+	uint32_t bucketIdx() const {
+		return (packedData & BUCKET_IDX_MASK) >> BUCKET_IDX_SHIFT;
 	}
 
-	void setHeapIdx(uint32_t idx) {
-		assert(!(idx & ~(HEAP_IDX_MASK >> HEAP_IDX_SHIFT)));
-		packedData = idx | (packedData & ~HEAP_IDX_MASK);
+	void setBucketIdx(uint32_t idx) {
+		assert(!(idx & ~(BUCKET_IDX_MASK >> BUCKET_IDX_SHIFT)));
+		packedData = idx | (packedData & ~BUCKET_IDX_MASK);
 	}
 
 	bool hasPathContinuation() const {
@@ -138,25 +141,78 @@ public:
 };
 
 
-class TopBottomEdgeTracer::PrioQueue :
-	public PriorityQueue<uint32_t, PrioQueue>
+/**
+ * \brief A monotone priority queue of grid nodes keyed by their path costs.
+ *
+ * Path costs are in [0, 1] range, so we quantize them into a fixed number
+ * of buckets and process the buckets in order.  Relaxation never produces
+ * a cost lower than that of the node being processed, so nodes are never
+ * pushed into a bucket we've already passed.
+ *
+ * Within a bucket, nodes are processed in FIFO order rather than in the
+ * exact order of their costs.  To still get exact path costs, a node whose
+ * cost is lowered after it was taken from the queue is simply queued again.
+ * A node whose cost is lowered while it's queued is moved to a lower bucket
+ * (if necessary) by queueing it again, leaving a stale entry behind.
+ * Stale entries are recognized by GridNode::bucketIdx() and skipped.
+ */
+class TopBottomEdgeTracer::BucketQueue
 {
 public:
-	PrioQueue(Grid<GridNode>& grid) : m_pData(grid.data()) {}
-
-	bool higherThan(uint32_t lhs, uint32_t rhs) const {
-		return m_pData[lhs].pathCost < m_pData[rhs].pathCost;
+	BucketQueue(Grid<GridNode>& grid)
+	: m_pData(grid.data())
+	, m_buckets(NUM_BUCKETS)
+	, m_curBucket(0)
+	, m_readPos(0)
+	{
 	}
 
-	void setIndex(uint32_t grid_idx, size_t heap_idx) {
-		m_pData[grid_idx].setHeapIdx(static_cast<uint32_t>(heap_idx));
+	/**
+	 * \brief Queues a node, or moves an already queued one
+	 *        to the bucket matching its current path cost.
+	 */
+	void push(uint32_t grid_idx) {
+		GridNode& node = m_pData[grid_idx];
+		assert(node.pathCost >= 0 && node.pathCost <= 1.0f);
+		uint32_t const bucket = (uint32_t)(node.pathCost * float(NUM_BUCKETS - 1));
+		assert(bucket >= (uint32_t)m_curBucket);
+		if (node.bucketIdx() != bucket) {
+			node.setBucketIdx(bucket);
+			m_buckets[bucket].push_back(grid_idx);
+		}
 	}
 
-	void reposition(GridNode* node) {
-		PriorityQueue<uint32_t, PrioQueue>::reposition(node->heapIdx());
+	/**
+	 * \brief Takes a node with the lowest (up to quantization) path cost
+	 *        out of the queue.
+	 *
+	 * \return false if the queue is empty.
+	 */
+	bool pop(uint32_t& grid_idx) {
+		for (; m_curBucket < NUM_BUCKETS; ++m_curBucket, m_readPos = 0) {
+			std::vector<uint32_t>& bucket = m_buckets[m_curBucket];
+			while (m_readPos < bucket.size()) {
+				uint32_t const idx = bucket[m_readPos];
+				++m_readPos;
+				GridNode& node = m_pData[idx];
+				if (node.bucketIdx() == (uint32_t)m_curBucket) {
+					node.setBucketIdx(GridNode::INVALID_BUCKET_IDX);
+					grid_idx = idx;
+					return true;
+				}
+				// Otherwise it's a stale entry.
+			}
+			std::vector<uint32_t>().swap(bucket); // We are done with this bucket.
+		}
+		return false;
 	}
 private:
+	static int const NUM_BUCKETS = 4097;
+
 	GridNode* const m_pData;
+	std::vector<std::vector<uint32_t> > m_buckets;
+	int m_curBucket;
+	size_t m_readPos;
 };
 
 
@@ -245,7 +301,7 @@ TopBottomEdgeTracer::trace(
 
 	status.throwIfCancelled();
 
-	PrioQueue queue(grid);
+	BucketQueue queue(grid);
 	
 	// Shortest paths from bounds.first towards bounds.second.
 	prepareForShortestPathsFrom(queue, grid, bounds.first);
@@ -479,7 +535,7 @@ TopBottomEdgeTracer::directionFromPointToLine(QPointF const& pt, QLineF const& l
 
 void
 TopBottomEdgeTracer::prepareForShortestPathsFrom(
-	PrioQueue& queue, Grid<GridNode>& grid, QLineF const& from)
+	BucketQueue& queue, Grid<GridNode>& grid, QLineF const& from)
 {
 	GridNode padding_node;
 	padding_node.setupForPadding();
@@ -516,7 +572,7 @@ TopBottomEdgeTracer::prepareForShortestPathsFrom(
 
 void
 TopBottomEdgeTracer::propagateShortestPaths(
-	Vec2f const& direction, PrioQueue& queue, Grid<GridNode>& grid)
+	Vec2f const& direction, BucketQueue& queue, Grid<GridNode>& grid)
 {
 	GridNode* const data = grid.data();
 	
@@ -524,15 +580,13 @@ TopBottomEdgeTracer::propagateShortestPaths(
 	int prev_nbh_indexes[8];
 	int const num_neighbours = initNeighbours(next_nbh_offsets, prev_nbh_indexes, grid.stride(), direction);
 
-	while (!queue.empty()) {
-		int const grid_idx = queue.front();
+	uint32_t grid_idx;
+	while (queue.pop(grid_idx)) {
 		GridNode* node = data + grid_idx;
 		assert(node->pathCost >= 0);
-		queue.pop();
-		node->setHeapIdx(GridNode::INVALID_HEAP_IDX);
 
 		for (int i = 0; i < num_neighbours; ++i) {
-			int const nbh_grid_idx = grid_idx + next_nbh_offsets[i];
+			int const nbh_grid_idx = (int)grid_idx + next_nbh_offsets[i];
 			GridNode* nbh_node = data + nbh_grid_idx;
 			
 			assert(fabs(node->dirDeriv) <= 1.0);
@@ -540,11 +594,7 @@ TopBottomEdgeTracer::propagateShortestPaths(
 			if (new_cost < nbh_node->pathCost) {
 				nbh_node->pathCost = new_cost;
 				nbh_node->setPrevNeighbourIdx(prev_nbh_indexes[i]);
-				if (nbh_node->heapIdx() == GridNode::INVALID_HEAP_IDX) {
-					queue.push(nbh_grid_idx);
-				} else {
-					queue.reposition(nbh_node);
-				}
+				queue.push(nbh_grid_idx);
 			}
 		}
 	}
@@ -51,7 +51,7 @@ public:
 		DistortionModelBuilder& output, TaskStatus const& status, DebugImages* dbg = 0);
 private:
 	struct GridNode;
-	class PrioQueue;
+	class BucketQueue;
 	struct Step;
 
 	static bool intersectWithRect(std::pair<QLineF, QLineF>& bounds, QRectF const& rect);
@@ -69,9 +69,9 @@ private:
 
 	static Vec2f directionFromPointToLine(QPointF const& pt, QLineF const& line);
 
-	static void prepareForShortestPathsFrom(PrioQueue& queue, Grid<GridNode>& grid, QLineF const& from); 
+	static void prepareForShortestPathsFrom(BucketQueue& queue, Grid<GridNode>& grid, QLineF const& from); 
 
-	static void propagateShortestPaths(Vec2f const& direction, PrioQueue& queue, Grid<GridNode>& grid);
+	static void propagateShortestPaths(Vec2f const& direction, BucketQueue& queue, Grid<GridNode>& grid);
 
 	static int initNeighbours(int* next_nbh_offsets, int* prev_nbh_indexes, int stride, Vec2f const& direction);
 
@@ -0,0 +1,38 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+    Copyright (C)  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef UPTODATECOLLECTOR_H_
+#define UPTODATECOLLECTOR_H_
+
+#include "AbstractFilterDataCollector.h"
+
+/**
+ * \brief Gets notified when a cache-driven task chain makes it to its
+ *        last filter.
+ *
+ * That only happens if every filter in the chain has parameters that are
+ * valid for the page, meaning that processing it for real wouldn't
+ * need to look at the pixels.
+ */
+class UpToDateCollector : public AbstractFilterDataCollector
+{
+public:
+	virtual void processUpToDate() = 0;
+};
+
+#endif
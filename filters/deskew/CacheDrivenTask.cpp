@@ -24,6 +24,7 @@
 #include "ImageTransformation.h"
 #include "filter_dc/AbstractFilterDataCollector.h"
 #include "filter_dc/ThumbnailCollector.h"
+#include "filter_dc/UpToDateCollector.h"
 #include "filters/select_content/CacheDrivenTask.h"
 
 namespace deskew
@@ -73,6 +74,10 @@ CacheDrivenTask::process(
 		return;
 	}
 	
+	if (UpToDateCollector* col = dynamic_cast<UpToDateCollector*>(collector)) {
+		col->processUpToDate();
+	}
+	
 	if (ThumbnailCollector* thumb_col = dynamic_cast<ThumbnailCollector*>(collector)) {
 		thumb_col->processThumbnail(
 			std::auto_ptr<QGraphicsItem>(
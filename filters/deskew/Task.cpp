@@ -23,6 +23,7 @@
 #include "Params.h"
 #include "Dependencies.h"
 #include "TaskStatus.h"
+#include "Trace.h"
 #include "DebugImages.h"
 #include "filters/select_content/Task.h"
 #include "FilterUiInterface.h"
@@ -107,6 +108,8 @@ Task::~Task()
 FilterResultPtr
 Task::process(TaskStatus const& status, FilterData const& data)
 {
+	TraceSpan const span("deskew task", m_pageId.imageId().filePath());
+
 	status.throwIfCancelled();
 
 	Dependencies const deps(data.xform().preCropArea(), data.xform().preRotation());
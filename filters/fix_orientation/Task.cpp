@@ -24,6 +24,7 @@
 #include "ImageTransformation.h"
 #include "filters/page_split/Task.h"
 #include "TaskStatus.h"
+#include "Trace.h"
 #include "ImageView.h"
 #include "FilterUiInterface.h"
 #include <QImage>
@@ -76,6 +77,8 @@ Task::~Task()
 FilterResultPtr
 Task::process(TaskStatus const& status, FilterData const& data)
 {
+	TraceSpan const span("fix orientation task", m_imageId.filePath());
+
 	// This function is executed from the worker thread.
 	
 	status.throwIfCancelled();
@@ -21,6 +21,7 @@
 #include "Dpi.h"
 #include "imageproc/BinaryImage.h"
 #include "imageproc/SEDM.h"
+#include "Grid.h"
 #include <QPainter>
 #include <stdint.h>
 
@@ -55,13 +56,16 @@ DespeckleVisualization::colorizeSpeckles(
 	uint32_t* image_line = (uint32_t*)image.bits();
 	int const image_stride = image.bytesPerLine() / 4;
 
-	SEDM const sedm(speckles, SEDM::DIST_TO_BLACK, SEDM::DIST_TO_NO_BORDERS);
-	uint32_t const* sedm_line = sedm.data();
-	int const sedm_stride = sedm.stride();
-
 	float const radius = 15.0 * std::max(dpi.horizontal(), dpi.vertical()) / 600;
 	float const sq_radius = radius * radius;
 
+	// Distances beyond the radius don't matter, so saturated ones will do.
+	Grid<uint16_t> const sedm(
+		SEDM::buildSaturated(speckles, SEDM::DIST_TO_BLACK, SEDM::DIST_TO_NO_BORDERS)
+	);
+	uint16_t const* sedm_line = sedm.data();
+	int const sedm_stride = sedm.stride();
+
 	for (int y = 0; y < h; ++y) {
 		for (int x = 0; x < w; ++x) {
 			uint32_t const sq_dist = sedm_line[x];
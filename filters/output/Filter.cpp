@@ -90,6 +90,7 @@ Filter::saveSettings(
 	using namespace boost::lambda;
 	
 	QDomElement filter_el(doc.createElement("output"));
+	filter_el.appendChild(m_ptrSettings->tiffOptions().toXml(doc, "tiff-options"));
 	writer.enumPages(
 		boost::lambda::bind(
 			&Filter::writePageSettings,
@@ -130,6 +131,13 @@ Filter::loadSettings(ProjectReader const& reader, QDomElement const& filters_el)
 	QDomElement const filter_el(
 		filters_el.namedItem("output").toElement()
 	);
+
+	QDomElement const tiff_options_el(
+		filter_el.namedItem("tiff-options").toElement()
+	);
+	if (!tiff_options_el.isNull()) {
+		m_ptrSettings->setTiffOptions(TiffWriter::Options(tiff_options_el));
+	}
 	
 	QString const page_tag_name("page");
 	QDomNode node(filter_el.firstChild());
@@ -65,6 +65,14 @@ OptionsWidget::OptionsWidget(
 	colorModeSelector->addItem(tr("Black and White"), ColorParams::BLACK_AND_WHITE);
 	colorModeSelector->addItem(tr("Color / Grayscale"), ColorParams::COLOR_GRAYSCALE);
 	colorModeSelector->addItem(tr("Mixed"), ColorParams::MIXED);
+
+	bilevelCompressionSelector->addItem(tr("LZW"), TiffWriter::BILEVEL_LZW);
+	bilevelCompressionSelector->addItem(
+		tr("CCITT Group 4"), TiffWriter::BILEVEL_CCITT_G4
+	);
+	contoneCompressionSelector->addItem(tr("LZW"), TiffWriter::CONTONE_LZW);
+	contoneCompressionSelector->addItem(tr("Deflate"), TiffWriter::CONTONE_DEFLATE);
+	contoneCompressionSelector->addItem(tr("ZSTD"), TiffWriter::CONTONE_ZSTD);
 	
 	darkerThresholdLink->setText(
 		Utils::richTextForLink(darkerThresholdLink->text())
@@ -77,6 +85,7 @@ OptionsWidget::OptionsWidget(
 	updateDpiDisplay();
 	updateColorsDisplay();
 	updateDewarpingDisplay();
+	updateTiffCompressionDisplay();
 	
 	connect(
 		changeDpiButton, SIGNAL(clicked()),
@@ -154,6 +163,15 @@ OptionsWidget::OptionsWidget(
 		depthPerceptionSlider, SIGNAL(valueChanged(int)),
 		this, SLOT(depthPerceptionChangedSlot(int))
 	);
+
+	connect(
+		bilevelCompressionSelector, SIGNAL(currentIndexChanged(int)),
+		this, SLOT(tiffCompressionChanged())
+	);
+	connect(
+		contoneCompressionSelector, SIGNAL(currentIndexChanged(int)),
+		this, SLOT(tiffCompressionChanged())
+	);
 	
 	thresholdSlider->setMinimum(-50);
 	thresholdSlider->setMaximum(50);
@@ -177,6 +195,7 @@ OptionsWidget::preUpdateUI(PageId const& page_id)
 	updateDpiDisplay();
 	updateColorsDisplay();
 	updateDewarpingDisplay();
+	updateTiffCompressionDisplay();
 }
 
 void
@@ -526,6 +545,28 @@ OptionsWidget::depthPerceptionChangedSlot(int val)
 	emit depthPerceptionChanged(m_depthPerception.value());
 }
 
+void
+OptionsWidget::tiffCompressionChanged()
+{
+	TiffWriter::Options options(m_ptrSettings->tiffOptions());
+	options.setBilevelCompression(
+		(TiffWriter::BilevelCompression)bilevelCompressionSelector->itemData(
+			bilevelCompressionSelector->currentIndex()
+		).toInt()
+	);
+	options.setContoneCompression(
+		(TiffWriter::ContoneCompression)contoneCompressionSelector->itemData(
+			contoneCompressionSelector->currentIndex()
+		).toInt()
+	);
+	
+	if (options != m_ptrSettings->tiffOptions()) {
+		// This makes all pages out of date, not just this one.
+		m_ptrSettings->setTiffOptions(options);
+		emit reloadRequested();
+	}
+}
+
 void
 OptionsWidget::reloadIfNecessary()
 {
@@ -674,4 +715,22 @@ OptionsWidget::updateDewarpingDisplay()
 	depthPerceptionSlider->blockSignals(false);
 }
 
+void
+OptionsWidget::updateTiffCompressionDisplay()
+{
+	TiffWriter::Options const options(m_ptrSettings->tiffOptions());
+
+	bilevelCompressionSelector->blockSignals(true);
+	bilevelCompressionSelector->setCurrentIndex(
+		bilevelCompressionSelector->findData(options.bilevelCompression())
+	);
+	bilevelCompressionSelector->blockSignals(false);
+
+	contoneCompressionSelector->blockSignals(true);
+	contoneCompressionSelector->setCurrentIndex(
+		contoneCompressionSelector->findData(options.contoneCompression())
+	);
+	contoneCompressionSelector->blockSignals(false);
+}
+
 } // namespace output
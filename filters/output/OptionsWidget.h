@@ -112,6 +112,8 @@ private slots:
 	void applyDepthPerceptionConfirmed(std::set<PageId> const& pages);
 
 	void depthPerceptionChangedSlot(int val);
+
+	void tiffCompressionChanged();
 private:
 	void handleDespeckleLevelChange(DespeckleLevel level);
 
@@ -122,6 +124,8 @@ private:
 	void updateColorsDisplay();
 
 	void updateDewarpingDisplay();
+
+	void updateTiffCompressionDisplay();
 	
 	IntrusivePtr<Settings> m_ptrSettings;
 	PageSelectionAccessor m_pageSelectionAccessor;
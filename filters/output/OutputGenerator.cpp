@@ -19,9 +19,11 @@
 #include "OutputGenerator.h"
 #include "ImageTransformation.h"
 #include "FilterData.h"
+#include "ImageId.h"
 #include "TaskStatus.h"
 #include "Utils.h"
 #include "DebugImages.h"
+#include "Trace.h"
 #include "EstimateBackground.h"
 #include "Despeckle.h"
 #include "RenderParams.h"
@@ -68,6 +70,12 @@
 #endif
 #include <QImage>
 #include <QSize>
+#include <QByteArray>
+#include <QDataStream>
+#include <QIODevice>
+#include <QCryptographicHash>
+#include <QFileInfo>
+#include <QDateTime>
 #include <QPoint>
 #include <QRect>
 #include <QRectF>
@@ -234,6 +242,127 @@ void combineMixed(
 	}
 }
 
+/**
+ * Produces rows [row_begin, row_end) of an output image.  Pixels outside of
+ * \p content_rect are set to \p background.  Pixels inside of it come from
+ * \p content, whose top-left corner corresponds to \p content_origin in
+ * output image coordinates.  If \p bw_mask is provided, this works like
+ * combineMixed(), otherwise content pixels just go through
+ * reserveBlackAndWhite().  \p bw_content and \p bw_mask, if provided,
+ * must have the same size as \p content.
+ */
+template<typename MixedPixel>
+void composeOutputRows(
+	QImage& dst, int const row_begin, int const row_end,
+	MixedPixel const background, QRect const& content_rect,
+	QImage const& content, QPoint const& content_origin,
+	BinaryImage const* bw_content, BinaryImage const* bw_mask)
+{
+	int const width = dst.width();
+	int const dst_stride = dst.bytesPerLine() / sizeof(MixedPixel);
+	MixedPixel* dst_line = reinterpret_cast<MixedPixel*>(dst.bits()) + row_begin * dst_stride;
+	int const content_left = content_rect.left();
+	int const content_right = content_rect.right() + 1;
+	int const src_x_begin = content_left - content_origin.x();
+	int const src_x_end = content_right - content_origin.x();
+	uint32_t const msb = uint32_t(1) << 31;
+
+	for (int y = row_begin; y < row_end; ++y, dst_line += dst_stride) {
+		if (y < content_rect.top() || y > content_rect.bottom()) {
+			std::fill(dst_line, dst_line + width, background);
+			continue;
+		}
+
+		std::fill(dst_line, dst_line + content_left, background);
+		std::fill(dst_line + content_right, dst_line + width, background);
+
+		int const src_y = y - content_origin.y();
+		MixedPixel const* src_line = reinterpret_cast<MixedPixel const*>(
+			content.bits() + src_y * content.bytesPerLine()
+		);
+		MixedPixel* dst_pixel = dst_line + content_left;
+
+		if (!bw_mask) {
+			for (int x = src_x_begin; x < src_x_end; ++x, ++dst_pixel) {
+				*dst_pixel = reserveBlackAndWhite<MixedPixel>(src_line[x]);
+			}
+			continue;
+		}
+
+		uint32_t const* bw_content_line = bw_content->data() + src_y * bw_content->wordsPerLine();
+		uint32_t const* bw_mask_line = bw_mask->data() + src_y * bw_mask->wordsPerLine();
+		for (int x = src_x_begin; x < src_x_end; ++x, ++dst_pixel) {
+			if (bw_mask_line[x >> 5] & (msb >> (x & 31))) {
+				// B/W content.  See combineMixed().
+				uint32_t tmp = bw_content_line[x >> 5];
+				tmp >>= (31 - (x & 31));
+				tmp &= uint32_t(1);
+				--tmp;
+				tmp |= 0xff000000;
+				*dst_pixel = static_cast<MixedPixel>(tmp);
+			} else {
+				*dst_pixel = reserveBlackAndWhite<MixedPixel>(src_line[x]);
+			}
+		}
+	}
+}
+
+struct FillPolygon
+{
+	QPolygonF poly;
+	QColor color;
+	QRect bounds; // Includes antialiasing.
+
+	FillPolygon(QPolygonF const& p, QColor const& c)
+	: poly(p), color(c),
+	bounds(p.boundingRect().toAlignedRect().adjusted(-1, -1, 1, 1)) {}
+};
+
+/**
+ * Does to \p strip_rect of \p img what OutputGenerator::applyFillZonesInPlace()
+ * does to the whole image.
+ */
+void fillPolygonsInStrip(
+	QImage& img, QRect const& strip_rect, std::vector<FillPolygon> const& polygons)
+{
+	if (img.format() != QImage::Format_ARGB32) {
+		// Other formats survive a round trip through ARGB32_Premultiplied
+		// unchanged, so strips not touched by any polygon can be skipped.
+		bool touched = false;
+		BOOST_FOREACH(FillPolygon const& polygon, polygons) {
+			if (polygon.bounds.intersects(strip_rect)) {
+				touched = true;
+				break;
+			}
+		}
+		if (!touched) {
+			return;
+		}
+	}
+
+	QImage canvas(img.copy(strip_rect).convertToFormat(QImage::Format_ARGB32_Premultiplied));
+	
+	{
+		QPainter painter(&canvas);
+		painter.setRenderHint(QPainter::Antialiasing, true);
+		painter.setPen(Qt::NoPen);
+		painter.translate(-strip_rect.left(), -strip_rect.top());
+
+		BOOST_FOREACH(FillPolygon const& polygon, polygons) {
+			painter.setBrush(polygon.color);
+			painter.drawPolygon(polygon.poly, Qt::WindingFill);
+		}
+	}
+
+	QImage strip;
+	if (img.format() == QImage::Format_Indexed8 && img.isGrayscale()) {
+		strip = toGrayscale(canvas);
+	} else {
+		strip = canvas.convertToFormat(img.format());
+	}
+	drawOver(img, strip_rect, strip, strip.rect());
+}
+
 } // anonymous namespace
 
 
@@ -266,6 +395,8 @@ OutputGenerator::process(
 	imageproc::BinaryImage* speckles_image,
 	DebugImages* const dbg) const
 {
+	TraceSpan const span("output generator");
+
 	QImage image(
 		processImpl(
 			status, input, picture_zones, fill_zones,
@@ -295,6 +426,38 @@ OutputGenerator::outputContentRect() const
 	return m_contentRect;
 }
 
+QString
+OutputGenerator::autoDistortionModelFingerprint(
+	ImageId const& image_id, QSize const& image_size) const
+{
+	// Increment it whenever changes to text line or edge tracing
+	// make previously built models obsolete.
+	static qint32 const ALGORITHM_VERSION = 1;
+
+	RenderParams const render_params(m_colorParams);
+
+	// A scan replaced at the same path must not reuse a stale model.
+	QFileInfo const file_info(image_id.filePath());
+
+	// These are the things processWithDewarping() derives the images
+	// it traces from.
+	QByteArray data;
+	{
+		QDataStream strm(&data, QIODevice::WriteOnly);
+		strm.setVersion(QDataStream::Qt_4_4);
+		strm << ALGORITHM_VERSION;
+		strm << image_id.filePath() << qint32(image_id.page()) << image_size;
+		strm << qint64(file_info.size()) << file_info.lastModified();
+		strm << qint32(m_dpi.horizontal()) << qint32(m_dpi.vertical());
+		strm << m_xform.transform() << m_xform.resultingPreCropArea();
+		strm << m_outRect << m_contentRect;
+		strm << render_params.normalizeIllumination();
+	}
+
+	QByteArray const hash(QCryptographicHash::hash(data, QCryptographicHash::Sha1).toHex());
+	return QString::fromAscii(hash.data(), hash.size());
+}
+
 GrayImage
 OutputGenerator::normalizeIlluminationGray(
 	TaskStatus const& status,
@@ -302,6 +465,8 @@ OutputGenerator::normalizeIlluminationGray(
 	QTransform const& xform, QRect const& target_rect,
 	GrayImage* background, DebugImages* const dbg)
 {
+	TraceSpan const span("normalize illumination");
+
 	GrayImage to_be_normalized(
 		transformToGray(
 			input, xform, target_rect, OutsidePixels::assumeWeakNearest()
@@ -349,6 +514,8 @@ OutputGenerator::estimateBinarizationMask(
 	QRect const& source_rect, QRect const& source_sub_rect,
 	DebugImages* const dbg) const
 {
+	TraceSpan const span("binarization mask");
+
 	assert(source_rect.contains(source_sub_rect));
 	
 	// If we need to strip some of the margins from a grayscale
@@ -687,34 +854,11 @@ OutputGenerator::processWithoutDewarping(
 		}
 	}
 	
-	if (render_params.normalizeIllumination()
-			&& !input.origImage().allGray()) {
-		assert(maybe_normalized.format() == QImage::Format_Indexed8);
-		QImage tmp(
-			transform(
-				input.origImage(), m_xform.transform(),
-				normalize_illumination_rect,
-				OutsidePixels::assumeColor(Qt::white)
-			)
-		);
-		
-		status.throwIfCancelled();
-		
-		adjustBrightnessGrayscale(tmp, maybe_normalized);
-		maybe_normalized = tmp;
-		if (dbg) {
-			dbg->add(maybe_normalized, "norm_illum_color");
-		}
-	}
-	
-	if (!render_params.mixedOutput()) {
-		// It's "Color / Grayscale" mode, as we handle B/W above.
-		reserveBlackAndWhite(maybe_normalized);
-	} else {
-		BinaryImage bw_content(
-			binarize(maybe_smoothed, normalize_illumination_crop_area, &bw_mask)
-		);
-		maybe_smoothed = QImage(); // Save memory.
+	// Binarization goes before conversion to color, so that we don't
+	// keep maybe_smoothed around while allocating the color image.
+	BinaryImage bw_content;
+	if (render_params.mixedOutput()) {
+		bw_content = binarize(maybe_smoothed, normalize_illumination_crop_area, &bw_mask);
 		if (dbg) {
 			dbg->add(bw_content, "binarized_and_cropped");
 		}
@@ -744,49 +888,128 @@ OutputGenerator::processWithoutDewarping(
 		);
 		
 		status.throwIfCancelled();
+	}
+	maybe_smoothed = QImage(); // Save memory.
+	
+	if (render_params.normalizeIllumination()
+			&& !input.origImage().allGray()) {
+		assert(maybe_normalized.format() == QImage::Format_Indexed8);
+		QImage tmp(
+			transform(
+				input.origImage(), m_xform.transform(),
+				normalize_illumination_rect,
+				OutsidePixels::assumeColor(Qt::white)
+			)
+		);
+		
+		status.throwIfCancelled();
 		
-		if (maybe_normalized.format() == QImage::Format_Indexed8) {
-			combineMixed<uint8_t>(
-				maybe_normalized, bw_content, bw_mask
-			);
-		} else {
-			assert(maybe_normalized.format() == QImage::Format_RGB32
-				|| maybe_normalized.format() == QImage::Format_ARGB32);
-			
-			combineMixed<uint32_t>(
-				maybe_normalized, bw_content, bw_mask
-			);
+		adjustBrightnessGrayscale(tmp, maybe_normalized);
+		maybe_normalized = tmp;
+		if (dbg) {
+			dbg->add(maybe_normalized, "norm_illum_color");
 		}
 	}
 	
 	status.throwIfCancelled();
 	
 	assert(!target_size.isEmpty());
-	QImage dst(target_size, maybe_normalized.format());
-
-	if (maybe_normalized.format() == QImage::Format_Indexed8) {
-		dst.setColorTable(createGrayscalePalette());
-		// White.  0xff is reserved if in "Color / Grayscale" mode.
-		uint8_t const color = render_params.mixedOutput() ? 0xff : 0xfe;
-		dst.fill(color);
+	if (!render_params.mixedOutput()) {
+		// It's "Color / Grayscale" mode, as we handle B/W above.
+		return composeOutput(
+			target_size, maybe_normalized, small_margins_rect.topLeft(),
+			0, 0, fill_zones, status
+		);
 	} else {
-		// White.  0x[ff]ffffff is reserved if in "Color / Grayscale" mode.
-		uint32_t const color = render_params.mixedOutput() ? 0xffffffff : 0xfffefefe;
-		dst.fill(color);
+		return composeOutput(
+			target_size, maybe_normalized, small_margins_rect.topLeft(),
+			&bw_content, &bw_mask, fill_zones, status
+		);
 	}
+}
 
+/**
+ * \brief Builds the final color, grayscale or mixed output image.
+ *
+ * Everything that happens to the output pixels at this point is pointwise:
+ * mixing with B/W content, reserving black and white, copying the content
+ * area and filling zones.  So instead of making a pass over the whole image
+ * for each of those, we go strip by strip, producing each strip of the
+ * output in one go, while it's still in cache.  That also means fill zones
+ * don't require full size temporary images.
+ *
+ * \param target_size The size of the output image.
+ * \param content The image to take the content area from.
+ * \param content_origin The position of \p content in output image coordinates.
+ * \param bw_content B/W content, corresponding to \p content.
+ *        Must be provided in mixed mode and only in mixed mode.
+ * \param bw_mask Areas where \p bw_content is to be used, corresponding
+ *        to \p content.  Must be provided in mixed mode and only in mixed mode.
+ * \param fill_zones Fill zones to be applied to the output.
+ * \param status Task status.
+ */
+QImage
+OutputGenerator::composeOutput(
+	QSize const& target_size, QImage const& content, QPoint const& content_origin,
+	BinaryImage const* bw_content, BinaryImage const* bw_mask,
+	ZoneSet const& fill_zones, TaskStatus const& status) const
+{
+	TraceSpan const span("compose output");
+
+	assert((bw_content != 0) == (bw_mask != 0));
+	bool const mixed = (bw_mask != 0);
+
+	QImage dst(target_size, content.format());
+	if (dst.format() == QImage::Format_Indexed8) {
+		dst.setColorTable(createGrayscalePalette());
+	}
 	if (dst.isNull()) {
 		// Both the constructor and setColorTable() above can leave the image null.
 		throw std::bad_alloc();
 	}
 
-	if (!m_contentRect.isEmpty()) {
-		QRect const src_rect(m_contentRect.translated(-small_margins_rect.topLeft()));
-		QRect const dst_rect(m_contentRect);
-		drawOver(dst, dst_rect, maybe_normalized, src_rect);
+	std::vector<FillPolygon> fill_polygons;
+	BOOST_FOREACH(Zone const& zone, fill_zones) {
+		QColor const color(zone.properties().locateOrDefault<FillColorProperty>()->color());
+		QPolygonF const poly(zone.spline().transformed(m_xform.transform()).toPolygon());
+		fill_polygons.push_back(FillPolygon(poly, color));
 	}
-	
-	applyFillZonesInPlace(dst, fill_zones);
+
+	// Around a megabyte per strip.
+	int const strip_height = std::max(1, (1 << 20) / dst.bytesPerLine());
+	int const height = dst.height();
+
+	for (int top = 0; top < height; top += strip_height) {
+		int const bottom = std::min(top + strip_height, height);
+		
+		if (dst.format() == QImage::Format_Indexed8) {
+			// White.  0xff is reserved if in "Color / Grayscale" mode.
+			uint8_t const background = mixed ? 0xff : 0xfe;
+			composeOutputRows<uint8_t>(
+				dst, top, bottom, background, m_contentRect,
+				content, content_origin, bw_content, bw_mask
+			);
+		} else {
+			assert(dst.format() == QImage::Format_RGB32
+				|| dst.format() == QImage::Format_ARGB32);
+
+			// White.  0x[ff]ffffff is reserved if in "Color / Grayscale" mode.
+			uint32_t const background = mixed ? 0xffffffff : 0xfffefefe;
+			composeOutputRows<uint32_t>(
+				dst, top, bottom, background, m_contentRect,
+				content, content_origin, bw_content, bw_mask
+			);
+		}
+
+		if (!fill_polygons.empty()) {
+			fillPolygonsInStrip(
+				dst, QRect(0, top, dst.width(), bottom - top), fill_polygons
+			);
+		}
+
+		status.throwIfCancelled();
+	}
+
 	return dst;
 }
 
@@ -979,23 +1202,34 @@ OutputGenerator::processWithDewarping(
 		status.throwIfCancelled();
 	}
 
-	if (dewarping_mode == DewarpingMode::AUTO) {
+	if (dewarping_mode == DewarpingMode::AUTO && !distortion_model.isValid()) {
+		// No model from a previous run with the same geometry, so build one.
+		TraceSpan const span("build distortion model");
 		DistortionModelBuilder model_builder(Vec2d(0, 1));
 
 		QRect const content_rect(
 			m_contentRect.translated(-normalize_illumination_rect.topLeft())
 		);
 		TextLineTracer::trace(
-			warped_gray_output, m_dpi, content_rect, model_builder, status, dbg
+			warped_gray_output, m_dpi, content_rect,
+			model_builder, status, dbg
 		);
 		model_builder.transform(norm_illum_to_original);
 
-		TopBottomEdgeTracer::trace(
-			input.grayImage(), model_builder.verticalBounds(),
-			model_builder, status, dbg
-		);
+		{
+			TraceSpan const span("top/bottom edges");
+			TopBottomEdgeTracer::trace(
+				input.grayImage(), model_builder.verticalBounds(),
+				model_builder, status, dbg
+			);
+		}
 		
-		distortion_model = model_builder.tryBuildModel(dbg, &input.grayImage().toQImage());
+		{
+			TraceSpan const span("build model");
+			distortion_model = model_builder.tryBuildModel(
+				dbg, &input.grayImage().toQImage()
+			);
+		}
 		if (!distortion_model.isValid()) {
 			setupTrivialDistortionModel(distortion_model);
 		}
@@ -1244,6 +1478,8 @@ OutputGenerator::dewarp(
 	QTransform const& src_to_output, DistortionModel const& distortion_model,
 	DepthPerception const& depth_perception, QColor const& bg_color) const
 {
+	TraceSpan const span("dewarp");
+
 	CylindricalSurfaceDewarper const dewarper(
 		createDewarper(distortion_model, orig_to_src, depth_perception.value())
 	);
@@ -1336,6 +1572,8 @@ OutputGenerator::detectPictures(
 	GrayImage const& input_300dpi, TaskStatus const& status,
 	DebugImages* const dbg)
 {
+	TraceSpan const span("detect pictures");
+
 	// We stretch the range of gray levels to cover the whole
 	// range of [0, 255].  We do it because we want text
 	// and background to be equally far from the center
@@ -1487,6 +1725,8 @@ BinaryImage
 OutputGenerator::binarize(QImage const& image,
 	QPolygonF const& crop_area, BinaryImage const* mask) const
 {
+	TraceSpan const span("binarize");
+
 	QPainterPath path;
 	path.addPolygon(crop_area);
 	
@@ -1538,6 +1778,8 @@ OutputGenerator::maybeDespeckleInPlace(
 	DespeckleLevel const level, BinaryImage* speckles_img,
 	Dpi const& dpi, TaskStatus const& status, DebugImages* dbg) const
 {
+	TraceSpan const span("despeckle");
+
 	QRect const src_rect(mask_rect.translated(-image_rect.topLeft()));
 	QRect const dst_rect(mask_rect);
 
@@ -1583,6 +1825,8 @@ void
 OutputGenerator::morphologicalSmoothInPlace(
 	BinaryImage& bin_img, TaskStatus const& status)
 {
+	TraceSpan const span("smooth edges");
+
 	// When removing black noise, remove small ones first.
 	
 	{
@@ -36,6 +36,7 @@
 #include <QPointF>
 #include <QLineF>
 #include <QPolygonF>
+#include <QString>
 #include <vector>
 #include <utility>
 #include <stdint.h>
@@ -46,6 +47,7 @@ class FilterData;
 class ZoneSet;
 class QSize;
 class QImage;
+class ImageId;
 
 namespace imageproc
 {
@@ -79,7 +81,10 @@ public:
 	 * \param input The input image plus data produced by previous stages.
 	 * \param picture_zones A set of manual picture zones.
 	 * \param fill_zones A set of manual fill zones.
-	 * \param distortion_model A curved rectangle.
+	 * \param distortion_model A curved rectangle.  With DewarpingMode::AUTO,
+	 *        a valid model passed in is used as is, which is how a model
+	 *        built previously gets reused.  Otherwise, a new model is built
+	 *        and written there.
 	 * \param auto_picture_mask If provided, the auto-detected picture mask
 	 *        will be written there.  It would only happen if automatic picture
 	 *        detection actually took place.  Otherwise, nothing will be
@@ -112,6 +117,20 @@ public:
 	 * \brief Returns the content rectangle in output image coordinates.
 	 */
 	QRect outputContentRect() const;
+
+	/**
+	 * \brief Identifies the inputs of automatic distortion model building.
+	 *
+	 * With DewarpingMode::AUTO, equal fingerprints mean equal distortion
+	 * models would be built, so a stored model may be reused.  Color mode,
+	 * thresholds and despeckling don't affect the fingerprint, with the
+	 * exception of illumination normalization.
+	 *
+	 * \param image_id The source image.
+	 * \param image_size The size of the source image.
+	 */
+	QString autoDistortionModelFingerprint(
+		ImageId const& image_id, QSize const& image_size) const;
 private:
 	QImage processImpl(
 		TaskStatus const& status, FilterData const& input,
@@ -231,6 +250,11 @@ private:
 		QImage const& gray_input, DebugImages* dbg,
 		QImage const* morph_background = 0) const;
 
+	QImage composeOutput(
+		QSize const& target_size, QImage const& content, QPoint const& content_origin,
+		imageproc::BinaryImage const* bw_content, imageproc::BinaryImage const* bw_mask,
+		ZoneSet const& fill_zones, TaskStatus const& status) const;
+
 	void applyFillZonesInPlace(QImage& img, ZoneSet const& zones,
 		boost::function<QPointF(QPointF const&)> const& orig_to_output) const;
 
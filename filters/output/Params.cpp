@@ -38,6 +38,7 @@ Params::Params()
 Params::Params(QDomElement const& el)
 :	m_dpi(XmlUnmarshaller::dpi(el.namedItem("dpi").toElement())),
 	m_distortionModel(el.namedItem("distortion-model").toElement()),
+	m_distortionModelFingerprint(el.attribute("distortionModelFingerprint")),
 	m_depthPerception(el.attribute("depthPerception")),
 	m_dewarpingMode(el.attribute("dewarpingMode")),
 	m_despeckleLevel(despeckleLevelFromString(el.attribute("despeckleLevel")))
@@ -61,6 +62,9 @@ Params::toXml(QDomDocument& doc, QString const& name) const
 	
 	QDomElement el(doc.createElement(name));
 	el.appendChild(m_distortionModel.toXml(doc, "distortion-model"));
+	if (!m_distortionModelFingerprint.isEmpty()) {
+		el.setAttribute("distortionModelFingerprint", m_distortionModelFingerprint);
+	}
 	el.setAttribute("depthPerception", m_depthPerception.toString());
 	el.setAttribute("dewarpingMode", m_dewarpingMode.toString());
 	el.setAttribute("despeckleLevel", despeckleLevelToString(m_despeckleLevel));
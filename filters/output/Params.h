@@ -25,6 +25,7 @@
 #include "dewarping/DistortionModel.h"
 #include "DepthPerception.h"
 #include "DespeckleLevel.h"
+#include <QString>
 
 class QDomDocument;
 class QDomElement;
@@ -53,7 +54,37 @@ public:
 
 	dewarping::DistortionModel const& distortionModel() const { return m_distortionModel; }
 
-	void setDistortionModel(dewarping::DistortionModel const& model) { m_distortionModel = model; }
+	/**
+	 * \brief Sets a distortion model that didn't come from automatic building,
+	 *        like a manually adjusted one.
+	 */
+	void setDistortionModel(dewarping::DistortionModel const& model) {
+		m_distortionModel = model;
+		m_distortionModelFingerprint.clear();
+	}
+
+	/**
+	 * \brief Sets a distortion model built in DewarpingMode::AUTO.
+	 *
+	 * \param model The model that was built.
+	 * \param fingerprint Identifies the inputs the model was built from.
+	 *        \see OutputGenerator::autoDistortionModelFingerprint()
+	 */
+	void setAutoDistortionModel(
+		dewarping::DistortionModel const& model, QString const& fingerprint) {
+		m_distortionModel = model;
+		m_distortionModelFingerprint = fingerprint;
+	}
+
+	/**
+	 * \brief Returns the fingerprint passed to setAutoDistortionModel().
+	 *
+	 * An empty string is returned if the current distortion model wasn't
+	 * automatically built.
+	 */
+	QString const& distortionModelFingerprint() const {
+		return m_distortionModelFingerprint;
+	}
 
 	DepthPerception const& depthPerception() const { return m_depthPerception; }
 
@@ -74,6 +105,7 @@ private:
 	Dpi m_dpi;
 	ColorParams m_colorParams;
 	dewarping::DistortionModel m_distortionModel;
+	QString m_distortionModelFingerprint;
 	DepthPerception m_depthPerception;
 	DewarpingMode m_dewarpingMode;
 	DespeckleLevel m_despeckleLevel;
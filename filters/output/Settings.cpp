@@ -54,6 +54,7 @@ Settings::clear()
 	m_perPageOutputParams.clear();
 	m_perPagePictureZones.clear();
 	m_perPageFillZones.clear();
+	m_tiffOptions = TiffWriter::Options();
 }
 
 void
@@ -305,6 +306,24 @@ Settings::setDefaultFillZoneProperties(PropertySet const& props)
 	m_defaultFillZoneProps = props;
 }
 
+TiffWriter::Options
+Settings::tiffOptions() const
+{
+	QMutexLocker const locker(&m_mutex);
+	return m_tiffOptions;
+}
+
+void
+Settings::setTiffOptions(TiffWriter::Options const& options)
+{
+	QMutexLocker const locker(&m_mutex);
+	if (options != m_tiffOptions) {
+		m_tiffOptions = options;
+		// Files written with other options have to be written again.
+		m_perPageOutputParams.clear();
+	}
+}
+
 PropertySet
 Settings::initialPictureZoneProps()
 {
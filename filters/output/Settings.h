@@ -30,6 +30,7 @@
 #include "DespeckleLevel.h"
 #include "ZoneSet.h"
 #include "PropertySet.h"
+#include "TiffWriter.h"
 #include <QMutex>
 #include <map>
 #include <memory>
@@ -94,6 +95,19 @@ public:
 	void setDefaultPictureZoneProperties(PropertySet const& props);
 
 	void setDefaultFillZoneProperties(PropertySet const& props);
+
+	/**
+	 * \brief TIFF compression and layout options.
+	 *
+	 * Unlike most other settings, these apply to all pages of a project.
+	 */
+	TiffWriter::Options tiffOptions() const;
+
+	/**
+	 * Changing the options makes the output of every page out of date,
+	 * so all output params are removed in that case.
+	 */
+	void setTiffOptions(TiffWriter::Options const& options);
 private:
 	typedef std::map<PageId, Params> PerPageParams;
 	typedef std::map<PageId, OutputParams> PerPageOutputParams;
@@ -110,6 +124,7 @@ private:
 	PerPageZones m_perPageFillZones;
 	PropertySet m_defaultPictureZoneProps;
 	PropertySet m_defaultFillZoneProps;
+	TiffWriter::Options m_tiffOptions;
 };
 
 } // namespace output
@@ -28,6 +28,7 @@
 #include "RenderParams.h"
 #include "FilterUiInterface.h"
 #include "TaskStatus.h"
+#include "Trace.h"
 #include "FilterData.h"
 #include "ImageView.h"
 #include "ImageViewTab.h"
@@ -150,6 +151,8 @@ Task::process(
 	TaskStatus const& status, FilterData const& data,
 	QPolygonF const& content_rect_phys)
 {
+	TraceSpan const span("output task", m_pageId.imageId().filePath());
+
 	status.throwIfCancelled();
 
 	Params params(m_ptrSettings->getParams(m_pageId));
@@ -295,11 +298,22 @@ Task::process(
 		speckles_img = BinaryImage();
 
 		DistortionModel distortion_model;
+		QString auto_model_fingerprint;
 		if (params.dewarpingMode() == DewarpingMode::MANUAL) {
 			distortion_model = params.distortionModel();
+		} else if (params.dewarpingMode() == DewarpingMode::AUTO) {
+			// If only things like thresholds or despeckling changed,
+			// the previously built model is still good.
+			auto_model_fingerprint = generator.autoDistortionModelFingerprint(
+				m_pageId.imageId(), data.origImage().size()
+			);
+			if (params.distortionModelFingerprint() == auto_model_fingerprint) {
+				distortion_model = params.distortionModel();
+			}
 		}
 		// OutputGenerator will write a new distortion model
-		// there, if dewarping mode is AUTO.
+		// there, if dewarping mode is AUTO and we didn't
+		// provide a valid one.
 
 		out_img = generator.process(
 			status, data, new_picture_zones, new_fill_zones,
@@ -311,9 +325,10 @@ Task::process(
 		);
 
 		if (params.dewarpingMode() == DewarpingMode::AUTO && distortion_model.isValid()) {
-			// A new distortion model was generated.
-			// We need to save it to be able to modify it manually.
-			params.setDistortionModel(distortion_model);
+			// A new distortion model was generated, or an old one reused.
+			// We need to save it to be able to modify it manually,
+			// and to avoid building it again.
+			params.setAutoDistortionModel(distortion_model, auto_model_fingerprint);
 			m_ptrSettings->setParams(m_pageId, params);
 			new_output_image_params.setDistortionModel(distortion_model);
 		}
@@ -327,7 +342,7 @@ Task::process(
 
 		bool invalidate_params = false;
 		
-		if (!TiffWriter::writeImage(out_file_path, out_img)) {
+		if (!TiffWriter::writeImage(out_file_path, out_img, m_ptrSettings->tiffOptions())) {
 			invalidate_params = true;
 		} else {
 			deleteMutuallyExclusiveOutputFiles();
@@ -28,6 +28,7 @@
 #include "filters/output/CacheDrivenTask.h"
 #include "filter_dc/AbstractFilterDataCollector.h"
 #include "filter_dc/ThumbnailCollector.h"
+#include "filter_dc/UpToDateCollector.h"
 #include <QSizeF>
 #include <QRectF>
 #include <QPolygonF>
@@ -91,6 +92,10 @@ CacheDrivenTask::process(
 		return;
 	}
 	
+	if (UpToDateCollector* col = dynamic_cast<UpToDateCollector*>(collector)) {
+		col->processUpToDate();
+	}
+	
 	if (ThumbnailCollector* thumb_col = dynamic_cast<ThumbnailCollector*>(collector)) {
 		
 		thumb_col->processThumbnail(
@@ -25,6 +25,7 @@
 #include "Utils.h"
 #include "FilterUiInterface.h"
 #include "TaskStatus.h"
+#include "Trace.h"
 #include "FilterData.h"
 #include "ImageView.h"
 #include "ImageTransformation.h"
@@ -90,6 +91,8 @@ Task::process(
 	TaskStatus const& status, FilterData const& data,
 	QRectF const& content_rect)
 {
+	TraceSpan const span("page layout task", m_pageId.imageId().filePath());
+
 	status.throwIfCancelled();
 	
 	QSizeF const content_size_mm(
@@ -18,6 +18,7 @@
 
 #include "Task.h"
 #include "TaskStatus.h"
+#include "Trace.h"
 #include "Filter.h"
 #include "OptionsWidget.h"
 #include "Settings.h"
@@ -116,6 +117,8 @@ Task::~Task()
 FilterResultPtr
 Task::process(TaskStatus const& status, FilterData const& data)
 {
+	TraceSpan const span("split pages task", m_pageInfo.imageId().filePath());
+
 	status.throwIfCancelled();
 	
 	Settings::Record record(m_ptrSettings->getPageRecord(m_pageInfo.imageId()));
@@ -25,6 +25,7 @@
 #include "PageId.h"
 #include "filter_dc/AbstractFilterDataCollector.h"
 #include "filter_dc/ThumbnailCollector.h"
+#include "filter_dc/UpToDateCollector.h"
 #include "filter_dc/ContentBoxCollector.h"
 #include "filters/page_layout/CacheDrivenTask.h"
 
@@ -76,6 +77,10 @@ CacheDrivenTask::process(
 		return;
 	}
 	
+	if (UpToDateCollector* col = dynamic_cast<UpToDateCollector*>(collector)) {
+		col->processUpToDate();
+	}
+	
 	if (ThumbnailCollector* thumb_col = dynamic_cast<ThumbnailCollector*>(collector)) {
 		thumb_col->processThumbnail(
 			std::auto_ptr<QGraphicsItem>(
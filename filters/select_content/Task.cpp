@@ -26,6 +26,7 @@
 #include "Params.h"
 #include "Settings.h"
 #include "TaskStatus.h"
+#include "Trace.h"
 #include "ContentBoxFinder.h"
 #include "FilterUiInterface.h"
 #include "ImageView.h"
@@ -87,6 +88,8 @@ Task::~Task()
 FilterResultPtr
 Task::process(TaskStatus const& status, FilterData const& data)
 {
+	TraceSpan const span("select content task", m_pageId.imageId().filePath());
+
 	status.throwIfCancelled();
 	
 	Dependencies const deps(data.xform().resultingPreCropArea());
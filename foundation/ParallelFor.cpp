@@ -0,0 +1,212 @@
+/*
+	Scan Tailor - Interactive post-processing tool for scanned pages.
+	Copyright (C) Joseph Artsimovich <joseph_a@mail.ru>
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "ParallelFor.h"
+#include "RefCountable.h"
+#include "IntrusivePtr.h"
+#include <QThreadPool>
+#include <QThread>
+#include <QRunnable>
+#include <QAtomicInt>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QWaitCondition>
+#include <new>
+#include <string>
+#include <exception>
+#include <stdexcept>
+#include <algorithm>
+
+namespace
+{
+
+QAtomicInt g_maxThreads(0);
+
+class SharedState : public RefCountable
+{
+public:
+	SharedState(int begin, int end, int num_chunks,
+		ParallelFor::RangeProcessor const& processor);
+
+	/**
+	 * Keeps claiming unprocessed chunks until there are none left.
+	 */
+	void processChunks();
+
+	/**
+	 * Blocks until every chunk has been processed, then re-throws
+	 * the first exception that occurred, if any.
+	 */
+	void waitForCompletion();
+private:
+	void processChunk(int chunk);
+
+	ParallelFor::RangeProcessor m_processor;
+	QAtomicInt m_nextChunk;
+	int const m_begin;
+	int const m_end;
+	int const m_numChunks;
+	QMutex m_mutex;
+	QWaitCondition m_allDone;
+	int m_chunksDone;
+	bool m_badAlloc;
+	bool m_failed;
+	std::string m_errorMessage;
+};
+
+
+class Runnable : public QRunnable
+{
+public:
+	Runnable(IntrusivePtr<SharedState> const& state) : m_ptrState(state) {
+		setAutoDelete(true);
+	}
+
+	virtual void run() { m_ptrState->processChunks(); }
+private:
+	IntrusivePtr<SharedState> m_ptrState;
+};
+
+
+SharedState::SharedState(
+	int const begin, int const end, int const num_chunks,
+	ParallelFor::RangeProcessor const& processor)
+:	m_processor(processor),
+	m_nextChunk(0),
+	m_begin(begin),
+	m_end(end),
+	m_numChunks(num_chunks),
+	m_chunksDone(0),
+	m_badAlloc(false),
+	m_failed(false)
+{
+}
+
+void
+SharedState::processChunks()
+{
+	for (;;) {
+		int const chunk = m_nextChunk.fetchAndAddOrdered(1);
+		if (chunk >= m_numChunks) {
+			break;
+		}
+		processChunk(chunk);
+	}
+}
+
+void
+SharedState::processChunk(int const chunk)
+{
+	qint64 const size = m_end - m_begin;
+	int const chunk_begin = m_begin + int(size * chunk / m_numChunks);
+	int const chunk_end = m_begin + int(size * (chunk + 1) / m_numChunks);
+
+	bool bad_alloc = false;
+	bool failed = false;
+	std::string error_message;
+	try {
+		m_processor(chunk_begin, chunk_end);
+	} catch (std::bad_alloc const&) {
+		bad_alloc = true;
+	} catch (std::exception const& e) {
+		failed = true;
+		error_message = e.what();
+	} catch (...) {
+		failed = true;
+		error_message = "Unknown exception in a parallel task";
+	}
+
+	QMutexLocker const locker(&m_mutex);
+	if (!m_badAlloc && !m_failed) {
+		m_badAlloc = bad_alloc;
+		m_failed = failed;
+		m_errorMessage = error_message;
+	}
+	if (++m_chunksDone == m_numChunks) {
+		m_allDone.wakeAll();
+	}
+}
+
+void
+SharedState::waitForCompletion()
+{
+	QMutexLocker const locker(&m_mutex);
+	while (m_chunksDone < m_numChunks) {
+		m_allDone.wait(&m_mutex);
+	}
+
+	if (m_badAlloc) {
+		throw std::bad_alloc();
+	} else if (m_failed) {
+		throw std::runtime_error(m_errorMessage);
+	}
+}
+
+} // anonymous namespace
+
+void
+ParallelFor::run(int const begin, int const end, int const min_chunk,
+	RangeProcessor const& processor)
+{
+	if (begin >= end) {
+		return;
+	}
+
+	int const max_threads = maxThreads();
+	qint64 const size = end - begin;
+	qint64 const chunk = std::max(min_chunk, 1);
+	if (max_threads <= 1 || size <= chunk) {
+		processor(begin, end);
+		return;
+	}
+
+	// A few chunks per thread help balancing uneven workloads.
+	int const num_chunks = (int)std::min<qint64>(
+		(size + chunk - 1) / chunk, max_threads * 4
+	);
+	int const num_helpers = std::min(num_chunks, max_threads) - 1;
+
+	IntrusivePtr<SharedState> const state(
+		new SharedState(begin, end, num_chunks, processor)
+	);
+
+	QThreadPool* pool = QThreadPool::globalInstance();
+	for (int i = 0; i < num_helpers; ++i) {
+		pool->start(new Runnable(state));
+	}
+
+	state->processChunks();
+	state->waitForCompletion();
+}
+
+int
+ParallelFor::maxThreads()
+{
+	int const num_threads = g_maxThreads;
+	if (num_threads > 0) {
+		return num_threads;
+	}
+	return std::max(QThread::idealThreadCount(), 1);
+}
+
+void
+ParallelFor::setMaxThreads(int const num_threads)
+{
+	g_maxThreads = std::max(num_threads, 1);
+}
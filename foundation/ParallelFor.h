@@ -0,0 +1,79 @@
+/*
+	Scan Tailor - Interactive post-processing tool for scanned pages.
+	Copyright (C) Joseph Artsimovich <joseph_a@mail.ru>
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef PARALLEL_FOR_H_
+#define PARALLEL_FOR_H_
+
+#ifndef Q_MOC_RUN
+#include <boost/function.hpp>
+#endif
+
+/**
+ * \brief Splits an index range into chunks and processes them concurrently.
+ *
+ * Worker threads come from QThreadPool::globalInstance().  The calling
+ * thread takes part in the processing and doesn't return until every chunk
+ * is done.  Chunks no pool thread has picked up yet are processed by the
+ * calling thread itself, so it's safe to call run() from a pool thread
+ * or recursively: at worst everything ends up running serially.
+ */
+class ParallelFor
+{
+public:
+	/**
+	 * Processes indices in [begin, end).
+	 * It's called concurrently for non-overlapping ranges.
+	 */
+	typedef boost::function<void (int begin, int end)> RangeProcessor;
+
+	/**
+	 * \brief Calls \p processor for sub-ranges covering [begin, end).
+	 *
+	 * \param begin The first index to process.
+	 * \param end One past the last index to process.
+	 * \param min_chunk The minimum size of a sub-range.  Ranges not larger
+	 *        than that are processed by the calling thread in one go.
+	 * \param processor The functor to call.  Chunk boundaries don't depend
+	 *        on timing, so if \p processor only writes data belonging
+	 *        to its own range, the result is independent of the number
+	 *        of threads.
+	 *
+	 * If \p processor throws std::bad_alloc, it's re-thrown from the calling
+	 * thread once all started chunks are finished.  Any other exception
+	 * is re-thrown as std::runtime_error with the same message.
+	 */
+	static void run(int begin, int end, int min_chunk,
+		RangeProcessor const& processor);
+
+	/**
+	 * \brief The maximum number of threads (the calling one included)
+	 *        a single run() call is going to use.
+	 *
+	 * Defaults to QThread::idealThreadCount().
+	 */
+	static int maxThreads();
+
+	/**
+	 * \brief Limits the number of threads a single run() call is going to use.
+	 *
+	 * A value of 1 makes everything run on the calling thread.
+	 */
+	static void setMaxThreads(int num_threads);
+};
+
+#endif
@@ -0,0 +1,271 @@
+/*
+	Scan Tailor - Interactive post-processing tool for scanned pages.
+	Copyright (C)  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "Trace.h"
+#include <QMutex>
+#include <QMutexLocker>
+#include <QAtomicInt>
+#include <QElapsedTimer>
+#include <QThread>
+#include <QFile>
+#include <QIODevice>
+#include <QByteArray>
+#include <vector>
+#include <map>
+#include <stdio.h>
+
+#if defined(Q_OS_UNIX)
+#include <sys/time.h>
+#include <sys/resource.h>
+#include <time.h>
+#elif defined(Q_OS_WIN)
+#include <windows.h>
+#endif
+
+namespace
+{
+
+struct Event
+{
+	char const* name;
+	QString detail;
+	qint64 startUsec;
+	qint64 durationUsec;
+	qint64 cpuUsec; // -1 if unknown.
+	qint64 peakRssKb; // -1 if unknown.
+	qint64 rssGrowthKb;
+	int thread;
+};
+
+QMutex g_mutex;
+QElapsedTimer g_clock;
+QAtomicInt g_enabled(0); // Read without locking g_mutex.
+std::vector<Event> g_events;
+std::map<Qt::HANDLE, int> g_threads;
+
+qint64 wallUsec()
+{
+#if QT_VERSION >= 0x040800
+	return g_clock.nsecsElapsed() / 1000;
+#else
+	// nsecsElapsed() appeared in Qt 4.8.
+	return g_clock.elapsed() * 1000;
+#endif
+}
+
+/**
+ * CPU time consumed by the calling thread, or -1 if not available.
+ */
+qint64 threadCpuUsec()
+{
+#if defined(Q_OS_UNIX) && defined(CLOCK_THREAD_CPUTIME_ID)
+	timespec ts;
+	if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts) == 0) {
+		return qint64(ts.tv_sec) * 1000000 + ts.tv_nsec / 1000;
+	}
+#elif defined(Q_OS_WIN)
+	FILETIME creation, exit, kernel, user;
+	if (GetThreadTimes(GetCurrentThread(), &creation, &exit, &kernel, &user)) {
+		ULARGE_INTEGER k, u;
+		k.LowPart = kernel.dwLowDateTime;
+		k.HighPart = kernel.dwHighDateTime;
+		u.LowPart = user.dwLowDateTime;
+		u.HighPart = user.dwHighDateTime;
+		return qint64(k.QuadPart + u.QuadPart) / 10; // 100 ns units.
+	}
+#endif
+	return -1;
+}
+
+/**
+ * The peak resident set size of the process, or -1 if not available.
+ */
+qint64 peakRssKb()
+{
+#if defined(Q_OS_UNIX)
+	rusage usage;
+	if (getrusage(RUSAGE_SELF, &usage) == 0) {
+#if defined(Q_OS_MAC)
+		return usage.ru_maxrss / 1024; // Bytes rather than kilobytes there.
+#else
+		return usage.ru_maxrss;
+#endif
+	}
+#endif
+	return -1;
+}
+
+void recordEvent(Event& event)
+{
+	Qt::HANDLE const thread_id = QThread::currentThreadId();
+
+	QMutexLocker const locker(&g_mutex);
+	
+	std::map<Qt::HANDLE, int>::iterator it(g_threads.find(thread_id));
+	if (it == g_threads.end()) {
+		int const idx = g_threads.size() + 1;
+		it = g_threads.insert(std::make_pair(thread_id, idx)).first;
+	}
+	event.thread = it->second;
+	
+	g_events.push_back(event);
+}
+
+void appendJsonString(QByteArray& json, QByteArray const& utf8)
+{
+	json += '"';
+	for (int i = 0; i < utf8.size(); ++i) {
+		char const ch = utf8[i];
+		if (ch == '"' || ch == '\\') {
+			json += '\\';
+			json += ch;
+		} else if ((unsigned char)ch < 0x20) {
+			char buf[8];
+			sprintf(buf, "\\u%04x", (unsigned)ch);
+			json += buf;
+		} else {
+			json += ch;
+		}
+	}
+	json += '"';
+}
+
+} // anonymous namespace
+
+
+/*================================== Trace ==================================*/
+
+void
+Trace::enable()
+{
+	QMutexLocker const locker(&g_mutex);
+	if (!g_clock.isValid()) {
+		g_clock.start();
+	}
+	// The ordered store publishes the started clock to the spans.
+	g_enabled.fetchAndStoreOrdered(1);
+}
+
+bool
+Trace::isEnabled()
+{
+	return g_enabled != 0;
+}
+
+bool
+Trace::writeChromeTrace(QString const& file_path)
+{
+	QByteArray json("{\"traceEvents\":[\n");
+	
+	{
+		QMutexLocker const locker(&g_mutex);
+		
+		for (size_t i = 0; i < g_events.size(); ++i) {
+			Event const& event = g_events[i];
+			if (i != 0) {
+				json += ",\n";
+			}
+			json += "{\"name\":";
+			appendJsonString(json, QByteArray(event.name));
+			json += ",\"cat\":\"scantailor\",\"ph\":\"X\",\"pid\":1,\"tid\":";
+			json += QByteArray::number(event.thread);
+			json += ",\"ts\":";
+			json += QByteArray::number(event.startUsec);
+			json += ",\"dur\":";
+			json += QByteArray::number(event.durationUsec);
+			json += ",\"args\":{";
+			
+			bool first_arg = true;
+			if (!event.detail.isEmpty()) {
+				json += "\"detail\":";
+				appendJsonString(json, event.detail.toUtf8());
+				first_arg = false;
+			}
+			if (event.cpuUsec >= 0) {
+				json += first_arg ? "" : ",";
+				json += "\"cpu_us\":";
+				json += QByteArray::number(event.cpuUsec);
+				first_arg = false;
+			}
+			if (event.peakRssKb >= 0) {
+				json += first_arg ? "" : ",";
+				json += "\"peak_rss_kb\":";
+				json += QByteArray::number(event.peakRssKb);
+				json += ",\"peak_rss_growth_kb\":";
+				json += QByteArray::number(event.rssGrowthKb);
+			}
+			json += "}}";
+		}
+	}
+	
+	json += "\n],\"displayTimeUnit\":\"ms\"}\n";
+	
+	QFile file(file_path);
+	if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+		return false;
+	}
+	
+	return file.write(json) == json.size();
+}
+
+
+/*================================ TraceSpan ================================*/
+
+TraceSpan::TraceSpan(char const* name, QString const& detail)
+:	m_pName(name),
+	m_startUsec(0),
+	m_startCpuUsec(-1),
+	m_startPeakRssKb(-1),
+	m_active(Trace::isEnabled())
+{
+	if (m_active) {
+		m_detail = detail;
+		m_startPeakRssKb = peakRssKb();
+		m_startCpuUsec = threadCpuUsec();
+		m_startUsec = wallUsec();
+	}
+}
+
+TraceSpan::~TraceSpan()
+{
+	if (!m_active) {
+		return;
+	}
+	
+	qint64 const end_usec = wallUsec();
+	qint64 const end_cpu_usec = threadCpuUsec();
+	qint64 const end_peak_rss_kb = peakRssKb();
+	
+	Event event;
+	event.name = m_pName;
+	event.detail = m_detail;
+	event.startUsec = m_startUsec;
+	event.durationUsec = end_usec - m_startUsec;
+	event.cpuUsec = -1;
+	if (m_startCpuUsec >= 0 && end_cpu_usec >= 0) {
+		event.cpuUsec = end_cpu_usec - m_startCpuUsec;
+	}
+	event.peakRssKb = end_peak_rss_kb;
+	event.rssGrowthKb = 0;
+	if (m_startPeakRssKb >= 0 && end_peak_rss_kb >= 0) {
+		event.rssGrowthKb = end_peak_rss_kb - m_startPeakRssKb;
+	}
+	event.thread = 0;
+	
+	recordEvent(event);
+}
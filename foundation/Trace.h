@@ -0,0 +1,83 @@
+/*
+	Scan Tailor - Interactive post-processing tool for scanned pages.
+	Copyright (C)  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef TRACE_H_
+#define TRACE_H_
+
+#include "NonCopyable.h"
+#include <QString>
+#include <QtGlobal>
+
+/**
+ * \brief Process-wide recorder of timed spans.
+ *
+ * Recording is off unless enable() was called, in which case TraceSpan
+ * objects cost a single check.  Recorded spans can be written out in
+ * Chrome's trace event format and viewed in chrome://tracing or Perfetto.
+ * All methods are thread-safe.
+ */
+class Trace
+{
+public:
+	/**
+	 * \brief Starts recording spans.
+	 *
+	 * Timestamps of spans are relative to the first call to this method.
+	 */
+	static void enable();
+
+	static bool isEnabled();
+
+	/**
+	 * \brief Writes the spans recorded so far as Chrome trace JSON.
+	 *
+	 * \return false if the file couldn't be written.
+	 */
+	static bool writeChromeTrace(QString const& file_path);
+};
+
+
+/**
+ * \brief Records a span covering the lifetime of this object.
+ *
+ * Each span gets the wall clock time, the CPU time consumed by the calling
+ * thread, the thread itself, and the peak resident set size of the process
+ * along with how much it grew during the span.  The last three are only
+ * recorded on platforms where they are available.
+ */
+class TraceSpan
+{
+	DECLARE_NON_COPYABLE(TraceSpan)
+public:
+	/**
+	 * \param name The name of the span.  Must point to a string literal.
+	 * \param detail Optional details, like the file being processed.
+	 */
+	explicit TraceSpan(char const* name, QString const& detail = QString());
+
+	~TraceSpan();
+private:
+	char const* m_pName;
+	QString m_detail;
+	qint64 m_startUsec;
+	qint64 m_startCpuUsec;
+	qint64 m_startPeakRssKb;
+	bool m_active;
+};
+
+#endif
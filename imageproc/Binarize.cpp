@@ -20,9 +20,8 @@
 #include "BinaryImage.h"
 #include "BinaryThreshold.h"
 #include "Grayscale.h"
-#include "IntegralImage.h"
+#include "ParallelFor.h"
 #include <QImage>
-#include <QRect>
 #include <QDebug>
 #include <vector>
 #include <algorithm>
@@ -52,85 +51,441 @@ BinaryImage binarizeMokji(
 	return BinaryImage(src, threshold);
 }
 
-BinaryImage binarizeSauvola(QImage const& src, QSize const window_size)
+namespace
 {
-	if (window_size.isEmpty()) {
-		throw std::invalid_argument("binarizeSauvola: invalid window_size");
+
+/**
+ * \brief Means and variances of pixels in windows centered
+ *        at each pixel of a line.
+ *
+ * Rather than building integral images of the whole picture, we keep
+ * column sums over the lines covered by the window.  Moving the window
+ * one line down adds the line entering it and subtracts the one leaving it.
+ * Sums over windows come from prefix sums of a line of column sums.
+ * These are integers small enough to be exact in double precision,
+ * so the results are exactly the ones integral images would give.
+ */
+class WindowStats
+{
+public:
+	WindowStats(QImage const& gray, QSize const& window_size);
+
+	/**
+	 * \brief Positions the window at line \p y and computes the statistics.
+	 *
+	 * The first call may be for any line.  Further calls must not
+	 * go upwards.
+	 */
+	void moveTo(int y);
+
+	double const* means() const { return &m_means[0]; }
+
+	double const* variances() const { return &m_variances[0]; }
+private:
+	void addLine(int y);
+
+	void subtractLine(int y);
+
+	void computeStats(int x_begin, int x_end);
+
+	void computeStatsUnclipped(int x_begin, int x_end);
+
+	uint8_t const* m_pGrayData;
+	int m_grayBpl;
+	int m_width;
+	int m_height;
+	int m_leftHalf;
+	int m_rightHalf;
+	int m_lowerHalf;
+	int m_upperHalf;
+	int m_top;
+	int m_bottom; // exclusive
+	std::vector<uint32_t> m_colSums;
+	std::vector<uint64_t> m_colSqsums;
+
+	/**
+	 * m_sumPrefix[x] is the sum of m_colSums[0] .. m_colSums[x - 1].
+	 */
+	std::vector<double> m_sumPrefix;
+	std::vector<double> m_sqsumPrefix;
+
+	std::vector<double> m_means;
+	std::vector<double> m_variances;
+};
+
+WindowStats::WindowStats(QImage const& gray, QSize const& window_size)
+:	m_pGrayData(gray.bits()),
+	m_grayBpl(gray.bytesPerLine()),
+	m_width(gray.width()),
+	m_height(gray.height()),
+	m_leftHalf(window_size.width() >> 1),
+	m_rightHalf(window_size.width() - m_leftHalf),
+	m_lowerHalf(window_size.height() >> 1),
+	m_upperHalf(window_size.height() - m_lowerHalf),
+	m_top(0),
+	m_bottom(0),
+	m_colSums(m_width, 0),
+	m_colSqsums(m_width, 0),
+	m_sumPrefix(m_width + 1, 0),
+	m_sqsumPrefix(m_width + 1, 0),
+	m_means(m_width, 0),
+	m_variances(m_width, 0)
+{
+}
+
+void
+WindowStats::moveTo(int const y)
+{
+	int const top = std::max(0, y - m_lowerHalf);
+	int const bottom = std::min(m_height, y + m_upperHalf);
+
+	if (m_top == m_bottom) {
+		// The first call.
+		m_top = top;
+		m_bottom = top;
 	}
-	
-	if (src.isNull()) {
-		return BinaryImage();
+
+	for (; m_bottom < bottom; ++m_bottom) {
+		addLine(m_bottom);
 	}
-	
-	QImage const gray(toGrayscale(src));
-	int const w = gray.width();
-	int const h = gray.height();
-	
-	IntegralImage<uint32_t> integral_image(w, h);
-	IntegralImage<uint64_t> integral_sqimage(w, h);
-	
-	uint8_t const* gray_line = gray.bits();
-	int const gray_bpl = gray.bytesPerLine();
-	
-	for (int y = 0; y < h; ++y, gray_line += gray_bpl) {
-		integral_image.beginRow();
-		integral_sqimage.beginRow();
-		for (int x = 0; x < w; ++x) {
-			uint32_t const pixel = gray_line[x];
-			integral_image.push(pixel);
-			integral_sqimage.push(pixel * pixel);
+	for (; m_top < top; ++m_top) {
+		subtractLine(m_top);
+	}
+
+	// Integer accumulators keep the conversions to double
+	// off the dependency chain.
+	uint64_t sum = 0;
+	uint64_t sqsum = 0;
+	for (int x = 0; x < m_width; ++x) {
+		sum += m_colSums[x];
+		sqsum += m_colSqsums[x];
+		m_sumPrefix[x + 1] = double(int64_t(sum));
+		m_sqsumPrefix[x + 1] = double(int64_t(sqsum));
+	}
+
+	// Windows are clipped by the left and right edges of the image
+	// at the beginning and at the end of the line.
+	int const unclipped_begin = std::min(m_width, m_leftHalf);
+	int const unclipped_end = std::max(unclipped_begin, m_width - m_rightHalf + 1);
+	computeStats(0, unclipped_begin);
+	computeStatsUnclipped(unclipped_begin, unclipped_end);
+	computeStats(unclipped_end, m_width);
+}
+
+void
+WindowStats::addLine(int const y)
+{
+	uint8_t const* const line = m_pGrayData + y * m_grayBpl;
+	uint32_t* const sums = &m_colSums[0];
+	uint64_t* const sqsums = &m_colSqsums[0];
+	for (int x = 0; x < m_width; ++x) {
+		uint32_t const pixel = line[x];
+		sums[x] += pixel;
+		sqsums[x] += pixel * pixel;
+	}
+}
+
+void
+WindowStats::subtractLine(int const y)
+{
+	uint8_t const* const line = m_pGrayData + y * m_grayBpl;
+	uint32_t* const sums = &m_colSums[0];
+	uint64_t* const sqsums = &m_colSqsums[0];
+	for (int x = 0; x < m_width; ++x) {
+		uint32_t const pixel = line[x];
+		sums[x] -= pixel;
+		sqsums[x] -= pixel * pixel;
+	}
+}
+
+void
+WindowStats::computeStats(int const x_begin, int const x_end)
+{
+	int const height = m_bottom - m_top;
+	for (int x = x_begin; x < x_end; ++x) {
+		int const left = std::max(0, x - m_leftHalf);
+		int const right = std::min(m_width, x + m_rightHalf); // exclusive
+		int const area = height * (right - left);
+		assert(area > 0); // because window_size > 0 and w > 0 and h > 0
+
+		double const window_sum = m_sumPrefix[right] - m_sumPrefix[left];
+		double const window_sqsum = m_sqsumPrefix[right] - m_sqsumPrefix[left];
+
+		double const r_area = 1.0 / area;
+		double const mean = window_sum * r_area;
+		double const sqmean = window_sqsum * r_area;
+
+		m_means[x] = mean;
+		m_variances[x] = sqmean - mean * mean;
+	}
+}
+
+/**
+ * Same as computeStats(), but for windows that fit horizontally.
+ * Here the area is constant and the loop is simple enough
+ * for the compiler to vectorize.
+ */
+void
+WindowStats::computeStatsUnclipped(int const x_begin, int const x_end)
+{
+	double const r_area = 1.0 / ((m_bottom - m_top) * (m_leftHalf + m_rightHalf));
+	double const* const sum_prefix = &m_sumPrefix[0];
+	double const* const sqsum_prefix = &m_sqsumPrefix[0];
+	double* const means = &m_means[0];
+	double* const variances = &m_variances[0];
+	int const left_half = m_leftHalf;
+	int const right_half = m_rightHalf;
+
+	for (int x = x_begin; x < x_end; ++x) {
+		double const window_sum = sum_prefix[x + right_half] - sum_prefix[x - left_half];
+		double const window_sqsum = sqsum_prefix[x + right_half] - sqsum_prefix[x - left_half];
+		double const mean = window_sum * r_area;
+		double const sqmean = window_sqsum * r_area;
+		means[x] = mean;
+		variances[x] = sqmean - mean * mean;
+	}
+}
+
+/**
+ * Bands of lines are processed independently, each one starting
+ * with a window of its own.  Setting up a window costs as much
+ * as moving it by its height, so bands have to be much taller than that.
+ */
+int bandHeight(QSize const& image_size, QSize const& window_size)
+{
+	int const max_threads = ParallelFor::maxThreads();
+	if (max_threads <= 1) {
+		return image_size.height();
+	}
+
+	int const min_height = std::max(
+		window_size.height() * 4, (1 << 16) / image_size.width() + 1
+	);
+	int const even_split = (image_size.height() + max_threads * 4 - 1) / (max_threads * 4);
+	return std::max(min_height, even_split);
+}
+
+/**
+ * Packs a line of per-pixel decisions into BinaryImage words.
+ * Decisions are made in a separate loop, so that one may be vectorized.
+ */
+void packLine(uint8_t const* black, int const width, uint32_t* bw_line)
+{
+	int x = 0;
+	for (; x + 32 <= width; x += 32) {
+		uint32_t word = 0;
+		for (int i = 0; i < 32; ++i) {
+			word = (word << 1) | black[x + i];
 		}
+		*bw_line++ = word;
 	}
+	if (x < width) {
+		uint32_t word = 0;
+		for (int i = x; i < width; ++i) {
+			word = (word << 1) | black[i];
+		}
+		*bw_line = word << (32 - (width - x));
+	}
+}
+
+class SauvolaBands
+{
+public:
+	SauvolaBands(
+		QImage const& gray, QSize const& window_size,
+		BinaryImage& dst, int band_height)
+	:	m_rGray(gray),
+		m_windowSize(window_size),
+		m_rDst(dst),
+		m_bandHeight(band_height) {}
+
+	void operator()(int band_begin, int band_end) const;
+private:
+	QImage const& m_rGray;
+	QSize m_windowSize;
+	BinaryImage& m_rDst;
+	int m_bandHeight;
+};
+
+void
+SauvolaBands::operator()(int const band_begin, int const band_end) const
+{
+	int const w = m_rGray.width();
+	int const h = m_rGray.height();
+	int const gray_bpl = m_rGray.bytesPerLine();
+	int const bw_wpl = m_rDst.wordsPerLine();
+
+	WindowStats stats(m_rGray, m_windowSize);
+	std::vector<uint8_t> black(w);
 	
-	int const window_lower_half = window_size.height() >> 1;
-	int const window_upper_half = window_size.height() - window_lower_half;
-	int const window_left_half = window_size.width() >> 1;
-	int const window_right_half = window_size.width() - window_left_half;
-	
-	BinaryImage bw_img(w, h);
-	uint32_t* bw_line = bw_img.data();
-	int const bw_wpl = bw_img.wordsPerLine();
-	
-	gray_line = gray.bits();
-	for (int y = 0; y < h; ++y) {
-		int const top = std::max(0, y - window_lower_half);
-		int const bottom = std::min(h, y + window_upper_half); // exclusive
-		
+	int const y_begin = band_begin * m_bandHeight;
+	int const y_end = std::min(h, band_end * m_bandHeight);
+	for (int y = y_begin; y < y_end; ++y) {
+		stats.moveTo(y);
+
+		uint8_t const* const gray_line = m_rGray.bits() + y * gray_bpl;
+		double const* const means = stats.means();
+		double const* const variances = stats.variances();
 		for (int x = 0; x < w; ++x) {
-			int const left = std::max(0, x - window_left_half);
-			int const right = std::min(w, x + window_right_half); // exclusive
-			int const area = (bottom - top) * (right - left);
-			assert(area > 0); // because window_size > 0 and w > 0 and h > 0
-			
-			QRect const rect(left, top, right - left, bottom - top);
-			double const window_sum = integral_image.sum(rect);
-			double const window_sqsum = integral_sqimage.sum(rect);
-			
-			double const r_area = 1.0 / area;
-			double const mean = window_sum * r_area;
-			double const sqmean = window_sqsum * r_area;
-			
-			double const variance = sqmean - mean * mean;
-			double const deviation = sqrt(fabs(variance));
-			
+			double const mean = means[x];
+			double const deviation = sqrt(fabs(variances[x]));
 			double const k = 0.34;
 			double const threshold = mean * (1.0 + k * (deviation / 128.0 - 1.0));
-			
-			uint32_t const msb = uint32_t(1) << 31;
-			uint32_t const mask = msb >> (x & 31);
-			if (int(gray_line[x]) < threshold) {
-				// black
-				bw_line[x >> 5] |= mask;
-			} else {
-				// white
-				bw_line[x >> 5] &= ~mask;
+			black[x] = int(gray_line[x]) < threshold;
+		}
+
+		packLine(&black[0], w, m_rDst.data() + y * bw_wpl);
+	}
+}
+
+/**
+ * The first pass of Wolf's method: the maximum deviation and
+ * the minimum gray level, collected per band.
+ */
+class WolfStatsBands
+{
+public:
+	WolfStatsBands(
+		QImage const& gray, QSize const& window_size, int band_height,
+		std::vector<double>& max_deviations, std::vector<uint32_t>& min_gray_levels)
+	:	m_rGray(gray),
+		m_windowSize(window_size),
+		m_bandHeight(band_height),
+		m_rMaxDeviations(max_deviations),
+		m_rMinGrayLevels(min_gray_levels) {}
+
+	void operator()(int band_begin, int band_end) const;
+private:
+	QImage const& m_rGray;
+	QSize m_windowSize;
+	int m_bandHeight;
+	std::vector<double>& m_rMaxDeviations;
+	std::vector<uint32_t>& m_rMinGrayLevels;
+};
+
+void
+WolfStatsBands::operator()(int const band_begin, int const band_end) const
+{
+	int const w = m_rGray.width();
+	int const h = m_rGray.height();
+	int const gray_bpl = m_rGray.bytesPerLine();
+
+	WindowStats stats(m_rGray, m_windowSize);
+
+	for (int band = band_begin; band < band_end; ++band) {
+		// sqrt() is monotonic, so it's enough to take it once,
+		// for the maximum variance.
+		double max_variance = 0;
+		uint32_t min_gray_level = 255;
+
+		int const y_end = std::min(h, (band + 1) * m_bandHeight);
+		for (int y = band * m_bandHeight; y < y_end; ++y) {
+			stats.moveTo(y);
+
+			uint8_t const* const gray_line = m_rGray.bits() + y * gray_bpl;
+			double const* const variances = stats.variances();
+			for (int x = 0; x < w; ++x) {
+				max_variance = std::max(max_variance, fabs(variances[x]));
+				min_gray_level = std::min<uint32_t>(min_gray_level, gray_line[x]);
 			}
 		}
-		
-		gray_line += gray_bpl;
-		bw_line += bw_wpl;
+
+		m_rMaxDeviations[band] = sqrt(max_variance);
+		m_rMinGrayLevels[band] = min_gray_level;
+	}
+}
+
+/**
+ * The second pass of Wolf's method.  Means and deviations are computed
+ * again rather than stored, which would take 8 bytes per pixel.
+ */
+class WolfBands
+{
+public:
+	WolfBands(
+		QImage const& gray, QSize const& window_size,
+		BinaryImage& dst, int band_height,
+		double max_deviation, uint32_t min_gray_level,
+		unsigned char lower_bound, unsigned char upper_bound)
+	:	m_rGray(gray),
+		m_windowSize(window_size),
+		m_rDst(dst),
+		m_bandHeight(band_height),
+		m_maxDeviation(max_deviation),
+		m_minGrayLevel(min_gray_level),
+		m_lowerBound(lower_bound),
+		m_upperBound(upper_bound) {}
+
+	void operator()(int band_begin, int band_end) const;
+private:
+	QImage const& m_rGray;
+	QSize m_windowSize;
+	BinaryImage& m_rDst;
+	int m_bandHeight;
+	double m_maxDeviation;
+	uint32_t m_minGrayLevel;
+	unsigned char m_lowerBound;
+	unsigned char m_upperBound;
+};
+
+void
+WolfBands::operator()(int const band_begin, int const band_end) const
+{
+	int const w = m_rGray.width();
+	int const h = m_rGray.height();
+	int const gray_bpl = m_rGray.bytesPerLine();
+	int const bw_wpl = m_rDst.wordsPerLine();
+
+	WindowStats stats(m_rGray, m_windowSize);
+	std::vector<uint8_t> black(w);
+
+	int const y_begin = band_begin * m_bandHeight;
+	int const y_end = std::min(h, band_end * m_bandHeight);
+	for (int y = y_begin; y < y_end; ++y) {
+		stats.moveTo(y);
+
+		uint8_t const* const gray_line = m_rGray.bits() + y * gray_bpl;
+		double const* const means = stats.means();
+		double const* const variances = stats.variances();
+		for (int x = 0; x < w; ++x) {
+			// Single precision, as that's what these used to be stored in.
+			float const mean = means[x];
+			float const deviation = sqrt(fabs(variances[x]));
+			double const k = 0.3;
+			double const a = 1.0 - deviation / m_maxDeviation;
+			double const threshold = mean - k * a * (mean - m_minGrayLevel);
+
+			uint8_t const pixel = gray_line[x];
+			black[x] = pixel < m_lowerBound ||
+				(pixel <= m_upperBound && int(pixel) < threshold);
+		}
+
+		packLine(&black[0], w, m_rDst.data() + y * bw_wpl);
+	}
+}
+
+} // anonymous namespace
+
+BinaryImage binarizeSauvola(QImage const& src, QSize const window_size)
+{
+	if (window_size.isEmpty()) {
+		throw std::invalid_argument("binarizeSauvola: invalid window_size");
 	}
 	
+	if (src.isNull()) {
+		return BinaryImage();
+	}
+	
+	QImage const gray(toGrayscale(src));
+	BinaryImage bw_img(gray.width(), gray.height());
+
+	int const band_height = bandHeight(gray.size(), window_size);
+	int const num_bands = (gray.height() + band_height - 1) / band_height;
+	ParallelFor::run(
+		0, num_bands, 1,
+		SauvolaBands(gray, window_size, bw_img, band_height)
+	);
+	
 	return bw_img;
 }
 
@@ -147,92 +502,32 @@ BinaryImage binarizeWolf(
 	}
 	
 	QImage const gray(toGrayscale(src));
-	int const w = gray.width();
-	int const h = gray.height();
-	
-	IntegralImage<uint32_t> integral_image(w, h);
-	IntegralImage<uint64_t> integral_sqimage(w, h);
-	
-	uint8_t const* gray_line = gray.bits();
-	int const gray_bpl = gray.bytesPerLine();
-	
-	uint32_t min_gray_level = 255;
-	
-	for (int y = 0; y < h; ++y, gray_line += gray_bpl) {
-		integral_image.beginRow();
-		integral_sqimage.beginRow();
-		for (int x = 0; x < w; ++x) {
-			uint32_t const pixel = gray_line[x];
-			integral_image.push(pixel);
-			integral_sqimage.push(pixel * pixel);
-			min_gray_level = std::min(min_gray_level, pixel);
-		}
-	}
-	
-	int const window_lower_half = window_size.height() >> 1;
-	int const window_upper_half = window_size.height() - window_lower_half;
-	int const window_left_half = window_size.width() >> 1;
-	int const window_right_half = window_size.width() - window_left_half;
-	
-	std::vector<float> means(w * h, 0);
-	std::vector<float> deviations(w * h, 0);
-	
-	double max_deviation = 0;
-	
-	for (int y = 0; y < h; ++y) {
-		int const top = std::max(0, y - window_lower_half);
-		int const bottom = std::min(h, y + window_upper_half); // exclusive
-		
-		for (int x = 0; x < w; ++x) {
-			int const left = std::max(0, x - window_left_half);
-			int const right = std::min(w, x + window_right_half); // exclusive
-			int const area = (bottom - top) * (right - left);
-			assert(area > 0); // because window_size > 0 and w > 0 and h > 0
-			
-			QRect const rect(left, top, right - left, bottom - top);
-			double const window_sum = integral_image.sum(rect);
-			double const window_sqsum = integral_sqimage.sum(rect);
-			
-			double const r_area = 1.0 / area;
-			double const mean = window_sum * r_area;
-			double const sqmean = window_sqsum * r_area;
-			
-			double const variance = sqmean - mean * mean;
-			double const deviation = sqrt(fabs(variance));
-			max_deviation = std::max(max_deviation, deviation);
-			means[w * y + x] = mean;
-			deviations[w * y + x] = deviation;
-		}
-	}
-	
-	// TODO: integral images can be disposed at this point.
-	
-	BinaryImage bw_img(w, h);
-	uint32_t* bw_line = bw_img.data();
-	int const bw_wpl = bw_img.wordsPerLine();
+
+	int const band_height = bandHeight(gray.size(), window_size);
+	int const num_bands = (gray.height() + band_height - 1) / band_height;
+
+	std::vector<double> max_deviations(num_bands, 0);
+	std::vector<uint32_t> min_gray_levels(num_bands, 255);
+	ParallelFor::run(
+		0, num_bands, 1,
+		WolfStatsBands(gray, window_size, band_height, max_deviations, min_gray_levels)
+	);
+
+	double const max_deviation = *std::max_element(
+		max_deviations.begin(), max_deviations.end()
+	);
+	uint32_t const min_gray_level = *std::min_element(
+		min_gray_levels.begin(), min_gray_levels.end()
+	);
 	
-	gray_line = gray.bits();
-	for (int y = 0; y < h; ++y, gray_line += gray_bpl, bw_line += bw_wpl) {
-		for (int x = 0; x < w; ++x) {
-			float const mean = means[y * w + x];
-			float const deviation = deviations[y * w + x];
-			double const k = 0.3;
-			double const a = 1.0 - deviation / max_deviation;
-			double const threshold = mean - k * a * (mean - min_gray_level);
-			
-			uint32_t const msb = uint32_t(1) << 31;
-			uint32_t const mask = msb >> (x & 31);
-			if (gray_line[x] < lower_bound ||
-					(gray_line[x] <= upper_bound &&
-					int(gray_line[x]) < threshold)) {
-				// black
-				bw_line[x >> 5] |= mask;
-			} else {
-				// white
-				bw_line[x >> 5] &= ~mask;
-			}
-		}
-	}
+	BinaryImage bw_img(gray.width(), gray.height());
+	ParallelFor::run(
+		0, num_bands, 1,
+		WolfBands(
+			gray, window_size, bw_img, band_height,
+			max_deviation, min_gray_level, lower_bound, upper_bound
+		)
+	);
 	
 	return bw_img;
 }
@@ -19,6 +19,8 @@
 #include "BinaryImage.h"
 #include "ByteOrder.h"
 #include "BitOps.h"
+#include "FileBackedMemory.h"
+#include "PackedThreshold.h"
 #include <QAtomicInt>
 #include <QImage>
 #include <QRect>
@@ -51,13 +53,15 @@ private:
 		NumWords(size_t num_words) : numWords(num_words) {}
 	};
 public:
-	static SharedData* create(size_t num_words) {
-		return new(NumWords(num_words)) SharedData();
-	}
+	/**
+	 * Depending on size and FileBackedMemory settings, the pixels
+	 * either follow the header or live in a mapped scratch file.
+	 */
+	static SharedData* create(size_t num_words);
 	
-	uint32_t* data() { return m_data; }
+	uint32_t* data() { return m_pWords; }
 	
-	uint32_t const* data() const { return m_data; }
+	uint32_t const* data() const { return m_pWords; }
 	
 	bool isShared() const {
 		return m_refCounter.fetchAndAddRelaxed(0) > 1;
@@ -71,12 +75,15 @@ public:
 	
 	static void operator delete(void* addr, NumWords num_words);
 private:
-	SharedData() : m_refCounter(1) {}
+	SharedData(uint32_t* words, size_t mapped_bytes)
+	: m_refCounter(1), m_pWords(words), m_mappedBytes(mapped_bytes) {}
 	
 	SharedData& operator=(SharedData const&); // forbidden
 	
 	mutable QAtomicInt m_refCounter;
-	uint32_t m_data[1]; // more data follows
+	uint32_t* m_pWords;
+	size_t m_mappedBytes; // Non-zero if m_pWords came from FileBackedMemory.
+	uint32_t m_data[1]; // more data follows, unless file-backed
 };
 
 BinaryImage::BinaryImage()
@@ -841,18 +848,29 @@ BinaryImage::fromIndexed8(
 	for (; color_idx < 256; ++color_idx) {
 		color_to_gray[color_idx] = 0; // just in case
 	}
+
+	// With a full grayscale palette, like the one GrayImage has,
+	// we can threshold color indices directly.
+	bool gray_palette = (num_colors == 256);
+	for (int i = 0; gray_palette && i < 256; ++i) {
+		gray_palette = (color_to_gray[i] == i);
+	}
 	
 	for (int i = height; i > 0; --i) {
-		for (int j = 0; j < last_word_idx; ++j) {
-			uint8_t const* const src_pos = &src_line[j << 5];
-			uint32_t word = 0;
-			for (int bit = 0; bit < 32; ++bit) {
-				word <<= 1;
-				if (color_to_gray[src_pos[bit]] < threshold) {
-					word |= uint32_t(1);
+		if (gray_palette) {
+			PackedThreshold::gray8(src_line, dst_line, last_word_idx, threshold);
+		} else {
+			for (int j = 0; j < last_word_idx; ++j) {
+				uint8_t const* const src_pos = &src_line[j << 5];
+				uint32_t word = 0;
+				for (int bit = 0; bit < 32; ++bit) {
+					word <<= 1;
+					if (color_to_gray[src_pos[bit]] < threshold) {
+						word |= uint32_t(1);
+					}
 				}
+				dst_line[j] = word;
 			}
-			dst_line[j] = word;
 		}
 		
 		// Handle the last word.
@@ -902,15 +920,7 @@ BinaryImage::fromRgb32(
 	int const last_word_unused_bits = 32 - last_word_bits;
 	
 	for (int i = height; i > 0; --i) {
-		for (int j = 0; j < last_word_idx; ++j) {
-			QRgb const* const src_pos = &src_line[j << 5];
-			uint32_t word = 0;
-			for (int bit = 0; bit < 32; ++bit) {
-				word <<= 1;
-				word |= thresholdRgb32(src_pos[bit], threshold);
-			}
-			dst_line[j] = word;
-		}
+		PackedThreshold::rgb32(src_line, dst_line, last_word_idx, threshold);
 		
 		// Handle the last word.
 		QRgb const* const src_pos = &src_line[last_word_idx << 5];
@@ -965,15 +975,9 @@ BinaryImage::fromArgb32Premultiplied(
 	int const last_word_unused_bits = 32 - last_word_bits;
 	
 	for (int i = height; i > 0; --i) {
-		for (int j = 0; j < last_word_idx; ++j) {
-			QRgb const* const src_pos = &src_line[j << 5];
-			uint32_t word = 0;
-			for (int bit = 0; bit < 32; ++bit) {
-				word <<= 1;
-				word |= thresholdArgbPM(src_pos[bit], threshold);
-			}
-			dst_line[j] = word;
-		}
+		PackedThreshold::argb32Premultiplied(
+			src_line, dst_line, last_word_idx, threshold
+		);
 		
 		// Handle the last word.
 		QRgb const* const src_pos = &src_line[last_word_idx << 5];
@@ -1175,10 +1179,31 @@ bool operator==(BinaryImage const& lhs, BinaryImage const& rhs)
 
 /*====================== BinaryIamge::SharedData ========================*/
 
+BinaryImage::SharedData*
+BinaryImage::SharedData::create(size_t const num_words)
+{
+	size_t const mapped_bytes = num_words * 4;
+	if (void* const mapped = FileBackedMemory::allocate(mapped_bytes)) {
+		try {
+			return new(NumWords(0)) SharedData((uint32_t*)mapped, mapped_bytes);
+		} catch (...) {
+			FileBackedMemory::release(mapped, mapped_bytes);
+			throw;
+		}
+	}
+	
+	SharedData* sd = new(NumWords(num_words)) SharedData(0, 0);
+	sd->m_pWords = sd->m_data;
+	return sd;
+}
+
 void
 BinaryImage::SharedData::unref() const
 {
 	if (!m_refCounter.deref()) {
+		if (m_mappedBytes) {
+			FileBackedMemory::release(m_pWords, m_mappedBytes);
+		}
 		this->~SharedData();
 		free((void*)this);
 	}
@@ -67,6 +67,22 @@ public:
 		m_accum += AccumType(gray_level) * weight;
 	}
 
+	/**
+	 * \brief Adds a run of pixels having the same weight.
+	 *
+	 * For integer AccumType, this is exactly equivalent to calling add()
+	 * for each of them, just faster, as the pixels are summed up first
+	 * in a loop the compiler is able to vectorize.  For floating point
+	 * AccumType, rounding errors may be slightly different.
+	 */
+	void addRun(uint8_t const* gray_levels, int count, AccumType weight) {
+		AccumType sum = AccumType();
+		for (int i = 0; i < count; ++i) {
+			sum += AccumType(gray_levels[i]);
+		}
+		m_accum += sum * weight;
+	}
+
 	result_type mix(AccumType total_weight) const {
 		using namespace color_mixer_impl;
 		typedef std::numeric_limits<AccumType> traits;
@@ -104,6 +120,24 @@ public:
 		m_greenAccum += AccumType((rgb >> 8) & 0xFF) * weight;
 		m_blueAccum += AccumType(rgb & 0xFF) * weight;
 	}
+
+	/**
+	 * \see GrayColorMixer::addRun()
+	 */
+	void addRun(uint32_t const* rgb, int count, AccumType weight) {
+		AccumType red = AccumType();
+		AccumType green = AccumType();
+		AccumType blue = AccumType();
+		for (int i = 0; i < count; ++i) {
+			uint32_t const pixel = rgb[i];
+			red += AccumType((pixel >> 16) & 0xFF);
+			green += AccumType((pixel >> 8) & 0xFF);
+			blue += AccumType(pixel & 0xFF);
+		}
+		m_redAccum += red * weight;
+		m_greenAccum += green * weight;
+		m_blueAccum += blue * weight;
+	}
 	
 	result_type mix(AccumType total_weight) const {
 		using namespace color_mixer_impl;
@@ -151,6 +185,27 @@ public:
 		m_greenAccum += AccumType((argb >> 8) & 0xFF) * weight;
 		m_blueAccum += AccumType(argb & 0xFF) * weight;
 	}
+
+	/**
+	 * \see GrayColorMixer::addRun()
+	 */
+	void addRun(uint32_t const* argb, int count, AccumType weight) {
+		AccumType alpha = AccumType();
+		AccumType red = AccumType();
+		AccumType green = AccumType();
+		AccumType blue = AccumType();
+		for (int i = 0; i < count; ++i) {
+			uint32_t const pixel = argb[i];
+			alpha += AccumType((pixel >> 24) & 0xFF);
+			red += AccumType((pixel >> 16) & 0xFF);
+			green += AccumType((pixel >> 8) & 0xFF);
+			blue += AccumType(pixel & 0xFF);
+		}
+		m_alphaAccum += alpha * weight;
+		m_redAccum += red * weight;
+		m_greenAccum += green * weight;
+		m_blueAccum += blue * weight;
+	}
 	
 	result_type mix(AccumType total_weight) const {
 		using namespace color_mixer_impl;
@@ -19,6 +19,7 @@
 #include "ConnectivityMap.h"
 #include "BinaryImage.h"
 #include "InfluenceMap.h"
+#include "RunLengthLabeler.h"
 #include "BitOps.h"
 #ifndef Q_MOC_RUN
 #include <boost/foreach.hpp>
@@ -76,28 +77,13 @@ ConnectivityMap::ConnectivityMap(
 	int const width = m_size.width();
 	int const height = m_size.height();
 	
-	m_data.resize((width + 2) * (height + 2), BACKGROUND);
+	m_data.resize((width + 2) * (height + 2), 0);
 	m_stride = width + 2;
 	m_pData = &m_data[0] + 1 + m_stride;
 	
-	uint32_t* dst = m_pData;
-	int const dst_stride = m_stride;
-	
-	uint32_t const* src = image.data();
-	int const src_stride = image.wordsPerLine();
-	
-	uint32_t const msb = uint32_t(1) << 31;
-	for (int y = 0; y < height; ++y) {
-		for (int x = 0; x < width; ++x) {
-			if (src[x >> 5] & (msb >> (x & 31))) {
-				dst[x] = UNTAGGED_FG;
-			}
-		}
-		src += src_stride;
-		dst += dst_stride;
-	}
-	
-	assignIds(conn);
+	RunLengthLabeler const labeler(image, conn);
+	labeler.writeLabels(m_pData, m_stride);
+	m_maxLabel = labeler.numComponents();
 }
 
 ConnectivityMap::ConnectivityMap(ConnectivityMap const& other)
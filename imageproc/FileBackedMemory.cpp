@@ -0,0 +1,136 @@
+/*
+	Scan Tailor - Interactive post-processing tool for scanned pages.
+	Copyright (C)  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "FileBackedMemory.h"
+#include <QtGlobal>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QDir>
+#include <QFile>
+#include <QByteArray>
+#include <vector>
+
+#if defined(Q_OS_UNIX)
+#include <sys/types.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <unistd.h>
+#endif
+
+namespace imageproc
+{
+
+namespace
+{
+
+QMutex g_mutex;
+QString g_scratchDir;
+size_t g_minBytes = 0;
+bool g_enabled = false;
+
+} // anonymous namespace
+
+void
+FileBackedMemory::enable(QString const& scratch_dir, size_t const min_bytes)
+{
+	QMutexLocker const locker(&g_mutex);
+	g_scratchDir = scratch_dir;
+	g_minBytes = min_bytes;
+	g_enabled = !scratch_dir.isEmpty();
+}
+
+void
+FileBackedMemory::disable()
+{
+	QMutexLocker const locker(&g_mutex);
+	g_enabled = false;
+}
+
+bool
+FileBackedMemory::isEnabled()
+{
+	QMutexLocker const locker(&g_mutex);
+	return g_enabled;
+}
+
+void*
+FileBackedMemory::allocate(size_t const bytes)
+{
+#if defined(Q_OS_UNIX)
+	QString scratch_dir;
+	{
+		QMutexLocker const locker(&g_mutex);
+		if (!g_enabled || bytes < g_minBytes || bytes == 0) {
+			return 0;
+		}
+		scratch_dir = g_scratchDir;
+	}
+
+	QByteArray const templ(
+		QFile::encodeName(
+			QDir(scratch_dir).absoluteFilePath("scantailor-XXXXXX")
+		)
+	);
+	std::vector<char> path(templ.constData(), templ.constData() + templ.size() + 1);
+
+	int const fd = mkstemp(&path[0]);
+	if (fd == -1) {
+		return 0;
+	}
+
+	// The file stays around until it's unmapped.
+	unlink(&path[0]);
+
+	// Reserving disk space upfront turns a full disk into an allocation
+	// failure here, rather than SIGBUS on first access to a page.
+#if defined(Q_OS_LINUX)
+	bool const sized = posix_fallocate(fd, 0, (off_t)bytes) == 0;
+#else
+	bool const sized = ftruncate(fd, (off_t)bytes) == 0;
+#endif
+
+	void* addr = 0;
+	if (sized) {
+		// A shared mapping lets the kernel write dirty pages back
+		// to the file, rather than to swap, which may not even exist.
+		addr = mmap(0, bytes, PROT_READ|PROT_WRITE, MAP_SHARED, fd, 0);
+		if (addr == MAP_FAILED) {
+			addr = 0;
+		}
+	}
+	close(fd);
+
+	return addr;
+#else
+	return 0;
+#endif
+}
+
+void
+FileBackedMemory::release(void* addr, size_t const bytes)
+{
+#if defined(Q_OS_UNIX)
+	if (addr) {
+		munmap(addr, bytes);
+	}
+#endif
+}
+
+} // namespace imageproc
@@ -0,0 +1,88 @@
+/*
+	Scan Tailor - Interactive post-processing tool for scanned pages.
+	Copyright (C)  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef IMAGEPROC_FILE_BACKED_MEMORY_H_
+#define IMAGEPROC_FILE_BACKED_MEMORY_H_
+
+#include <QString>
+#include <stddef.h>
+
+namespace imageproc
+{
+
+/**
+ * \brief Allocates large raster buffers in memory-mapped scratch files.
+ *
+ * Pages of such buffers are backed by a file rather than by swap, so under
+ * memory pressure the kernel can write them out and drop them.  That makes
+ * the resident set follow the pixels actually being worked on rather than
+ * the total size of images alive.  Scratch files are unlinked right after
+ * being created, so nothing is left behind even if the process crashes.
+ *
+ * This mode is disabled by default and is only available on POSIX systems.
+ * Elsewhere allocate() always returns null, making callers use the heap.
+ *
+ * Only BinaryImage allocates from here.  GrayImage and colour images are
+ * QImages, which stay on the heap, as Qt 4 can't tell us when the last
+ * copy of an external buffer goes away.  Buffers are contiguous rather
+ * than tiled, and copy-on-write copies a whole raster, not a tile.
+ */
+class FileBackedMemory
+{
+public:
+	/**
+	 * Only big rasters, like a 1200 dpi black and white page (about 18 MB),
+	 * are worth the system calls.
+	 */
+	static size_t const DEFAULT_MIN_BYTES = 8 << 20;
+
+	/**
+	 * \brief Makes allocate() map buffers of at least \p min_bytes.
+	 *
+	 * \param scratch_dir The directory to create scratch files in.
+	 *        It should be on a real disk rather than on tmpfs.
+	 * \param min_bytes Smaller buffers come from the heap.
+	 */
+	static void enable(QString const& scratch_dir, size_t min_bytes = DEFAULT_MIN_BYTES);
+
+	static void disable();
+
+	static bool isEnabled();
+
+	/**
+	 * \brief Allocates a zero-initialized, page aligned buffer.
+	 *
+	 * \return The address of the buffer, or null if file backing is disabled,
+	 *         \p bytes is below the threshold, or mapping failed.
+	 *         In all those cases the caller is expected to fall back
+	 *         to heap allocation.
+	 */
+	static void* allocate(size_t bytes);
+
+	/**
+	 * \brief Releases a buffer returned by allocate().
+	 *
+	 * \p bytes has to be the same as passed to allocate().
+	 */
+	static void release(void* addr, size_t bytes);
+};
+
+} // namespace imageproc
+
+#endif
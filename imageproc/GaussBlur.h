@@ -23,6 +23,7 @@
 #define IMAGEPROC_GAUSSBLUR_H_
 
 #include "ValueConv.h"
+#include "ParallelFor.h"
 #include <QSize>
 #ifndef Q_MOC_RUN
 #include <boost/scoped_array.hpp>
@@ -86,6 +87,11 @@ GrayImage gaussBlur(GrayImage const& src, float h_sigma, float v_sigma);
  * // Convert to uint8_t, with rounding and clipping.
  * gaussBlurGeneric(..., _1 = bind<uint8_t>(RoundAndClipValueConv<uint8_t>(), _2);
  * \endcode
+ *
+ * The vertical and the horizontal passes are split into bands processed
+ * by multiple threads, so \p float_reader and \p float_writer may be called
+ * concurrently, though never for the same grid cell.  The result doesn't
+ * depend on the number of threads.
  */
 template<typename SrcIt, typename DstIt, typename FloatReader, typename FloatWriter>
 void gaussBlurGeneric(QSize size, float h_sigma, float v_sigma,
@@ -99,6 +105,35 @@ void find_iir_constants(
 	float* n_p, float *n_m, float *d_p,
 	float* d_m, float *bd_p, float *bd_m, float std_dev);
 
+/**
+ * \brief The number of columns or rows filtered at once.
+ *
+ * The inner loops over this many lanes have a fixed trip count and
+ * no dependencies between lanes, which lets the compiler turn them
+ * into SIMD instructions.  In the vertical pass, it also makes each
+ * input row access cover LANES adjacent items rather than a single one.
+ */
+static int const LANES = 8;
+
+/**
+ * \brief The minimum number of data cells a single thread should process.
+ */
+static int const MIN_CELLS_PER_THREAD = 1 << 16;
+
+struct IirCoefficients
+{
+	float n_p[5];
+	float n_m[5];
+	float d_p[5];
+	float d_m[5];
+	float bd_p[5];
+	float bd_m[5];
+
+	explicit IirCoefficients(float std_dev) {
+		find_iir_constants(n_p, n_m, d_p, d_m, bd_p, bd_m, std_dev);
+	}
+};
+
 template<typename Src1It, typename Src2It, typename DstIt, typename FloatWriter>
 void save(int num_items, Src1It src1, Src2It src2,
 		  DstIt dst, int dst_stride, FloatWriter writer)
@@ -111,10 +146,239 @@ void save(int num_items, Src1It src1, Src2It src2,
 	}
 }
 
-class FloatToFloatWriter
+/**
+ * \brief Runs the forward and backward recursions on LANES interleaved
+ *        sequences at once.
+ *
+ * Item \p n of sequence \p l is src[n * LANES + l].  The results go to
+ * \p val_p and \p val_m with the same layout.  For each lane, the arithmetic
+ * is exactly what filtering that sequence alone would do, so the results
+ * don't depend on how sequences are grouped into lanes.
+ */
+inline void filterLanes(IirCoefficients const& c, int length,
+	float const* src, float* val_p, float* val_m)
+{
+	int const last = (length - 1) * LANES;
+
+	memset(val_p, 0, length * LANES * sizeof(*val_p));
+	memset(val_m, 0, length * LANES * sizeof(*val_m));
+
+	float initial_p[LANES];
+	float initial_m[LANES];
+	for (int l = 0; l < LANES; ++l) {
+		initial_p[l] = src[l];
+		initial_m[l] = src[last + l];
+	}
+
+	float const* sp_p = src;
+	float const* sp_m = src + last;
+	float* vp = val_p;
+	float* vm = val_m + last;
+
+	// The first 4 items, where the missing history is substituted
+	// with the boundary value.
+	int const head = length < 4 ? length : 4;
+	for (int n = 0; n < head; ++n) {
+		int i = 0;
+		int off = 0;
+		for (; i <= n; ++i, off += LANES) {
+			for (int l = 0; l < LANES; ++l) {
+				vp[l] += c.n_p[i] * sp_p[l - off] - c.d_p[i] * vp[l - off];
+				vm[l] += c.n_m[i] * sp_m[l + off] - c.d_m[i] * vm[l + off];
+			}
+		}
+		for (; i <= 4; ++i) {
+			for (int l = 0; l < LANES; ++l) {
+				vp[l] += (c.n_p[i] - c.bd_p[i]) * initial_p[l];
+				vm[l] += (c.n_m[i] - c.bd_m[i]) * initial_m[l];
+			}
+		}
+		sp_p += LANES;
+		sp_m -= LANES;
+		vp += LANES;
+		vm -= LANES;
+	}
+
+	// The steady state.  It's the same sequence of operations
+	// as above, just with the term loop unrolled.
+	for (int n = head; n < length; ++n) {
+		for (int l = 0; l < LANES; ++l) {
+			float p = vp[l];
+			p += c.n_p[0] * sp_p[l] - c.d_p[0] * p;
+			p += c.n_p[1] * sp_p[l - LANES] - c.d_p[1] * vp[l - LANES];
+			p += c.n_p[2] * sp_p[l - 2 * LANES] - c.d_p[2] * vp[l - 2 * LANES];
+			p += c.n_p[3] * sp_p[l - 3 * LANES] - c.d_p[3] * vp[l - 3 * LANES];
+			p += c.n_p[4] * sp_p[l - 4 * LANES] - c.d_p[4] * vp[l - 4 * LANES];
+			vp[l] = p;
+
+			float m = vm[l];
+			m += c.n_m[0] * sp_m[l] - c.d_m[0] * m;
+			m += c.n_m[1] * sp_m[l + LANES] - c.d_m[1] * vm[l + LANES];
+			m += c.n_m[2] * sp_m[l + 2 * LANES] - c.d_m[2] * vm[l + 2 * LANES];
+			m += c.n_m[3] * sp_m[l + 3 * LANES] - c.d_m[3] * vm[l + 3 * LANES];
+			m += c.n_m[4] * sp_m[l + 4 * LANES] - c.d_m[4] * vm[l + 4 * LANES];
+			vm[l] = m;
+		}
+		sp_p += LANES;
+		sp_m -= LANES;
+		vp += LANES;
+		vm -= LANES;
+	}
+}
+
+/**
+ * Filters blocks of LANES columns from the input into the intermediate image.
+ */
+template<typename SrcIt, typename FloatReader>
+class VerticalPass
+{
+public:
+	VerticalPass(IirCoefficients const& coeffs, int width, int height,
+		SrcIt input, int input_stride, FloatReader const& float_reader,
+		float* intermediate, int intermediate_stride)
+	: m_rCoeffs(coeffs), m_width(width), m_height(height),
+	m_input(input), m_inputStride(input_stride), m_floatReader(float_reader),
+	m_pIntermediate(intermediate), m_intermediateStride(intermediate_stride) {}
+
+	void operator()(int begin_block, int end_block) const {
+		int const buf_size = m_height * LANES;
+		boost::scoped_array<float> src(new float[buf_size]);
+		boost::scoped_array<float> val_p(new float[buf_size]);
+		boost::scoped_array<float> val_m(new float[buf_size]);
+
+		for (int block = begin_block; block < end_block; ++block) {
+			int const x0 = block * LANES;
+			int const num_lanes = m_width - x0 < LANES ? m_width - x0 : LANES;
+			loadBlock(x0, num_lanes, &src[0]);
+			filterLanes(m_rCoeffs, m_height, &src[0], &val_p[0], &val_m[0]);
+
+			float const* vp = &val_p[0];
+			float const* vm = &val_m[0];
+			float* dst_line = m_pIntermediate + x0;
+			for (int y = 0; y < m_height; ++y) {
+				for (int l = 0; l < num_lanes; ++l) {
+					dst_line[l] = vp[l] + vm[l];
+				}
+				vp += LANES;
+				vm += LANES;
+				dst_line += m_intermediateStride;
+			}
+		}
+	}
+private:
+	/**
+	 * Converts a block of columns to floats, interleaving them in a way
+	 * that puts items from the same row next to each other.  Unused lanes
+	 * of a partial block are zero-filled.
+	 */
+	void loadBlock(int x0, int num_lanes, float* src) const {
+		SrcIt line(m_input + x0);
+		for (int y = 0; y < m_height; ++y) {
+			int l = 0;
+			for (; l < num_lanes; ++l) {
+				src[l] = m_floatReader(line[l]);
+			}
+			for (; l < LANES; ++l) {
+				src[l] = 0.0f;
+			}
+			src += LANES;
+			line += m_inputStride;
+		}
+	}
+
+	IirCoefficients const& m_rCoeffs;
+	int m_width;
+	int m_height;
+	SrcIt m_input;
+	int m_inputStride;
+	FloatReader m_floatReader;
+	float* m_pIntermediate;
+	int m_intermediateStride;
+};
+
+/**
+ * Filters blocks of LANES rows of the intermediate image
+ * and writes them to the output.
+ */
+template<typename DstIt, typename FloatWriter>
+class HorizontalPass
 {
 public:
-	void operator()(float& dst, float src) const { dst = src; }
+	HorizontalPass(IirCoefficients const& coeffs, int width, int height,
+		float const* intermediate, int intermediate_stride,
+		DstIt output, int output_stride, FloatWriter const& float_writer)
+	: m_rCoeffs(coeffs), m_width(width), m_height(height),
+	m_pIntermediate(intermediate), m_intermediateStride(intermediate_stride),
+	m_output(output), m_outputStride(output_stride), m_floatWriter(float_writer) {}
+
+	void operator()(int begin_block, int end_block) const {
+		int const buf_size = m_width * LANES;
+		boost::scoped_array<float> src(new float[buf_size]);
+		boost::scoped_array<float> val_p(new float[buf_size]);
+		boost::scoped_array<float> val_m(new float[buf_size]);
+
+		for (int block = begin_block; block < end_block; ++block) {
+			int const y0 = block * LANES;
+			int const num_lanes = m_height - y0 < LANES ? m_height - y0 : LANES;
+			loadBlock(y0, num_lanes, &src[0]);
+			filterLanes(m_rCoeffs, m_width, &src[0], &val_p[0], &val_m[0]);
+
+			DstIt output_line(m_output + y0 * m_outputStride);
+			for (int l = 0; l < num_lanes; ++l) {
+				save(
+					m_width, StridedIt(&val_p[l]), StridedIt(&val_m[l]),
+					output_line, 1, m_floatWriter
+				);
+				output_line += m_outputStride;
+			}
+		}
+	}
+private:
+	/**
+	 * A pointer wrapper that advances by LANES items at a time.
+	 */
+	class StridedIt
+	{
+	public:
+		explicit StridedIt(float const* p) : m_p(p) {}
+
+		float operator*() const { return *m_p; }
+
+		StridedIt& operator++() { m_p += LANES; return *this; }
+	private:
+		float const* m_p;
+	};
+
+	/**
+	 * Transposes a block of rows of the intermediate image into LANES
+	 * interleaved sequences.  Unused lanes of a partial block are zero-filled.
+	 */
+	void loadBlock(int y0, int num_lanes, float* src) const {
+		float const* line = m_pIntermediate + y0 * m_intermediateStride;
+		int l = 0;
+		for (; l < num_lanes; ++l, line += m_intermediateStride) {
+			float* dst = src + l;
+			for (int x = 0; x < m_width; ++x, dst += LANES) {
+				*dst = line[x];
+			}
+		}
+		for (; l < LANES; ++l) {
+			float* dst = src + l;
+			for (int x = 0; x < m_width; ++x, dst += LANES) {
+				*dst = 0.0f;
+			}
+		}
+	}
+
+private:
+	IirCoefficients const& m_rCoeffs;
+	int m_width;
+	int m_height;
+	float const* m_pIntermediate;
+	int m_intermediateStride;
+	DstIt m_output;
+	int m_outputStride;
+	FloatWriter m_floatWriter;
 };
 
 } // namespace gauss_blur_impl
@@ -124,96 +388,37 @@ void gaussBlurGeneric(QSize const size, float const h_sigma, float const v_sigma
 					  SrcIt const input, int const input_stride, FloatReader const float_reader,
 					  DstIt const output, int const output_stride, FloatWriter const float_writer)
 {
+	using namespace gauss_blur_impl;
+
 	if (size.isEmpty()) {
 		return;
 	}
 
 	int const width = size.width();
 	int const height = size.height();
-	int const width_height_max = width > height ? width : height;
 
-	boost::scoped_array<float> val_p(new float[width_height_max]);
-	boost::scoped_array<float> val_m(new float[width_height_max]);
 	boost::scoped_array<float> intermediate_image(new float[width * height]);
 	int const intermediate_stride = width;
 
-	// IIR parameters.
-	float n_p[5], n_m[5], d_p[5], d_m[5], bd_p[5], bd_m[5];
-	
-	// Vertical pass.
-	gauss_blur_impl::find_iir_constants(n_p, n_m, d_p, d_m, bd_p, bd_m, v_sigma);
-	for (int x = 0; x < width; ++x) {
-		memset(&val_p[0], 0, height * sizeof(val_p[0]));
-		memset(&val_m[0], 0, height * sizeof(val_m[0]));
-		
-		SrcIt sp_p(input + x);
-		SrcIt sp_m(sp_p + (height - 1) * input_stride);
-		float* vp = &val_p[0];
-		float* vm = &val_m[0] + height - 1;
-		float const initial_p = float_reader(sp_p[0]);
-		float const initial_m = float_reader(sp_m[0]);
-		
-		for (int y = 0; y < height; ++y) {
-			int const terms = y < 4 ? y : 4;
-			int i = 0;
-			int sp_off = 0;
-			for (; i <= terms; ++i, sp_off += input_stride) {
-				*vp += n_p[i] * float_reader(sp_p[-sp_off]) - d_p[i] * vp[-i];
-				*vm += n_m[i] * float_reader(sp_m[sp_off]) - d_m[i] * vm[i];
-			}
-			for (; i <= 4; ++i) {
-				*vp += (n_p[i] - bd_p[i]) * initial_p;
-				*vm += (n_m[i] - bd_m[i]) * initial_m;
-			}
-			sp_p += input_stride;
-			sp_m -= input_stride;
-			++vp;
-			--vm;
-		}
-		
-		gauss_blur_impl::save(
-			height, &val_p[0], &val_m[0], &intermediate_image[0] + x,
-			intermediate_stride, gauss_blur_impl::FloatToFloatWriter()
-		);
-	}
-	
-	// Horizontal pass.
-	gauss_blur_impl::find_iir_constants(n_p, n_m, d_p, d_m, bd_p, bd_m, h_sigma);
-	float const* intermediate_line = &intermediate_image[0];
-	DstIt output_line(output);
-	for (int y = 0; y < height; ++y) {
-		memset(&val_p[0], 0, width * sizeof(val_p[0]));
-		memset(&val_m[0], 0, width * sizeof(val_m[0]));
-		
-		float const* sp_p = intermediate_line;
-		float const* sp_m = intermediate_line + width - 1;
-		float* vp = &val_p[0];
-		float* vm = &val_m[0] + width - 1;
-		float const initial_p = sp_p[0];
-		float const initial_m = sp_m[0];
-		
-		for (int x = 0; x < width; ++x) {
-			int const terms = x < 4 ? x : 4;
-			int i = 0;
-			for (; i <= terms; ++i) {
-				*vp += n_p[i] * sp_p[-i] - d_p[i] * vp[-i];
-				*vm += n_m[i] * sp_m[i] - d_m[i] * vm[i];
-			}
-			for (; i <= 4; ++i) {
-				*vp += (n_p[i] - bd_p[i]) * initial_p;
-				*vm += (n_m[i] - bd_m[i]) * initial_m;
-			}
-			++sp_p;
-			--sp_m;
-			++vp;
-			--vm;
-		}
-		
-		gauss_blur_impl::save(width, &val_p[0], &val_m[0], output_line, 1, float_writer);
+	// Vertical pass, split into bands of columns.
+	IirCoefficients const v_coeffs(v_sigma);
+	ParallelFor::run(
+		0, (width + LANES - 1) / LANES, MIN_CELLS_PER_THREAD / (LANES * height) + 1,
+		VerticalPass<SrcIt, FloatReader>(
+			v_coeffs, width, height, input, input_stride, float_reader,
+			&intermediate_image[0], intermediate_stride
+		)
+	);
 
-		intermediate_line += intermediate_stride;
-		output_line += output_stride;
-	}
+	// Horizontal pass, split into bands of rows.
+	IirCoefficients const h_coeffs(h_sigma);
+	ParallelFor::run(
+		0, (height + LANES - 1) / LANES, MIN_CELLS_PER_THREAD / (LANES * width) + 1,
+		HorizontalPass<DstIt, FloatWriter>(
+			h_coeffs, width, height, &intermediate_image[0], intermediate_stride,
+			output, output_stride, float_writer
+		)
+	);
 }
 
 } // namespace imageproc
@@ -21,6 +21,8 @@
 #include "GrayImage.h"
 #include "RasterOp.h"
 #include "Grayscale.h"
+#include "PackedMorphology.h"
+#include "ParallelFor.h"
 #include <QPoint>
 #include <QSize>
 #include <QRect>
@@ -192,6 +194,168 @@ inline QRect shrinkByBrick(QRect const& rect, Brick const& brick)
 	return rect.adjusted(brick.maxX(), brick.maxY(), brick.minX(), brick.minY());
 }
 
+/**
+ * \brief Combines a shifted copy of an image with another image.
+ *
+ * Does the same as TemplateRasterOp<Rop>, where Rop is either
+ * RopOr<RopSrc, RopDst> or RopAnd<RopSrc, RopDst>, except that
+ * full words in the middle of each line are processed by the matching
+ * PackedMorphology function.
+ */
+template<typename Rop>
+class PackedRasterOp : public AbstractRasterOp
+{
+public:
+	typedef void (*WordsFunc)(
+		uint32_t* dst, uint32_t const* src, int num_words, int shift);
+
+	explicit PackedRasterOp(WordsFunc words_func) : m_wordsFunc(words_func) {}
+
+	virtual void operator()(
+		BinaryImage& dst, QRect const& dr,
+		BinaryImage const& src, QPoint const& sp) const;
+private:
+	static uint32_t fetchWord(
+		uint32_t const* src_line, int idx, int shift, uint32_t mask);
+
+	WordsFunc m_wordsFunc;
+};
+
+/**
+ * Assembles a word from src_line[idx] and src_line[idx + 1], reading
+ * only those of them that contribute to the bits set in \p mask.
+ */
+template<typename Rop>
+uint32_t
+PackedRasterOp<Rop>::fetchWord(
+	uint32_t const* const src_line, int const idx,
+	int const shift, uint32_t const mask)
+{
+	uint32_t word = 0;
+	if ((~uint32_t(0) << shift) & mask) {
+		word |= src_line[idx] << shift;
+	}
+	if (shift != 0 && ((~uint32_t(0) >> (32 - shift)) & mask)) {
+		word |= src_line[idx + 1] >> (32 - shift);
+	}
+	return word;
+}
+
+template<typename Rop>
+void
+PackedRasterOp<Rop>::operator()(
+	BinaryImage& dst, QRect const& dr,
+	BinaryImage const& src, QPoint const& sp) const
+{
+	if (dr.isEmpty()) {
+		return;
+	}
+	
+	if (dst.isNull() || src.isNull()) {
+		throw std::invalid_argument("PackedRasterOp: can't operate on null images");
+	}
+	
+	if (!dst.rect().contains(dr)) {
+		throw std::invalid_argument("PackedRasterOp: raster area exceedes the dst image");
+	}
+	
+	if (!src.rect().contains(QRect(sp, dr.size()))) {
+		throw std::invalid_argument("PackedRasterOp: raster area exceedes the src image");
+	}
+	
+	int const first_word = dr.left() >> 5;
+	int const num_words = (dr.right() >> 5) - first_word + 1;
+	uint32_t const first_mask = ~uint32_t(0) >> (dr.left() & 31);
+	uint32_t const last_mask = ~uint32_t(0) << (31 - (dr.right() & 31));
+	
+	// The source pixel corresponding to the first pixel of the first
+	// dst word.  It may be up to 31 pixels to the left of sp.x().
+	int const src_first_bit = sp.x() - (dr.left() & 31);
+	int const src_first_word = src_first_bit < 0 ? -1 : src_first_bit >> 5;
+	int const shift = src_first_bit - src_first_word * 32;
+	
+	int const dst_wpl = dst.wordsPerLine();
+	int const src_wpl = src.wordsPerLine();
+	int dst_delta = dst_wpl;
+	int src_delta = src_wpl;
+	
+	// dst.data() has to be called first, as it may detach dst from src.
+	uint32_t* dst_line = dst.data() + dr.top() * dst_wpl + first_word;
+	uint32_t const* src_line = src.data() + sp.y() * src_wpl;
+	
+	// We need to avoid reading source pixels we've already overwritten.
+	// When shifting down, that's achieved by going from bottom to top.
+	// When shifting within the same lines, source lines are copied.
+	std::vector<uint32_t> line_copy;
+	if (&dst == &src) {
+		if (dr.top() > sp.y()) {
+			dst_line += (dr.height() - 1) * dst_wpl;
+			src_line += (dr.height() - 1) * src_wpl;
+			dst_delta = -dst_wpl;
+			src_delta = -src_wpl;
+		} else if (dr.top() == sp.y()) {
+			line_copy.resize(src_wpl);
+		}
+	}
+	
+	for (int i = dr.height(); i > 0; --i,
+			dst_line += dst_delta, src_line += src_delta) {
+		uint32_t const* src_words = src_line;
+		if (!line_copy.empty()) {
+			memcpy(&line_copy[0], src_line, src_wpl * sizeof(uint32_t));
+			src_words = &line_copy[0];
+		}
+		
+		if (num_words == 1) {
+			uint32_t const mask = first_mask & last_mask;
+			uint32_t const dst_word = dst_line[0];
+			uint32_t const src_word = fetchWord(src_words, src_first_word, shift, mask);
+			uint32_t const new_dst_word = Rop::transform(src_word, dst_word);
+			dst_line[0] = (dst_word & ~mask) | (new_dst_word & mask);
+			continue;
+		}
+		
+		// The first (possibly incomplete) word.
+		uint32_t dst_word = dst_line[0];
+		uint32_t src_word = fetchWord(src_words, src_first_word, shift, first_mask);
+		uint32_t new_dst_word = Rop::transform(src_word, dst_word);
+		dst_line[0] = (dst_word & ~first_mask) | (new_dst_word & first_mask);
+		
+		// Full words in between.
+		m_wordsFunc(
+			dst_line + 1, src_words + src_first_word + 1, num_words - 2, shift
+		);
+		
+		// The last (possibly incomplete) word.
+		int const last = num_words - 1;
+		dst_word = dst_line[last];
+		src_word = fetchWord(src_words, src_first_word + last, shift, last_mask);
+		new_dst_word = Rop::transform(src_word, dst_word);
+		dst_line[last] = (dst_word & ~last_mask) | (new_dst_word & last_mask);
+	}
+}
+
+/**
+ * \brief Picks the height of horizontal bands an output area is split into
+ *        for concurrent processing.
+ *
+ * Each band computes brick.height() - 1 rows of intermediate data
+ * its neighbours compute as well, so bands shouldn't be too thin.
+ * Returns a value not less than \p dst_area.height() if splitting
+ * is not worth it.
+ */
+int bandHeight(QRect const& dst_area, Brick const& brick)
+{
+	int const max_threads = ParallelFor::maxThreads();
+	if (max_threads <= 1) {
+		return dst_area.height();
+	}
+	
+	int const min_height = std::max(brick.height() * 8, (1 << 16) / dst_area.width() + 1);
+	int const even_split = (dst_area.height() + max_threads * 4 - 1) / (max_threads * 4);
+	return std::max(min_height, even_split);
+}
+
 static int const COMPOSITE_THRESHOLD = 8;
 
 void doInitialCopy(
@@ -450,12 +614,106 @@ void dilateOrErodeBrick(
 	}
 }
 
+/**
+ * Runs dilateOrErodeBrick() on horizontal bands of the output area.
+ * Each band reads the source rows it needs by itself, so different
+ * bands may be processed concurrently.
+ */
+class BrickBands
+{
+public:
+	BrickBands(
+		BinaryImage& dst, BinaryImage const& src, Brick const& brick,
+		QRect const& dst_area, BWColor src_surroundings,
+		AbstractRasterOp const& rop, BWColor spreading_color, int band_height);
+
+	void operator()(int band_begin, int band_end) const;
+private:
+	BinaryImage& m_rDst;
+	BinaryImage const& m_rSrc;
+	Brick m_brick;
+	QRect m_dstArea;
+	BWColor m_srcSurroundings;
+	AbstractRasterOp const& m_rRop;
+	BWColor m_spreadingColor;
+	int m_bandHeight;
+};
+
+BrickBands::BrickBands(
+	BinaryImage& dst, BinaryImage const& src, Brick const& brick,
+	QRect const& dst_area, BWColor const src_surroundings,
+	AbstractRasterOp const& rop, BWColor const spreading_color,
+	int const band_height)
+:	m_rDst(dst),
+	m_rSrc(src),
+	m_brick(brick),
+	m_dstArea(dst_area),
+	m_srcSurroundings(src_surroundings),
+	m_rRop(rop),
+	m_spreadingColor(spreading_color),
+	m_bandHeight(band_height)
+{
+}
+
+void
+BrickBands::operator()(int const band_begin, int const band_end) const
+{
+	for (int band = band_begin; band < band_end; ++band) {
+		int const top = band * m_bandHeight;
+		int const height = std::min(m_bandHeight, m_dstArea.height() - top);
+		QRect const band_area(
+			m_dstArea.left(), m_dstArea.top() + top, m_dstArea.width(), height
+		);
+		
+		BinaryImage band_dst(band_area.size());
+		dilateOrErodeBrick(
+			band_dst, m_rSrc, m_brick, band_area,
+			m_srcSurroundings, m_rRop, m_spreadingColor
+		);
+		
+		// Bands don't share any words of m_rDst, and m_rDst is not
+		// shared with other images, so this is safe to do concurrently.
+		rasterOp<RopSrc>(
+			m_rDst, QRect(0, top, band_area.width(), height),
+			band_dst, QPoint(0, 0)
+		);
+	}
+}
+
+void dilateOrErodeBrickInBands(
+	BinaryImage& dst, BinaryImage const& src, Brick const& brick,
+	QRect const& dst_area, BWColor const src_surroundings,
+	AbstractRasterOp const& rop, BWColor const spreading_color)
+{
+	int const band_height = bandHeight(dst_area, brick);
+	int const num_bands = (dst_area.height() + band_height - 1) / band_height;
+	if (num_bands <= 1) {
+		dilateOrErodeBrick(
+			dst, src, brick, dst_area, src_surroundings, rop, spreading_color
+		);
+		return;
+	}
+	
+	ParallelFor::run(
+		0, num_bands, 1,
+		BrickBands(
+			dst, src, brick, dst_area, src_surroundings,
+			rop, spreading_color, band_height
+		)
+	);
+}
+
 class Darker
 {
 public:
 	static uint8_t select(uint8_t v1, uint8_t v2) {
 		return std::min(v1, v2);
 	}
+	
+	static void selectRow(
+		uint8_t* dst, uint8_t const* src1, uint8_t const* src2, int len) {
+		PackedMorphology::minBytes(dst, src1, src2, len);
+	}
 };
 
 class Lighter
@@ -464,6 +722,11 @@ public:
 	static uint8_t select(uint8_t v1, uint8_t v2) {
 		return std::max(v1, v2);
 	}
+	
+	static void selectRow(
+		uint8_t* dst, uint8_t const* src1, uint8_t const* src2, int len) {
+		PackedMorphology::maxBytes(dst, src1, src2, len);
+	}
 };
 
 template<typename MinOrMax>
@@ -570,6 +833,11 @@ void spreadGrayHorizontal(
 	);
 }
 
+/**
+ * Same algorithm as spreadGrayHorizontal(), but whole rows are processed
+ * at once, which allows processing many pixels with a single instruction
+ * and keeps memory accesses sequential.
+ */
 template<typename MinOrMax>
 void spreadGrayVertical(
 	GrayImage& dst, GrayImage const& src,
@@ -585,41 +853,53 @@ void spreadGrayVertical(
 	
 	int const se_len = dy2 - dy1 + 1;
 	
-	std::vector<uint8_t> min_max_array(se_len * 2 - 1, 0);
-	uint8_t* const array_center = &min_max_array[se_len - 1];
-	
-	for (int x = 0; x < dst_width; ++x) {
-		for (int dst_segment_first = 0; dst_segment_first < dst_height;
-				dst_segment_first += se_len) {
-			int const dst_segment_last = std::min(
-				dst_segment_first + se_len, dst_height
-			) - 1; // inclusive
-			int const src_segment_first = dst_segment_first + dy1;
-			int const src_segment_last = dst_segment_last + dy2;
-			int const src_segment_center =
-				(src_segment_first + src_segment_last) >> 1;
-			
-			fillExtremumArrayLeftHalf<MinOrMax>(
-				array_center, src_data + x + src_segment_center * src_stride,
-				src_stride, src_segment_first, src_segment_center
-			);
-			
-			fillExtremumArrayRightHalf<MinOrMax>(
-				array_center, src_data + x + src_segment_center * src_stride,
-				src_stride, src_segment_center, src_segment_last
+	// Rows of running extremums, going up and down from the center row.
+	std::vector<uint8_t> min_max_rows((se_len * 2 - 1) * dst_width, 0);
+	uint8_t* const center_row = &min_max_rows[(se_len - 1) * dst_width];
+	
+	for (int dst_segment_first = 0; dst_segment_first < dst_height;
+			dst_segment_first += se_len) {
+		int const dst_segment_last = std::min(
+			dst_segment_first + se_len, dst_height
+		) - 1; // inclusive
+		int const src_segment_first = dst_segment_first + dy1;
+		int const src_segment_last = dst_segment_last + dy2;
+		int const src_segment_center =
+			(src_segment_first + src_segment_last) >> 1;
+		
+		uint8_t const* const src_center =
+			src_data + src_segment_center * src_stride;
+		memcpy(center_row, src_center, dst_width);
+		
+		uint8_t* row = center_row;
+		uint8_t const* src_row = src_center;
+		for (int y = src_segment_center - 1; y >= src_segment_first; --y) {
+			src_row -= src_stride;
+			MinOrMax::selectRow(row - dst_width, row, src_row, dst_width);
+			row -= dst_width;
+		}
+		
+		row = center_row;
+		src_row = src_center;
+		for (int y = src_segment_center + 1; y <= src_segment_last; ++y) {
+			src_row += src_stride;
+			MinOrMax::selectRow(row + dst_width, row, src_row, dst_width);
+			row += dst_width;
+		}
+		
+		uint8_t* dst_line = dst_data + dst_segment_first * dst_stride;
+		for (int y = dst_segment_first; y <= dst_segment_last; ++y) {
+			int const src_first = y + dy1;
+			int const src_last = y + dy2; // inclusive
+			assert(src_segment_center >= src_first);
+			assert(src_segment_center <= src_last);
+			MinOrMax::selectRow(
+				dst_line,
+				center_row + (src_first - src_segment_center) * dst_width,
+				center_row + (src_last - src_segment_center) * dst_width,
+				dst_width
 			);
-			
-			uint8_t* dst = dst_data + x + dst_segment_first * dst_stride;
-			for (int y = dst_segment_first; y <= dst_segment_last; ++y) {
-				int const src_first = y + dy1;
-				int const src_last = y + dy2; // inclusive
-				assert(src_segment_center >= src_first);
-				assert(src_segment_center <= src_last);
-				uint8_t v1 = array_center[src_first - src_segment_center];
-				uint8_t v2 = array_center[src_last - src_segment_center];
-				*dst = MinOrMax::select(v1, v2);
-				dst += dst_stride;
-			}
+			dst_line += dst_stride;
 		}
 	}
 }
@@ -797,6 +1077,84 @@ GrayImage dilateOrErodeGray(
 	return dst;
 }
 
+/**
+ * Runs dilateOrErodeGray() on horizontal bands of the output area.
+ * \see BrickBands
+ */
+template<typename MinOrMax>
+class GrayBrickBands
+{
+public:
+	GrayBrickBands(
+		GrayImage& dst, GrayImage const& src, Brick const& brick,
+		QRect const& dst_area, unsigned char src_surroundings, int band_height)
+	:	m_pDstData(dst.data()),
+		m_dstStride(dst.stride()),
+		m_rSrc(src),
+		m_brick(brick),
+		m_dstArea(dst_area),
+		m_srcSurroundings(src_surroundings),
+		m_bandHeight(band_height) {}
+
+	void operator()(int band_begin, int band_end) const;
+private:
+	uint8_t* m_pDstData;
+	int m_dstStride;
+	GrayImage const& m_rSrc;
+	Brick m_brick;
+	QRect m_dstArea;
+	unsigned char m_srcSurroundings;
+	int m_bandHeight;
+};
+
+template<typename MinOrMax>
+void
+GrayBrickBands<MinOrMax>::operator()(int const band_begin, int const band_end) const
+{
+	for (int band = band_begin; band < band_end; ++band) {
+		int const top = band * m_bandHeight;
+		int const height = std::min(m_bandHeight, m_dstArea.height() - top);
+		QRect const band_area(
+			m_dstArea.left(), m_dstArea.top() + top, m_dstArea.width(), height
+		);
+		
+		GrayImage const band_dst(
+			dilateOrErodeGray<MinOrMax>(
+				m_rSrc, m_brick, band_area, m_srcSurroundings
+			)
+		);
+		
+		uint8_t const* src_line = band_dst.data();
+		uint8_t* dst_line = m_pDstData + top * m_dstStride;
+		for (int y = 0; y < height; ++y) {
+			memcpy(dst_line, src_line, band_area.width());
+			src_line += band_dst.stride();
+			dst_line += m_dstStride;
+		}
+	}
+}
+
+template<typename MinOrMax>
+GrayImage dilateOrErodeGrayInBands(
+	GrayImage const& src, Brick const& brick,
+	QRect const& dst_area, unsigned char const src_surroundings)
+{
+	int const band_height = bandHeight(dst_area, brick);
+	int const num_bands = (dst_area.height() + band_height - 1) / band_height;
+	if (num_bands <= 1) {
+		return dilateOrErodeGray<MinOrMax>(src, brick, dst_area, src_surroundings);
+	}
+	
+	GrayImage dst(dst_area.size());
+	ParallelFor::run(
+		0, num_bands, 1,
+		GrayBrickBands<MinOrMax>(
+			dst, src, brick, dst_area, src_surroundings, band_height
+		)
+	);
+	return dst;
+}
+
 } // anonymous namespace
 
 
@@ -814,9 +1172,9 @@ BinaryImage dilateBrick(
 		throw std::invalid_argument("dilateBrick: dst_area is empty");
 	}
 	
-	TemplateRasterOp<RopOr<RopSrc, RopDst> > rop;
+	PackedRasterOp<RopOr<RopSrc, RopDst> > const rop(&PackedMorphology::orShifted);
 	BinaryImage dst(dst_area.size());
-	dilateOrErodeBrick(dst, src, brick, dst_area, src_surroundings, rop, BLACK);
+	dilateOrErodeBrickInBands(dst, src, brick, dst_area, src_surroundings, rop, BLACK);
 	
 	return dst;
 }
@@ -835,7 +1193,7 @@ GrayImage dilateGray(
 		throw std::invalid_argument("dilateGray: dst_area is empty");
 	}
 	
-	return dilateOrErodeGray<Darker>(src, brick, dst_area, src_surroundings);
+	return dilateOrErodeGrayInBands<Darker>(src, brick, dst_area, src_surroundings);
 }
 
 BinaryImage dilateBrick(
@@ -864,11 +1222,9 @@ BinaryImage erodeBrick(
 		throw std::invalid_argument("erodeBrick: dst_area is empty");
 	}
 	
-	typedef RopAnd<RopSrc, RopDst> Rop;
-	
-	TemplateRasterOp<RopAnd<RopSrc, RopDst> > rop;
+	PackedRasterOp<RopAnd<RopSrc, RopDst> > const rop(&PackedMorphology::andShifted);
 	BinaryImage dst(dst_area.size());
-	dilateOrErodeBrick(dst, src, brick, dst_area, src_surroundings, rop, WHITE);
+	dilateOrErodeBrickInBands(dst, src, brick, dst_area, src_surroundings, rop, WHITE);
 	
 	return dst;
 }
@@ -887,7 +1243,7 @@ GrayImage erodeGray(
 		throw std::invalid_argument("erodeGray: dst_area is empty");
 	}
 	
-	return dilateOrErodeGray<Lighter>(src, brick, dst_area, src_surroundings);
+	return dilateOrErodeGrayInBands<Lighter>(src, brick, dst_area, src_surroundings);
 }
 
 BinaryImage erodeBrick(
@@ -972,9 +1328,9 @@ GrayImage openGray(
 	CoordinateSystem tmp_cs(tmp_rect.topLeft());
 	
 	GrayImage const tmp(
-		dilateOrErodeGray<Lighter>(src, brick1, tmp_rect, src_surroundings)
+		dilateOrErodeGrayInBands<Lighter>(src, brick1, tmp_rect, src_surroundings)
 	);
-	return dilateOrErodeGray<Darker>(
+	return dilateOrErodeGrayInBands<Darker>(
 		tmp, brick2, tmp_cs.fromGlobal(dst_area), src_surroundings
 	);
 }
@@ -1056,9 +1412,9 @@ GrayImage closeGray(
 	CoordinateSystem tmp_cs(tmp_rect.topLeft());
 	
 	GrayImage const tmp(
-		dilateOrErodeGray<Darker>(src, brick1, tmp_rect, src_surroundings)
+		dilateOrErodeGrayInBands<Darker>(src, brick1, tmp_rect, src_surroundings)
 	);
-	return dilateOrErodeGray<Lighter>(
+	return dilateOrErodeGrayInBands<Lighter>(
 		tmp, brick2, tmp_cs.fromGlobal(dst_area), src_surroundings
 	);
 }
@@ -0,0 +1,282 @@
+/*
+	Scan Tailor - Interactive post-processing tool for scanned pages.
+	Copyright (C)  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "PackedMorphology.h"
+
+#include "SimdDispatch.h"
+
+namespace imageproc
+{
+
+namespace
+{
+
+typedef void (*WordsFunc)(uint32_t*, uint32_t const*, int, int);
+typedef void (*BytesFunc)(uint8_t*, uint8_t const*, uint8_t const*, int);
+
+struct Kernels
+{
+	WordsFunc orShifted;
+	WordsFunc andShifted;
+	BytesFunc minBytes;
+	BytesFunc maxBytes;
+	char const* name;
+};
+
+struct OrWords
+{
+	static uint32_t apply(uint32_t a, uint32_t b) { return a | b; }
+#ifdef IMAGEPROC_HAVE_SSE2
+	static __m128i apply(__m128i a, __m128i b) { return _mm_or_si128(a, b); }
+#endif
+#ifdef IMAGEPROC_HAVE_AVX2
+	IMAGEPROC_AVX2_TARGET
+	static __m256i apply(__m256i a, __m256i b) { return _mm256_or_si256(a, b); }
+#endif
+};
+
+struct AndWords
+{
+	static uint32_t apply(uint32_t a, uint32_t b) { return a & b; }
+#ifdef IMAGEPROC_HAVE_SSE2
+	static __m128i apply(__m128i a, __m128i b) { return _mm_and_si128(a, b); }
+#endif
+#ifdef IMAGEPROC_HAVE_AVX2
+	IMAGEPROC_AVX2_TARGET
+	static __m256i apply(__m256i a, __m256i b) { return _mm256_and_si256(a, b); }
+#endif
+};
+
+struct MinBytes
+{
+	static uint8_t apply(uint8_t a, uint8_t b) { return a < b ? a : b; }
+#ifdef IMAGEPROC_HAVE_SSE2
+	static __m128i apply(__m128i a, __m128i b) { return _mm_min_epu8(a, b); }
+#endif
+#ifdef IMAGEPROC_HAVE_AVX2
+	IMAGEPROC_AVX2_TARGET
+	static __m256i apply(__m256i a, __m256i b) { return _mm256_min_epu8(a, b); }
+#endif
+};
+
+struct MaxBytes
+{
+	static uint8_t apply(uint8_t a, uint8_t b) { return a > b ? a : b; }
+#ifdef IMAGEPROC_HAVE_SSE2
+	static __m128i apply(__m128i a, __m128i b) { return _mm_max_epu8(a, b); }
+#endif
+#ifdef IMAGEPROC_HAVE_AVX2
+	IMAGEPROC_AVX2_TARGET
+	static __m256i apply(__m256i a, __m256i b) { return _mm256_max_epu8(a, b); }
+#endif
+};
+
+/*================================= Scalar =================================*/
+
+template<typename Op>
+void shiftedScalar(
+	uint32_t* dst, uint32_t const* src, int const num_words, int const shift)
+{
+	if (shift == 0) {
+		for (int i = 0; i < num_words; ++i) {
+			dst[i] = Op::apply(dst[i], src[i]);
+		}
+	} else {
+		int const rshift = 32 - shift;
+		for (int i = 0; i < num_words; ++i) {
+			dst[i] = Op::apply(dst[i], (src[i] << shift) | (src[i + 1] >> rshift));
+		}
+	}
+}
+
+template<typename Op>
+void bytesScalar(
+	uint8_t* dst, uint8_t const* src1, uint8_t const* src2, int const len)
+{
+	for (int i = 0; i < len; ++i) {
+		dst[i] = Op::apply(src1[i], src2[i]);
+	}
+}
+
+Kernels const g_scalarKernels = {
+	&shiftedScalar<OrWords>, &shiftedScalar<AndWords>,
+	&bytesScalar<MinBytes>, &bytesScalar<MaxBytes>, "scalar"
+};
+
+/*================================== SSE2 ==================================*/
+
+#ifdef IMAGEPROC_HAVE_SSE2
+
+template<typename Op>
+void shiftedSse2(
+	uint32_t* dst, uint32_t const* src, int const num_words, int const shift)
+{
+	int i = 0;
+
+	if (shift == 0) {
+		for (; i + 4 <= num_words; i += 4) {
+			__m128i const s = _mm_loadu_si128((__m128i const*)(src + i));
+			__m128i const d = _mm_loadu_si128((__m128i const*)(dst + i));
+			_mm_storeu_si128((__m128i*)(dst + i), Op::apply(d, s));
+		}
+	} else {
+		__m128i const lcount = _mm_cvtsi32_si128(shift);
+		__m128i const rcount = _mm_cvtsi32_si128(32 - shift);
+		for (; i + 4 <= num_words; i += 4) {
+			__m128i const s1 = _mm_loadu_si128((__m128i const*)(src + i));
+			__m128i const s2 = _mm_loadu_si128((__m128i const*)(src + i + 1));
+			__m128i const s = _mm_or_si128(
+				_mm_sll_epi32(s1, lcount), _mm_srl_epi32(s2, rcount)
+			);
+			__m128i const d = _mm_loadu_si128((__m128i const*)(dst + i));
+			_mm_storeu_si128((__m128i*)(dst + i), Op::apply(d, s));
+		}
+	}
+
+	shiftedScalar<Op>(dst + i, src + i, num_words - i, shift);
+}
+
+template<typename Op>
+void bytesSse2(
+	uint8_t* dst, uint8_t const* src1, uint8_t const* src2, int const len)
+{
+	int i = 0;
+	for (; i + 16 <= len; i += 16) {
+		__m128i const a = _mm_loadu_si128((__m128i const*)(src1 + i));
+		__m128i const b = _mm_loadu_si128((__m128i const*)(src2 + i));
+		_mm_storeu_si128((__m128i*)(dst + i), Op::apply(a, b));
+	}
+
+	bytesScalar<Op>(dst + i, src1 + i, src2 + i, len - i);
+}
+
+Kernels const g_sse2Kernels = {
+	&shiftedSse2<OrWords>, &shiftedSse2<AndWords>,
+	&bytesSse2<MinBytes>, &bytesSse2<MaxBytes>, "sse2"
+};
+
+#endif // IMAGEPROC_HAVE_SSE2
+
+/*================================== AVX2 ==================================*/
+
+#ifdef IMAGEPROC_HAVE_AVX2
+
+template<typename Op>
+IMAGEPROC_AVX2_TARGET
+void shiftedAvx2(
+	uint32_t* dst, uint32_t const* src, int const num_words, int const shift)
+{
+	int i = 0;
+
+	if (shift == 0) {
+		for (; i + 8 <= num_words; i += 8) {
+			__m256i const s = _mm256_loadu_si256((__m256i const*)(src + i));
+			__m256i const d = _mm256_loadu_si256((__m256i const*)(dst + i));
+			_mm256_storeu_si256((__m256i*)(dst + i), Op::apply(d, s));
+		}
+	} else {
+		__m128i const lcount = _mm_cvtsi32_si128(shift);
+		__m128i const rcount = _mm_cvtsi32_si128(32 - shift);
+		for (; i + 8 <= num_words; i += 8) {
+			__m256i const s1 = _mm256_loadu_si256((__m256i const*)(src + i));
+			__m256i const s2 = _mm256_loadu_si256((__m256i const*)(src + i + 1));
+			__m256i const s = _mm256_or_si256(
+				_mm256_sll_epi32(s1, lcount), _mm256_srl_epi32(s2, rcount)
+			);
+			__m256i const d = _mm256_loadu_si256((__m256i const*)(dst + i));
+			_mm256_storeu_si256((__m256i*)(dst + i), Op::apply(d, s));
+		}
+	}
+
+	// Not the SSE2 version, as mixing legacy SSE and AVX instructions
+	// without clearing the upper halves of registers is slow.
+	shiftedScalar<Op>(dst + i, src + i, num_words - i, shift);
+}
+
+template<typename Op>
+IMAGEPROC_AVX2_TARGET
+void bytesAvx2(
+	uint8_t* dst, uint8_t const* src1, uint8_t const* src2, int const len)
+{
+	int i = 0;
+	for (; i + 32 <= len; i += 32) {
+		__m256i const a = _mm256_loadu_si256((__m256i const*)(src1 + i));
+		__m256i const b = _mm256_loadu_si256((__m256i const*)(src2 + i));
+		_mm256_storeu_si256((__m256i*)(dst + i), Op::apply(a, b));
+	}
+
+	bytesScalar<Op>(dst + i, src1 + i, src2 + i, len - i);
+}
+
+Kernels const g_avx2Kernels = {
+	&shiftedAvx2<OrWords>, &shiftedAvx2<AndWords>,
+	&bytesAvx2<MinBytes>, &bytesAvx2<MaxBytes>, "avx2"
+};
+
+#endif // IMAGEPROC_HAVE_AVX2
+
+SimdDispatch<Kernels> g_dispatch(
+	g_scalarKernels,
+	IMAGEPROC_SSE2_KERNELS(g_sse2Kernels),
+	IMAGEPROC_AVX2_KERNELS(g_avx2Kernels)
+);
+
+} // anonymous namespace
+
+void
+PackedMorphology::orShifted(
+	uint32_t* dst, uint32_t const* src, int const num_words, int const shift)
+{
+	g_dispatch.kernels().orShifted(dst, src, num_words, shift);
+}
+
+void
+PackedMorphology::andShifted(
+	uint32_t* dst, uint32_t const* src, int const num_words, int const shift)
+{
+	g_dispatch.kernels().andShifted(dst, src, num_words, shift);
+}
+
+void
+PackedMorphology::minBytes(
+	uint8_t* dst, uint8_t const* src1, uint8_t const* src2, int const len)
+{
+	g_dispatch.kernels().minBytes(dst, src1, src2, len);
+}
+
+void
+PackedMorphology::maxBytes(
+	uint8_t* dst, uint8_t const* src1, uint8_t const* src2, int const len)
+{
+	g_dispatch.kernels().maxBytes(dst, src1, src2, len);
+}
+
+char const*
+PackedMorphology::implementation()
+{
+	return g_dispatch.kernels().name;
+}
+
+void
+PackedMorphology::forceScalar(bool const force)
+{
+	g_dispatch.forceScalar(force);
+}
+
+} // namespace imageproc
@@ -0,0 +1,88 @@
+/*
+	Scan Tailor - Interactive post-processing tool for scanned pages.
+	Copyright (C)  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef IMAGEPROC_PACKED_MORPHOLOGY_H_
+#define IMAGEPROC_PACKED_MORPHOLOGY_H_
+
+#include <stdint.h>
+
+namespace imageproc
+{
+
+/**
+ * \brief Inner loops of brick morphology.
+ *
+ * Binary functions work on packed words of BinaryImage format, with
+ * the first pixel in the most significant bit.  Gray functions work on
+ * 8-bit pixels.  Source and destination ranges must not overlap,
+ * except for a gray destination being the same as one of its sources.
+ *
+ * SSE2 and AVX2 implementations process 4 or 8 words (16 or 32 pixels
+ * for gray functions) at a time.  The best one the CPU supports is picked
+ * at runtime.  Other CPUs get a portable scalar implementation.
+ * All implementations produce identical results.
+ */
+class PackedMorphology
+{
+public:
+	/**
+	 * \brief dst[i] |= (src[i] << shift) | (src[i + 1] >> (32 - shift))
+	 *
+	 * \p shift must be within [0, 31].  src[num_words] is only
+	 * accessed if \p shift is not zero.
+	 */
+	static void orShifted(
+		uint32_t* dst, uint32_t const* src, int num_words, int shift);
+
+	/**
+	 * \brief dst[i] &= (src[i] << shift) | (src[i + 1] >> (32 - shift))
+	 *
+	 * \see orShifted()
+	 */
+	static void andShifted(
+		uint32_t* dst, uint32_t const* src, int num_words, int shift);
+
+	/**
+	 * \brief dst[i] = min(src1[i], src2[i])
+	 */
+	static void minBytes(
+		uint8_t* dst, uint8_t const* src1, uint8_t const* src2, int len);
+
+	/**
+	 * \brief dst[i] = max(src1[i], src2[i])
+	 */
+	static void maxBytes(
+		uint8_t* dst, uint8_t const* src1, uint8_t const* src2, int len);
+
+	/**
+	 * \brief The name of the implementation in use: "scalar", "sse2" or "avx2".
+	 */
+	static char const* implementation();
+
+	/**
+	 * \brief Switches to the scalar implementation, or back to the
+	 *        best one available.
+	 *
+	 * Meant for testing and benchmarking.  Not thread-safe.
+	 */
+	static void forceScalar(bool force);
+};
+
+} // namespace imageproc
+
+#endif
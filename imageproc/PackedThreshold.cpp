@@ -0,0 +1,375 @@
+/*
+	Scan Tailor - Interactive post-processing tool for scanned pages.
+	Copyright (C)  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "PackedThreshold.h"
+
+#include "SimdDispatch.h"
+
+namespace imageproc
+{
+
+namespace
+{
+
+typedef void (*Gray8Func)(uint8_t const*, uint32_t*, int, int);
+typedef void (*Rgb32Func)(uint32_t const*, uint32_t*, int, int);
+
+struct Kernels
+{
+	Gray8Func gray8;
+	Rgb32Func rgb32;
+	Rgb32Func argb32Premultiplied;
+	char const* name;
+};
+
+/**
+ * movemask puts the first pixel into the least significant bit,
+ * while BinaryImage wants it in the most significant one.
+ */
+inline uint32_t reverseBits(uint32_t x)
+{
+	x = ((x >> 1) & 0x55555555) | ((x & 0x55555555) << 1);
+	x = ((x >> 2) & 0x33333333) | ((x & 0x33333333) << 2);
+	x = ((x >> 4) & 0x0F0F0F0F) | ((x & 0x0F0F0F0F) << 4);
+	x = ((x >> 8) & 0x00FF00FF) | ((x & 0x00FF00FF) << 8);
+	return (x >> 16) | (x << 16);
+}
+
+inline int clampThreshold(int const threshold)
+{
+	// Gray levels and (R * 11 + G * 16 + B * 5) / 32 are in [0, 255],
+	// so clamping doesn't change any results.
+	return threshold < 0 ? 0 : (threshold > 256 ? 256 : threshold);
+}
+
+/*================================= Scalar =================================*/
+
+void gray8Scalar(
+	uint8_t const* src, uint32_t* dst, int const num_words, int const threshold)
+{
+	for (int i = 0; i < num_words; ++i, src += 32) {
+		uint32_t word = 0;
+		for (int bit = 0; bit < 32; ++bit) {
+			word <<= 1;
+			if (src[bit] < threshold) {
+				word |= uint32_t(1);
+			}
+		}
+		dst[i] = word;
+	}
+}
+
+void rgb32Scalar(
+	uint32_t const* src, uint32_t* dst, int const num_words, int const threshold)
+{
+	for (int i = 0; i < num_words; ++i, src += 32) {
+		uint32_t word = 0;
+		for (int bit = 0; bit < 32; ++bit) {
+			uint32_t const c = src[bit];
+			int const sum = ((c >> 16) & 0xff) * 11 + ((c >> 8) & 0xff) * 16 + (c & 0xff) * 5;
+			word <<= 1;
+			word |= (sum < threshold * 32) ? 1 : 0;
+		}
+		dst[i] = word;
+	}
+}
+
+void argb32PremultipliedScalar(
+	uint32_t const* src, uint32_t* dst, int const num_words, int const threshold)
+{
+	for (int i = 0; i < num_words; ++i, src += 32) {
+		uint32_t word = 0;
+		for (int bit = 0; bit < 32; ++bit) {
+			uint32_t const pm = src[bit];
+			int const alpha = pm >> 24;
+			int const sum = ((pm >> 16) & 0xff) * (255*11)
+				+ ((pm >> 8) & 0xff) * (255*16) + (pm & 0xff) * (255*5);
+			word <<= 1;
+			word |= (alpha == 0 || sum < alpha * threshold * 32) ? 1 : 0;
+		}
+		dst[i] = word;
+	}
+}
+
+Kernels const g_scalarKernels = {
+	&gray8Scalar, &rgb32Scalar, &argb32PremultipliedScalar, "scalar"
+};
+
+/*================================== SSE2 ==================================*/
+
+#ifdef IMAGEPROC_HAVE_SSE2
+
+void gray8Sse2(
+	uint8_t const* src, uint32_t* dst, int const num_words, int const threshold)
+{
+	if (threshold <= 0 || threshold > 255) {
+		uint32_t const word = threshold > 255 ? ~uint32_t(0) : 0;
+		for (int i = 0; i < num_words; ++i) {
+			dst[i] = word;
+		}
+		return;
+	}
+
+	// There is no unsigned byte comparison, so we flip the sign bits.
+	__m128i const bias = _mm_set1_epi8((char)0x80);
+	__m128i const limit = _mm_set1_epi8((char)(threshold ^ 0x80));
+
+	for (int i = 0; i < num_words; ++i, src += 32) {
+		__m128i const p0 = _mm_xor_si128(_mm_loadu_si128((__m128i const*)src), bias);
+		__m128i const p1 = _mm_xor_si128(_mm_loadu_si128((__m128i const*)(src + 16)), bias);
+		uint32_t const lo = _mm_movemask_epi8(_mm_cmplt_epi8(p0, limit));
+		uint32_t const hi = _mm_movemask_epi8(_mm_cmplt_epi8(p1, limit));
+		dst[i] = reverseBits(lo | (hi << 16));
+	}
+}
+
+/**
+ * Computes R * 11 + G * 16 + B * 5 for 4 pixels.
+ */
+inline __m128i graySums4Sse2(uint32_t const* src)
+{
+	// Pixels are stored as B, G, R, A bytes.
+	__m128i const weights = _mm_set_epi16(0, 11, 16, 5, 0, 11, 16, 5);
+	__m128i const ones = _mm_set1_epi16(1);
+	__m128i const zero = _mm_setzero_si128();
+
+	__m128i const px = _mm_loadu_si128((__m128i const*)src);
+	__m128i const lo = _mm_madd_epi16(_mm_unpacklo_epi8(px, zero), weights);
+	__m128i const hi = _mm_madd_epi16(_mm_unpackhi_epi8(px, zero), weights);
+
+	// Partial sums fit into 16 bits, so packing doesn't saturate.
+	return _mm_madd_epi16(_mm_packs_epi32(lo, hi), ones);
+}
+
+/**
+ * Packs 8 vectors of 32-bit masks into a BinaryImage word.
+ */
+inline uint32_t packMasksSse2(__m128i const* m)
+{
+	__m128i const b0 = _mm_packs_epi16(
+		_mm_packs_epi32(m[0], m[1]), _mm_packs_epi32(m[2], m[3])
+	);
+	__m128i const b1 = _mm_packs_epi16(
+		_mm_packs_epi32(m[4], m[5]), _mm_packs_epi32(m[6], m[7])
+	);
+	uint32_t const lo = _mm_movemask_epi8(b0);
+	uint32_t const hi = _mm_movemask_epi8(b1);
+	return reverseBits(lo | (hi << 16));
+}
+
+void rgb32Sse2(
+	uint32_t const* src, uint32_t* dst, int const num_words, int const threshold)
+{
+	__m128i const limit = _mm_set1_epi32(clampThreshold(threshold) * 32);
+
+	for (int i = 0; i < num_words; ++i, src += 32) {
+		__m128i masks[8];
+		for (int k = 0; k < 8; ++k) {
+			masks[k] = _mm_cmplt_epi32(graySums4Sse2(src + k * 4), limit);
+		}
+		dst[i] = packMasksSse2(masks);
+	}
+}
+
+void argb32PremultipliedSse2(
+	uint32_t const* src, uint32_t* dst, int const num_words, int const threshold)
+{
+	if (threshold < 0 || threshold > 256) {
+		// Here clamping could change the results for pixels
+		// that aren't properly premultiplied.
+		argb32PremultipliedScalar(src, dst, num_words, threshold);
+		return;
+	}
+
+	// A 16-bit multiplier, for _mm_madd_epi16().
+	__m128i const threshold32 = _mm_set1_epi32(threshold * 32);
+	__m128i const zero = _mm_setzero_si128();
+
+	for (int i = 0; i < num_words; ++i, src += 32) {
+		__m128i masks[8];
+		for (int k = 0; k < 8; ++k) {
+			__m128i const sum = graySums4Sse2(src + k * 4);
+			__m128i const sum255 = _mm_sub_epi32(_mm_slli_epi32(sum, 8), sum);
+			__m128i const alpha = _mm_srli_epi32(
+				_mm_loadu_si128((__m128i const*)(src + k * 4)), 24
+			);
+			__m128i const limit = _mm_madd_epi16(alpha, threshold32);
+			masks[k] = _mm_or_si128(
+				_mm_cmplt_epi32(sum255, limit), _mm_cmpeq_epi32(alpha, zero)
+			);
+		}
+		dst[i] = packMasksSse2(masks);
+	}
+}
+
+Kernels const g_sse2Kernels = {
+	&gray8Sse2, &rgb32Sse2, &argb32PremultipliedSse2, "sse2"
+};
+
+#endif // IMAGEPROC_HAVE_SSE2
+
+/*================================== AVX2 ==================================*/
+
+#ifdef IMAGEPROC_HAVE_AVX2
+
+IMAGEPROC_AVX2_TARGET
+void gray8Avx2(
+	uint8_t const* src, uint32_t* dst, int const num_words, int const threshold)
+{
+	if (threshold <= 0 || threshold > 255) {
+		gray8Sse2(src, dst, num_words, threshold);
+		return;
+	}
+
+	__m256i const bias = _mm256_set1_epi8((char)0x80);
+	__m256i const limit = _mm256_set1_epi8((char)(threshold ^ 0x80));
+
+	for (int i = 0; i < num_words; ++i, src += 32) {
+		__m256i const px = _mm256_xor_si256(
+			_mm256_loadu_si256((__m256i const*)src), bias
+		);
+		uint32_t const mask = _mm256_movemask_epi8(_mm256_cmpgt_epi8(limit, px));
+		dst[i] = reverseBits(mask);
+	}
+}
+
+IMAGEPROC_AVX2_TARGET
+inline __m256i graySums8Avx2(__m256i const px)
+{
+	__m256i const weights = _mm256_set_epi16(
+		0, 11, 16, 5, 0, 11, 16, 5, 0, 11, 16, 5, 0, 11, 16, 5
+	);
+	__m256i const ones = _mm256_set1_epi16(1);
+	__m256i const zero = _mm256_setzero_si256();
+
+	// Unpacking and packing stay within 128-bit lanes,
+	// so the sums come out in pixel order.
+	__m256i const lo = _mm256_madd_epi16(_mm256_unpacklo_epi8(px, zero), weights);
+	__m256i const hi = _mm256_madd_epi16(_mm256_unpackhi_epi8(px, zero), weights);
+	return _mm256_madd_epi16(_mm256_packs_epi32(lo, hi), ones);
+}
+
+IMAGEPROC_AVX2_TARGET
+inline uint32_t packMasksAvx2(__m256i const* m)
+{
+	__m256i const bytes = _mm256_packs_epi16(
+		_mm256_packs_epi32(m[0], m[1]), _mm256_packs_epi32(m[2], m[3])
+	);
+
+	// In-lane packing leaves groups of 4 pixels in the order of
+	// 0, 8, 16, 24, 4, 12, 20, 28.
+	__m256i const order = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);
+	uint32_t const mask = _mm256_movemask_epi8(
+		_mm256_permutevar8x32_epi32(bytes, order)
+	);
+	return reverseBits(mask);
+}
+
+IMAGEPROC_AVX2_TARGET
+void rgb32Avx2(
+	uint32_t const* src, uint32_t* dst, int const num_words, int const threshold)
+{
+	__m256i const limit = _mm256_set1_epi32(clampThreshold(threshold) * 32);
+
+	for (int i = 0; i < num_words; ++i, src += 32) {
+		__m256i masks[4];
+		for (int k = 0; k < 4; ++k) {
+			__m256i const px = _mm256_loadu_si256((__m256i const*)(src + k * 8));
+			masks[k] = _mm256_cmpgt_epi32(limit, graySums8Avx2(px));
+		}
+		dst[i] = packMasksAvx2(masks);
+	}
+}
+
+IMAGEPROC_AVX2_TARGET
+void argb32PremultipliedAvx2(
+	uint32_t const* src, uint32_t* dst, int const num_words, int const threshold)
+{
+	if (threshold < 0 || threshold > 256) {
+		argb32PremultipliedScalar(src, dst, num_words, threshold);
+		return;
+	}
+
+	__m256i const threshold32 = _mm256_set1_epi32(threshold * 32);
+	__m256i const zero = _mm256_setzero_si256();
+
+	for (int i = 0; i < num_words; ++i, src += 32) {
+		__m256i masks[4];
+		for (int k = 0; k < 4; ++k) {
+			__m256i const px = _mm256_loadu_si256((__m256i const*)(src + k * 8));
+			__m256i const sum = graySums8Avx2(px);
+			__m256i const sum255 = _mm256_sub_epi32(_mm256_slli_epi32(sum, 8), sum);
+			__m256i const alpha = _mm256_srli_epi32(px, 24);
+			__m256i const limit = _mm256_madd_epi16(alpha, threshold32);
+			masks[k] = _mm256_or_si256(
+				_mm256_cmpgt_epi32(limit, sum255), _mm256_cmpeq_epi32(alpha, zero)
+			);
+		}
+		dst[i] = packMasksAvx2(masks);
+	}
+}
+
+Kernels const g_avx2Kernels = {
+	&gray8Avx2, &rgb32Avx2, &argb32PremultipliedAvx2, "avx2"
+};
+
+#endif // IMAGEPROC_HAVE_AVX2
+
+SimdDispatch<Kernels> g_dispatch(
+	g_scalarKernels,
+	IMAGEPROC_SSE2_KERNELS(g_sse2Kernels),
+	IMAGEPROC_AVX2_KERNELS(g_avx2Kernels)
+);
+
+} // anonymous namespace
+
+void
+PackedThreshold::gray8(
+	uint8_t const* src, uint32_t* dst, int const num_words, int const threshold)
+{
+	g_dispatch.kernels().gray8(src, dst, num_words, threshold);
+}
+
+void
+PackedThreshold::rgb32(
+	uint32_t const* src, uint32_t* dst, int const num_words, int const threshold)
+{
+	g_dispatch.kernels().rgb32(src, dst, num_words, threshold);
+}
+
+void
+PackedThreshold::argb32Premultiplied(
+	uint32_t const* src, uint32_t* dst, int const num_words, int const threshold)
+{
+	g_dispatch.kernels().argb32Premultiplied(src, dst, num_words, threshold);
+}
+
+char const*
+PackedThreshold::implementation()
+{
+	return g_dispatch.kernels().name;
+}
+
+void
+PackedThreshold::forceScalar(bool const force)
+{
+	g_dispatch.forceScalar(force);
+}
+
+} // namespace imageproc
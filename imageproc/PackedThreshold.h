@@ -0,0 +1,79 @@
+/*
+	Scan Tailor - Interactive post-processing tool for scanned pages.
+	Copyright (C)  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef IMAGEPROC_PACKED_THRESHOLD_H_
+#define IMAGEPROC_PACKED_THRESHOLD_H_
+
+#include <stdint.h>
+
+namespace imageproc
+{
+
+/**
+ * \brief Thresholds pixels into packed words of BinaryImage format.
+ *
+ * Each function converts num_words * 32 source pixels into num_words
+ * words, with the first pixel in the most significant bit and black
+ * pixels represented by 1 bits.  The formulas are exactly the ones used
+ * by the scalar code in BinaryImage.cpp.
+ *
+ * SSE2 and AVX2 implementations compare 16 or 32 pixels at a time and
+ * pack them with movemask.  The best one the CPU supports is picked at
+ * runtime.  Other CPUs get a portable scalar implementation.
+ */
+class PackedThreshold
+{
+public:
+	/**
+	 * \brief 8-bit gray levels below \p threshold become black.
+	 */
+	static void gray8(
+		uint8_t const* src, uint32_t* dst, int num_words, int threshold);
+
+	/**
+	 * \brief Pixels with (R * 11 + G * 16 + B * 5) / 32 below
+	 *        \p threshold become black.  Alpha is ignored.
+	 */
+	static void rgb32(
+		uint32_t const* src, uint32_t* dst, int num_words, int threshold);
+
+	/**
+	 * \brief Same as rgb32(), but for premultiplied ARGB pixels.
+	 *        Fully transparent pixels become black.
+	 */
+	static void argb32Premultiplied(
+		uint32_t const* src, uint32_t* dst, int num_words, int threshold);
+
+	/**
+	 * \brief The name of the implementation in use: "scalar", "sse2" or "avx2".
+	 */
+	static char const* implementation();
+
+	/**
+	 * \brief Switches to the scalar implementation, or back to the
+	 *        best one available.
+	 *
+	 * Meant for testing and benchmarking.  Not thread-safe.
+	 */
+	static void forceScalar(bool force);
+};
+
+} // namespace imageproc
+
+#endif
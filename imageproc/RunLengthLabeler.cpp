@@ -0,0 +1,446 @@
+/*
+	Scan Tailor - Interactive post-processing tool for scanned pages.
+	Copyright (C)  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "RunLengthLabeler.h"
+#include "BinaryImage.h"
+#include "BitOps.h"
+#include "ParallelFor.h"
+#include <QPoint>
+#include <QRect>
+#include <algorithm>
+#include <assert.h>
+
+namespace imageproc
+{
+
+namespace
+{
+
+struct ComponentStats
+{
+	int left;
+	int top;
+	int right;
+	int bottom;
+	int seedX;
+	int pixCount;
+
+	ComponentStats() : left(0), top(0), right(0), bottom(0), seedX(0), pixCount(0) {}
+};
+
+} // anonymous namespace
+
+/**
+ * Extracts runs of a range of bands into per-band vectors.
+ */
+class RunLengthLabeler::BandExtractor
+{
+public:
+	BandExtractor(
+		BinaryImage const& image, int band_height,
+		std::vector<std::vector<Run> >& band_runs,
+		std::vector<int>& line_sizes)
+	:	m_rImage(image),
+		m_bandHeight(band_height),
+		m_rBandRuns(band_runs),
+		m_rLineSizes(line_sizes) {}
+
+	void operator()(int band_begin, int band_end) const {
+		int const width = m_rImage.width();
+		int const height = m_rImage.height();
+		int const wpl = m_rImage.wordsPerLine();
+
+		for (int band = band_begin; band < band_end; ++band) {
+			std::vector<Run>& runs = m_rBandRuns[band];
+			int const y_end = std::min(height, (band + 1) * m_bandHeight);
+			for (int y = band * m_bandHeight; y < y_end; ++y) {
+				size_t const size_before = runs.size();
+				extractRuns(m_rImage.data() + y * wpl, width, runs);
+				m_rLineSizes[y] = runs.size() - size_before;
+			}
+		}
+	}
+private:
+	BinaryImage const& m_rImage;
+	int m_bandHeight;
+	std::vector<std::vector<Run> >& m_rBandRuns;
+	std::vector<int>& m_rLineSizes;
+};
+
+/**
+ * Merges runs of adjacent lines within a range of bands.
+ * Different bands don't share runs, so they may be processed concurrently.
+ */
+class RunLengthLabeler::BandMerger
+{
+public:
+	BandMerger(RunLengthLabeler& owner, int band_height, int diagonal)
+	:	m_rOwner(owner),
+		m_bandHeight(band_height),
+		m_diagonal(diagonal) {}
+
+	void operator()(int band_begin, int band_end) const {
+		int const height = m_rOwner.m_size.height();
+		for (int band = band_begin; band < band_end; ++band) {
+			int const y_end = std::min(height, (band + 1) * m_bandHeight);
+			for (int y = band * m_bandHeight + 1; y < y_end; ++y) {
+				m_rOwner.unionLines(y - 1, y, m_diagonal);
+			}
+		}
+	}
+private:
+	RunLengthLabeler& m_rOwner;
+	int m_bandHeight;
+	int m_diagonal;
+};
+
+class RunLengthLabeler::LabelWriter
+{
+public:
+	/**
+	 * \param remapping Translates labels before they are written,
+	 *        or null to write them as is.
+	 */
+	LabelWriter(RunLengthLabeler const& owner, uint32_t* data, int stride,
+		uint32_t const* remapping)
+	:	m_rOwner(owner),
+		m_pData(data),
+		m_stride(stride),
+		m_pRemapping(remapping) {}
+
+	void operator()(int y_begin, int y_end) const {
+		for (int y = y_begin; y < y_end; ++y) {
+			uint32_t* const line = m_pData + y * m_stride;
+			int const run_end = m_rOwner.m_lineBegin[y + 1];
+			for (int run = m_rOwner.m_lineBegin[y]; run < run_end; ++run) {
+				Run const& r = m_rOwner.m_runs[run];
+				uint32_t label = m_rOwner.m_labels[run];
+				if (m_pRemapping) {
+					label = m_pRemapping[label];
+				}
+				std::fill(line + r.xBegin, line + r.xEnd, label);
+			}
+		}
+	}
+private:
+	RunLengthLabeler const& m_rOwner;
+	uint32_t* m_pData;
+	int m_stride;
+	uint32_t const* m_pRemapping;
+};
+
+/**
+ * Clears bits of runs belonging to erased components.
+ * Lines don't share words, so they may be processed concurrently.
+ */
+class RunLengthLabeler::ComponentEraser
+{
+public:
+	ComponentEraser(RunLengthLabeler const& owner,
+		BinaryImage& image, std::vector<uint8_t> const& erase)
+	:	m_rOwner(owner),
+		m_pData(image.data()),
+		m_wpl(image.wordsPerLine()),
+		m_rErase(erase) {}
+
+	void operator()(int y_begin, int y_end) const {
+		for (int y = y_begin; y < y_end; ++y) {
+			uint32_t* const line = m_pData + y * m_wpl;
+			int const run_end = m_rOwner.m_lineBegin[y + 1];
+			for (int run = m_rOwner.m_lineBegin[y]; run < run_end; ++run) {
+				if (m_rErase[m_rOwner.m_labels[run]]) {
+					Run const& r = m_rOwner.m_runs[run];
+					clearBits(line, r.xBegin, r.xEnd);
+				}
+			}
+		}
+	}
+private:
+	static void clearBits(uint32_t* line, int x_begin, int x_end) {
+		uint32_t const all_ones = ~uint32_t(0);
+		int const first_word = x_begin >> 5;
+		int const last_word = (x_end - 1) >> 5;
+		uint32_t const first_mask = all_ones >> (x_begin & 31);
+		uint32_t const last_mask = all_ones << (31 - ((x_end - 1) & 31));
+		if (first_word == last_word) {
+			line[first_word] &= ~(first_mask & last_mask);
+			return;
+		}
+
+		line[first_word] &= ~first_mask;
+		std::fill(line + first_word + 1, line + last_word, uint32_t(0));
+		line[last_word] &= ~last_mask;
+	}
+
+	RunLengthLabeler const& m_rOwner;
+	uint32_t* m_pData;
+	int m_wpl;
+	std::vector<uint8_t> const& m_rErase;
+};
+
+RunLengthLabeler::RunLengthLabeler(
+	BinaryImage const& image, Connectivity const conn)
+:	m_size(image.size()),
+	m_numComponents(0)
+{
+	if (image.isNull()) {
+		m_size = QSize(0, 0);
+		m_lineBegin.push_back(0);
+		return;
+	}
+
+	int const height = m_size.height();
+	int const max_threads = ParallelFor::maxThreads();
+	int const band_height = max_threads <= 1 ? height
+		: std::max(32, (height + max_threads * 4 - 1) / (max_threads * 4));
+	int const num_bands = (height + band_height - 1) / band_height;
+
+	std::vector<std::vector<Run> > band_runs(num_bands);
+	std::vector<int> line_sizes(height);
+	ParallelFor::run(
+		0, num_bands, 1,
+		BandExtractor(image, band_height, band_runs, line_sizes)
+	);
+
+	m_lineBegin.resize(height + 1);
+	m_lineBegin[0] = 0;
+	for (int y = 0; y < height; ++y) {
+		m_lineBegin[y + 1] = m_lineBegin[y] + line_sizes[y];
+	}
+
+	m_runs.reserve(m_lineBegin[height]);
+	for (int band = 0; band < num_bands; ++band) {
+		m_runs.insert(m_runs.end(), band_runs[band].begin(), band_runs[band].end());
+		std::vector<Run>().swap(band_runs[band]);
+	}
+
+	uint32_t const num_runs = m_runs.size();
+	m_labels.resize(num_runs);
+	for (uint32_t i = 0; i < num_runs; ++i) {
+		m_labels[i] = i;
+	}
+
+	int const diagonal = conn == CONN8 ? 1 : 0;
+	ParallelFor::run(0, num_bands, 1, BandMerger(*this, band_height, diagonal));
+	for (int band = 1; band < num_bands; ++band) {
+		int const y = band * band_height;
+		unionLines(y - 1, y, diagonal);
+	}
+
+	// The root of each set is its first run, and every other run points
+	// to an earlier one, which at this point already holds its label.
+	for (uint32_t i = 0; i < num_runs; ++i) {
+		if (m_labels[i] == i) {
+			m_labels[i] = ++m_numComponents;
+		} else {
+			m_labels[i] = m_labels[m_labels[i]];
+		}
+	}
+}
+
+std::vector<ConnComp>
+RunLengthLabeler::components() const
+{
+	std::vector<ComponentStats> stats(m_numComponents);
+
+	int const height = m_size.height();
+	for (int y = 0; y < height; ++y) {
+		int const run_end = m_lineBegin[y + 1];
+		for (int run = m_lineBegin[y]; run < run_end; ++run) {
+			Run const& r = m_runs[run];
+			ComponentStats& s = stats[m_labels[run] - 1];
+			if (s.pixCount == 0) {
+				s.left = r.xBegin;
+				s.right = r.xEnd - 1;
+				s.top = y;
+				s.seedX = r.xBegin;
+			} else {
+				s.left = std::min(s.left, r.xBegin);
+				s.right = std::max(s.right, r.xEnd - 1);
+			}
+			s.bottom = y;
+			s.pixCount += r.xEnd - r.xBegin;
+		}
+	}
+
+	std::vector<ConnComp> comps;
+	comps.reserve(m_numComponents);
+	for (uint32_t i = 0; i < m_numComponents; ++i) {
+		ComponentStats const& s = stats[i];
+		comps.push_back(
+			ConnComp(
+				QPoint(s.seedX, s.top),
+				QRect(QPoint(s.left, s.top), QPoint(s.right, s.bottom)),
+				s.pixCount
+			)
+		);
+	}
+
+	return comps;
+}
+
+void
+RunLengthLabeler::writeLabels(uint32_t* const data, int const stride) const
+{
+	int const height = m_size.height();
+	if (height == 0) {
+		return;
+	}
+
+	ParallelFor::run(
+		0, height, (1 << 16) / (m_size.width() + 1) + 1,
+		LabelWriter(*this, data, stride, 0)
+	);
+}
+
+void
+RunLengthLabeler::writeLabels(uint32_t* const data, int const stride,
+	std::vector<uint32_t> const& remapping) const
+{
+	int const height = m_size.height();
+	if (height == 0) {
+		return;
+	}
+
+	assert(remapping.size() == m_numComponents + 1);
+
+	ParallelFor::run(
+		0, height, (1 << 16) / (m_size.width() + 1) + 1,
+		LabelWriter(*this, data, stride, &remapping[0])
+	);
+}
+
+void
+RunLengthLabeler::eraseComponents(
+	BinaryImage& image, std::vector<uint8_t> const& erase) const
+{
+	int const height = m_size.height();
+	if (height == 0) {
+		return;
+	}
+
+	assert(image.size() == m_size);
+	assert(erase.size() == m_numComponents + 1);
+
+	ParallelFor::run(
+		0, height, (1 << 16) / (m_size.width() + 1) + 1,
+		ComponentEraser(*this, image, erase)
+	);
+}
+
+/**
+ * Appends runs of black pixels in a line to \p runs.
+ * Words that don't contain a transition we are looking for
+ * are skipped in one go.
+ */
+void
+RunLengthLabeler::extractRuns(
+	uint32_t const* const line, int const width, std::vector<Run>& runs)
+{
+	int const num_words = (width + 31) >> 5;
+
+	int x = 0;
+	int word_idx = 0;
+
+	// Black pixels are 1 bits.  When looking for the end of a run,
+	// we invert the word, so we always look for the first 1 bit.
+	uint32_t invert = 0;
+	uint32_t word = line[0];
+
+	for (;;) {
+		word = (word ^ invert) & (~uint32_t(0) >> (x & 31));
+		while (word == 0) {
+			if (++word_idx == num_words) {
+				if (invert) {
+					runs.push_back(Run(x, width));
+				}
+				return;
+			}
+			word = line[word_idx] ^ invert;
+		}
+
+		int const transition = std::min(
+			width, (word_idx << 5) + countMostSignificantZeroes(word)
+		);
+		if (invert) {
+			runs.push_back(Run(x, transition));
+		}
+		x = transition;
+		if (x == width) {
+			return;
+		}
+
+		invert = ~invert;
+		word = line[word_idx];
+	}
+}
+
+/**
+ * Unites the runs of two adjacent lines that touch each other.
+ * \p diagonal is 1 for 8-connectivity and 0 for 4-connectivity.
+ */
+void
+RunLengthLabeler::unionLines(int const prev_line, int const line, int const diagonal)
+{
+	int const prev_end = m_lineBegin[prev_line + 1];
+	int const cur_end = m_lineBegin[line + 1];
+
+	int prev = m_lineBegin[prev_line];
+	for (int cur = m_lineBegin[line]; cur < cur_end; ++cur) {
+		int const lo = m_runs[cur].xBegin - diagonal;
+		int const hi = m_runs[cur].xEnd + diagonal;
+
+		// Runs ending before this one can't touch the following ones either.
+		while (prev < prev_end && m_runs[prev].xEnd <= lo) {
+			++prev;
+		}
+
+		for (int p = prev; p < prev_end && m_runs[p].xBegin < hi; ++p) {
+			unite(p, cur);
+		}
+	}
+}
+
+uint32_t
+RunLengthLabeler::findRoot(uint32_t run)
+{
+	// Path halving.
+	while (m_labels[run] != run) {
+		m_labels[run] = m_labels[m_labels[run]];
+		run = m_labels[run];
+	}
+	return run;
+}
+
+void
+RunLengthLabeler::unite(uint32_t const run1, uint32_t const run2)
+{
+	uint32_t const root1 = findRoot(run1);
+	uint32_t const root2 = findRoot(run2);
+
+	// The smaller index always becomes the root, so that roots
+	// are the first runs of their components.
+	if (root1 < root2) {
+		m_labels[root2] = root1;
+	} else if (root2 < root1) {
+		m_labels[root1] = root2;
+	}
+}
+
+} // namespace imageproc
@@ -0,0 +1,138 @@
+/*
+	Scan Tailor - Interactive post-processing tool for scanned pages.
+	Copyright (C)  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef IMAGEPROC_RUN_LENGTH_LABELER_H_
+#define IMAGEPROC_RUN_LENGTH_LABELER_H_
+
+#include "Connectivity.h"
+#include "ConnComp.h"
+#include <QSize>
+#include <vector>
+#include <stdint.h>
+
+namespace imageproc
+{
+
+class BinaryImage;
+
+/**
+ * \brief Labels connected components of black pixels by merging
+ *        horizontal runs rather than individual pixels.
+ *
+ * Runs are extracted from packed words of a BinaryImage, skipping whole
+ * words of white or black pixels at once.  Runs of adjacent lines are
+ * then merged with a union-find structure.  Horizontal bands of the image
+ * are processed concurrently and merged across band boundaries afterwards.
+ *
+ * Labels go from 1 to numComponents() and are assigned in the order
+ * the components first appear when scanning the image line by line,
+ * which is the same labeling ConnectivityMap produces.
+ *
+ * Memory usage is proportional to the number of runs, so statistics
+ * of components can be obtained without a per-pixel label map.
+ */
+class RunLengthLabeler
+{
+public:
+	RunLengthLabeler(BinaryImage const& image, Connectivity conn);
+
+	QSize size() const { return m_size; }
+
+	uint32_t numComponents() const { return m_numComponents; }
+
+	/**
+	 * \brief Returns pixel counts and bounding boxes of components.
+	 *
+	 * Element i describes the component labeled i + 1.  The seed of each
+	 * component is its first pixel in line by line order.
+	 */
+	std::vector<ConnComp> components() const;
+
+	/**
+	 * \brief Writes labels of black pixels into a map.
+	 *
+	 * \param data The top-left corner of a map of size() pixels.
+	 * \param stride The distance between lines of the map, in units.
+	 *
+	 * Positions of white pixels are left untouched.
+	 */
+	void writeLabels(uint32_t* data, int stride) const;
+
+	/**
+	 * \brief Same as above, but writes remapping[label] instead of label.
+	 *
+	 * \p remapping must have numComponents() + 1 elements.
+	 */
+	void writeLabels(uint32_t* data, int stride,
+		std::vector<uint32_t> const& remapping) const;
+
+	/**
+	 * \brief Turns components white in the image that was labeled.
+	 *
+	 * \param image The image passed to the constructor, or its copy.
+	 * \param erase Indexed by label, must have numComponents() + 1
+	 *        elements.  Components with non-zero entries are erased.
+	 *
+	 * Only the runs of erased components are touched.
+	 */
+	void eraseComponents(
+		BinaryImage& image, std::vector<uint8_t> const& erase) const;
+private:
+	struct Run
+	{
+		int xBegin;
+		int xEnd; // exclusive
+
+		Run(int x_begin, int x_end) : xBegin(x_begin), xEnd(x_end) {}
+	};
+
+	class BandExtractor;
+	class BandMerger;
+	class LabelWriter;
+	class ComponentEraser;
+
+	static void extractRuns(
+		uint32_t const* line, int width, std::vector<Run>& runs);
+
+	void unionLines(int prev_line, int line, int diagonal);
+
+	uint32_t findRoot(uint32_t run);
+
+	void unite(uint32_t run1, uint32_t run2);
+
+	QSize m_size;
+
+	/**
+	 * Runs of line y are m_runs[m_lineBegin[y]] .. m_runs[m_lineBegin[y + 1] - 1].
+	 */
+	std::vector<int> m_lineBegin;
+
+	std::vector<Run> m_runs;
+
+	/**
+	 * During labeling, the index of a run that is connected to this one
+	 * and doesn't come after it.  After labeling, the label of the run.
+	 */
+	std::vector<uint32_t> m_labels;
+
+	uint32_t m_numComponents;
+};
+
+} // namespace imageproc
+
+#endif
@@ -25,6 +25,7 @@
 #include "Morphology.h"
 #include "SeedFill.h"
 #include "RasterOp.h"
+#include "ParallelFor.h"
 #include <algorithm>
 #include <string.h>
 #include <math.h>
@@ -37,6 +38,435 @@ namespace imageproc
 // It exists to make sure INF_DIST + 1 doesn't overflow.
 uint32_t const SEDM::INF_DIST = ~uint32_t(0) - 1;
 
+namespace
+{
+
+/**
+ * The column pass goes through blocks of columns this wide line by line,
+ * rather than through one column at a time.  That way memory is accessed
+ * sequentially, and the state of the columns in a block stays in cache.
+ */
+int const COLUMN_BLOCK = 512;
+
+int const MIN_ROWS_PER_CHUNK = 16;
+
+/**
+ * Values in maps built by SEDM::buildSaturated() don't exceed this one.
+ */
+uint32_t const SATURATED_DIST = 0xffff;
+
+inline uint32_t distSq(int const x1, int const x2, uint32_t const dy_sq)
+{
+	if (dy_sq == SEDM::INF_DIST) {
+		return SEDM::INF_DIST;
+	}
+	int const dx = x1 - x2;
+	uint32_t const dx_sq = dx * dx;
+	return dx_sq + dy_sq;
+}
+
+/**
+ * Sets the distances of image pixels to either zero or infinity.
+ */
+template<typename T>
+class DistanceInitializer
+{
+public:
+	DistanceInitializer(
+		BinaryImage const& image, SEDM::DistType dist_type,
+		T inf_dist, T* dist, int dist_stride)
+	:	m_rImage(image),
+		m_pDist(dist),
+		m_distStride(dist_stride)
+	{
+		m_initialDistance[0] = dist_type == SEDM::DIST_TO_WHITE ? 0 : inf_dist; // white
+		m_initialDistance[1] = dist_type == SEDM::DIST_TO_WHITE ? inf_dist : 0; // black
+	}
+
+	void operator()(int y_begin, int y_end) const;
+private:
+	BinaryImage const& m_rImage;
+	T* m_pDist;
+	int m_distStride;
+	T m_initialDistance[2];
+};
+
+template<typename T>
+void
+DistanceInitializer<T>::operator()(int const y_begin, int const y_end) const
+{
+	int const width = m_rImage.width();
+	int const img_stride = m_rImage.wordsPerLine();
+	uint32_t const* img_line = m_rImage.data() + y_begin * img_stride;
+	T* dist_line = m_pDist + y_begin * m_distStride;
+	for (int y = y_begin; y < y_end; ++y) {
+		for (int x = 0; x < width; ++x) {
+			uint32_t word = img_line[x >> 5];
+			word >>= 31 - (x & 31);
+			dist_line[x] = m_initialDistance[word & 1];
+		}
+		dist_line += m_distStride;
+		img_line += img_stride;
+	}
+}
+
+/**
+ * \brief Initializes a padded distance map.
+ *
+ * \param padded_data The map, including a padding of one cell,
+ *        with every cell set to \p inf_dist.
+ */
+template<typename T>
+void initDistances(
+	BinaryImage const& image, SEDM::DistType const dist_type,
+	SEDM::Borders const borders, T const inf_dist,
+	T* const padded_data, int const stride)
+{
+	int const padded_height = image.height() + 2;
+
+	if (borders & SEDM::DIST_TO_TOP_BORDER) {
+		std::fill(padded_data, padded_data + stride, T(0));
+	}
+	if (borders & SEDM::DIST_TO_BOTTOM_BORDER) {
+		T* const line = padded_data + (padded_height - 1) * stride;
+		std::fill(line, line + stride, T(0));
+	}
+	if (borders & (SEDM::DIST_TO_LEFT_BORDER|SEDM::DIST_TO_RIGHT_BORDER)) {
+		int const last = stride - 1;
+		T* line = padded_data;
+		for (int todo = padded_height; todo > 0; --todo) {
+			if (borders & SEDM::DIST_TO_LEFT_BORDER) {
+				line[0] = 0;
+			}
+			if (borders & SEDM::DIST_TO_RIGHT_BORDER) {
+				line[last] = 0;
+			}
+			line += stride;
+		}
+	}
+
+	ParallelFor::run(
+		0, image.height(), MIN_ROWS_PER_CHUNK,
+		DistanceInitializer<T>(
+			image, dist_type, inf_dist, padded_data + stride + 1, stride
+		)
+	);
+}
+
+/**
+ * Propagates squared distances from \p src to the adjacent line \p dst.
+ * \p b holds 2d + 1 for every column, where d is the distance at \p src.
+ */
+inline void relaxLine(
+	uint32_t const* src, uint32_t* dst, uint32_t* b, int const width)
+{
+	// Written without branches, so that it may be vectorized.
+	for (int x = 0; x < width; ++x) {
+		uint32_t const sqd = src[x] + b[x];
+		uint32_t const old_sqd = dst[x];
+		dst[x] = old_sqd > sqd ? sqd : old_sqd;
+		b[x] = old_sqd > sqd ? b[x] + 2 : 1;
+	}
+}
+
+/**
+ * Same as above, but also propagates labels along with distances.
+ */
+inline void relaxLine(
+	uint32_t const* src, uint32_t* dst,
+	uint32_t const* src_labels, uint32_t* dst_labels,
+	uint32_t* b, int const width)
+{
+	for (int x = 0; x < width; ++x) {
+		uint32_t const sqd = src[x] + b[x];
+		if (sqd < dst[x]) {
+			dst[x] = sqd;
+			dst_labels[x] = src_labels[x];
+			b[x] += 2;
+		} else {
+			b[x] = 1;
+		}
+	}
+}
+
+/**
+ * The vertical pass of the distance transform.  Propagates squared
+ * distances down and then up every column, optionally along with labels.
+ */
+class ColumnPass
+{
+public:
+	/**
+	 * \param sqd The padded distance map.
+	 * \param labels The padded label map with the same stride, or null.
+	 * \param stride The stride of both maps.
+	 * \param height The height of the maps, including padding.
+	 */
+	ColumnPass(uint32_t* sqd, uint32_t* labels, int stride, int height)
+	:	m_pSqd(sqd),
+		m_pLabels(labels),
+		m_stride(stride),
+		m_height(height) {}
+
+	void operator()(int x_begin, int x_end) const;
+private:
+	uint32_t* m_pSqd;
+	uint32_t* m_pLabels;
+	int m_stride;
+	int m_height;
+};
+
+void
+ColumnPass::operator()(int const x_begin, int const x_end) const
+{
+	int const stride = m_stride;
+
+	// (d + 1)^2 = d^2 + 2d + 1
+	std::vector<uint32_t> b(COLUMN_BLOCK); // 2d + 1 in the above formula.
+
+	for (int x0 = x_begin; x0 < x_end; x0 += COLUMN_BLOCK) {
+		int const width = std::min(COLUMN_BLOCK, x_end - x0);
+		uint32_t* line = m_pSqd + x0;
+		uint32_t* label_line = m_pLabels ? m_pLabels + x0 : 0;
+
+		std::fill(b.begin(), b.begin() + width, 1);
+		for (int todo = m_height - 1; todo > 0; --todo) {
+			if (label_line) {
+				relaxLine(
+					line, line + stride, label_line,
+					label_line + stride, &b[0], width
+				);
+				label_line += stride;
+			} else {
+				relaxLine(line, line + stride, &b[0], width);
+			}
+			line += stride;
+		}
+
+		std::fill(b.begin(), b.begin() + width, 1);
+		for (int todo = m_height - 1; todo > 0; --todo) {
+			if (label_line) {
+				relaxLine(
+					line, line - stride, label_line,
+					label_line - stride, &b[0], width
+				);
+				label_line -= stride;
+			} else {
+				relaxLine(line, line - stride, &b[0], width);
+			}
+			line -= stride;
+		}
+	}
+}
+
+/**
+ * The vertical pass for saturated maps.  These store plain vertical
+ * distances at this stage, which fit 16 bits for any sane image height.
+ * Those that don't are treated as infinite, which doesn't change
+ * the result, as their squares would saturate anyway.
+ */
+class SaturatedColumnPass
+{
+public:
+	SaturatedColumnPass(uint16_t* dist, int stride, int height)
+	:	m_pDist(dist),
+		m_stride(stride),
+		m_height(height) {}
+
+	void operator()(int x_begin, int x_end) const;
+private:
+	static void relaxLine(uint16_t const* src, uint16_t* dst, int x_begin, int x_end);
+
+	uint16_t* m_pDist;
+	int m_stride;
+	int m_height;
+};
+
+void
+SaturatedColumnPass::operator()(int const x_begin, int const x_end) const
+{
+	uint16_t* line = m_pDist;
+	for (int todo = m_height - 1; todo > 0; --todo) {
+		relaxLine(line, line + m_stride, x_begin, x_end);
+		line += m_stride;
+	}
+	for (int todo = m_height - 1; todo > 0; --todo) {
+		relaxLine(line, line - m_stride, x_begin, x_end);
+		line -= m_stride;
+	}
+}
+
+inline void
+SaturatedColumnPass::relaxLine(
+	uint16_t const* src, uint16_t* dst, int const x_begin, int const x_end)
+{
+	for (int x = x_begin; x < x_end; ++x) {
+		int const dist = std::min<int>(src[x] + 1, SATURATED_DIST);
+		dst[x] = std::min<int>(dst[x], dist);
+	}
+}
+
+/**
+ * The horizontal pass of the distance transform for a single line,
+ * done according to Meijster et al.  The buffers are reused between lines.
+ */
+class LineTransform
+{
+public:
+	LineTransform(int width, bool with_labels);
+
+	/**
+	 * \param line Squared vertical distances, to be replaced
+	 *        by squared euclidean ones.
+	 * \param labels Labels to propagate along with distances, or null.
+	 */
+	void operator()(uint32_t* line, uint32_t* labels);
+private:
+	std::vector<int> m_s;
+	std::vector<int> m_t;
+	std::vector<uint32_t> m_rowCopy;
+	std::vector<uint32_t> m_labelsCopy;
+	int m_width;
+};
+
+LineTransform::LineTransform(int const width, bool const with_labels)
+:	m_s(width, 0),
+	m_t(width, 0),
+	m_rowCopy(width, 0),
+	m_labelsCopy(with_labels ? width : 0, 0),
+	m_width(width)
+{
+}
+
+void
+LineTransform::operator()(uint32_t* const line, uint32_t* const labels)
+{
+	int const width = m_width;
+	int* const s = &m_s[0];
+	int* const t = &m_t[0];
+
+	int q = 0;
+	s[0] = 0;
+	t[0] = 0;
+	for (int x = 1; x < width; ++x) {
+		while (q >= 0 && distSq(t[q], s[q], line[s[q]])
+				> distSq(t[q], x, line[x])) {
+			--q;
+		}
+		
+		if (q < 0) {
+			q = 0;
+			s[0] = x;
+		} else {
+			int const x2 = s[q];
+			if (line[x] != SEDM::INF_DIST && line[x2] != SEDM::INF_DIST) {
+				int w = (x * x + line[x]) - (x2 * x2 + line[x2]);
+				w /= (x - x2) << 1;
+				++w;
+				if ((unsigned)w < (unsigned)width) {
+					++q;
+					s[q] = x;
+					t[q] = w;
+				}
+			}
+		}
+	}
+	
+	memcpy(&m_rowCopy[0], line, width * sizeof(*line));
+	uint32_t const* const row_copy = &m_rowCopy[0];
+	
+	if (labels) {
+		memcpy(&m_labelsCopy[0], labels, width * sizeof(*labels));
+		uint32_t const* const labels_copy = &m_labelsCopy[0];
+		for (int x = width - 1; x >= 0; --x) {
+			int const x2 = s[q];
+			line[x] = distSq(x, x2, row_copy[x2]);
+			labels[x] = labels_copy[x2];
+			if (x == t[q]) {
+				--q;
+			}
+		}
+	} else {
+		for (int x = width - 1; x >= 0; --x) {
+			int const x2 = s[q];
+			line[x] = distSq(x, x2, row_copy[x2]);
+			if (x == t[q]) {
+				--q;
+			}
+		}
+	}
+}
+
+/**
+ * The horizontal pass over a range of lines of a padded distance map,
+ * optionally propagating labels along with distances.
+ */
+class RowPass
+{
+public:
+	RowPass(uint32_t* sqd, uint32_t* labels, int stride)
+	:	m_pSqd(sqd),
+		m_pLabels(labels),
+		m_stride(stride) {}
+
+	void operator()(int y_begin, int y_end) const;
+private:
+	uint32_t* m_pSqd;
+	uint32_t* m_pLabels;
+	int m_stride;
+};
+
+void
+RowPass::operator()(int const y_begin, int const y_end) const
+{
+	LineTransform transform(m_stride, m_pLabels != 0);
+	for (int y = y_begin; y < y_end; ++y) {
+		int const offset = y * m_stride;
+		transform(m_pSqd + offset, m_pLabels ? m_pLabels + offset : 0);
+	}
+}
+
+/**
+ * The horizontal pass for saturated maps.  Turns vertical distances
+ * into saturated squared euclidean ones.
+ */
+class SaturatedRowPass
+{
+public:
+	SaturatedRowPass(uint16_t* dist, int stride)
+	:	m_pDist(dist),
+		m_stride(stride) {}
+
+	void operator()(int y_begin, int y_end) const;
+private:
+	uint16_t* m_pDist;
+	int m_stride;
+};
+
+void
+SaturatedRowPass::operator()(int const y_begin, int const y_end) const
+{
+	int const width = m_stride;
+	LineTransform transform(width, false);
+	std::vector<uint32_t> sqd(width);
+	
+	for (int y = y_begin; y < y_end; ++y) {
+		uint16_t* const line = m_pDist + y * m_stride;
+		for (int x = 0; x < width; ++x) {
+			uint32_t const dist = line[x];
+			sqd[x] = dist == SATURATED_DIST ? SEDM::INF_DIST : dist * dist;
+		}
+		
+		transform(&sqd[0], 0);
+		
+		for (int x = 0; x < width; ++x) {
+			line[x] = std::min(sqd[x], SATURATED_DIST);
+		}
+	}
+}
+
+} // anonymous namespace
+
 SEDM::SEDM()
 :	m_pData(0),
 	m_size(),
@@ -62,53 +492,16 @@ SEDM::SEDM(
 	m_stride = width + 2;
 	m_pData = &m_data[0] + m_stride + 1;
 	
-	if (borders & DIST_TO_TOP_BORDER) {
-		memset(&m_data[0], 0, m_stride * sizeof(m_data[0]));
-	}
-	if (borders & DIST_TO_BOTTOM_BORDER) {
-		memset(
-			&m_data[m_data.size() - m_stride],
-			0, m_stride * sizeof(m_data[0])
-		);
-	}
-	if (borders & (DIST_TO_LEFT_BORDER|DIST_TO_RIGHT_BORDER)) {
-		int const last = m_stride - 1;
-		uint32_t* line = &m_data[0];
-		for (int todo = height + 2; todo > 0; --todo) {
-			if (borders & DIST_TO_LEFT_BORDER) {
-				line[0] = 0;
-			}
-			if (borders & DIST_TO_RIGHT_BORDER) {
-				line[last] = 0;
-			}
-			line += m_stride;
-		}
-	}
-	
-	uint32_t initial_distance[2];
-	if (dist_type == DIST_TO_WHITE) {
-		initial_distance[0] = 0; // white
-		initial_distance[1] = INF_DIST; // black
-	} else {
-		initial_distance[0] = INF_DIST; // white
-		initial_distance[1] = 0; // black
-	}
+	initDistances(image, dist_type, borders, INF_DIST, &m_data[0], m_stride);
 	
-	uint32_t* p_dist = m_pData;
-	uint32_t const* img_line = image.data();
-	int const img_stride = image.wordsPerLine();
-	for (int y = 0; y < height; ++y) {
-		for (int x = 0; x < width; ++x, ++p_dist) {
-			uint32_t word = img_line[x >> 5];
-			word >>= 31 - (x & 31);
-			*p_dist = initial_distance[word & 1];
-		}
-		p_dist += 2;
-		img_line += img_stride;
-	}
-	
-	processColumns();
-	processRows();
+	ParallelFor::run(
+		0, m_stride, COLUMN_BLOCK,
+		ColumnPass(&m_data[0], 0, m_stride, height + 2)
+	);
+	ParallelFor::run(
+		0, height + 2, MIN_ROWS_PER_CHUNK,
+		RowPass(&m_data[0], 0, m_stride)
+	);
 }
 
 SEDM::SEDM(ConnectivityMap& cmap)
@@ -139,8 +532,47 @@ SEDM::SEDM(ConnectivityMap& cmap)
 		p_label += 2;
 	}
 	
-	processColumns(cmap);
-	processRows(cmap);
+	ParallelFor::run(
+		0, m_stride, COLUMN_BLOCK,
+		ColumnPass(&m_data[0], cmap.paddedData(), m_stride, height + 2)
+	);
+	ParallelFor::run(
+		0, height + 2, MIN_ROWS_PER_CHUNK,
+		RowPass(&m_data[0], cmap.paddedData(), m_stride)
+	);
+}
+
+Grid<uint16_t>
+SEDM::buildSaturated(
+	BinaryImage const& image, DistType const dist_type,
+	Borders const borders)
+{
+	// A single named return value on every path lets the compiler
+	// construct it in place rather than copy it on return.
+	Grid<uint16_t> dist;
+	if (image.isNull()) {
+		return dist;
+	}
+	
+	int const height = image.height();
+	
+	Grid<uint16_t>(image.width(), height, 1).swap(dist);
+	dist.initPadding(SATURATED_DIST);
+	initDistances(
+		image, dist_type, borders, uint16_t(SATURATED_DIST),
+		dist.paddedData(), dist.stride()
+	);
+	
+	ParallelFor::run(
+		0, dist.stride(), COLUMN_BLOCK,
+		SaturatedColumnPass(dist.paddedData(), dist.stride(), height + 2)
+	);
+	ParallelFor::run(
+		0, height + 2, MIN_ROWS_PER_CHUNK,
+		SaturatedRowPass(dist.paddedData(), dist.stride())
+	);
+	
+	return dist;
 }
 
 SEDM::SEDM(SEDM const& other)
@@ -219,200 +651,6 @@ SEDM::findPeaksDestructive()
 	return peak_candidates;
 }
 
-inline uint32_t
-SEDM::distSq(
-	int const x1, int const x2, uint32_t const dy_sq)
-{
-	if (dy_sq == INF_DIST) {
-		return INF_DIST;
-	}
-	int const dx = x1 - x2;
-	uint32_t const dx_sq = dx * dx;
-	return dx_sq + dy_sq;
-}
-
-void
-SEDM::processColumns()
-{
-	int const width = m_size.width() + 2;
-	int const height = m_size.height() + 2;
-	
-	uint32_t* p_sqd = &m_data[0];
-	for (int x = 0; x < width; ++x, ++p_sqd) {
-		// (d + 1)^2 = d^2 + 2d + 1
-		uint32_t b = 1; // 2d + 1 in the above formula.
-		for (int todo = height - 1; todo > 0; --todo) {
-			uint32_t const sqd = *p_sqd + b;
-			p_sqd += width;
-			if (*p_sqd > sqd) {
-				*p_sqd = sqd;
-				b += 2;
-			} else {
-				b = 1;
-			}
-		}
-		
-		b = 1;
-		for (int todo = height - 1; todo > 0; --todo) {
-			uint32_t const sqd = *p_sqd + b;
-			p_sqd -= width;
-			if (*p_sqd > sqd) {
-				*p_sqd = sqd;
-				b += 2;
-			} else {
-				b = 1;
-			}
-		}
-	}
-}
-
-void
-SEDM::processColumns(ConnectivityMap& cmap)
-{
-	int const width = m_size.width() + 2;
-	int const height = m_size.height() + 2;
-	
-	uint32_t* p_sqd = &m_data[0];
-	uint32_t* p_label = cmap.paddedData();
-	for (int x = 0; x < width; ++x, ++p_sqd, ++p_label) {
-		// (d + 1)^2 = d^2 + 2d + 1
-		uint32_t b = 1; // 2d + 1 in the above formula.
-		for (int todo = height - 1; todo > 0; --todo) {
-			uint32_t const sqd = *p_sqd + b;
-			p_sqd += width;
-			p_label += width;
-			if (sqd < *p_sqd) {
-				*p_sqd = sqd;
-				*p_label = p_label[-width];
-				b += 2;
-			} else {
-				b = 1;
-			}
-		}
-		
-		b = 1;
-		for (int todo = height - 1; todo > 0; --todo) {
-			uint32_t const sqd = *p_sqd + b;
-			p_sqd -= width;
-			p_label -= width;
-			if (sqd < *p_sqd) {
-				*p_sqd = sqd;
-				*p_label = p_label[width];
-				b += 2;
-			} else {
-				b = 1;
-			}
-		}
-	}
-}
-
-void
-SEDM::processRows()
-{
-	int const width = m_size.width() + 2;
-	int const height = m_size.height() + 2;
-	
-	std::vector<int> s(width, 0);
-	std::vector<int> t(width, 0);
-	std::vector<uint32_t> row_copy(width, 0);
-	
-	uint32_t* line = &m_data[0];
-	for (int y = 0; y < height; ++y, line += width) {
-		int q = 0;
-		s[0] = 0;
-		t[0] = 0;
-		for (int x = 1; x < width; ++x) {
-			while (q >= 0 && distSq(t[q], s[q], line[s[q]])
-					> distSq(t[q], x, line[x])) {
-				--q;
-			}
-			
-			if (q < 0) {
-				q = 0;
-				s[0] = x;
-			} else {
-				int const x2 = s[q];
-				if (line[x] != INF_DIST && line[x2] != INF_DIST) {
-					int w = (x * x + line[x]) - (x2 * x2 + line[x2]);
-					w /= (x - x2) << 1;
-					++w;
-					if ((unsigned)w < (unsigned)width) {
-						++q;
-						s[q] = x;
-						t[q] = w;
-					}
-				}
-			}
-		}
-		
-		memcpy(&row_copy[0], line, width * sizeof(*line));
-		
-		for (int x = width - 1; x >= 0; --x) {
-			int const x2 = s[q];
-			line[x] = distSq(x, x2, row_copy[x2]);
-			if (x == t[q]) {
-				--q;
-			}
-		}
-	}
-}
-
-void
-SEDM::processRows(ConnectivityMap& cmap)
-{
-	int const width = m_size.width() + 2;
-	int const height = m_size.height() + 2;
-	
-	std::vector<int> s(width, 0);
-	std::vector<int> t(width, 0);
-	std::vector<uint32_t> row_copy(width, 0);
-	std::vector<uint32_t> cmap_row_copy(width, 0);
-	
-	uint32_t* line = &m_data[0];
-	uint32_t* cmap_line = cmap.paddedData();
-	for (int y = 0; y < height; ++y, line += width, cmap_line += width) {
-		int q = 0;
-		s[0] = 0;
-		t[0] = 0;
-		for (int x = 1; x < width; ++x) {
-			while (q >= 0 && distSq(t[q], s[q], line[s[q]])
-					> distSq(t[q], x, line[x])) {
-				--q;
-			}
-			
-			if (q < 0) {
-				q = 0;
-				s[0] = x;
-			} else {
-				int const x2 = s[q];
-				if (line[x] != INF_DIST && line[x2] != INF_DIST) {
-					int w = (x * x + line[x]) - (x2 * x2 + line[x2]);
-					w /= (x - x2) << 1;
-					++w;
-					if ((unsigned)w < (unsigned)width) {
-						++q;
-						s[q] = x;
-						t[q] = w;
-					}
-				}
-			}
-		}
-		
-		memcpy(&row_copy[0], line, width * sizeof(*line));
-		memcpy(&cmap_row_copy[0], cmap_line, width * sizeof(*cmap_line));
-		
-		for (int x = width - 1; x >= 0; --x) {
-			int const x2 = s[q];
-			line[x] = distSq(x, x2, row_copy[x2]);
-			cmap_line[x] = cmap_row_copy[x2];
-			if (x == t[q]) {
-				--q;
-			}
-		}
-	}
-}
-
-
 /*====================== Peak finding stuff goes below ====================*/
 
 BinaryImage
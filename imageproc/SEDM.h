@@ -20,6 +20,7 @@
 #define IMAGEPROC_SEDM_H_
 
 #include "foundation/FlagOps.h"
+#include "Grid.h"
 #include <vector>
 #include <QSize>
 #include <stdint.h>
@@ -124,6 +125,22 @@ public:
 	 */
 	explicit SEDM(ConnectivityMap& cmap);
 	
+	/**
+	 * \brief Build a distance map of 16-bit values saturated at 65535.
+	 *
+	 * For callers only interested in distances below 256 pixels.
+	 * Takes half the memory of a regular distance map, and never
+	 * allocates a full size 32-bit one.
+	 *
+	 * The values are the same as SEDM(image, dist_type, borders)
+	 * would have, except that the ones above 65535, including INF_DIST,
+	 * become 65535.  Like a regular distance map, the grid has
+	 * a padding of one cell on each side.
+	 */
+	static Grid<uint16_t> buildSaturated(
+		BinaryImage const& image, DistType dist_type = DIST_TO_WHITE,
+		Borders borders = DIST_TO_ALL_BORDERS);
+	
 	SEDM(SEDM const& other);
 	
 	SEDM& operator=(SEDM const& other);
@@ -172,16 +189,6 @@ public:
 	 */
 	BinaryImage findPeaksDestructive();
 private:
-	static uint32_t distSq(int x1, int x2, uint32_t dy_sq);
-	
-	void processColumns();
-	
-	void processColumns(ConnectivityMap& cmap);
-	
-	void processRows();
-	
-	void processRows(ConnectivityMap& cmap);
-	
 	BinaryImage findPeakCandidatesNonPadded() const;
 	
 	BinaryImage buildEqualMapNonPadded(uint32_t const* src1, uint32_t const* src2) const;
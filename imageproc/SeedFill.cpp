@@ -19,6 +19,7 @@
 #include "SeedFill.h"
 #include "SeedFillGeneric.h"
 #include "GrayImage.h"
+#include "ParallelFor.h"
 #include <QSize>
 #include <QImage>
 #include <QDebug>
@@ -48,19 +49,20 @@ inline uint32_t fillWordHorizontally(uint32_t word, uint32_t const mask)
 	return word;
 }
 
-void seedFill4Iteration(BinaryImage& seed, BinaryImage const& mask)
+/**
+ * \return true if any pixel in \p seed was modified.
+ */
+bool seedFill4Iteration(
+	uint32_t* const seed, int const seed_wpl,
+	uint32_t const* const mask, int const mask_wpl, int const w, int const h)
 {
-	int const w = seed.width();
-	int const h = seed.height();
-	
-	int const seed_wpl = seed.wordsPerLine();
-	int const mask_wpl = mask.wordsPerLine();
 	int const last_word_idx = (w - 1) >> 5;
 	uint32_t const last_word_mask = ~uint32_t(0) << (((last_word_idx + 1) << 5) - w);
 	
-	uint32_t* seed_line = seed.data();
-	uint32_t const* mask_line = mask.data();
+	uint32_t* seed_line = seed;
+	uint32_t const* mask_line = mask;
 	uint32_t const* prev_line = seed_line;
+	uint32_t modified = 0;
 	
 	// Top to bottom.
 	for (int y = 0; y < h; ++y) {
@@ -76,6 +78,7 @@ void seedFill4Iteration(BinaryImage& seed, BinaryImage const& mask)
 			word |= seed_line[i] | prev_line[i];
 			word &= mask;
 			word = fillWordHorizontally(word, mask);
+			modified |= (seed_line[i] ^ word) & (i == last_word_idx ? last_word_mask : ~uint32_t(0));
 			seed_line[i] = word;
 			prev_word = word;
 		}
@@ -108,6 +111,7 @@ void seedFill4Iteration(BinaryImage& seed, BinaryImage const& mask)
 			word |= seed_line[i] | prev_line[i];
 			word &= mask;
 			word = fillWordHorizontally(word, mask);
+			modified |= (seed_line[i] ^ word) & (i == last_word_idx ? last_word_mask : ~uint32_t(0));
 			seed_line[i] = word;
 			prev_word = word;
 		}
@@ -123,21 +127,24 @@ void seedFill4Iteration(BinaryImage& seed, BinaryImage const& mask)
 		seed_line -= seed_wpl;
 		mask_line -= mask_wpl;
 	}
+	
+	return modified != 0;
 }
 
-void seedFill8Iteration(BinaryImage& seed, BinaryImage const& mask)
+/**
+ * \return true if any pixel in \p seed was modified.
+ */
+bool seedFill8Iteration(
+	uint32_t* const seed, int const seed_wpl,
+	uint32_t const* const mask, int const mask_wpl, int const w, int const h)
 {
-	int const w = seed.width();
-	int const h = seed.height();
-	
-	int const seed_wpl = seed.wordsPerLine();
-	int const mask_wpl = mask.wordsPerLine();
 	int const last_word_idx = (w - 1) >> 5;
 	uint32_t const last_word_mask = ~uint32_t(0) << (((last_word_idx + 1) << 5) - w);
 	
-	uint32_t* seed_line = seed.data();
-	uint32_t const* mask_line = mask.data();
+	uint32_t* seed_line = seed;
+	uint32_t const* mask_line = mask;
 	uint32_t const* prev_line = seed_line;
+	uint32_t modified = 0;
 	
 	// Note: we start with prev_line == seed_line, but in this case
 	// prev_line[i + 1] won't be clipped by its mask when we use it to
@@ -145,7 +152,9 @@ void seedFill8Iteration(BinaryImage& seed, BinaryImage const& mask)
 	// there, so clipping we do on the anti-raster pass won't help.
 	// That's why we clip the first line here.
 	for (int i = 0; i <= last_word_idx; ++i) {
-		seed_line[i] &= mask_line[i];
+		uint32_t const word = seed_line[i] & mask_line[i];
+		modified |= (seed_line[i] ^ word) & (i == last_word_idx ? last_word_mask : ~uint32_t(0));
+		seed_line[i] = word;
 	}
 	
 	// Top to bottom.
@@ -156,18 +165,22 @@ void seedFill8Iteration(BinaryImage& seed, BinaryImage const& mask)
 		seed_line[last_word_idx] &= last_word_mask;
 		
 		// Left to right (except the last word).
+		uint32_t prev_above = 0;
 		int i = 0;
 		for (; i < last_word_idx; ++i) {
 			uint32_t const mask = mask_line[i];
-			uint32_t word = prev_line[i];
+			uint32_t const above = prev_line[i];
+			uint32_t word = above;
 			word |= (word << 1) | (word >> 1);
 			word |= seed_line[i];
 			word |= prev_line[i + 1] >> 31;
-			word |= prev_word << 31;
+			word |= (prev_word | prev_above) << 31;
 			word &= mask;
 			word = fillWordHorizontally(word, mask);
+			modified |= seed_line[i] ^ word;
 			seed_line[i] = word;
 			prev_word = word;
+			prev_above = above;
 		}
 		
 		// Last word.
@@ -175,9 +188,10 @@ void seedFill8Iteration(BinaryImage& seed, BinaryImage const& mask)
 		uint32_t word = prev_line[i];
 		word |= (word << 1) | (word >> 1);
 		word |= seed_line[i];
-		word |= prev_word << 31;
+		word |= (prev_word | prev_above) << 31;
 		word &= mask;
 		word = fillWordHorizontally(word, mask);
+		modified |= (seed_line[i] ^ word) & last_word_mask;
 		seed_line[i] = word;
 		
 		prev_line = seed_line;
@@ -197,18 +211,22 @@ void seedFill8Iteration(BinaryImage& seed, BinaryImage const& mask)
 		seed_line[last_word_idx] &= last_word_mask;
 		
 		// Right to left (except the last word).
+		uint32_t prev_below = 0;
 		int i = last_word_idx;
 		for (; i > 0; --i) {
 			uint32_t const mask = mask_line[i];
-			uint32_t word = prev_line[i];
+			uint32_t const below = prev_line[i];
+			uint32_t word = below;
 			word |= (word << 1) | (word >> 1);
 			word |= seed_line[i];
 			word |= prev_line[i - 1] << 31;
-			word |= prev_word >> 31;
+			word |= (prev_word | prev_below) >> 31;
 			word &= mask;
 			word = fillWordHorizontally(word, mask);
+			modified |= (seed_line[i] ^ word) & (i == last_word_idx ? last_word_mask : ~uint32_t(0));
 			seed_line[i] = word;
 			prev_word = word;
+			prev_below = below;
 		}
 		
 		// Last word.
@@ -216,9 +234,10 @@ void seedFill8Iteration(BinaryImage& seed, BinaryImage const& mask)
 		uint32_t word = prev_line[i];
 		word |= (word << 1) | (word >> 1);
 		word |= seed_line[i];
-		word |= prev_word >> 31;
+		word |= (prev_word | prev_below) >> 31;
 		word &= mask;
 		word = fillWordHorizontally(word, mask);
+		modified |= (seed_line[i] ^ word) & (i == last_word_idx ? last_word_mask : ~uint32_t(0));
 		seed_line[i] = word;
 		
 		// If we don't do this, prev_line[last_word_idx] on the next
@@ -232,8 +251,255 @@ void seedFill8Iteration(BinaryImage& seed, BinaryImage const& mask)
 		seed_line -= seed_wpl;
 		mask_line -= mask_wpl;
 	}
+	
+	return modified != 0;
+}
+
+/**
+ * \brief Horizontal bands of a binary image, to be seed-filled concurrently.
+ *
+ * Works like detail::seed_fill_generic::Bands, except bands are
+ * filled by raster iterations rather than by queue propagation.
+ */
+class SeedFillBands
+{
+public:
+	SeedFillBands(
+		BinaryImage& seed, BinaryImage const& mask,
+		Connectivity conn, int band_height);
+	
+	int numBands() const { return m_numBands; }
+	
+	/**
+	 * Iterates the band until it stops changing.
+	 */
+	void fillBand(int band) const;
+	
+	/**
+	 * Copies the first and the last lines of every band and
+	 * marks all bands as unchanged.
+	 *
+	 * \return true if any band was changed since the previous call.
+	 */
+	bool takeBoundaries();
+	
+	/**
+	 * Spreads black pixels into a band from the copies of its adjacent
+	 * lines, provided the bands they belong to were changed.
+	 */
+	void exchange(int band) const;
+	
+	/**
+	 * Iterates the whole image on the calling thread until it stops changing.
+	 */
+	void finish() const;
+private:
+	uint32_t* bandSeed(int band) const { return m_pSeed + band * m_bandHeight * m_seedWpl; }
+	
+	uint32_t const* bandMask(int band) const { return m_pMask + band * m_bandHeight * m_maskWpl; }
+	
+	int bandHeight(int band) const {
+		return std::min(m_bandHeight, m_height - band * m_bandHeight);
+	}
+	
+	bool iterate(uint32_t* seed, uint32_t const* mask, int height) const;
+	
+	bool spreadFromAdjacentLine(
+		uint32_t const* adjacent, uint32_t* seed_line, uint32_t const* mask_line) const;
+	
+	bool sameLine(uint32_t const* line, uint32_t const* copy) const;
+	
+	uint32_t* m_pSeed;
+	uint32_t const* m_pMask;
+	int m_seedWpl;
+	int m_maskWpl;
+	int m_width;
+	int m_height;
+	Connectivity m_conn;
+	int m_bandHeight;
+	int m_numBands;
+	int m_wpl; // The number of words with image data in a line.
+	uint32_t m_lastWordMask;
+	std::vector<uint32_t> m_firstLines;
+	std::vector<uint32_t> m_lastLines;
+	std::vector<uint8_t> m_wasChanged; // During the previous round.
+	mutable std::vector<uint8_t> m_changed; // During the current round.
+};
+
+SeedFillBands::SeedFillBands(
+	BinaryImage& seed, BinaryImage const& mask,
+	Connectivity const conn, int const band_height)
+:	m_pSeed(seed.data()),
+	m_pMask(mask.data()),
+	m_seedWpl(seed.wordsPerLine()),
+	m_maskWpl(mask.wordsPerLine()),
+	m_width(seed.width()),
+	m_height(seed.height()),
+	m_conn(conn),
+	m_bandHeight(band_height),
+	m_numBands((seed.height() + band_height - 1) / band_height),
+	m_wpl((seed.width() + 31) >> 5),
+	m_lastWordMask(~uint32_t(0) << ((m_wpl << 5) - seed.width())),
+	m_firstLines(m_numBands * m_wpl),
+	m_lastLines(m_numBands * m_wpl),
+	m_wasChanged(m_numBands, 0),
+	m_changed(m_numBands, 1)
+{
+}
+
+void
+SeedFillBands::fillBand(int const band) const
+{
+	while (iterate(bandSeed(band), bandMask(band), bandHeight(band))) {
+		// Continue until done.
+	}
+}
+
+bool
+SeedFillBands::takeBoundaries()
+{
+	bool any_changed = false;
+	
+	for (int band = 0; band < m_numBands; ++band) {
+		m_wasChanged[band] = m_changed[band];
+		m_changed[band] = 0;
+		if (!m_wasChanged[band]) {
+			continue;
+		}
+		
+		any_changed = true;
+		uint32_t const* const first_line = bandSeed(band);
+		uint32_t const* const last_line = first_line + (bandHeight(band) - 1) * m_seedWpl;
+		uint32_t* const first_copy = &m_firstLines[band * m_wpl];
+		uint32_t* const last_copy = &m_lastLines[band * m_wpl];
+		memcpy(first_copy, first_line, m_wpl * sizeof(*first_line));
+		memcpy(last_copy, last_line, m_wpl * sizeof(*last_line));
+		first_copy[m_wpl - 1] &= m_lastWordMask;
+		last_copy[m_wpl - 1] &= m_lastWordMask;
+	}
+	
+	return any_changed;
+}
+
+void
+SeedFillBands::exchange(int const band) const
+{
+	int const h = bandHeight(band);
+	uint32_t* const seed = bandSeed(band);
+	uint32_t const* const mask = bandMask(band);
+	uint32_t* const last_seed_line = seed + (h - 1) * m_seedWpl;
+	uint32_t const* const last_mask_line = mask + (h - 1) * m_maskWpl;
+	
+	bool modified = false;
+	if (band > 0 && m_wasChanged[band - 1]) {
+		modified |= spreadFromAdjacentLine(&m_lastLines[(band - 1) * m_wpl], seed, mask);
+	}
+	if (band < m_numBands - 1 && m_wasChanged[band + 1]) {
+		modified |= spreadFromAdjacentLine(
+			&m_firstLines[(band + 1) * m_wpl], last_seed_line, last_mask_line
+		);
+	}
+	if (!modified) {
+		return;
+	}
+	
+	fillBand(band);
+	
+	// The copies of our own boundary lines are always up to date
+	// at the beginning of a round, as those are only taken from bands
+	// that did change.
+	m_changed[band] = !sameLine(seed, &m_firstLines[band * m_wpl])
+		|| !sameLine(last_seed_line, &m_lastLines[band * m_wpl]);
+}
+
+void
+SeedFillBands::finish() const
+{
+	while (iterate(m_pSeed, m_pMask, m_height)) {
+		// Continue until done.
+	}
+}
+
+bool
+SeedFillBands::iterate(uint32_t* const seed, uint32_t const* const mask, int const height) const
+{
+	if (m_conn == CONN4) {
+		return seedFill4Iteration(seed, m_seedWpl, mask, m_maskWpl, m_width, height);
+	} else {
+		return seedFill8Iteration(seed, m_seedWpl, mask, m_maskWpl, m_width, height);
+	}
+}
+
+bool
+SeedFillBands::spreadFromAdjacentLine(
+	uint32_t const* const adjacent, uint32_t* const seed_line,
+	uint32_t const* const mask_line) const
+{
+	int const last_word_idx = m_wpl - 1;
+	uint32_t modified = 0;
+	
+	for (int i = 0; i <= last_word_idx; ++i) {
+		uint32_t word = adjacent[i];
+		if (m_conn == CONN8) {
+			word |= (word << 1) | (word >> 1);
+			if (i > 0) {
+				word |= adjacent[i - 1] << 31;
+			}
+			if (i < last_word_idx) {
+				word |= adjacent[i + 1] >> 31;
+			}
+		}
+		word &= mask_line[i];
+		if (i == last_word_idx) {
+			word &= m_lastWordMask;
+		}
+		modified |= word & ~seed_line[i];
+		seed_line[i] |= word;
+	}
+	
+	return modified != 0;
 }
 
+bool
+SeedFillBands::sameLine(uint32_t const* const line, uint32_t const* const copy) const
+{
+	int const last_word_idx = m_wpl - 1;
+	for (int i = 0; i < last_word_idx; ++i) {
+		if (line[i] != copy[i]) {
+			return false;
+		}
+	}
+	return (line[last_word_idx] & m_lastWordMask) == copy[last_word_idx];
+}
+
+class SeedFillBandFiller
+{
+public:
+	SeedFillBandFiller(SeedFillBands const& bands) : m_rBands(bands) {}
+	
+	void operator()(int band_begin, int band_end) const {
+		for (int band = band_begin; band < band_end; ++band) {
+			m_rBands.fillBand(band);
+		}
+	}
+private:
+	SeedFillBands const& m_rBands;
+};
+
+class SeedFillBandExchanger
+{
+public:
+	SeedFillBandExchanger(SeedFillBands const& bands) : m_rBands(bands) {}
+	
+	void operator()(int band_begin, int band_end) const {
+		for (int band = band_begin; band < band_end; ++band) {
+			m_rBands.exchange(band);
+		}
+	}
+private:
+	SeedFillBands const& m_rBands;
+};
+
 inline uint8_t lightest(uint8_t lhs, uint8_t rhs)
 {
 	return lhs > rhs ? lhs : rhs;
@@ -504,17 +770,29 @@ BinaryImage seedFill(
 		throw std::invalid_argument("seedFill: seed and mask have different sizes");
 	}
 	
-	BinaryImage prev;
 	BinaryImage img(seed);
+	if (img.isNull()) {
+		return img;
+	}
 	
-	do {
-		prev = img;
-		if (connectivity == CONN4) {
-			seedFill4Iteration(img, mask);
-		} else {
-			seedFill8Iteration(img, mask);
+	int const band_height = detail::seed_fill_generic::parallelBandHeight(img.size());
+	SeedFillBands bands(img, mask, connectivity, band_height ? band_height : img.height());
+	if (band_height == 0) {
+		bands.finish();
+		return img;
+	}
+	
+	int const num_bands = bands.numBands();
+	ParallelFor::run(0, num_bands, 1, SeedFillBandFiller(bands));
+	
+	// See detail::seed_fill_generic::seedFillParallel() for the reasoning.
+	for (int round = 0; bands.takeBoundaries(); ++round) {
+		if (round == num_bands * 2) {
+			bands.finish();
+			break;
 		}
-	} while (img != prev);
+		ParallelFor::run(0, num_bands, 1, SeedFillBandExchanger(bands));
+	}
 	
 	return img;
 }
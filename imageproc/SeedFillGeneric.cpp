@@ -17,6 +17,8 @@
 */
 
 #include "SeedFillGeneric.h"
+#include "ParallelFor.h"
+#include <algorithm>
 
 namespace imageproc
 {
@@ -71,6 +73,22 @@ void initVertTransitions(std::vector<VTransition>& transitions, int const height
 	transitions.push_back(VTransition(~0, 0));
 }
 
+int parallelBandHeight(QSize const size)
+{
+	int const max_threads = ParallelFor::maxThreads();
+	if (max_threads <= 1) {
+		return 0;
+	}
+	
+	// Values crossing a boundary take a round of exchange, so we want
+	// as few bands as possible: one per thread, and not too thin ones.
+	int const min_height = std::max(64, (1 << 16) / size.width() + 1);
+	int const even_split = (size.height() + max_threads - 1) / max_threads;
+	int const band_height = std::max(min_height, even_split);
+	
+	return band_height < size.height() ? band_height : 0;
+}
+
 } // namespace seed_fill_generic
 
 } // namespace detail
@@ -21,9 +21,12 @@
 
 #include "Connectivity.h"
 #include "FastQueue.h"
+#include "ParallelFor.h"
 #include <QSize>
 #include <vector>
+#include <algorithm>
 #include <assert.h>
+#include <stdint.h>
 
 namespace imageproc
 {
@@ -490,6 +493,315 @@ void seedFill8(
 	);
 }
 
+/**
+ * Spreads values into the first or the last line of a band from
+ * a copy of the adjacent line of the neighboring band.  Modified
+ * positions are pushed to the queue, with \p y relative to the band.
+ */
+template<typename T, typename SpreadOp, typename MaskOp>
+void spreadFromAdjacentLine(
+	SpreadOp spread_op, MaskOp mask_op, Connectivity const conn,
+	FastQueue<Position<T> >& queue, T const* const adjacent,
+	T* const seed_line, T const* const mask_line, int const width, int const y)
+{
+	for (int x = 0; x < width; ++x) {
+		T val(adjacent[x]);
+		if (conn == CONN8) {
+			if (x > 0) {
+				val = spread_op(val, adjacent[x - 1]);
+			}
+			if (x < width - 1) {
+				val = spread_op(val, adjacent[x + 1]);
+			}
+		}
+
+		T const new_val(mask_op(mask_line[x], spread_op(seed_line[x], val)));
+		if (new_val != seed_line[x]) {
+			seed_line[x] = new_val;
+			queue.push(Position<T>(seed_line + x, mask_line + x, x, y));
+		}
+	}
+}
+
+/**
+ * \brief Horizontal bands of an image, to be seed-filled concurrently.
+ *
+ * Each band is filled on its own first.  Then values are exchanged across
+ * band boundaries in rounds, with all the bands processed concurrently
+ * in every round.  A round spreads values into a band from copies of
+ * the lines adjacent to it, taken before the round.  Once a round leaves
+ * the boundary lines of every band intact, the whole image is done.
+ */
+template<typename T, typename SpreadOp, typename MaskOp>
+class Bands
+{
+public:
+	Bands(SpreadOp spread_op, MaskOp mask_op, Connectivity conn,
+		T* seed, int seed_stride, QSize size,
+		T const* mask, int mask_stride, int band_height);
+
+	int numBands() const { return m_numBands; }
+
+	/**
+	 * Fills each band independently of the others.
+	 */
+	void fillBand(int band) const;
+
+	/**
+	 * Copies the first and the last lines of every band and
+	 * marks all bands as unchanged.
+	 *
+	 * \return true if any band was changed since the previous call.
+	 */
+	bool takeBoundaries();
+
+	/**
+	 * Spreads values into a band from the copies of its adjacent lines,
+	 * provided the bands they belong to were changed.
+	 */
+	void exchange(int band) const;
+
+	/**
+	 * Finishes the job on the calling thread, spreading values
+	 * across all band boundaries at once.
+	 */
+	void finish() const;
+private:
+	T* bandSeed(int band) const { return m_pSeed + band * m_bandHeight * m_seedStride; }
+
+	T const* bandMask(int band) const { return m_pMask + band * m_bandHeight * m_maskStride; }
+
+	int bandHeight(int band) const {
+		return std::min(m_bandHeight, m_size.height() - band * m_bandHeight);
+	}
+
+	SpreadOp m_spreadOp;
+	MaskOp m_maskOp;
+	Connectivity m_conn;
+	T* m_pSeed;
+	T const* m_pMask;
+	int m_seedStride;
+	int m_maskStride;
+	QSize m_size;
+	int m_bandHeight;
+	int m_numBands;
+	std::vector<HTransition> m_hTransitions;
+	std::vector<T> m_firstLines;
+	std::vector<T> m_lastLines;
+	std::vector<uint8_t> m_wasChanged; // During the previous round.
+	mutable std::vector<uint8_t> m_changed; // During the current round.
+};
+
+template<typename T, typename SpreadOp, typename MaskOp>
+Bands<T, SpreadOp, MaskOp>::Bands(
+	SpreadOp spread_op, MaskOp mask_op, Connectivity const conn,
+	T* const seed, int const seed_stride, QSize const size,
+	T const* const mask, int const mask_stride, int const band_height)
+:	m_spreadOp(spread_op),
+	m_maskOp(mask_op),
+	m_conn(conn),
+	m_pSeed(seed),
+	m_pMask(mask),
+	m_seedStride(seed_stride),
+	m_maskStride(mask_stride),
+	m_size(size),
+	m_bandHeight(band_height),
+	m_numBands((size.height() + band_height - 1) / band_height),
+	m_firstLines(m_numBands * size.width()),
+	m_lastLines(m_numBands * size.width()),
+	m_wasChanged(m_numBands, 0),
+	m_changed(m_numBands, 1)
+{
+	initHorTransitions(m_hTransitions, size.width());
+}
+
+template<typename T, typename SpreadOp, typename MaskOp>
+void
+Bands<T, SpreadOp, MaskOp>::fillBand(int const band) const
+{
+	QSize const band_size(m_size.width(), bandHeight(band));
+	if (m_conn == CONN4) {
+		seedFill4(
+			m_spreadOp, m_maskOp, bandSeed(band), m_seedStride,
+			band_size, bandMask(band), m_maskStride
+		);
+	} else {
+		seedFill8(
+			m_spreadOp, m_maskOp, bandSeed(band), m_seedStride,
+			band_size, bandMask(band), m_maskStride
+		);
+	}
+}
+
+template<typename T, typename SpreadOp, typename MaskOp>
+bool
+Bands<T, SpreadOp, MaskOp>::takeBoundaries()
+{
+	int const w = m_size.width();
+	bool any_changed = false;
+
+	for (int band = 0; band < m_numBands; ++band) {
+		m_wasChanged[band] = m_changed[band];
+		m_changed[band] = 0;
+		if (!m_wasChanged[band]) {
+			continue;
+		}
+
+		any_changed = true;
+		T const* const first_line = bandSeed(band);
+		T const* const last_line = first_line + (bandHeight(band) - 1) * m_seedStride;
+		std::copy(first_line, first_line + w, m_firstLines.begin() + band * w);
+		std::copy(last_line, last_line + w, m_lastLines.begin() + band * w);
+	}
+
+	return any_changed;
+}
+
+template<typename T, typename SpreadOp, typename MaskOp>
+void
+Bands<T, SpreadOp, MaskOp>::exchange(int const band) const
+{
+	int const w = m_size.width();
+	int const h = bandHeight(band);
+	T* const seed = bandSeed(band);
+	T const* const mask = bandMask(band);
+	T* const last_seed_line = seed + (h - 1) * m_seedStride;
+	T const* const last_mask_line = mask + (h - 1) * m_maskStride;
+
+	FastQueue<Position<T> > queue;
+	if (band > 0 && m_wasChanged[band - 1]) {
+		spreadFromAdjacentLine(
+			m_spreadOp, m_maskOp, m_conn, queue,
+			&m_lastLines[(band - 1) * w], seed, mask, w, 0
+		);
+	}
+	if (band < m_numBands - 1 && m_wasChanged[band + 1]) {
+		spreadFromAdjacentLine(
+			m_spreadOp, m_maskOp, m_conn, queue,
+			&m_firstLines[(band + 1) * w], last_seed_line, last_mask_line, w, h - 1
+		);
+	}
+	if (queue.empty()) {
+		return;
+	}
+
+	std::vector<VTransition> v_transitions;
+	initVertTransitions(v_transitions, h);
+	if (m_conn == CONN4) {
+		spread4(
+			m_spreadOp, m_maskOp, queue, &m_hTransitions[0],
+			&v_transitions[0], m_seedStride, m_maskStride
+		);
+	} else {
+		spread8(
+			m_spreadOp, m_maskOp, queue, &m_hTransitions[0],
+			&v_transitions[0], m_seedStride, m_maskStride
+		);
+	}
+
+	// Unless the boundary lines were modified, the neighbors don't care.
+	// The copies of our own boundary lines are always up to date
+	// at the beginning of a round, as those are only taken from bands
+	// that did change.
+	m_changed[band] = !std::equal(seed, seed + w, &m_firstLines[band * w])
+		|| !std::equal(last_seed_line, last_seed_line + w, &m_lastLines[band * w]);
+}
+
+template<typename T, typename SpreadOp, typename MaskOp>
+void
+Bands<T, SpreadOp, MaskOp>::finish() const
+{
+	int const w = m_size.width();
+	std::vector<VTransition> v_transitions;
+	initVertTransitions(v_transitions, m_size.height());
+
+	// Every line adjacent to a band boundary becomes a source of spreading.
+	FastQueue<Position<T> > queue;
+	for (int band = 1; band < m_numBands; ++band) {
+		int const y = band * m_bandHeight;
+		for (int line_y = y - 1; line_y <= y; ++line_y) {
+			T* const seed_line = m_pSeed + line_y * m_seedStride;
+			T const* const mask_line = m_pMask + line_y * m_maskStride;
+			for (int x = 0; x < w; ++x) {
+				queue.push(Position<T>(seed_line + x, mask_line + x, x, line_y));
+			}
+		}
+	}
+
+	if (m_conn == CONN4) {
+		spread4(
+			m_spreadOp, m_maskOp, queue, &m_hTransitions[0],
+			&v_transitions[0], m_seedStride, m_maskStride
+		);
+	} else {
+		spread8(
+			m_spreadOp, m_maskOp, queue, &m_hTransitions[0],
+			&v_transitions[0], m_seedStride, m_maskStride
+		);
+	}
+}
+
+template<typename T, typename SpreadOp, typename MaskOp>
+class BandFiller
+{
+public:
+	BandFiller(Bands<T, SpreadOp, MaskOp> const& bands) : m_rBands(bands) {}
+
+	void operator()(int band_begin, int band_end) const {
+		for (int band = band_begin; band < band_end; ++band) {
+			m_rBands.fillBand(band);
+		}
+	}
+private:
+	Bands<T, SpreadOp, MaskOp> const& m_rBands;
+};
+
+template<typename T, typename SpreadOp, typename MaskOp>
+class BandExchanger
+{
+public:
+	BandExchanger(Bands<T, SpreadOp, MaskOp> const& bands) : m_rBands(bands) {}
+
+	void operator()(int band_begin, int band_end) const {
+		for (int band = band_begin; band < band_end; ++band) {
+			m_rBands.exchange(band);
+		}
+	}
+private:
+	Bands<T, SpreadOp, MaskOp> const& m_rBands;
+};
+
+/**
+ * \brief The band height for seedFillParallel(), or 0 if the image
+ *        is not worth splitting.
+ */
+int parallelBandHeight(QSize size);
+
+template<typename T, typename SpreadOp, typename MaskOp>
+void seedFillParallel(
+	SpreadOp spread_op, MaskOp mask_op, Connectivity const conn,
+	T* const seed, int const seed_stride, QSize const size,
+	T const* const mask, int const mask_stride, int const band_height)
+{
+	Bands<T, SpreadOp, MaskOp> bands(
+		spread_op, mask_op, conn, seed, seed_stride, size, mask, mask_stride, band_height
+	);
+	int const num_bands = bands.numBands();
+
+	ParallelFor::run(0, num_bands, 1, BandFiller<T, SpreadOp, MaskOp>(bands));
+
+	// A value may need a round per band it crosses.  Beyond that,
+	// we are probably dealing with a path zigzagging between bands,
+	// which is better followed by a single thread.
+	for (int round = 0; bands.takeBoundaries(); ++round) {
+		if (round == num_bands * 2) {
+			bands.finish();
+			break;
+		}
+		ParallelFor::run(0, num_bands, 1, BandExchanger<T, SpreadOp, MaskOp>(bands));
+	}
+}
+
 } // namespace seed_fill_generic
 
 } // namespace detail
@@ -522,6 +834,10 @@ void seedFill8(
  * Morphological Grayscale Reconstruction in Image Analysis:
  * Applications and Efficient Algorithms, technical report 91-16, Harvard Robotics Laboratory,
  * November 1991, IEEE Transactions on Image Processing, Vol. 2, No. 2, pp. 176-201, April 1993.\n
+ * \par
+ * Large images are split into horizontal bands, filled concurrently
+ * with ParallelFor.  Values crossing band boundaries are then exchanged
+ * until nothing changes.  The result doesn't depend on the number of threads.
  */
 template<typename T, typename SpreadOp, typename MaskOp>
 void seedFillGenericInPlace(
@@ -533,7 +849,13 @@ void seedFillGenericInPlace(
 		return;
 	}
 
-	if (conn == CONN4) {
+	int const band_height = detail::seed_fill_generic::parallelBandHeight(size);
+	if (band_height != 0) {
+		detail::seed_fill_generic::seedFillParallel(
+			spread_op, mask_op, conn, seed, seed_stride, size,
+			mask, mask_stride, band_height
+		);
+	} else if (conn == CONN4) {
 		detail::seed_fill_generic::seedFill4(
 			spread_op, mask_op, seed, seed_stride, size, mask, mask_stride
 		);
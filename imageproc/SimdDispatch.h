@@ -0,0 +1,106 @@
+/*
+	Scan Tailor - Interactive post-processing tool for scanned pages.
+	Copyright (C)  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef IMAGEPROC_SIMD_DISPATCH_H_
+#define IMAGEPROC_SIMD_DISPATCH_H_
+
+/**
+ * \file
+ * Internal header for translation units providing SSE2 and AVX2 variants
+ * of their kernels.  It's not to be included from other headers.
+ *
+ * IMAGEPROC_HAVE_SSE2 and IMAGEPROC_HAVE_AVX2 tell which variants can be
+ * compiled.  AVX2 functions have to be marked with IMAGEPROC_AVX2_TARGET.
+ * IMAGEPROC_SSE2_KERNELS(k) and IMAGEPROC_AVX2_KERNELS(k) turn into &k,
+ * or into a null pointer if the corresponding variant isn't compiled.
+ */
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define IMAGEPROC_HAVE_SSE2 1
+#include <emmintrin.h>
+#define IMAGEPROC_SSE2_KERNELS(kernels) (&(kernels))
+#else
+#define IMAGEPROC_SSE2_KERNELS(kernels) 0
+#endif
+
+// AVX2 code is compiled with the target attribute, so that the rest of
+// the program doesn't require an AVX2 capable CPU.
+#if defined(IMAGEPROC_HAVE_SSE2) && (defined(__x86_64__) || defined(__i386__)) \
+	&& (defined(__clang__) || (defined(__GNUC__) && __GNUC__ >= 5))
+#define IMAGEPROC_HAVE_AVX2 1
+#define IMAGEPROC_AVX2_TARGET __attribute__((target("avx2")))
+#include <immintrin.h>
+#define IMAGEPROC_AVX2_KERNELS(kernels) (&(kernels))
+#else
+#define IMAGEPROC_AVX2_KERNELS(kernels) 0
+#endif
+
+namespace imageproc
+{
+
+/**
+ * \brief Picks the best of several sets of kernels for the CPU we are on.
+ *
+ * \p Kernels is a struct of function pointers, one instance per variant.
+ * A dispatcher is meant to be a global object, constructed during static
+ * initialization, before any threads exist.
+ */
+template<typename Kernels>
+class SimdDispatch
+{
+public:
+	/**
+	 * \param sse2 SSE2 kernels, or null if not compiled.
+	 * \param avx2 AVX2 kernels, or null if not compiled.
+	 */
+	SimdDispatch(Kernels const& scalar, Kernels const* sse2, Kernels const* avx2)
+	:	m_pScalar(&scalar),
+		m_pBest(selectBest(scalar, sse2, avx2)),
+		m_pCurrent(m_pBest)
+	{
+	}
+
+	Kernels const& kernels() const { return *m_pCurrent; }
+
+	/**
+	 * \brief Switches to the scalar kernels, or back to the best ones.
+	 *
+	 * Meant for testing and benchmarking.  Not thread-safe.
+	 */
+	void forceScalar(bool force) { m_pCurrent = force ? m_pScalar : m_pBest; }
+private:
+	static Kernels const* selectBest(
+		Kernels const& scalar, Kernels const* sse2, Kernels const* avx2) {
+#ifdef IMAGEPROC_HAVE_AVX2
+		// We may be called before the constructor that normally does it.
+		__builtin_cpu_init();
+		if (avx2 && __builtin_cpu_supports("avx2")) {
+			return avx2;
+		}
+#endif
+		return sse2 ? sse2 : &scalar;
+	}
+
+	Kernels const* m_pScalar;
+	Kernels const* m_pBest;
+	Kernels const* m_pCurrent;
+};
+
+} // namespace imageproc
+
+#endif
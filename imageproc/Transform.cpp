@@ -19,6 +19,7 @@
 #include "Transform.h"
 #include "Grayscale.h"
 #include "GrayImage.h"
+#include "ParallelFor.h"
 #include <QImage>
 #include <QRect>
 #include <QSizeF>
@@ -54,6 +55,60 @@ struct YLess
 	}
 };
 
+/**
+ * Divides by an arbitrary number, the ordinary way.
+ */
+class PlainDivider
+{
+public:
+	explicit PlainDivider(unsigned divisor) : m_divisor(divisor) {}
+
+	unsigned halfDivisor() const { return m_divisor >> 1; }
+
+	unsigned operator()(unsigned numerator) const { return numerator / m_divisor; }
+private:
+	unsigned m_divisor;
+};
+
+/**
+ * Divides by a fixed number, using a multiplication and a shift.
+ *
+ * With m = ceil(2^(NUMERATOR_BITS + l) / d) where 2^l >= d, the error
+ * of (n * m) >> (NUMERATOR_BITS + l) compared to n / d is under 1 / d,
+ * which is not enough to change the integer part, as long as
+ * n < 2^NUMERATOR_BITS.  Therefore, the results are exact.
+ */
+class ReciprocalDivider
+{
+public:
+	/**
+	 * Numerators are sums of products of 8-bit values and areas,
+	 * where the total area is at most 32 * 32, plus half of that area.
+	 */
+	enum { NUMERATOR_BITS = 18, MAX_DIVISOR = 32 * 32 };
+
+	explicit ReciprocalDivider(unsigned divisor) : m_halfDivisor(divisor >> 1) {
+		assert(divisor > 0 && divisor <= MAX_DIVISOR);
+		int log2_ceil = 0;
+		while ((1u << log2_ceil) < divisor) {
+			++log2_ceil;
+		}
+		m_shift = NUMERATOR_BITS + log2_ceil;
+		m_multiplier = ((uint64_t(1) << m_shift) + divisor - 1) / divisor;
+	}
+
+	unsigned halfDivisor() const { return m_halfDivisor; }
+
+	unsigned operator()(unsigned numerator) const {
+		assert(numerator < (1u << NUMERATOR_BITS));
+		return static_cast<unsigned>((numerator * m_multiplier) >> m_shift);
+	}
+private:
+	uint64_t m_multiplier;
+	int m_shift;
+	unsigned m_halfDivisor;
+};
+
 class Gray
 {
 public:
@@ -63,9 +118,10 @@ public:
 		m_grayLevel += gray_level * area;
 	}
 	
-	uint8_t result(unsigned const total_area) const {
-		unsigned const half_area = total_area >> 1;
-		unsigned const res = (m_grayLevel + half_area) / total_area;
+	template<typename Divider>
+	uint8_t result(Divider const& div) const {
+		unsigned const half_area = div.halfDivisor();
+		unsigned const res = div(m_grayLevel + half_area);
 		return static_cast<uint8_t>(res);
 	}
 private:
@@ -85,14 +141,15 @@ public:
 		m_red += (rgb & 0xFF) * area;
 	}
 	
-	uint32_t result(unsigned const total_area) const {
-		unsigned const half_area = total_area >> 1;
+	template<typename Divider>
+	uint32_t result(Divider const& div) const {
+		unsigned const half_area = div.halfDivisor();
 		uint32_t rgb = 0x0000FF00;
-		rgb |= (m_red + half_area) / total_area;
+		rgb |= div(m_red + half_area);
 		rgb <<= 8;
-		rgb |= (m_green + half_area) / total_area;
+		rgb |= div(m_green + half_area);
 		rgb <<= 8;
-		rgb |= (m_blue + half_area) / total_area;
+		rgb |= div(m_blue + half_area);
 		return rgb;
 	}
 private:
@@ -116,15 +173,16 @@ public:
 		m_alpha += argb * area;
 	}
 	
-	uint32_t result(unsigned const total_area) const {
-		unsigned const half_area = total_area >> 1;
-		uint32_t argb = (m_alpha + half_area) / total_area;
+	template<typename Divider>
+	uint32_t result(Divider const& div) const {
+		unsigned const half_area = div.halfDivisor();
+		uint32_t argb = div(m_alpha + half_area);
 		argb <<= 8;
-		argb |= (m_red + half_area) / total_area;
+		argb |= div(m_red + half_area);
 		argb <<= 8;
-		argb |= (m_green + half_area) / total_area;
+		argb |= div(m_green + half_area);
 		argb <<= 8;
-		argb |= (m_blue + half_area) / total_area;
+		argb |= div(m_blue + half_area);
 		return argb;
 	}
 private:
@@ -157,33 +215,89 @@ static QSizeF calcSrcUnitSize(QTransform const& xform, QSizeF const& min)
 	);
 }
 
+/**
+ * Maps horizontal bands of the destination image to the source image.
+ * Different bands may be processed concurrently.
+ */
 template<typename StorageUnit, typename Mixer>
-static void transformGeneric(
+class TransformGeneric
+{
+public:
+	TransformGeneric(
+		StorageUnit const* src_data, int src_stride, QSize src_size,
+		StorageUnit* dst_data, int dst_stride, QTransform const& xform,
+		QRect const& dst_rect, StorageUnit outside_color, int outside_flags,
+		QSizeF const& min_mapping_area);
+
+	void operator()(int dy_begin, int dy_end) const;
+private:
+	StorageUnit const* m_pSrcData;
+	int m_srcStride;
+	QSize m_srcSize;
+	StorageUnit* m_pDstData;
+	int m_dstStride;
+	int m_dstWidth;
+	QTransform m_invXform;
+	StorageUnit m_outsideColor;
+	int m_outsideFlags;
+	int m_src32UnitW;
+	int m_src32UnitH;
+};
+
+template<typename StorageUnit, typename Mixer>
+TransformGeneric<StorageUnit, Mixer>::TransformGeneric(
 	StorageUnit const* const src_data, int const src_stride, QSize const src_size,
 	StorageUnit* const dst_data, int const dst_stride, QTransform const& xform,
 	QRect const& dst_rect, StorageUnit const outside_color, int const outside_flags,
 	QSizeF const& min_mapping_area)
+:	m_pSrcData(src_data),
+	m_srcStride(src_stride),
+	m_srcSize(src_size),
+	m_pDstData(dst_data),
+	m_dstStride(dst_stride),
+	m_dstWidth(dst_rect.width()),
+	m_outsideColor(outside_color),
+	m_outsideFlags(outside_flags)
 {
-	int const sw = src_size.width();
-	int const sh = src_size.height();
-	int const dw = dst_rect.width();
-	int const dh = dst_rect.height();
-
-	StorageUnit* dst_line = dst_data;
-	
-	QTransform inv_xform;
-	inv_xform.translate(dst_rect.x(), dst_rect.y());
-	inv_xform *= xform.inverted();
-	inv_xform *= QTransform().scale(32.0, 32.0);
+	m_invXform.translate(dst_rect.x(), dst_rect.y());
+	m_invXform *= xform.inverted();
+	m_invXform *= QTransform().scale(32.0, 32.0);
 	
 	// sx32 = dx*inv_xform.m11() + dy*inv_xform.m21() + inv_xform.dx();
 	// sy32 = dy*inv_xform.m22() + dx*inv_xform.m12() + inv_xform.dy();
 	
-	QSizeF const src32_unit_size(calcSrcUnitSize(inv_xform, min_mapping_area));
-	int const src32_unit_w = std::max<int>(1, qRound(src32_unit_size.width()));
-	int const src32_unit_h = std::max<int>(1, qRound(src32_unit_size.height()));
+	QSizeF const src32_unit_size(calcSrcUnitSize(m_invXform, min_mapping_area));
+	m_src32UnitW = std::max<int>(1, qRound(src32_unit_size.width()));
+	m_src32UnitH = std::max<int>(1, qRound(src32_unit_size.height()));
+}
+
+template<typename StorageUnit, typename Mixer>
+void
+TransformGeneric<StorageUnit, Mixer>::operator()(int const dy_begin, int const dy_end) const
+{
+	StorageUnit const* const src_data = m_pSrcData;
+	int const src_stride = m_srcStride;
+	int const sw = m_srcSize.width();
+	int const sh = m_srcSize.height();
+	int const dw = m_dstWidth;
+	QTransform const& inv_xform = m_invXform;
+	StorageUnit const outside_color = m_outsideColor;
+	int const outside_flags = m_outsideFlags;
+	int const src32_unit_w = m_src32UnitW;
+	int const src32_unit_h = m_src32UnitH;
+
+	// If a destination pixel maps to an area no larger than a source pixel,
+	// it's covered by at most 2x2 source pixels with known weights.  As long
+	// as that area is completely inside the source image, we take a shortcut
+	// that produces exactly the same result as the general case below.
+	bool const bilinear = src32_unit_w <= 32 && src32_unit_h <= 32;
+	int const src32_max_left = (sw << 5) - src32_unit_w;
+	int const src32_max_top = (sh << 5) - src32_unit_h;
+	ReciprocalDivider const bilinear_div(bilinear ? src32_unit_w * src32_unit_h : 1);
+
+	StorageUnit* dst_line = m_pDstData + dy_begin * m_dstStride;
 	
-	for (int dy = 0; dy < dh; ++dy, dst_line += dst_stride) {
+	for (int dy = dy_begin; dy < dy_end; ++dy, dst_line += m_dstStride) {
 		double const f_dy_center = dy + 0.5;
 		double const f_sx32_base = f_dy_center * inv_xform.m21() + inv_xform.dx();
 		double const f_sy32_base = f_dy_center * inv_xform.m22() + inv_xform.dy();
@@ -192,6 +306,41 @@ static void transformGeneric(
 			double const f_dx_center = dx + 0.5;
 			double const f_sx32_center = f_sx32_base + f_dx_center * inv_xform.m11();
 			double const f_sy32_center = f_sy32_base + f_dx_center * inv_xform.m12();
+			
+			if (bilinear) {
+				int const src32_left = (int)f_sx32_center - (src32_unit_w >> 1);
+				int const src32_top = (int)f_sy32_center - (src32_unit_h >> 1);
+				if (src32_left >= 0 && src32_left <= src32_max_left &&
+						src32_top >= 0 && src32_top <= src32_max_top) {
+					int const sx = src32_left >> 5;
+					int const sy = src32_top >> 5;
+					unsigned const fx = src32_left & 31;
+					unsigned const fy = src32_top & 31;
+					bool const two_cols = fx + src32_unit_w > 32;
+					bool const two_rows = fy + src32_unit_h > 32;
+					if (!(two_cols | two_rows)) {
+						// Maps to a single src pixel.
+						dst_line[dx] = src_data[sy * src_stride + sx];
+						continue;
+					}
+					unsigned const left_w = two_cols ? 32 - fx : src32_unit_w;
+					unsigned const right_w = two_cols ? fx + src32_unit_w - 32 : 0;
+					unsigned const top_h = two_rows ? 32 - fy : src32_unit_h;
+					unsigned const bottom_h = two_rows ? fy + src32_unit_h - 32 : 0;
+					StorageUnit const* const top_line = src_data + sy * src_stride + sx;
+					StorageUnit const* const bottom_line = two_rows ? top_line + src_stride : top_line;
+					int const right_offset = two_cols ? 1 : 0;
+
+					Mixer mixer;
+					mixer.add(top_line[0], top_h * left_w);
+					mixer.add(top_line[right_offset], top_h * right_w);
+					mixer.add(bottom_line[0], bottom_h * left_w);
+					mixer.add(bottom_line[right_offset], bottom_h * right_w);
+					dst_line[dx] = mixer.result(bilinear_div);
+					continue;
+				}
+			}
+			
 			int src32_left = (int)f_sx32_center - (src32_unit_w >> 1);
 			int src32_top = (int)f_sy32_center - (src32_unit_h >> 1);
 			int src32_right = src32_left + src32_unit_w;
@@ -387,11 +536,32 @@ static void transformGeneric(
 				mixer.add(src_line[src_right], bottomright_area);
 			}
 
-			dst_line[dx] = mixer.result(src_area + background_area);
+			dst_line[dx] = mixer.result(PlainDivider(src_area + background_area));
 		}
 	}
 }
 
+template<typename StorageUnit, typename Mixer>
+static void transformGeneric(
+	StorageUnit const* const src_data, int const src_stride, QSize const src_size,
+	StorageUnit* const dst_data, int const dst_stride, QTransform const& xform,
+	QRect const& dst_rect, StorageUnit const outside_color, int const outside_flags,
+	QSizeF const& min_mapping_area)
+{
+	int const dw = dst_rect.width();
+	int const dh = dst_rect.height();
+
+	// Rows are processed independently of each other, so the result
+	// doesn't depend on how they are split into bands.
+	ParallelFor::run(
+		0, dh, (1 << 14) / dw + 1,
+		TransformGeneric<StorageUnit, Mixer>(
+			src_data, src_stride, src_size, dst_data, dst_stride,
+			xform, dst_rect, outside_color, outside_flags, min_mapping_area
+		)
+	);
+}
+
 } // anonymous namespace
 
 QImage transform(
@@ -0,0 +1,210 @@
+/*
+	Scan Tailor - Interactive post-processing tool for scanned pages.
+	Copyright (C)  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "AllocationCounter.h"
+#include <stddef.h>
+#include <stdlib.h> // Defines __GLIBC__ where applicable.
+
+#if defined(__GLIBC__)
+
+#include <malloc.h>
+#include <errno.h>
+
+extern "C"
+{
+void* __libc_malloc(size_t size);
+void* __libc_calloc(size_t num, size_t size);
+void* __libc_realloc(void* ptr, size_t size);
+void* __libc_memalign(size_t alignment, size_t size);
+void* __libc_valloc(size_t size);
+void* __libc_pvalloc(size_t size);
+void __libc_free(void* ptr);
+}
+
+namespace
+{
+
+long g_allocations = 0;
+long g_currentBytes = 0;
+long g_peakBytes = 0;
+
+void onAllocated(void* ptr)
+{
+	if (!ptr) {
+		return;
+	}
+
+	__sync_fetch_and_add(&g_allocations, 1);
+	long const current = __sync_add_and_fetch(&g_currentBytes, (long)malloc_usable_size(ptr));
+	
+	long peak = g_peakBytes;
+	while (current > peak) {
+		long const prev = __sync_val_compare_and_swap(&g_peakBytes, peak, current);
+		if (prev == peak) {
+			break;
+		}
+		peak = prev;
+	}
+}
+
+void onFreed(void* ptr)
+{
+	if (ptr) {
+		__sync_sub_and_fetch(&g_currentBytes, (long)malloc_usable_size(ptr));
+	}
+}
+
+} // anonymous namespace
+
+extern "C" void* malloc(size_t size)
+{
+	void* const ptr = __libc_malloc(size);
+	onAllocated(ptr);
+	return ptr;
+}
+
+extern "C" void* calloc(size_t num, size_t size)
+{
+	void* const ptr = __libc_calloc(num, size);
+	onAllocated(ptr);
+	return ptr;
+}
+
+extern "C" void* realloc(void* ptr, size_t size)
+{
+	size_t const old_size = ptr ? malloc_usable_size(ptr) : 0;
+	void* const new_ptr = __libc_realloc(ptr, size);
+	if (new_ptr || size == 0) {
+		__sync_sub_and_fetch(&g_currentBytes, (long)old_size);
+		onAllocated(new_ptr);
+	}
+	return new_ptr;
+}
+
+extern "C" void* memalign(size_t alignment, size_t size)
+{
+	void* const ptr = __libc_memalign(alignment, size);
+	onAllocated(ptr);
+	return ptr;
+}
+
+extern "C" void* valloc(size_t size)
+{
+	void* const ptr = __libc_valloc(size);
+	onAllocated(ptr);
+	return ptr;
+}
+
+extern "C" void* pvalloc(size_t size)
+{
+	void* const ptr = __libc_pvalloc(size);
+	onAllocated(ptr);
+	return ptr;
+}
+
+extern "C" void* aligned_alloc(size_t alignment, size_t size)
+{
+	return memalign(alignment, size);
+}
+
+extern "C" int posix_memalign(void** out, size_t alignment, size_t size)
+{
+	if (alignment % sizeof(void*) != 0 || (alignment & (alignment - 1)) != 0) {
+		return EINVAL;
+	}
+
+	void* const ptr = memalign(alignment, size);
+	if (!ptr) {
+		return ENOMEM;
+	}
+	*out = ptr;
+	return 0;
+}
+
+extern "C" void free(void* ptr)
+{
+	onFreed(ptr);
+	__libc_free(ptr);
+}
+
+#endif // __GLIBC__
+
+namespace imageproc
+{
+
+namespace benchmarks
+{
+
+#if defined(__GLIBC__)
+
+bool
+AllocationCounter::isAvailable()
+{
+	return true;
+}
+
+void
+AllocationCounter::reset()
+{
+	__sync_lock_test_and_set(&g_allocations, 0);
+	__sync_lock_test_and_set(&g_currentBytes, 0);
+	__sync_lock_test_and_set(&g_peakBytes, 0);
+}
+
+qint64
+AllocationCounter::allocations()
+{
+	return __sync_add_and_fetch(&g_allocations, 0);
+}
+
+qint64
+AllocationCounter::peakBytes()
+{
+	return __sync_add_and_fetch(&g_peakBytes, 0);
+}
+
+#else
+
+bool
+AllocationCounter::isAvailable()
+{
+	return false;
+}
+
+void
+AllocationCounter::reset()
+{
+}
+
+qint64
+AllocationCounter::allocations()
+{
+	return 0;
+}
+
+qint64
+AllocationCounter::peakBytes()
+{
+	return 0;
+}
+
+#endif
+
+} // namespace benchmarks
+
+} // namespace imageproc
@@ -0,0 +1,69 @@
+/*
+	Scan Tailor - Interactive post-processing tool for scanned pages.
+	Copyright (C)  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef IMAGEPROC_BENCHMARKS_ALLOCATION_COUNTER_H_
+#define IMAGEPROC_BENCHMARKS_ALLOCATION_COUNTER_H_
+
+#include <QtGlobal>
+
+namespace imageproc
+{
+
+namespace benchmarks
+{
+
+/**
+ * \brief Counts heap allocations made by the whole process.
+ *
+ * This works by interposing malloc() and friends, which is only done
+ * on glibc-based systems.  Elsewhere, isAvailable() returns false.
+ * Allocations made by all threads are counted.
+ *
+ * Every allocation function glibc provides is interposed, as free()
+ * subtracts the usable size of whatever block it gets.  A block coming
+ * from a function that isn't interposed would make the figures drift.
+ */
+class AllocationCounter
+{
+public:
+	static bool isAvailable();
+
+	/**
+	 * \brief Zeroes the counters.
+	 *
+	 * The heap usage at this point becomes the baseline for peakBytes().
+	 */
+	static void reset();
+
+	/**
+	 * \brief The number of allocations since the last reset().
+	 */
+	static qint64 allocations();
+
+	/**
+	 * \brief The peak heap usage since the last reset(), relative
+	 *        to the heap usage at the time of that reset().
+	 */
+	static qint64 peakBytes();
+};
+
+} // namespace benchmarks
+
+} // namespace imageproc
+
+#endif
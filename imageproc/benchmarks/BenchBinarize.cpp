@@ -0,0 +1,80 @@
+/*
+	Scan Tailor - Interactive post-processing tool for scanned pages.
+	Copyright (C)  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "Benchmarks.h"
+#include "Runner.h"
+#include "SyntheticPages.h"
+#include "Binarize.h"
+#include "GrayImage.h"
+#include <QImage>
+#include <QSize>
+#include <stddef.h>
+
+namespace imageproc
+{
+
+namespace benchmarks
+{
+
+namespace
+{
+
+class SauvolaKernel
+{
+public:
+	SauvolaKernel(QImage const& page, QSize const& window)
+	: m_rPage(page), m_window(window) {}
+
+	void operator()() const { binarizeSauvola(m_rPage, m_window); }
+private:
+	QImage const& m_rPage;
+	QSize m_window;
+};
+
+class WolfKernel
+{
+public:
+	WolfKernel(QImage const& page, QSize const& window)
+	: m_rPage(page), m_window(window) {}
+
+	void operator()() const { binarizeWolf(m_rPage, m_window); }
+private:
+	QImage const& m_rPage;
+	QSize m_window;
+};
+
+} // anonymous namespace
+
+void benchBinarize(Runner& runner)
+{
+	if (!runner.wants("binarizeSauvola") && !runner.wants("binarizeWolf")) {
+		return;
+	}
+
+	for (size_t i = 0; i < runner.dpis().size(); ++i) {
+		int const dpi = runner.dpis()[i];
+		QImage const page(syntheticGrayPage(dpi).toQImage());
+		QSize const window(dpi / 5, dpi / 5);
+		runner.run("binarizeSauvola", dpi, page.size(), SauvolaKernel(page, window));
+		runner.run("binarizeWolf", dpi, page.size(), WolfKernel(page, window));
+	}
+}
+
+} // namespace benchmarks
+
+} // namespace imageproc
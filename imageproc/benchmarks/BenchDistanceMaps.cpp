@@ -0,0 +1,99 @@
+/*
+	Scan Tailor - Interactive post-processing tool for scanned pages.
+	Copyright (C)  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "Benchmarks.h"
+#include "Runner.h"
+#include "SyntheticPages.h"
+#include "SEDM.h"
+#include "ConnectivityMap.h"
+#include "RunLengthLabeler.h"
+#include "Connectivity.h"
+#include "BinaryImage.h"
+#include <stddef.h>
+
+namespace imageproc
+{
+
+namespace benchmarks
+{
+
+namespace
+{
+
+class SEDMKernel
+{
+public:
+	SEDMKernel(BinaryImage const& page) : m_rPage(page) {}
+
+	void operator()() const { SEDM sedm(m_rPage); }
+private:
+	BinaryImage const& m_rPage;
+};
+
+class SaturatedSEDMKernel
+{
+public:
+	SaturatedSEDMKernel(BinaryImage const& page) : m_rPage(page) {}
+
+	void operator()() const { SEDM::buildSaturated(m_rPage); }
+private:
+	BinaryImage const& m_rPage;
+};
+
+class ConnectivityMapKernel
+{
+public:
+	ConnectivityMapKernel(BinaryImage const& page) : m_rPage(page) {}
+
+	void operator()() const { ConnectivityMap cmap(m_rPage, CONN8); }
+private:
+	BinaryImage const& m_rPage;
+};
+
+class ConnCompStatsKernel
+{
+public:
+	ConnCompStatsKernel(BinaryImage const& page) : m_rPage(page) {}
+
+	void operator()() const { RunLengthLabeler(m_rPage, CONN8).components(); }
+private:
+	BinaryImage const& m_rPage;
+};
+
+} // anonymous namespace
+
+void benchDistanceMaps(Runner& runner)
+{
+	if (!runner.wants("SEDM") && !runner.wants("ConnectivityMap")
+			&& !runner.wants("connCompStats")) {
+		return;
+	}
+
+	for (size_t i = 0; i < runner.dpis().size(); ++i) {
+		int const dpi = runner.dpis()[i];
+		BinaryImage const page(syntheticBinaryPage(dpi));
+		runner.run("SEDM", dpi, page.size(), SEDMKernel(page));
+		runner.run("SEDMSaturated", dpi, page.size(), SaturatedSEDMKernel(page));
+		runner.run("ConnectivityMap", dpi, page.size(), ConnectivityMapKernel(page));
+		runner.run("connCompStats", dpi, page.size(), ConnCompStatsKernel(page));
+	}
+}
+
+} // namespace benchmarks
+
+} // namespace imageproc
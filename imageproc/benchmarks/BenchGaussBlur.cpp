@@ -0,0 +1,65 @@
+/*
+	Scan Tailor - Interactive post-processing tool for scanned pages.
+	Copyright (C)  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "Benchmarks.h"
+#include "Runner.h"
+#include "SyntheticPages.h"
+#include "GaussBlur.h"
+#include "GrayImage.h"
+#include <stddef.h>
+
+namespace imageproc
+{
+
+namespace benchmarks
+{
+
+namespace
+{
+
+class GaussBlurKernel
+{
+public:
+	GaussBlurKernel(GrayImage const& page, float sigma)
+	: m_rPage(page), m_sigma(sigma) {}
+
+	void operator()() const { gaussBlur(m_rPage, m_sigma, m_sigma); }
+private:
+	GrayImage const& m_rPage;
+	float m_sigma;
+};
+
+} // anonymous namespace
+
+void benchGaussBlur(Runner& runner)
+{
+	if (!runner.wants("gaussBlur")) {
+		return;
+	}
+
+	for (size_t i = 0; i < runner.dpis().size(); ++i) {
+		int const dpi = runner.dpis()[i];
+		GrayImage const page(syntheticGrayPage(dpi));
+		float const sigma = 2.0f * dpi / 300;
+		runner.run("gaussBlur", dpi, page.size(), GaussBlurKernel(page, sigma));
+	}
+}
+
+} // namespace benchmarks
+
+} // namespace imageproc
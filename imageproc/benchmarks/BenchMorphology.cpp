@@ -0,0 +1,150 @@
+/*
+	Scan Tailor - Interactive post-processing tool for scanned pages.
+	Copyright (C)  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "Benchmarks.h"
+#include "Runner.h"
+#include "SyntheticPages.h"
+#include "Morphology.h"
+#include "SeedFill.h"
+#include "Connectivity.h"
+#include "BinaryImage.h"
+#include "GrayImage.h"
+#include "BWColor.h"
+#include <QSize>
+#include <string.h>
+#include <stdint.h>
+#include <stddef.h>
+
+namespace imageproc
+{
+
+namespace benchmarks
+{
+
+namespace
+{
+
+class DilateKernel
+{
+public:
+	DilateKernel(BinaryImage const& page, QSize const& brick)
+	: m_rPage(page), m_brick(brick) {}
+
+	void operator()() const { dilateBrick(m_rPage, m_brick); }
+private:
+	BinaryImage const& m_rPage;
+	QSize m_brick;
+};
+
+class ErodeKernel
+{
+public:
+	ErodeKernel(BinaryImage const& page, QSize const& brick)
+	: m_rPage(page), m_brick(brick) {}
+
+	void operator()() const { erodeBrick(m_rPage, m_brick); }
+private:
+	BinaryImage const& m_rPage;
+	QSize m_brick;
+};
+
+class SeedFillKernel
+{
+public:
+	SeedFillKernel(BinaryImage const& seed, BinaryImage const& mask)
+	: m_rSeed(seed), m_rMask(mask) {}
+
+	void operator()() const { seedFill(m_rSeed, m_rMask, CONN8); }
+private:
+	BinaryImage const& m_rSeed;
+	BinaryImage const& m_rMask;
+};
+
+class SeedFillGrayKernel
+{
+public:
+	SeedFillGrayKernel(GrayImage const& seed, GrayImage const& mask)
+	: m_rSeed(seed), m_rMask(mask) {}
+
+	void operator()() const { seedFillGray(m_rSeed, m_rMask, CONN8); }
+private:
+	GrayImage const& m_rSeed;
+	GrayImage const& m_rMask;
+};
+
+/**
+ * White everywhere except for the outer frame, which is copied from \p mask.
+ * Filling from such a seed reconstructs what's reachable from page edges.
+ */
+GrayImage frameSeed(GrayImage const& mask)
+{
+	int const width = mask.width();
+	int const height = mask.height();
+
+	GrayImage seed(mask.size());
+	seed.fill(0xff);
+
+	uint8_t* seed_line = seed.data();
+	uint8_t const* mask_line = mask.data();
+	for (int y = 0; y < height; ++y) {
+		if (y == 0 || y == height - 1) {
+			memcpy(seed_line, mask_line, width);
+		} else {
+			seed_line[0] = mask_line[0];
+			seed_line[width - 1] = mask_line[width - 1];
+		}
+		seed_line += seed.stride();
+		mask_line += mask.stride();
+	}
+
+	return seed;
+}
+
+} // anonymous namespace
+
+void benchMorphology(Runner& runner)
+{
+	if (!runner.wants("dilateBrick") && !runner.wants("erodeBrick")
+			&& !runner.wants("seedFill") && !runner.wants("seedFillGray")) {
+		return;
+	}
+
+	for (size_t i = 0; i < runner.dpis().size(); ++i) {
+		int const dpi = runner.dpis()[i];
+		GrayImage const gray_page(syntheticGrayPage(dpi));
+		BinaryImage const page(gray_page.toQImage());
+		QSize const brick(7 * dpi / 300, 7 * dpi / 300);
+
+		runner.run("dilateBrick", dpi, page.size(), DilateKernel(page, brick));
+		runner.run("erodeBrick", dpi, page.size(), ErodeKernel(page, brick));
+
+		if (runner.wants("seedFill")) {
+			BinaryImage const seed(erodeBrick(page, QSize(3, 3)));
+			runner.run("seedFill", dpi, page.size(), SeedFillKernel(seed, page));
+		}
+
+		if (runner.wants("seedFillGray")) {
+			GrayImage const seed(frameSeed(gray_page));
+			runner.run("seedFillGray", dpi, page.size(), SeedFillGrayKernel(seed, gray_page));
+		}
+	}
+}
+
+} // namespace benchmarks
+
+} // namespace imageproc
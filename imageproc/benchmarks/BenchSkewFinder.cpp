@@ -0,0 +1,63 @@
+/*
+	Scan Tailor - Interactive post-processing tool for scanned pages.
+	Copyright (C)  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "Benchmarks.h"
+#include "Runner.h"
+#include "SyntheticPages.h"
+#include "SkewFinder.h"
+#include "BinaryImage.h"
+#include <stddef.h>
+
+namespace imageproc
+{
+
+namespace benchmarks
+{
+
+namespace
+{
+
+class FindSkewKernel
+{
+public:
+	FindSkewKernel(BinaryImage const& page) : m_rPage(page) {}
+
+	void operator()() const { m_finder.findSkew(m_rPage); }
+private:
+	BinaryImage const& m_rPage;
+	SkewFinder m_finder;
+};
+
+} // anonymous namespace
+
+void benchSkewFinder(Runner& runner)
+{
+	if (!runner.wants("findSkew")) {
+		return;
+	}
+
+	for (size_t i = 0; i < runner.dpis().size(); ++i) {
+		int const dpi = runner.dpis()[i];
+		BinaryImage const page(syntheticBinaryPage(dpi));
+		runner.run("findSkew", dpi, page.size(), FindSkewKernel(page));
+	}
+}
+
+} // namespace benchmarks
+
+} // namespace imageproc
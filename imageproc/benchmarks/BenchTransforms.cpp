@@ -0,0 +1,131 @@
+/*
+	Scan Tailor - Interactive post-processing tool for scanned pages.
+	Copyright (C)  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "Benchmarks.h"
+#include "Runner.h"
+#include "SyntheticPages.h"
+#include "Transform.h"
+#include "Scale.h"
+#include "OrthogonalRotation.h"
+#include "Shear.h"
+#include "BinaryImage.h"
+#include "GrayImage.h"
+#include "BWColor.h"
+#include <QImage>
+#include <QTransform>
+#include <QRect>
+#include <QRectF>
+#include <QSize>
+#include <QColor>
+#include <Qt>
+#include <stddef.h>
+
+namespace imageproc
+{
+
+namespace benchmarks
+{
+
+namespace
+{
+
+class TransformKernel
+{
+public:
+	TransformKernel(QImage const& page, QTransform const& xform)
+	: m_page(page), m_xform(xform),
+	m_dstRect(xform.mapRect(QRectF(page.rect())).toRect()) {}
+
+	void operator()() const {
+		transform(m_page, m_xform, m_dstRect, OutsidePixels::assumeColor(Qt::white));
+	}
+private:
+	QImage m_page;
+	QTransform m_xform;
+	QRect m_dstRect;
+};
+
+class ScaleToGrayKernel
+{
+public:
+	ScaleToGrayKernel(GrayImage const& page, QSize const& dst_size)
+	: m_rPage(page), m_dstSize(dst_size) {}
+
+	void operator()() const { scaleToGray(m_rPage, m_dstSize); }
+private:
+	GrayImage const& m_rPage;
+	QSize m_dstSize;
+};
+
+class OrthogonalRotationKernel
+{
+public:
+	OrthogonalRotationKernel(BinaryImage const& page) : m_rPage(page) {}
+
+	void operator()() const { orthogonalRotation(m_rPage, 90); }
+private:
+	BinaryImage const& m_rPage;
+};
+
+class HShearKernel
+{
+public:
+	HShearKernel(BinaryImage const& page) : m_rPage(page) {}
+
+	void operator()() const {
+		hShear(m_rPage, 0.02, 0.5 * m_rPage.height(), WHITE);
+	}
+private:
+	BinaryImage const& m_rPage;
+};
+
+} // anonymous namespace
+
+void benchTransforms(Runner& runner)
+{
+	if (!runner.wants("transform") && !runner.wants("scaleToGray")
+			&& !runner.wants("orthogonalRotation") && !runner.wants("hShear")) {
+		return;
+	}
+
+	for (size_t i = 0; i < runner.dpis().size(); ++i) {
+		int const dpi = runner.dpis()[i];
+		GrayImage const gray_page(syntheticGrayPage(dpi));
+		BinaryImage const page(gray_page.toQImage());
+
+		QTransform rotation;
+		rotation.rotate(1.5);
+		runner.run(
+			"transform", dpi, page.size(),
+			TransformKernel(gray_page.toQImage(), rotation)
+		);
+		runner.run(
+			"scaleToGray", dpi, page.size(),
+			ScaleToGrayKernel(gray_page, gray_page.size() / 2)
+		);
+		runner.run(
+			"orthogonalRotation", dpi, page.size(),
+			OrthogonalRotationKernel(page)
+		);
+		runner.run("hShear", dpi, page.size(), HShearKernel(page));
+	}
+}
+
+} // namespace benchmarks
+
+} // namespace imageproc
@@ -0,0 +1,134 @@
+/*
+	Scan Tailor - Interactive post-processing tool for scanned pages.
+	Copyright (C)  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "BenchmarkMain.h"
+#include "Runner.h"
+#include "ParallelFor.h"
+#include <QString>
+#include <QStringList>
+#include <vector>
+#include <algorithm>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+namespace imageproc
+{
+
+namespace benchmarks
+{
+
+namespace
+{
+
+void printUsage(char const* program_name)
+{
+	printf(
+		"Usage: %s [options] [filter]\n"
+		"Runs benchmarks whose names contain the filter string.\n"
+		"\t--dpi=<list>\t\tComma separated page resolutions; default: 300,600,1200\n"
+		"\t--repeat=<n>\t\tRuns of each benchmark, the best one counts; default: 3\n"
+		"\t--threads=<n>\t\tThreads available to parallel kernels; default: all\n"
+		"\t--output=<file>\t\tWrite results there as tab separated values\n"
+		"\t--baseline=<file>\tCompare against results written by --output earlier\n"
+		"\t--tolerance=<percent>\tThroughput drop considered a regression; default: 10\n",
+		program_name
+	);
+}
+
+char const* optionValue(char const* arg, char const* option)
+{
+	size_t const len = strlen(option);
+	return strncmp(arg, option, len) == 0 ? arg + len : 0;
+}
+
+} // anonymous namespace
+
+int benchmarkMain(int argc, char** argv,
+	char const* program_name, BenchmarkFunction const* benchmarks)
+{
+	QString filter;
+	std::vector<int> dpis;
+	int repetitions = 3;
+	QString output_file;
+	QString baseline_file;
+	double tolerance_percent = 10.0;
+
+	for (int i = 1; i < argc; ++i) {
+		char const* const arg = argv[i];
+		char const* value = 0;
+		if ((value = optionValue(arg, "--dpi="))) {
+			QStringList const list(QString::fromAscii(value).split(','));
+			for (int j = 0; j < list.size(); ++j) {
+				int const dpi = list[j].toInt();
+				if (dpi > 0) {
+					dpis.push_back(dpi);
+				}
+			}
+		} else if ((value = optionValue(arg, "--repeat="))) {
+			repetitions = atoi(value);
+		} else if ((value = optionValue(arg, "--threads="))) {
+			ParallelFor::setMaxThreads(std::max(1, atoi(value)));
+		} else if ((value = optionValue(arg, "--output="))) {
+			output_file = QString::fromLocal8Bit(value);
+		} else if ((value = optionValue(arg, "--baseline="))) {
+			baseline_file = QString::fromLocal8Bit(value);
+		} else if ((value = optionValue(arg, "--tolerance="))) {
+			tolerance_percent = atof(value);
+		} else if (arg[0] == '-') {
+			printUsage(program_name);
+			return arg[1] == 'h' || strcmp(arg, "--help") == 0 ? 0 : 1;
+		} else {
+			filter = QString::fromAscii(arg);
+		}
+	}
+
+	if (dpis.empty()) {
+		dpis.push_back(300);
+		dpis.push_back(600);
+		dpis.push_back(1200);
+	}
+
+	Runner runner(filter, dpis, repetitions);
+
+	for (; *benchmarks; ++benchmarks) {
+		(*benchmarks)(runner);
+	}
+
+	if (!output_file.isEmpty() && !runner.writeResults(output_file)) {
+		fprintf(stderr, "Failed to write %s\n", output_file.toLocal8Bit().constData());
+		return 1;
+	}
+
+	if (!baseline_file.isEmpty()) {
+		int const regressions = runner.compareWithBaseline(baseline_file, tolerance_percent);
+		if (regressions < 0) {
+			fprintf(stderr, "Failed to read %s\n", baseline_file.toLocal8Bit().constData());
+			return 1;
+		} else if (regressions > 0) {
+			printf("%d regression(s) beyond %.1f%%\n", regressions, tolerance_percent);
+			return 2;
+		}
+	}
+
+	return 0;
+}
+
+} // namespace benchmarks
+
+} // namespace imageproc
@@ -0,0 +1,51 @@
+/*
+	Scan Tailor - Interactive post-processing tool for scanned pages.
+	Copyright (C)  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef IMAGEPROC_BENCHMARKS_BENCHMARK_MAIN_H_
+#define IMAGEPROC_BENCHMARKS_BENCHMARK_MAIN_H_
+
+namespace imageproc
+{
+
+namespace benchmarks
+{
+
+class Runner;
+
+typedef void (*BenchmarkFunction)(Runner& runner);
+
+/**
+ * \brief The main() of a benchmark executable.
+ *
+ * Parses the command line, runs the benchmarks with a Runner configured
+ * accordingly, then writes the results and compares them to a baseline
+ * if asked to.  Run with --help for the options.
+ *
+ * \param argc The argument count passed to main().
+ * \param argv The arguments passed to main().
+ * \param program_name The executable's name, for the usage message.
+ * \param benchmarks A null-terminated array of benchmarks to run.
+ * \return The exit code for main() to return.
+ */
+int benchmarkMain(int argc, char** argv,
+	char const* program_name, BenchmarkFunction const* benchmarks);
+
+} // namespace benchmarks
+
+} // namespace imageproc
+
+#endif
@@ -0,0 +1,59 @@
+/*
+	Scan Tailor - Interactive post-processing tool for scanned pages.
+	Copyright (C)  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef IMAGEPROC_BENCHMARKS_BENCHMARKS_H_
+#define IMAGEPROC_BENCHMARKS_BENCHMARKS_H_
+
+namespace imageproc
+{
+
+namespace benchmarks
+{
+
+class Runner;
+
+void benchGaussBlur(Runner& runner);
+
+/**
+ * \brief binarizeSauvola() and binarizeWolf().
+ */
+void benchBinarize(Runner& runner);
+
+/**
+ * \brief dilateBrick(), erodeBrick(), seedFill() and seedFillGray().
+ */
+void benchMorphology(Runner& runner);
+
+/**
+ * \brief SEDM and ConnectivityMap construction.
+ */
+void benchDistanceMaps(Runner& runner);
+
+/**
+ * \brief transform(), scaleToGray(), orthogonalRotation() and hShear().
+ */
+void benchTransforms(Runner& runner);
+
+void benchSkewFinder(Runner& runner);
+
+} // namespace benchmarks
+
+} // namespace imageproc
+
+#endif
@@ -0,0 +1,195 @@
+/*
+	Scan Tailor - Interactive post-processing tool for scanned pages.
+	Copyright (C)  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "Runner.h"
+#include "AllocationCounter.h"
+#include <QElapsedTimer>
+#include <QFile>
+#include <QIODevice>
+#include <QByteArray>
+#include <QList>
+#include <QMap>
+#include <QPair>
+#include <algorithm>
+#include <stdio.h>
+
+namespace imageproc
+{
+
+namespace benchmarks
+{
+
+Runner::Runner(QString const& filter, std::vector<int> const& dpis, int const repetitions)
+:	m_filter(filter),
+	m_dpis(dpis),
+	m_repetitions(std::max(1, repetitions))
+{
+	printf(
+		"%-24s %5s %12s %10s %10s %10s %10s\n",
+		"benchmark", "dpi", "size", "ms", "MPix/s", "allocs", "peak MiB"
+	);
+}
+
+bool
+Runner::wants(char const* name) const
+{
+	return QString::fromAscii(name).contains(m_filter);
+}
+
+void
+Runner::run(char const* name, int const dpi, QSize const& size,
+	boost::function<void()> const& kernel)
+{
+	if (!wants(name)) {
+		return;
+	}
+
+	Result result;
+	result.name = QString::fromAscii(name);
+	result.dpi = dpi;
+	result.size = size;
+
+	for (int i = 0; i < m_repetitions; ++i) {
+		if (i == 0) {
+			AllocationCounter::reset();
+		}
+
+		QElapsedTimer timer;
+		timer.start();
+		kernel();
+#if QT_VERSION >= 0x040800
+		double const msec = timer.nsecsElapsed() * 1e-6;
+#else
+		double const msec = timer.elapsed();
+#endif
+
+		if (i == 0) {
+			result.msec = msec;
+			if (AllocationCounter::isAvailable()) {
+				result.allocations = AllocationCounter::allocations();
+				result.peakBytes = AllocationCounter::peakBytes();
+			}
+		} else {
+			result.msec = std::min(result.msec, msec);
+		}
+	}
+
+	double const mpix = double(size.width()) * size.height() * 1e-6;
+	result.mpixPerSec = mpix / (std::max(result.msec, 1e-3) * 1e-3);
+
+	QByteArray const size_str(
+		QString::fromAscii("%1x%2").arg(size.width()).arg(size.height()).toAscii()
+	);
+	if (result.allocations >= 0) {
+		printf(
+			"%-24s %5d %12s %10.1f %10.1f %10lld %10.1f\n",
+			name, dpi, size_str.constData(), result.msec, result.mpixPerSec,
+			(long long)result.allocations, result.peakBytes / (1024.0 * 1024.0)
+		);
+	} else {
+		printf(
+			"%-24s %5d %12s %10.1f %10.1f %10s %10s\n",
+			name, dpi, size_str.constData(), result.msec, result.mpixPerSec, "-", "-"
+		);
+	}
+	fflush(stdout);
+
+	m_results.push_back(result);
+}
+
+bool
+Runner::writeResults(QString const& file_path) const
+{
+	QFile file(file_path);
+	if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate | QIODevice::Text)) {
+		return false;
+	}
+
+	QByteArray data("# name\tdpi\twidth\theight\tmsec\tmpix_per_sec\tallocations\tpeak_bytes\n");
+	for (size_t i = 0; i < m_results.size(); ++i) {
+		Result const& r = m_results[i];
+		data += r.name.toUtf8();
+		data += '\t' + QByteArray::number(r.dpi);
+		data += '\t' + QByteArray::number(r.size.width());
+		data += '\t' + QByteArray::number(r.size.height());
+		data += '\t' + QByteArray::number(r.msec, 'f', 3);
+		data += '\t' + QByteArray::number(r.mpixPerSec, 'f', 3);
+		data += '\t' + QByteArray::number(r.allocations);
+		data += '\t' + QByteArray::number(r.peakBytes);
+		data += '\n';
+	}
+
+	return file.write(data) == data.size();
+}
+
+int
+Runner::compareWithBaseline(QString const& file_path, double const tolerance_percent) const
+{
+	QFile file(file_path);
+	if (!file.open(QIODevice::ReadOnly | QIODevice::Text)) {
+		return -1;
+	}
+
+	// (name, dpi) -> MPix/s
+	typedef QMap<QPair<QString, int>, double> Baseline;
+	Baseline baseline;
+	while (!file.atEnd()) {
+		QByteArray const line(file.readLine().trimmed());
+		if (line.isEmpty() || line.startsWith('#')) {
+			continue;
+		}
+
+		QList<QByteArray> const fields(line.split('\t'));
+		if (fields.size() < 6) {
+			continue;
+		}
+		
+		QString const name(QString::fromUtf8(fields[0]));
+		int const dpi = fields[1].toInt();
+		baseline[qMakePair(name, dpi)] = fields[5].toDouble();
+	}
+
+	printf("\nComparison with %s:\n", file_path.toLocal8Bit().constData());
+
+	int regressions = 0;
+	for (size_t i = 0; i < m_results.size(); ++i) {
+		Result const& r = m_results[i];
+		Baseline::const_iterator const it(baseline.find(qMakePair(r.name, r.dpi)));
+		if (it == baseline.end() || it.value() <= 0) {
+			continue;
+		}
+
+		double const change_percent = (r.mpixPerSec / it.value() - 1.0) * 100.0;
+		bool const regression = change_percent < -tolerance_percent;
+		if (regression) {
+			++regressions;
+		}
+		
+		printf(
+			"%-24s %5d %10.1f -> %10.1f MPix/s %+7.1f%%%s\n",
+			r.name.toUtf8().constData(), r.dpi, it.value(), r.mpixPerSec,
+			change_percent, regression ? "  REGRESSION" : ""
+		);
+	}
+
+	return regressions;
+}
+
+} // namespace benchmarks
+
+} // namespace imageproc
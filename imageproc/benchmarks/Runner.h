@@ -0,0 +1,124 @@
+/*
+	Scan Tailor - Interactive post-processing tool for scanned pages.
+	Copyright (C)  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef IMAGEPROC_BENCHMARKS_RUNNER_H_
+#define IMAGEPROC_BENCHMARKS_RUNNER_H_
+
+#include "NonCopyable.h"
+#include <QString>
+#include <QSize>
+#include <QtGlobal>
+#ifndef Q_MOC_RUN
+#include <boost/function.hpp>
+#endif
+#include <vector>
+
+namespace imageproc
+{
+
+namespace benchmarks
+{
+
+/**
+ * \brief Times benchmarked kernels and reports the results.
+ *
+ * Results are printed to stdout as they come.  They can also be saved
+ * in a machine-readable form, and compared against results saved earlier.
+ */
+class Runner
+{
+	DECLARE_NON_COPYABLE(Runner)
+public:
+	struct Result
+	{
+		QString name;
+		int dpi;
+		QSize size;
+		double msec; // The best of all runs.
+		double mpixPerSec;
+		qint64 allocations; // -1 if not available.
+		qint64 peakBytes; // -1 if not available.
+
+		Result() : dpi(0), msec(0), mpixPerSec(0), allocations(-1), peakBytes(-1) {}
+	};
+
+	/**
+	 * \param filter Only benchmarks whose names contain this string will run.
+	 * \param dpis Resolutions of synthetic pages to run benchmarks on.
+	 * \param repetitions How many times to run each benchmark.
+	 */
+	Runner(QString const& filter, std::vector<int> const& dpis, int repetitions);
+
+	std::vector<int> const& dpis() const { return m_dpis; }
+
+	/**
+	 * \brief Checks whether a benchmark passes the filter.
+	 *
+	 * Call it before preparing the input for a benchmark, as that
+	 * may take a while for large pages.
+	 */
+	bool wants(char const* name) const;
+
+	/**
+	 * \brief Runs \p kernel a few times and records the best time.
+	 *
+	 * Allocations are counted during the first run.
+	 *
+	 * \param name The benchmark name.  Doesn't need to pass the filter,
+	 *        as that's checked here.
+	 * \param dpi The resolution of the page being processed.
+	 * \param size The dimensions of the page being processed.
+	 *        Used to calculate megapixels per second.
+	 * \param kernel The operation to time.
+	 */
+	void run(char const* name, int dpi, QSize const& size,
+		boost::function<void()> const& kernel);
+
+	std::vector<Result> const& results() const { return m_results; }
+
+	/**
+	 * \brief Writes results as tab separated values.
+	 *
+	 * \return false if the file couldn't be written.
+	 */
+	bool writeResults(QString const& file_path) const;
+
+	/**
+	 * \brief Compares results against ones previously saved by writeResults().
+	 *
+	 * The comparison is printed to stdout.  Results missing on either side
+	 * are ignored.
+	 *
+	 * \param file_path The file to load the baseline from.
+	 * \param tolerance_percent The throughput drop, in percent, beyond which
+	 *        a result is considered a regression.
+	 * \return The number of regressions, or -1 if the baseline couldn't be read.
+	 */
+	int compareWithBaseline(QString const& file_path, double tolerance_percent) const;
+private:
+	QString m_filter;
+	std::vector<int> m_dpis;
+	int m_repetitions;
+	std::vector<Result> m_results;
+};
+
+} // namespace benchmarks
+
+} // namespace imageproc
+
+#endif
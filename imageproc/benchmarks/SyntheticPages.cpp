@@ -0,0 +1,149 @@
+/*
+	Scan Tailor - Interactive post-processing tool for scanned pages.
+	Copyright (C)  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "SyntheticPages.h"
+#include "GrayImage.h"
+#include "BinaryImage.h"
+#include "BinaryThreshold.h"
+#include <QSize>
+#include <vector>
+#include <algorithm>
+#include <stdint.h>
+
+namespace imageproc
+{
+
+namespace benchmarks
+{
+
+namespace
+{
+
+/**
+ * A tiny linear congruential generator.  Unlike rand(), it produces
+ * the same sequence everywhere, so pages are the same on all platforms.
+ */
+class Lcg
+{
+public:
+	explicit Lcg(uint32_t seed) : m_state(seed) {}
+
+	/** Returns a number in [0, limit). */
+	int next(int limit) {
+		m_state = m_state * 1664525u + 1013904223u;
+		return int((m_state >> 8) % uint32_t(limit));
+	}
+private:
+	uint32_t m_state;
+};
+
+} // anonymous namespace
+
+QSize a4PageSize(int const dpi)
+{
+	// 210 x 297 mm.
+	return QSize(dpi * 210 * 10 / 254, dpi * 297 * 10 / 254);
+}
+
+GrayImage syntheticGrayPage(int const dpi)
+{
+	QSize const size(a4PageSize(dpi));
+	int const width = size.width();
+	int const height = size.height();
+	int const margin = dpi; // One inch.
+	int const line_pitch = dpi / 6;
+	int const glyph_height = dpi / 12;
+	int const min_glyph_width = std::max(1, dpi / 40);
+	int const max_glyph_width = std::max(min_glyph_width + 1, dpi / 15);
+	int const glyph_gap = std::max(1, dpi / 100);
+	int const word_gap = std::max(1, dpi / 25);
+
+	Lcg rng(dpi);
+	std::vector<uint8_t> ink(width);
+
+	GrayImage page(size);
+	uint8_t* line = page.data();
+	int const stride = page.stride();
+	int text_line_top = margin;
+
+	for (int y = 0; y < height; ++y, line += stride) {
+		if (y == text_line_top + line_pitch) {
+			text_line_top += line_pitch;
+		}
+		if (y == text_line_top) {
+			// Lay out the glyphs of the next text line.
+			std::fill(ink.begin(), ink.end(), 0);
+			int x = margin + rng.next(word_gap);
+			while (x < width - margin) {
+				int const glyph_width = min_glyph_width
+					+ rng.next(max_glyph_width - min_glyph_width);
+				std::fill(ink.begin() + x, ink.begin() + std::min(x + glyph_width, width - margin), 1);
+				x += glyph_width + (rng.next(5) == 0 ? word_gap : glyph_gap);
+			}
+		}
+
+		bool const in_text = y >= text_line_top && y < text_line_top + glyph_height
+			&& y < height - margin;
+
+		for (int x = 0; x < width; ++x) {
+			int const noise = rng.next(17) - 8;
+			if (in_text && ink[x]) {
+				line[x] = static_cast<uint8_t>(40 + noise);
+			} else {
+				// Brighter towards the right side.
+				line[x] = static_cast<uint8_t>(205 + x * 30 / width + noise);
+			}
+		}
+	}
+
+	return page;
+}
+
+GrayImage syntheticCurvedPage(int const dpi, double const curvature)
+{
+	QSize const size(a4PageSize(dpi));
+	int const width = size.width();
+	int const height = size.height();
+
+	Lcg rng(dpi);
+
+	GrayImage page(size);
+	uint8_t* line = page.data();
+	int const stride = page.stride();
+
+	for (int y = 0; y < height; ++y, line += stride) {
+		for (int x = 0; x < width; ++x) {
+			double const u = double(x) / width - 0.5;
+			double const bend = curvature * height * u * u;
+			bool const on_page = y >= 0.1 * height + bend && y < 0.9 * height - bend;
+			int const noise = rng.next(33) - 16;
+			line[x] = static_cast<uint8_t>((on_page ? 220 : 50) + noise);
+		}
+	}
+
+	return page;
+}
+
+BinaryImage syntheticBinaryPage(int const dpi)
+{
+	return BinaryImage(syntheticGrayPage(dpi).toQImage(), BinaryThreshold(128));
+}
+
+} // namespace benchmarks
+
+} // namespace imageproc
@@ -0,0 +1,63 @@
+/*
+	Scan Tailor - Interactive post-processing tool for scanned pages.
+	Copyright (C)  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef IMAGEPROC_BENCHMARKS_SYNTHETIC_PAGES_H_
+#define IMAGEPROC_BENCHMARKS_SYNTHETIC_PAGES_H_
+
+#include <QSize>
+
+namespace imageproc
+{
+
+class GrayImage;
+class BinaryImage;
+
+namespace benchmarks
+{
+
+/**
+ * \brief The size of an A4 page scanned at a given resolution.
+ */
+QSize a4PageSize(int dpi);
+
+/**
+ * \brief A synthetic A4 page with lines of text-like blobs.
+ *
+ * The background has a horizontal illumination gradient and some noise.
+ * The content only depends on \p dpi, not on the platform.
+ */
+GrayImage syntheticGrayPage(int dpi);
+
+/**
+ * \brief syntheticGrayPage() binarized with a fixed threshold.
+ */
+BinaryImage syntheticBinaryPage(int dpi);
+
+/**
+ * \brief A light A4 page on a dark background, as a camera sees an open book.
+ *
+ * The top and bottom edges of the page bend towards the middle, the more
+ * the larger \p curvature is.  Zero gives straight edges.  Like
+ * syntheticGrayPage(), the content only depends on the arguments.
+ */
+GrayImage syntheticCurvedPage(int dpi, double curvature);
+
+} // namespace benchmarks
+
+} // namespace imageproc
+
+#endif
@@ -18,12 +18,17 @@
 
 #include "Binarize.h"
 #include "BinaryImage.h"
+#include "BWColor.h"
+#include "Grayscale.h"
 #include "Utils.h"
 #include <QImage>
 #include <QSize>
 #ifndef Q_MOC_RUN
 #include <boost/test/auto_unit_test.hpp>
 #endif
+#include <algorithm>
+#include <math.h>
+#include <stdint.h>
 
 namespace imageproc
 {
@@ -33,6 +38,123 @@ namespace tests
 
 using namespace utils;
 
+namespace
+{
+
+int grayLevel(QImage const& gray, int const x, int const y)
+{
+	return gray.bits()[y * gray.bytesPerLine() + x];
+}
+
+void setBlack(BinaryImage& image, int const x, int const y)
+{
+	image.data()[y * image.wordsPerLine() + (x >> 5)] |= (uint32_t(1) << 31) >> (x & 31);
+}
+
+/**
+ * The mean and the standard deviation of a window,
+ * summing its pixels one by one.
+ */
+void windowStats(
+	QImage const& gray, QSize const& window_size, int const x, int const y,
+	double& mean, double& deviation)
+{
+	int const top = std::max(0, y - (window_size.height() >> 1));
+	int const bottom = std::min(gray.height(), y + window_size.height() - (window_size.height() >> 1));
+	int const left = std::max(0, x - (window_size.width() >> 1));
+	int const right = std::min(gray.width(), x + window_size.width() - (window_size.width() >> 1));
+
+	uint64_t sum = 0;
+	uint64_t sqsum = 0;
+	for (int wy = top; wy < bottom; ++wy) {
+		uint8_t const* line = gray.bits() + wy * gray.bytesPerLine();
+		for (int wx = left; wx < right; ++wx) {
+			sum += line[wx];
+			sqsum += line[wx] * line[wx];
+		}
+	}
+
+	double const r_area = 1.0 / ((bottom - top) * (right - left));
+	mean = double(sum) * r_area;
+	double const variance = double(sqsum) * r_area - mean * mean;
+	deviation = sqrt(fabs(variance));
+}
+
+BinaryImage referenceSauvola(QImage const& src, QSize const& window_size)
+{
+	QImage const gray(toGrayscale(src));
+	BinaryImage dst(gray.size(), WHITE);
+	for (int y = 0; y < gray.height(); ++y) {
+		for (int x = 0; x < gray.width(); ++x) {
+			double mean, deviation;
+			windowStats(gray, window_size, x, y, mean, deviation);
+			double const threshold = mean * (1.0 + 0.34 * (deviation / 128.0 - 1.0));
+			if (grayLevel(gray, x, y) < threshold) {
+				setBlack(dst, x, y);
+			}
+		}
+	}
+	return dst;
+}
+
+BinaryImage referenceWolf(QImage const& src, QSize const& window_size)
+{
+	QImage const gray(toGrayscale(src));
+
+	double max_deviation = 0;
+	int min_gray_level = 255;
+	for (int y = 0; y < gray.height(); ++y) {
+		for (int x = 0; x < gray.width(); ++x) {
+			double mean, deviation;
+			windowStats(gray, window_size, x, y, mean, deviation);
+			max_deviation = std::max(max_deviation, deviation);
+			min_gray_level = std::min(min_gray_level, grayLevel(gray, x, y));
+		}
+	}
+
+	BinaryImage dst(gray.size(), WHITE);
+	for (int y = 0; y < gray.height(); ++y) {
+		for (int x = 0; x < gray.width(); ++x) {
+			double mean_d, deviation_d;
+			windowStats(gray, window_size, x, y, mean_d, deviation_d);
+			float const mean = mean_d;
+			float const deviation = deviation_d;
+			double const a = 1.0 - deviation / max_deviation;
+			double const threshold = mean - 0.3 * a * (mean - float(min_gray_level));
+			int const pixel = grayLevel(gray, x, y);
+			if (pixel < 1 || (pixel <= 254 && pixel < threshold)) {
+				setBlack(dst, x, y);
+			}
+		}
+	}
+	return dst;
+}
+
+class BinarizeOp
+{
+public:
+	typedef BinaryImage result_type;
+
+	enum Method { SAUVOLA, WOLF };
+
+	BinarizeOp(Method method, QImage const& img, QSize window)
+	: m_method(method), m_rImg(img), m_window(window) {}
+
+	result_type operator()() const {
+		if (m_method == SAUVOLA) {
+			return binarizeSauvola(m_rImg, m_window);
+		} else {
+			return binarizeWolf(m_rImg, m_window);
+		}
+	}
+private:
+	Method m_method;
+	QImage const& m_rImg;
+	QSize m_window;
+};
+
+} // anonymous namespace
+
 BOOST_AUTO_TEST_SUITE(BinarizeTestSuite);
 #if 0
 BOOST_AUTO_TEST_CASE(test)
@@ -41,6 +163,35 @@ BOOST_AUTO_TEST_CASE(test)
 	binarizeWolf(img).toQImage().save("out.png");
 }
 #endif
+
+BOOST_AUTO_TEST_CASE(test_matches_reference)
+{
+	static int const sizes[][2] = {
+		{ 1, 1 }, { 37, 20 }, { 101, 67 }
+	};
+	static int const windows[][2] = {
+		{ 1, 1 }, { 5, 9 }, { 31, 31 }, { 200, 3 }
+	};
+
+	for (unsigned i = 0; i < sizeof(sizes) / sizeof(sizes[0]); ++i) {
+		QImage const img(randomGrayImage(sizes[i][0], sizes[i][1]));
+		for (unsigned j = 0; j < sizeof(windows) / sizeof(windows[0]); ++j) {
+			QSize const window(windows[j][0], windows[j][1]);
+			BOOST_CHECK(binarizeSauvola(img, window) == referenceSauvola(img, window));
+			BOOST_CHECK(binarizeWolf(img, window) == referenceWolf(img, window));
+		}
+	}
+}
+
+BOOST_AUTO_TEST_CASE(test_independent_of_thread_count)
+{
+	QImage const img(randomGrayImage(300, 1200));
+	QSize const window(5, 5);
+
+	BOOST_CHECK(sameForAnyThreadCount(BinarizeOp(BinarizeOp::SAUVOLA, img, window)));
+	BOOST_CHECK(sameForAnyThreadCount(BinarizeOp(BinarizeOp::WOLF, img, window)));
+}
+
 BOOST_AUTO_TEST_SUITE_END();
 
 } // namespace tests
@@ -18,8 +18,13 @@
 
 #include "BinaryImage.h"
 #include "BWColor.h"
+#include "FileBackedMemory.h"
+#include "PackedThreshold.h"
+#include "BinaryThreshold.h"
+#include "GrayImage.h"
 #include "Utils.h"
 #include <QImage>
+#include <QDir>
 #ifndef Q_MOC_RUN
 #include <boost/test/auto_unit_test.hpp>
 #endif
@@ -161,6 +166,52 @@ BOOST_AUTO_TEST_CASE(test_content_bounding_box4)
 	BOOST_CHECK(img.contentBoundingBox() == QRect(1, 1, 6, 6));
 }
 
+BOOST_AUTO_TEST_CASE(test_simd_matches_scalar)
+{
+	int const w = 1000;
+	int const h = 20;
+	QImage qimg_argb32(w, h, QImage::Format_ARGB32);
+	for (int y = 0; y < h; ++y) {
+		for (int x = 0; x < w; ++x) {
+			qimg_argb32.setPixel(x, y, (rand() & 0xffff) | ((rand() & 0xffff) << 16));
+		}
+	}
+	QImage const qimg_rgb32(qimg_argb32.convertToFormat(QImage::Format_RGB32));
+	QImage const qimg_argb32_pm(qimg_argb32.convertToFormat(QImage::Format_ARGB32_Premultiplied));
+	QImage const qimg_gray(GrayImage(qimg_rgb32).toQImage());
+
+	static int const thresholds[] = { 0, 1, 100, 128, 255, 256 };
+	for (unsigned i = 0; i < sizeof(thresholds)/sizeof(thresholds[0]); ++i) {
+		BinaryThreshold const threshold(thresholds[i]);
+
+		PackedThreshold::forceScalar(true);
+		BinaryImage const rgb32_scalar(qimg_rgb32, threshold);
+		BinaryImage const argb32_pm_scalar(qimg_argb32_pm, threshold);
+		BinaryImage const gray_scalar(qimg_gray, threshold);
+
+		PackedThreshold::forceScalar(false);
+		BOOST_CHECK(BinaryImage(qimg_rgb32, threshold) == rgb32_scalar);
+		BOOST_CHECK(BinaryImage(qimg_argb32_pm, threshold) == argb32_pm_scalar);
+		BOOST_CHECK(BinaryImage(qimg_gray, threshold) == gray_scalar);
+	}
+}
+
+BOOST_AUTO_TEST_CASE(test_file_backed)
+{
+	QImage const q_image(randomMonoQImage(100, 100));
+
+	FileBackedMemory::enable(QDir::tempPath(), 0);
+	BinaryImage image(q_image);
+	BinaryImage const copy(image);
+	image.invert();
+	BinaryImage const inverted(image);
+	FileBackedMemory::disable();
+
+	// On platforms without file backing, this just tests the heap.
+	BOOST_CHECK(copy.toQImage() == q_image);
+	BOOST_CHECK(inverted == BinaryImage(q_image).inverted());
+}
+
 BOOST_AUTO_TEST_SUITE_END();
 
 } // namespace tests
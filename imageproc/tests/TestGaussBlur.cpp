@@ -0,0 +1,204 @@
+/*
+	Scan Tailor - Interactive post-processing tool for scanned pages.
+	Copyright (C)  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "GaussBlur.h"
+#include "GrayImage.h"
+#include "Utils.h"
+#include <QSize>
+#ifndef Q_MOC_RUN
+#include <boost/test/auto_unit_test.hpp>
+#endif
+#include <vector>
+#include <stdlib.h>
+#include <math.h>
+
+namespace imageproc
+{
+
+namespace tests
+{
+
+using namespace gauss_blur_impl;
+using namespace utils;
+
+BOOST_AUTO_TEST_SUITE(GaussBlurTestSuite);
+
+namespace
+{
+
+class FloatWriter
+{
+public:
+	void operator()(float& dst, float src) const { dst = src; }
+};
+
+/**
+ * Filters a single sequence, the way gaussBlurGeneric() used to do it
+ * for each column and each row.
+ */
+void filterSequence(IirCoefficients const& c, int length,
+	float const* src, int src_stride, float* dst, int dst_stride)
+{
+	std::vector<float> val_p(length, 0.0f);
+	std::vector<float> val_m(length, 0.0f);
+
+	float const initial_p = src[0];
+	float const initial_m = src[(length - 1) * src_stride];
+
+	for (int n = 0; n < length; ++n) {
+		int const n_m = length - 1 - n;
+		int const terms = n < 4 ? n : 4;
+		int i = 0;
+		for (; i <= terms; ++i) {
+			val_p[n] += c.n_p[i] * src[(n - i) * src_stride] - c.d_p[i] * val_p[n - i];
+			val_m[n_m] += c.n_m[i] * src[(n_m + i) * src_stride] - c.d_m[i] * val_m[n_m + i];
+		}
+		for (; i <= 4; ++i) {
+			val_p[n] += (c.n_p[i] - c.bd_p[i]) * initial_p;
+			val_m[n_m] += (c.n_m[i] - c.bd_m[i]) * initial_m;
+		}
+	}
+
+	for (int n = 0; n < length; ++n) {
+		dst[n * dst_stride] = val_p[n] + val_m[n];
+	}
+}
+
+std::vector<float> referenceBlur(
+	std::vector<float> const& input, int width, int height,
+	float h_sigma, float v_sigma)
+{
+	std::vector<float> intermediate(width * height);
+	IirCoefficients const v_coeffs(v_sigma);
+	for (int x = 0; x < width; ++x) {
+		filterSequence(v_coeffs, height, &input[x], width, &intermediate[x], width);
+	}
+
+	std::vector<float> output(width * height);
+	IirCoefficients const h_coeffs(h_sigma);
+	for (int y = 0; y < height; ++y) {
+		filterSequence(
+			h_coeffs, width, &intermediate[y * width], 1, &output[y * width], 1
+		);
+	}
+
+	return output;
+}
+
+std::vector<float> randomData(int width, int height)
+{
+	std::vector<float> data(width * height);
+	for (size_t i = 0; i < data.size(); ++i) {
+		data[i] = float(rand() & 0xff);
+	}
+	return data;
+}
+
+std::vector<float> blur(
+	std::vector<float> const& input, int width, int height,
+	float h_sigma, float v_sigma)
+{
+	std::vector<float> output(width * height);
+	gaussBlurGeneric(
+		QSize(width, height), h_sigma, v_sigma,
+		&input[0], width, StaticCastValueConv<float>(),
+		&output[0], width, FloatWriter()
+	);
+	return output;
+}
+
+class BlurOp
+{
+public:
+	typedef std::vector<float> result_type;
+
+	BlurOp(std::vector<float> const& input, int width, int height)
+	: m_rInput(input), m_width(width), m_height(height) {}
+
+	result_type operator()() const {
+		return blur(m_rInput, m_width, m_height, 3.0f, 3.0f);
+	}
+private:
+	std::vector<float> const& m_rInput;
+	int m_width;
+	int m_height;
+};
+
+} // anonymous namespace
+
+BOOST_AUTO_TEST_CASE(test_null_image)
+{
+	BOOST_CHECK(gaussBlur(GrayImage(), 2.0f, 2.0f).isNull());
+}
+
+BOOST_AUTO_TEST_CASE(test_matches_reference)
+{
+	static int const sizes[][2] = {
+		{ 1, 1 }, { 1, 9 }, { 9, 1 }, { 3, 5 },
+		{ 8, 8 }, { 17, 4 }, { 67, 131 }, { 300, 257 }
+	};
+	int const num_sizes = sizeof(sizes) / sizeof(sizes[0]);
+
+	for (int i = 0; i < num_sizes; ++i) {
+		int const w = sizes[i][0];
+		int const h = sizes[i][1];
+		std::vector<float> const input(randomData(w, h));
+
+		std::vector<float> const expected(referenceBlur(input, w, h, 1.5f, 4.0f));
+		std::vector<float> const actual(blur(input, w, h, 1.5f, 4.0f));
+
+		// The lane-wise computation performs the same operations in the same
+		// order, so normally the results are bit-exact.  We still allow for
+		// the compiler contracting things into FMA instructions differently.
+		for (int j = 0; j < w * h; ++j) {
+			BOOST_REQUIRE(fabs(expected[j] - actual[j]) <= 1e-4f * (1.0f + fabs(expected[j])));
+		}
+	}
+}
+
+BOOST_AUTO_TEST_CASE(test_independent_of_thread_count)
+{
+	int const w = 1021;
+	int const h = 1499;
+	std::vector<float> const input(randomData(w, h));
+
+	BOOST_CHECK(sameForAnyThreadCount(BlurOp(input, w, h)));
+}
+
+BOOST_AUTO_TEST_CASE(test_in_place)
+{
+	int const w = 97;
+	int const h = 55;
+	std::vector<float> data(randomData(w, h));
+	std::vector<float> const expected(blur(data, w, h, 2.0f, 2.0f));
+
+	gaussBlurGeneric(
+		QSize(w, h), 2.0f, 2.0f,
+		&data[0], w, StaticCastValueConv<float>(),
+		&data[0], w, FloatWriter()
+	);
+
+	BOOST_CHECK(data == expected);
+}
+
+BOOST_AUTO_TEST_SUITE_END();
+
+} // namespace tests
+
+} // namespace imageproc
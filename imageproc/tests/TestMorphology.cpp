@@ -20,10 +20,12 @@
 #include "GrayImage.h"
 #include "BinaryImage.h"
 #include "BWColor.h"
+#include "PackedMorphology.h"
 #include "Utils.h"
 #include <QImage>
 #include <QSize>
 #include <QPoint>
+#include <QRect>
 #ifndef Q_MOC_RUN
 #include <boost/test/auto_unit_test.hpp>
 #endif
@@ -36,6 +38,70 @@ namespace tests
 
 using namespace utils;
 
+namespace
+{
+
+/**
+ * Switches PackedMorphology back to the best implementation on scope exit.
+ */
+class ForceScalarGuard
+{
+public:
+	ForceScalarGuard() { PackedMorphology::forceScalar(true); }
+
+	~ForceScalarGuard() { PackedMorphology::forceScalar(false); }
+};
+
+class BinaryBrickOp
+{
+public:
+	typedef BinaryImage result_type;
+	
+	enum Op { DILATE, CLOSE };
+	
+	BinaryBrickOp(Op op, BinaryImage const& img, QSize brick, QRect area)
+	: m_op(op), m_rImg(img), m_brick(brick), m_area(area) {}
+	
+	result_type operator()() const {
+		if (m_op == DILATE) {
+			return dilateBrick(m_rImg, m_brick, m_area, WHITE);
+		} else {
+			return closeBrick(m_rImg, m_brick, m_area, WHITE);
+		}
+	}
+private:
+	Op m_op;
+	BinaryImage const& m_rImg;
+	QSize m_brick;
+	QRect m_area;
+};
+
+class GrayBrickOp
+{
+public:
+	typedef GrayImage result_type;
+	
+	enum Op { ERODE, OPEN };
+	
+	GrayBrickOp(Op op, GrayImage const& img, QSize brick, QRect area)
+	: m_op(op), m_rImg(img), m_brick(brick), m_area(area) {}
+	
+	result_type operator()() const {
+		if (m_op == ERODE) {
+			return erodeGray(m_rImg, m_brick, m_area, 0xff);
+		} else {
+			return openGray(m_rImg, m_brick, m_area, 0xff);
+		}
+	}
+private:
+	Op m_op;
+	GrayImage const& m_rImg;
+	QSize m_brick;
+	QRect m_area;
+};
+
+} // anonymous namespace
+
 BOOST_AUTO_TEST_SUITE(MorphologyTestSuite);
 
 BOOST_AUTO_TEST_CASE(test_dilate_1x1)
@@ -1329,6 +1395,51 @@ BOOST_AUTO_TEST_CASE(test_hmr_1)
 	BOOST_CHECK(hitMissReplace(img, BLACK, pattern, 3, 3) == control);
 }
 
+BOOST_AUTO_TEST_CASE(test_packed_matches_scalar)
+{
+	static int const sizes[][2] = {
+		{ 1, 1 }, { 31, 7 }, { 32, 5 }, { 33, 9 }, { 100, 40 }, { 517, 63 }
+	};
+	static int const bricks[][2] = {
+		{ 1, 1 }, { 3, 1 }, { 1, 5 }, { 3, 3 }, { 9, 4 }, { 40, 33 }
+	};
+	
+	for (unsigned i = 0; i < sizeof(sizes) / sizeof(sizes[0]); ++i) {
+		BinaryImage const img(randomBinaryImage(sizes[i][0], sizes[i][1]));
+		GrayImage const gray(randomGrayImage(sizes[i][0], sizes[i][1]));
+		QRect const area(img.rect().adjusted(-5, -3, 7, 2));
+		
+		for (unsigned j = 0; j < sizeof(bricks) / sizeof(bricks[0]); ++j) {
+			Brick const brick(QSize(bricks[j][0], bricks[j][1]));
+			
+			BinaryImage const dilated(dilateBrick(img, brick, area, WHITE));
+			BinaryImage const eroded(erodeBrick(img, brick, area, BLACK));
+			GrayImage const gray_dilated(dilateGray(gray, brick, area, 0xff));
+			GrayImage const gray_eroded(erodeGray(gray, brick, area, 0x00));
+			
+			ForceScalarGuard const guard;
+			BOOST_REQUIRE(dilateBrick(img, brick, area, WHITE) == dilated);
+			BOOST_REQUIRE(erodeBrick(img, brick, area, BLACK) == eroded);
+			BOOST_REQUIRE(dilateGray(gray, brick, area, 0xff) == gray_dilated);
+			BOOST_REQUIRE(erodeGray(gray, brick, area, 0x00) == gray_eroded);
+		}
+	}
+}
+
+BOOST_AUTO_TEST_CASE(test_independent_of_thread_count)
+{
+	// Narrow and tall, to get many bands.
+	BinaryImage const img(randomBinaryImage(67, 4001));
+	GrayImage const gray(randomGrayImage(67, 4001));
+	QRect const area(img.rect().adjusted(-3, -10, 3, 10));
+	QSize const brick(5, 7);
+	
+	BOOST_CHECK(sameForAnyThreadCount(BinaryBrickOp(BinaryBrickOp::DILATE, img, brick, area)));
+	BOOST_CHECK(sameForAnyThreadCount(BinaryBrickOp(BinaryBrickOp::CLOSE, img, brick, area)));
+	BOOST_CHECK(sameForAnyThreadCount(GrayBrickOp(GrayBrickOp::ERODE, gray, brick, area)));
+	BOOST_CHECK(sameForAnyThreadCount(GrayBrickOp(GrayBrickOp::OPEN, gray, brick, area)));
+}
+
 BOOST_AUTO_TEST_SUITE_END();
 
 } // namespace tests
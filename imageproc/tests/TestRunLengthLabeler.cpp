@@ -0,0 +1,265 @@
+/*
+	Scan Tailor - Interactive post-processing tool for scanned pages.
+	Copyright (C)  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "RunLengthLabeler.h"
+#include "ConnectivityMap.h"
+#include "ConnComp.h"
+#include "BinaryImage.h"
+#include "RasterOp.h"
+#include "BWColor.h"
+#include "Utils.h"
+#include <QPoint>
+#include <QRect>
+#include <QSize>
+#ifndef Q_MOC_RUN
+#include <boost/test/auto_unit_test.hpp>
+#endif
+#include <vector>
+#include <deque>
+#include <algorithm>
+#include <stdint.h>
+
+namespace imageproc
+{
+
+namespace tests
+{
+
+using namespace utils;
+
+namespace
+{
+
+bool isBlack(BinaryImage const& image, int const x, int const y)
+{
+	uint32_t const* line = image.data() + y * image.wordsPerLine();
+	return (line[x >> 5] >> (31 - (x & 31))) & 1;
+}
+
+/**
+ * A straightforward flood fill, labeling components in the order
+ * their first pixels are encountered.
+ */
+std::vector<uint32_t> referenceLabels(
+	BinaryImage const& image, Connectivity const conn,
+	std::vector<ConnComp>& comps)
+{
+	int const width = image.width();
+	int const height = image.height();
+	std::vector<uint32_t> labels(width * height, 0);
+	comps.clear();
+
+	for (int y = 0; y < height; ++y) {
+		for (int x = 0; x < width; ++x) {
+			if (!isBlack(image, x, y) || labels[y * width + x]) {
+				continue;
+			}
+
+			uint32_t const label = comps.size() + 1;
+			QRect rect(x, y, 1, 1);
+			int pix_count = 0;
+
+			std::deque<QPoint> queue;
+			queue.push_back(QPoint(x, y));
+			labels[y * width + x] = label;
+			while (!queue.empty()) {
+				QPoint const pt(queue.front());
+				queue.pop_front();
+				++pix_count;
+				rect |= QRect(pt, QSize(1, 1));
+
+				for (int dy = -1; dy <= 1; ++dy) {
+					for (int dx = -1; dx <= 1; ++dx) {
+						if ((dx == 0 && dy == 0) || (conn == CONN4 && dx != 0 && dy != 0)) {
+							continue;
+						}
+						int const nx = pt.x() + dx;
+						int const ny = pt.y() + dy;
+						if (nx < 0 || ny < 0 || nx >= width || ny >= height) {
+							continue;
+						}
+						if (isBlack(image, nx, ny) && !labels[ny * width + nx]) {
+							labels[ny * width + nx] = label;
+							queue.push_back(QPoint(nx, ny));
+						}
+					}
+				}
+			}
+
+			comps.push_back(ConnComp(QPoint(x, y), rect, pix_count));
+		}
+	}
+
+	return labels;
+}
+
+bool sameLabels(ConnectivityMap const& cmap, std::vector<uint32_t> const& control)
+{
+	int const width = cmap.size().width();
+	int const height = cmap.size().height();
+	uint32_t const* line = cmap.data();
+	for (int y = 0; y < height; ++y, line += cmap.stride()) {
+		if (!std::equal(line, line + width, control.begin() + y * width)) {
+			return false;
+		}
+	}
+	return true;
+}
+
+bool sameComponents(std::vector<ConnComp> const& comps, std::vector<ConnComp> const& control)
+{
+	if (comps.size() != control.size()) {
+		return false;
+	}
+	for (size_t i = 0; i < comps.size(); ++i) {
+		if (comps[i].rect() != control[i].rect()
+				|| comps[i].pixCount() != control[i].pixCount()
+				|| comps[i].seed() != control[i].seed()) {
+			return false;
+		}
+	}
+	return true;
+}
+
+} // anonymous namespace
+
+BOOST_AUTO_TEST_SUITE(RunLengthLabelerTestSuite);
+
+BOOST_AUTO_TEST_CASE(test_null_image)
+{
+	RunLengthLabeler const labeler((BinaryImage()), CONN8);
+	BOOST_CHECK_EQUAL(labeler.numComponents(), 0u);
+	BOOST_CHECK(labeler.components().empty());
+}
+
+BOOST_AUTO_TEST_CASE(test_diagonal_connectivity)
+{
+	static int const inp[] = {
+		1, 0, 0, 1,
+		0, 1, 1, 0,
+		0, 0, 0, 0,
+		1, 0, 1, 1
+	};
+
+	BinaryImage const img(makeBinaryImage(inp, 4, 4));
+	BOOST_CHECK_EQUAL(RunLengthLabeler(img, CONN8).numComponents(), 3u);
+	BOOST_CHECK_EQUAL(RunLengthLabeler(img, CONN4).numComponents(), 5u);
+}
+
+BOOST_AUTO_TEST_CASE(test_matches_flood_fill)
+{
+	static int const sizes[][2] = {
+		{ 1, 1 }, { 1, 50 }, { 50, 1 }, { 31, 17 },
+		{ 32, 32 }, { 33, 40 }, { 95, 64 }, { 301, 257 }
+	};
+
+	for (unsigned i = 0; i < sizeof(sizes) / sizeof(sizes[0]); ++i) {
+		BinaryImage const img(randomBinaryImage(sizes[i][0], sizes[i][1]));
+		for (int c = 0; c < 2; ++c) {
+			Connectivity const conn = c == 0 ? CONN4 : CONN8;
+
+			std::vector<ConnComp> control_comps;
+			std::vector<uint32_t> const control(referenceLabels(img, conn, control_comps));
+
+			RunLengthLabeler const labeler(img, conn);
+			BOOST_REQUIRE_EQUAL(labeler.numComponents(), control_comps.size());
+			BOOST_REQUIRE(sameComponents(labeler.components(), control_comps));
+
+			ConnectivityMap const cmap(img, conn);
+			BOOST_REQUIRE_EQUAL(cmap.maxLabel(), control_comps.size());
+			BOOST_REQUIRE(sameLabels(cmap, control));
+		}
+	}
+}
+
+BOOST_AUTO_TEST_CASE(test_independent_of_thread_count)
+{
+	ThreadLimitGuard const guard;
+
+	// Sparse enough for components to span band boundaries.
+	BinaryImage img(randomBinaryImage(203, 1501));
+	rasterOp<RopAnd<RopSrc, RopDst> >(img, randomBinaryImage(203, 1501));
+
+	std::vector<ConnComp> control_comps;
+	std::vector<uint32_t> const control(referenceLabels(img, CONN8, control_comps));
+
+	int const thread_counts[] = { 1, 2, 3, 8 };
+	for (int i = 0; i < 4; ++i) {
+		ParallelFor::setMaxThreads(thread_counts[i]);
+		RunLengthLabeler const labeler(img, CONN8);
+		BOOST_REQUIRE(sameComponents(labeler.components(), control_comps));
+
+		ConnectivityMap const cmap(img, CONN8);
+		BOOST_REQUIRE(sameLabels(cmap, control));
+	}
+}
+
+BOOST_AUTO_TEST_CASE(test_remapped_labels)
+{
+	BinaryImage const img(randomBinaryImage(301, 257));
+
+	std::vector<ConnComp> control_comps;
+	std::vector<uint32_t> control(referenceLabels(img, CONN8, control_comps));
+
+	std::vector<uint32_t> remapping(control_comps.size() + 1, 0);
+	for (uint32_t label = 1; label < remapping.size(); ++label) {
+		remapping[label] = label % 3 + 1;
+	}
+	for (size_t i = 0; i < control.size(); ++i) {
+		control[i] = remapping[control[i]];
+	}
+
+	RunLengthLabeler const labeler(img, CONN8);
+	ConnectivityMap cmap(img.size());
+	labeler.writeLabels(cmap.data(), cmap.stride(), remapping);
+	BOOST_CHECK(sameLabels(cmap, control));
+}
+
+BOOST_AUTO_TEST_CASE(test_erase_components)
+{
+	// Long runs, so that some of them cross word boundaries.
+	BinaryImage img(randomBinaryImage(301, 257));
+	rasterOp<RopOr<RopSrc, RopDst> >(img, randomBinaryImage(301, 257));
+
+	std::vector<ConnComp> control_comps;
+	std::vector<uint32_t> const control(referenceLabels(img, CONN4, control_comps));
+
+	std::vector<uint8_t> erase(control_comps.size() + 1, 0);
+	for (uint32_t label = 1; label < erase.size(); label += 2) {
+		erase[label] = 1;
+	}
+
+	BinaryImage erased(img);
+	RunLengthLabeler(img, CONN4).eraseComponents(erased, erase);
+
+	bool ok = true;
+	for (int y = 0; y < img.height(); ++y) {
+		for (int x = 0; x < img.width(); ++x) {
+			uint32_t const label = control[y * img.width() + x];
+			bool const expect_black = label != 0 && !erase[label];
+			ok = ok && isBlack(erased, x, y) == expect_black;
+		}
+	}
+	BOOST_CHECK(ok);
+}
+
+BOOST_AUTO_TEST_SUITE_END();
+
+} // namespace tests
+
+} // namespace imageproc
@@ -19,6 +19,8 @@
 #include "SEDM.h"
 #include "BinaryImage.h"
 #include "BWColor.h"
+#include "RasterOp.h"
+#include "Grid.h"
 #include "Utils.h"
 #include <iostream>
 #include <QImage>
@@ -26,7 +28,10 @@
 #include <boost/test/auto_unit_test.hpp>
 #endif
 
+#include <vector>
+#include <algorithm>
 #include <math.h>
+#include <stdint.h>
 
 namespace imageproc
 {
@@ -65,6 +70,109 @@ void dumpMatrix(uint32_t const* data, QSize size)
 	}
 }
 
+/**
+ * Builds a SEDM and returns it including padding, as SEDM
+ * itself isn't comparable.
+ */
+class PaddedSEDM
+{
+public:
+	typedef std::vector<uint32_t> result_type;
+	
+	PaddedSEDM(BinaryImage const& image) : m_rImage(image) {}
+	
+	result_type operator()() const {
+		SEDM const sedm(m_rImage, SEDM::DIST_TO_BLACK, SEDM::DIST_TO_NO_BORDERS);
+		return result_type(
+			sedm.data() - sedm.stride() - 1,
+			sedm.data() + sedm.stride() * (sedm.size().height() + 1) - 1
+		);
+	}
+private:
+	BinaryImage const& m_rImage;
+};
+
+/**
+ * Computes the distance map by trying every pair of cells.
+ * The result excludes padding.
+ */
+std::vector<uint32_t> bruteForceSEDM(
+	BinaryImage const& image, SEDM::DistType const dist_type,
+	SEDM::Borders const borders)
+{
+	int const width = image.width();
+	int const height = image.height();
+	uint32_t const* const img_data = image.data();
+	int const wpl = image.wordsPerLine();
+	
+	// Objects to compute the distance to, in padded coordinates.
+	std::vector<int> obj_x;
+	std::vector<int> obj_y;
+	for (int y = 0; y < height + 2; ++y) {
+		for (int x = 0; x < width + 2; ++x) {
+			bool object;
+			if (y == 0) {
+				object = borders & SEDM::DIST_TO_TOP_BORDER;
+			} else if (y == height + 1) {
+				object = borders & SEDM::DIST_TO_BOTTOM_BORDER;
+			} else if (x == 0) {
+				object = borders & SEDM::DIST_TO_LEFT_BORDER;
+			} else if (x == width + 1) {
+				object = borders & SEDM::DIST_TO_RIGHT_BORDER;
+			} else {
+				uint32_t const word = img_data[(y - 1) * wpl + ((x - 1) >> 5)];
+				bool const black = (word >> (31 - ((x - 1) & 31))) & 1;
+				object = black == (dist_type == SEDM::DIST_TO_BLACK);
+			}
+			if (y == 0 || y == height + 1) {
+				// Corners belong to both borders.
+				if (x == 0) {
+					object = object || (borders & SEDM::DIST_TO_LEFT_BORDER);
+				} else if (x == width + 1) {
+					object = object || (borders & SEDM::DIST_TO_RIGHT_BORDER);
+				}
+			}
+			if (object) {
+				obj_x.push_back(x);
+				obj_y.push_back(y);
+			}
+		}
+	}
+	
+	std::vector<uint32_t> control(width * height, SEDM::INF_DIST);
+	for (int y = 0; y < height; ++y) {
+		for (int x = 0; x < width; ++x) {
+			uint32_t& sqd = control[y * width + x];
+			for (size_t i = 0; i < obj_x.size(); ++i) {
+				int const dx = obj_x[i] - (x + 1);
+				int const dy = obj_y[i] - (y + 1);
+				sqd = std::min<uint32_t>(sqd, dx * dx + dy * dy);
+			}
+		}
+	}
+	
+	return control;
+}
+
+bool verifySaturated(Grid<uint16_t> const& grid, SEDM const& sedm)
+{
+	if (grid.width() != sedm.size().width() || grid.height() != sedm.size().height()
+			|| grid.padding() != 1 || grid.stride() != sedm.stride()) {
+		return false;
+	}
+	
+	// Padding included.
+	int const len = sedm.stride() * (sedm.size().height() + 2);
+	uint16_t const* saturated = grid.paddedData();
+	uint32_t const* exact = sedm.data() - sedm.stride() - 1;
+	for (int i = 0; i < len; ++i) {
+		if (saturated[i] != std::min<uint32_t>(exact[i], 0xffff)) {
+			return false;
+		}
+	}
+	return true;
+}
+
 BOOST_AUTO_TEST_CASE(test1)
 {
 	static int const inp[] = {
@@ -96,6 +204,73 @@ BOOST_AUTO_TEST_CASE(test1)
 	BOOST_CHECK(verifySEDM(sedm, out));
 }
 
+BOOST_AUTO_TEST_CASE(test_matches_brute_force)
+{
+	static int const sizes[][2] = {
+		{ 1, 1 }, { 1, 40 }, { 40, 1 }, { 33, 17 }, { 70, 45 }
+	};
+	static SEDM::Borders const borders[] = {
+		SEDM::DIST_TO_NO_BORDERS, SEDM::DIST_TO_TOP_BORDER,
+		SEDM::DIST_TO_VERT_BORDERS, SEDM::DIST_TO_ALL_BORDERS
+	};
+	
+	for (unsigned i = 0; i < sizeof(sizes) / sizeof(sizes[0]); ++i) {
+		// Sparse enough for some distances to be large.
+		BinaryImage img(randomBinaryImage(sizes[i][0], sizes[i][1]));
+		rasterOp<RopAnd<RopSrc, RopDst> >(img, randomBinaryImage(sizes[i][0], sizes[i][1]));
+		rasterOp<RopAnd<RopSrc, RopDst> >(img, randomBinaryImage(sizes[i][0], sizes[i][1]));
+		
+		for (unsigned b = 0; b < sizeof(borders) / sizeof(borders[0]); ++b) {
+			for (int d = 0; d < 2; ++d) {
+				SEDM::DistType const dist_type = d == 0 ? SEDM::DIST_TO_WHITE : SEDM::DIST_TO_BLACK;
+				std::vector<uint32_t> const control(bruteForceSEDM(img, dist_type, borders[b]));
+				SEDM const sedm(img, dist_type, borders[b]);
+				BOOST_REQUIRE(verifySEDM(sedm, &control[0]));
+			}
+		}
+	}
+}
+
+BOOST_AUTO_TEST_CASE(test_independent_of_thread_count)
+{
+	// Wider than a block of columns and taller than a chunk of rows.
+	BinaryImage img(randomBinaryImage(1100, 301));
+	rasterOp<RopAnd<RopSrc, RopDst> >(img, randomBinaryImage(1100, 301));
+	
+	BOOST_CHECK(sameForAnyThreadCount(PaddedSEDM(img)));
+}
+
+BOOST_AUTO_TEST_CASE(test_saturated)
+{
+	// A few black pixels far apart, so that distances exceed 255 pixels.
+	BinaryImage img(700, 400, WHITE);
+	img.fill(QRect(10, 10, 2, 3), BLACK);
+	img.fill(QRect(650, 380, 1, 1), BLACK);
+	
+	SEDM::Borders const borders[] = {
+		SEDM::DIST_TO_NO_BORDERS, SEDM::DIST_TO_LEFT_BORDER, SEDM::DIST_TO_ALL_BORDERS
+	};
+	for (int b = 0; b < 3; ++b) {
+		for (int d = 0; d < 2; ++d) {
+			SEDM::DistType const dist_type = d == 0 ? SEDM::DIST_TO_WHITE : SEDM::DIST_TO_BLACK;
+			SEDM const sedm(img, dist_type, borders[b]);
+			Grid<uint16_t> const saturated(SEDM::buildSaturated(img, dist_type, borders[b]));
+			BOOST_REQUIRE(verifySaturated(saturated, sedm));
+		}
+	}
+	
+	// Nothing to compute the distance to.
+	BinaryImage const white(50, 40, WHITE);
+	Grid<uint16_t> const saturated(
+		SEDM::buildSaturated(white, SEDM::DIST_TO_BLACK, SEDM::DIST_TO_NO_BORDERS)
+	);
+	SEDM const sedm(white, SEDM::DIST_TO_BLACK, SEDM::DIST_TO_NO_BORDERS);
+	BOOST_CHECK(verifySaturated(saturated, sedm));
+	BOOST_CHECK_EQUAL(saturated.data()[0], 0xffff);
+	
+	BOOST_CHECK(SEDM::buildSaturated(BinaryImage()).isNull());
+}
+
 BOOST_AUTO_TEST_SUITE_END();
 
 } // namespace tests
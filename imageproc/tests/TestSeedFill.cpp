@@ -21,13 +21,16 @@
 #include "BinaryImage.h"
 #include "BWColor.h"
 #include "Grayscale.h"
+#include "GrayImage.h"
 #include "Utils.h"
 #include <QImage>
 #include <QSize>
 #include <QPoint>
+#include <QRect>
 #ifndef Q_MOC_RUN
 #include <boost/test/auto_unit_test.hpp>
 #endif
+#include <stdlib.h>
 
 namespace imageproc
 {
@@ -37,6 +40,55 @@ namespace tests
 
 using namespace utils;
 
+namespace
+{
+
+/**
+ * A white seed with a few black dots, so that darkness has to travel
+ * a long way, crossing band boundaries back and forth.
+ */
+GrayImage sparseGraySeed(int const width, int const height)
+{
+	GrayImage seed(QSize(width, height));
+	seed.fill(0xff);
+	for (int i = 0; i < 5; ++i) {
+		seed.data()[(rand() % height) * seed.stride() + rand() % width] = 0;
+	}
+	return seed;
+}
+
+class BinaryFillOp
+{
+public:
+	typedef BinaryImage result_type;
+	
+	BinaryFillOp(BinaryImage const& seed, BinaryImage const& mask, Connectivity conn)
+	: m_rSeed(seed), m_rMask(mask), m_conn(conn) {}
+	
+	result_type operator()() const { return seedFill(m_rSeed, m_rMask, m_conn); }
+private:
+	BinaryImage const& m_rSeed;
+	BinaryImage const& m_rMask;
+	Connectivity m_conn;
+};
+
+class GrayFillOp
+{
+public:
+	typedef GrayImage result_type;
+	
+	GrayFillOp(GrayImage const& seed, GrayImage const& mask, Connectivity conn)
+	: m_rSeed(seed), m_rMask(mask), m_conn(conn) {}
+	
+	result_type operator()() const { return seedFillGray(m_rSeed, m_rMask, m_conn); }
+private:
+	GrayImage const& m_rSeed;
+	GrayImage const& m_rMask;
+	Connectivity m_conn;
+};
+
+} // anonymous namespace
+
 BOOST_AUTO_TEST_SUITE(SeedFillTestSuite);
 
 BOOST_AUTO_TEST_CASE(test_regression_1)
@@ -208,6 +260,64 @@ BOOST_AUTO_TEST_CASE(test_gray_vs_binary)
 	}
 }
 
+BOOST_AUTO_TEST_CASE(test_diagonal_across_word_boundary)
+{
+	int seed_data[70*2] = { 0 };
+	int mask_data[70*2] = { 0 };
+	
+	seed_data[31] = 1;
+	
+	mask_data[31] = 1;
+	mask_data[70 + 32] = 1;
+	
+	BinaryImage const seed(makeBinaryImage(seed_data, 70, 2));
+	BinaryImage const mask(makeBinaryImage(mask_data, 70, 2));
+	BOOST_CHECK(seedFill(seed, mask, CONN8) == mask);
+	
+	int seed2_data[70*2] = { 0 };
+	seed2_data[70 + 32] = 1;
+	BinaryImage const seed2(makeBinaryImage(seed2_data, 70, 2));
+	BOOST_CHECK(seedFill(seed2, mask, CONN8) == mask);
+}
+
+BOOST_AUTO_TEST_CASE(test_binary_independent_of_thread_count)
+{
+	ThreadLimitGuard const guard;
+	
+	// A serpentine corridor, which is filled completely from its end.
+	BinaryImage mask(301, 1000, BLACK);
+	for (int y = 2; y < 1000; y += 4) {
+		mask.fill(QRect((y & 4) ? 0 : 1, y, 300, 1), WHITE);
+	}
+	
+	BinaryImage seed(mask.size(), WHITE);
+	seed.fill(QRect(0, 999, 1, 1), BLACK);
+	
+	int const thread_counts[] = { 1, 2, 3, 8 };
+	for (int i = 0; i < 4; ++i) {
+		ParallelFor::setMaxThreads(thread_counts[i]);
+		BOOST_REQUIRE(seedFill(seed, mask, CONN4) == mask);
+		BOOST_REQUIRE(seedFill(seed, mask, CONN8) == mask);
+	}
+	
+	BinaryImage const random_seed(randomBinaryImage(301, 1000));
+	BinaryImage const random_mask(randomBinaryImage(301, 1000));
+	BOOST_CHECK(sameForAnyThreadCount(BinaryFillOp(random_seed, random_mask, CONN8)));
+}
+
+BOOST_AUTO_TEST_CASE(test_gray_parallel_vs_slow)
+{
+	// Tall enough to be split into bands.
+	GrayImage const mask(randomGrayImage(301, 1000));
+	GrayImage const seed(sparseGraySeed(301, 1000));
+	
+	for (int c = 0; c < 2; ++c) {
+		Connectivity const conn = c == 0 ? CONN4 : CONN8;
+		BOOST_CHECK(seedFillGray(seed, mask, conn) == seedFillGraySlow(seed, mask, conn));
+		BOOST_CHECK(sameForAnyThreadCount(GrayFillOp(seed, mask, conn)));
+	}
+}
+
 BOOST_AUTO_TEST_SUITE_END();
 
 } // namespace tests
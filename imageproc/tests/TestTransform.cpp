@@ -21,6 +21,9 @@
 #include "Utils.h"
 #include <QImage>
 #include <QSize>
+#include <QTransform>
+#include <QRect>
+#include <QRectF>
 #ifndef Q_MOC_RUN
 #include <boost/test/auto_unit_test.hpp>
 #endif
@@ -36,6 +39,29 @@ namespace tests
 
 using namespace utils;
 
+namespace
+{
+
+class TransformOp
+{
+public:
+	typedef QImage result_type;
+	
+	TransformOp(QImage const& img, QTransform const& xform, OutsidePixels const& outside_pixels)
+	: m_rImg(img), m_xform(xform), m_outsidePixels(outside_pixels) {}
+	
+	result_type operator()() const {
+		QRect const dst_rect(m_xform.mapRect(QRectF(m_rImg.rect())).toRect());
+		return transform(m_rImg, m_xform, dst_rect, m_outsidePixels);
+	}
+private:
+	QImage const& m_rImg;
+	QTransform m_xform;
+	OutsidePixels m_outsidePixels;
+};
+
+} // anonymous namespace
+
 BOOST_AUTO_TEST_SUITE(TransformTestSuite);
 
 BOOST_AUTO_TEST_CASE(test_null_image)
@@ -66,6 +92,61 @@ BOOST_AUTO_TEST_CASE(test_random_image)
 	BOOST_CHECK(transformToGray(img, null_xform, img.rect(), outside_pixels) == img);
 }
 
+BOOST_AUTO_TEST_CASE(test_half_pixel_shift)
+{
+	// Shifting by half a pixel takes the bilinear shortcut, with each
+	// destination pixel being a rounded average of two source pixels.
+	GrayImage img(QSize(50, 20));
+	uint8_t* line = img.data();
+	for (int y = 0; y < img.height(); ++y) {
+		for (int x = 0; x < img.width(); ++x) {
+			line[x] = rand() % 256;
+		}
+		line += img.stride();
+	}
+	
+	QColor const bgcolor(0xff, 0xff, 0xff);
+	OutsidePixels const outside_pixels(OutsidePixels::assumeColor(bgcolor));
+	
+	QTransform xform;
+	xform.translate(0.5, 0.0);
+	GrayImage const res(transformToGray(img, xform, img.rect(), outside_pixels));
+	BOOST_REQUIRE(res.size() == img.size());
+	
+	for (int y = 0; y < img.height(); ++y) {
+		uint8_t const* src_line = img.data() + y * img.stride();
+		uint8_t const* dst_line = res.data() + y * res.stride();
+		for (int x = 1; x < img.width(); ++x) {
+			int const expected = (src_line[x - 1] + src_line[x] + 1) / 2;
+			BOOST_REQUIRE_EQUAL(int(dst_line[x]), expected);
+		}
+	}
+}
+
+BOOST_AUTO_TEST_CASE(test_independent_of_thread_count)
+{
+	QImage img(317, 233, QImage::Format_RGB32);
+	for (int y = 0; y < img.height(); ++y) {
+		uint32_t* line = (uint32_t*)img.scanLine(y);
+		for (int x = 0; x < img.width(); ++x) {
+			line[x] = 0xff000000 | (rand() & 0x00ffffff);
+		}
+	}
+	
+	QColor const bgcolor(0xff, 0xff, 0xff);
+	OutsidePixels const outside_pixels(OutsidePixels::assumeColor(bgcolor));
+	
+	// Small-angle rotations (bilinear path) and downscaling (general path).
+	QTransform rotate;
+	rotate.rotate(3.0);
+	QTransform downscale;
+	downscale.scale(0.3, 0.4);
+	downscale.rotate(-7.0);
+	
+	BOOST_CHECK(sameForAnyThreadCount(TransformOp(img, rotate, outside_pixels)));
+	BOOST_CHECK(sameForAnyThreadCount(TransformOp(img, downscale, outside_pixels)));
+}
+
 BOOST_AUTO_TEST_SUITE_END();
 
 } // namespace tests
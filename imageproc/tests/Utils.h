@@ -19,6 +19,8 @@
 #ifndef IMAGEPROC_TESTS_UTILS_H_
 #define IMAGEPROC_TESTS_UTILS_H_
 
+#include "ParallelFor.h"
+
 class QImage;
 class QRect;
 
@@ -51,6 +53,49 @@ void dumpGrayImage(QImage const& img, char const* name = 0);
 
 bool surroundingsIntact(QImage const& img1, QImage const& img2, QRect const& rect);
 
+/**
+ * \brief Restores the thread limit of ParallelFor on scope exit.
+ */
+class ThreadLimitGuard
+{
+public:
+	ThreadLimitGuard() : m_maxThreads(ParallelFor::maxThreads()) {}
+
+	~ThreadLimitGuard() { ParallelFor::setMaxThreads(m_maxThreads); }
+private:
+	int m_maxThreads;
+};
+
+/**
+ * \brief Checks that a computation doesn't depend on the number of threads.
+ *
+ * \p op is called with a single thread, and then with 2, 3 and 8 threads,
+ * each time with the results compared to the first one with operator==.
+ * Odd thread counts and more threads than bands are what tends to break.
+ * The thread limit is restored on return.
+ *
+ * \param op A functor taking no arguments and declaring its result_type.
+ * \return true if all the results were the same.
+ */
+template<typename Op>
+bool sameForAnyThreadCount(Op const& op)
+{
+	ThreadLimitGuard const guard;
+
+	ParallelFor::setMaxThreads(1);
+	typename Op::result_type const control(op());
+
+	static int const thread_counts[] = { 2, 3, 8 };
+	for (int i = 0; i < 3; ++i) {
+		ParallelFor::setMaxThreads(thread_counts[i]);
+		if (!(op() == control)) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
 } // namespace utils
 
 } // namespace uests
@@ -23,6 +23,8 @@
 #include <iostream>
 
 #include "CommandLine.h"
+#include "imageproc/FileBackedMemory.h"
+#include "Trace.h"
 #include "ConsoleBatch.h"
 
 
@@ -39,6 +41,14 @@ int main(int argc, char **argv)
 	CommandLine cli(app.arguments(), false);
 	CommandLine::set(cli);
 
+	if (cli.hasScratchDir()) {
+		imageproc::FileBackedMemory::enable(cli.getScratchDir());
+	}
+
+	if (cli.hasTraceFile()) {
+		Trace::enable();
+	}
+
 	if (cli.hasHelp() || cli.outputDirectory().isEmpty() || (cli.images().size()==0 && cli.projectFile().isEmpty())) {
 		cli.printHelp();
 		return 0;
@@ -60,4 +70,10 @@ int main(int argc, char **argv)
 
 	if (cli.hasOutputProject())
 		cbatch->saveProject(cli.outputProjectFile());
+
+	if (cli.hasTraceFile() && !Trace::writeChromeTrace(cli.getTraceFile())) {
+		std::cerr << "Failed to write the trace to "
+			<< cli.getTraceFile().toLocal8Bit().constData() << std::endl;
+		return 1;
+	}
 }
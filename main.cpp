@@ -34,6 +34,7 @@
 #include <string.h>
 
 #include "CommandLine.h"
+#include "imageproc/FileBackedMemory.h"
 
 
 //#ifdef Q_WS_WIN
@@ -150,6 +151,10 @@ int main(int argc, char** argv)
 	CommandLine cli(app.arguments());
 	CommandLine::set(cli);
 
+	if (cli.hasScratchDir()) {
+		imageproc::FileBackedMemory::enable(cli.getScratchDir());
+	}
+
 	if (cli.hasHelp()) {
 		cli.printHelp();
 		return 0;
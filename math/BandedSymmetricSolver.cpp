@@ -0,0 +1,110 @@
+/*
+	Scan Tailor - Interactive post-processing tool for scanned pages.
+	Copyright (C)  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "BandedSymmetricSolver.h"
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+#include <math.h>
+
+size_t
+BandedSymmetricSolver::halfBandwidth(double const* A, size_t const n, size_t const rows)
+{
+	size_t bw = 0;
+	for (size_t j = 0; j < n; ++j) {
+		double const* col = A + j * rows;
+		// Look for the furthest non-zero element below the diagonal.
+		for (size_t i = n - 1; i > j + bw; --i) {
+			if (col[i] != 0.0) {
+				bw = i - j;
+				break;
+			}
+		}
+	}
+	return bw;
+}
+
+BandedSymmetricSolver::BandedSymmetricSolver(
+	double const* A, size_t const n, size_t const rows, size_t const half_bandwidth)
+:	m_size(n),
+	m_halfBandwidth(half_bandwidth),
+	m_L(n * half_bandwidth),
+	m_D(n)
+{
+	double const epsilon = sqrt(std::numeric_limits<double>::epsilon());
+	size_t const w = m_halfBandwidth;
+
+	for (size_t i = 0; i < n; ++i) {
+		size_t const first = i > w ? i - w : 0;
+
+		for (size_t j = first; j < i; ++j) {
+			// L(i, j) * D(j) = A(i, j) - sum(L(i, k) * D(k) * L(j, k)) for k < j
+			double sum = A[j * rows + i];
+			size_t const k_first = std::max(first, j > w ? j - w : 0);
+			for (size_t k = k_first; k < j; ++k) {
+				sum -= L(i, k) * m_D[k] * L(j, k);
+			}
+			L(i, j) = sum / m_D[j];
+		}
+
+		double const a_ii = A[i * rows + i];
+		double d = a_ii;
+		for (size_t k = first; k < i; ++k) {
+			double const l = L(i, k);
+			d -= l * l * m_D[k];
+		}
+		// The pivot is compared to the diagonal element it came from,
+		// so that matrices of any scale are treated alike.
+		if (!(d > epsilon * fabs(a_ii))) {
+			throw std::runtime_error("BandedSymmetricSolver: not a positive definite matrix");
+		}
+		m_D[i] = d;
+	}
+}
+
+void
+BandedSymmetricSolver::solve(double* x) const
+{
+	size_t const n = m_size;
+	size_t const w = m_halfBandwidth;
+
+	// Solve L * y = b
+	for (size_t i = 0; i < n; ++i) {
+		double sum = x[i];
+		for (size_t k = i > w ? i - w : 0; k < i; ++k) {
+			sum -= L(i, k) * x[k];
+		}
+		x[i] = sum;
+	}
+
+	// Solve D * z = y
+	for (size_t i = 0; i < n; ++i) {
+		x[i] /= m_D[i];
+	}
+
+	// Solve L^T * x = z
+	for (size_t i = n; i-- > 0;) {
+		double sum = x[i];
+		size_t const last = std::min(n, i + w + 1);
+		for (size_t k = i + 1; k < last; ++k) {
+			sum -= L(k, i) * x[k];
+		}
+		x[i] = sum;
+	}
+}
@@ -0,0 +1,100 @@
+/*
+	Scan Tailor - Interactive post-processing tool for scanned pages.
+	Copyright (C)  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef BANDED_SYMMETRIC_SOLVER_H_
+#define BANDED_SYMMETRIC_SOLVER_H_
+
+#include <vector>
+#include <stddef.h>
+
+/**
+ * \brief Solves Ax = b for a symmetric positive definite band matrix A.
+ *
+ * A is factorized as L * D * L^T, where L is unit lower triangular
+ * with the same bandwidth as A, and D is diagonal.  With n being the size
+ * of A and w its half bandwidth, the factorization takes O(n * w^2) time
+ * and O(n * w) memory, and each solve() takes O(n * w) time.
+ *
+ * No pivoting is done, which is fine for positive definite matrices.
+ * Other matrices are rejected at construction.
+ *
+ * \note Input matrices are assumed to be in column-major order,
+ *       like everywhere else in this library.
+ */
+class BandedSymmetricSolver
+{
+	// Member-wise copying is OK.
+public:
+	/**
+	 * \brief Returns the half bandwidth of the upper-left (n)x(n)
+	 *        block of a matrix.
+	 *
+	 * That's the maximum |i - j| for a non-zero A(i, j).
+	 * Only the lower triangle is examined.
+	 *
+	 * \param A Column-major matrix data.
+	 * \param n The size of the block to examine.
+	 * \param rows The number of rows in A, which may be more than \p n.
+	 */
+	static size_t halfBandwidth(double const* A, size_t n, size_t rows);
+
+	/**
+	 * \brief Factorizes the upper-left (n)x(n) block of A.
+	 *
+	 * Elements further than \p half_bandwidth from the diagonal
+	 * are assumed to be zero.  Only the lower triangle is read.
+	 *
+	 * \param A Column-major matrix data.
+	 * \param n The size of the block to factorize.
+	 * \param rows The number of rows in A, which may be more than \p n.
+	 * \param half_bandwidth See halfBandwidth().
+	 *
+	 * \throw std::runtime_error If the matrix is not positive definite,
+	 *        at least numerically.
+	 */
+	BandedSymmetricSolver(double const* A, size_t n, size_t rows, size_t half_bandwidth);
+
+	size_t size() const { return m_size; }
+
+	/**
+	 * \brief Solves Ax = b in place.
+	 *
+	 * \param x On input, vector b.  On output, vector x.
+	 *        Both are of size().
+	 */
+	void solve(double* x) const;
+private:
+	/**
+	 * Returns L(i, j) for j in [i - m_halfBandwidth, i).
+	 */
+	double& L(size_t i, size_t j) {
+		return m_L[i * m_halfBandwidth + j + m_halfBandwidth - i];
+	}
+
+	double L(size_t i, size_t j) const {
+		return m_L[i * m_halfBandwidth + j + m_halfBandwidth - i];
+	}
+
+	size_t m_size;
+	size_t m_halfBandwidth;
+	std::vector<double> m_L; // Row-wise, m_halfBandwidth elements per row.
+	std::vector<double> m_D;
+};
+
+#endif
@@ -580,6 +580,27 @@ XSpline::decomposedDerivsImpl(int const segment, double const t) const
 	return derivs;
 }
 
+namespace
+{
+
+/**
+ * Marks the Hessian elements for every pair of x coordinates and
+ * every pair of y coordinates of the given control points as non-zero.
+ * Variables are assumed to be laid out as [x0 y0 x1 y1 ...]
+ */
+template<typename It>
+void markInteractingControlPoints(adiff::SparseMap<2>& sparse_map, It const begin, It const end)
+{
+	for (It i(begin); i != end; ++i) {
+		for (It j(begin); j != end; ++j) {
+			sparse_map.markNonZero(*i * 2, *j * 2);
+			sparse_map.markNonZero(*i * 2 + 1, *j * 2 + 1);
+		}
+	}
+}
+
+} // anonymous namespace
+
 QuadraticFunction
 XSpline::controlPointsAttractionForce() const
 {
@@ -597,8 +618,15 @@ XSpline::controlPointsAttractionForce(int seg_begin, int seg_end) const
 
 	int const num_control_points = numControlPoints();
 
+	// Only adjacent control points interact, so let's not waste time
+	// computing derivatives that are known to be zero.
 	SparseMap<2> sparse_map(num_control_points * 2);
-	sparse_map.markAllNonZero();
+	if (seg_begin != seg_end) {
+		for (int i = seg_begin + 1; i <= seg_end; ++i) {
+			int const cps[2] = { i - 1, i };
+			markInteractingControlPoints(sparse_map, cps, cps + 2);
+		}
+	}
 
 	Function<2> force(sparse_map);
 	if (seg_begin != seg_end) {
@@ -643,8 +671,26 @@ XSpline::junctionPointsAttractionForce(int seg_begin, int seg_end) const
 
 	int const num_control_points = numControlPoints();
 
+	// A junction point only depends on a few control points around it,
+	// and only adjacent junction points interact.
 	SparseMap<2> sparse_map(num_control_points * 2);
-	sparse_map.markAllNonZero();
+	if (seg_begin != seg_end) {
+		std::vector<LinearCoefficient> coeffs;
+		std::vector<int> prev_cps;
+		std::vector<int> cps;
+		for (int i = seg_begin; i <= seg_end; ++i) {
+			linearCombinationAt(controlPointIndexToT(i), coeffs);
+			cps = prev_cps;
+			prev_cps.clear();
+			BOOST_FOREACH(LinearCoefficient const& coeff, coeffs) {
+				cps.push_back(coeff.controlPointIdx);
+				prev_cps.push_back(coeff.controlPointIdx);
+			}
+			if (i != seg_begin) {
+				markInteractingControlPoints(sparse_map, cps.begin(), cps.end());
+			}
+		}
+	}
 
 	Function<2> force(sparse_map);
 
@@ -17,7 +17,9 @@
 */
 
 #include "Optimizer.h"
+#include "config.h"
 #include "MatrixCalc.h"
+#include "BandedSymmetricSolver.h"
 #include <boost/foreach.hpp>
 #include <stdexcept>
 #include <algorithm>
@@ -134,7 +136,13 @@ Optimizer::optimize(double internal_force_weight)
 	DynamicMatrixCalc<double> mc;
 
 	try {
-		mc(m_A).solve(mc(m_b)).write(m_x.data());
+		bool solved = false;
+#ifdef ENABLE_SPARSE_SPLINE_FITTING
+		solved = solveBanded();
+#endif
+		if (!solved) {
+			mc(m_A).solve(mc(m_b)).write(m_x.data());
+		}
 	} catch (std::runtime_error const&) {
 		m_externalForce.reset();
 		m_internalForce.reset();
@@ -153,6 +161,94 @@ Optimizer::optimize(double internal_force_weight)
 	return OptimizationResult(total_force_before, total_force_after);
 }
 
+bool
+Optimizer::solveBanded()
+{
+	// For the layout of m_A and m_b, see setConstraints()
+	// Let's denote the Hessian part of m_A as H and the constraints part as C:
+	// |H C^T| * |x| = |b1|
+	// |C  0 |   |y|   |b2|
+	// Then we have:
+	// x = H^-1 * (b1 - C^T * y)
+	// (C * H^-1 * C^T) * y = C * H^-1 * b1 - b2
+	// A spline control point only interacts with its neighbours, so with
+	// variables ordered along the spline, H is a band matrix.  C has as many
+	// rows as there are constraints, which is typically a small number.
+
+	size_t const n = m_numVars;
+	size_t const num_dimensions = m_b.size();
+	size_t const num_constraints = num_dimensions - n;
+	double const* const A = m_A.data();
+
+	size_t const half_bandwidth = BandedSymmetricSolver::halfBandwidth(A, n, num_dimensions);
+	if (half_bandwidth * 4 >= n) {
+		// Not much of a band.  A dense solver will do just as well.
+		return false;
+	}
+
+	try {
+		BandedSymmetricSolver const solver(A, n, num_dimensions, half_bandwidth);
+
+		// z = H^-1 * b1
+		VecT<double> z(n, m_b.data());
+		solver.solve(z.data());
+
+		if (num_constraints == 0) {
+			std::copy(z.data(), z.data() + n, m_x.data());
+			return true;
+		}
+
+		// Y = H^-1 * C^T, computed column by column.
+		// Column k of C^T is stored in m_A as column n + k.
+		MatT<double> Y(n, num_constraints);
+		for (size_t k = 0; k < num_constraints; ++k) {
+			std::copy(
+				A + (n + k) * num_dimensions,
+				A + (n + k) * num_dimensions + n, Y.data() + k * n
+			);
+			solver.solve(Y.data() + k * n);
+		}
+
+		// S = C * Y
+		// r = C * z - b2
+		MatT<double> S(num_constraints, num_constraints);
+		VecT<double> r(num_constraints);
+		for (size_t i = 0; i < num_constraints; ++i) {
+			for (size_t j = 0; j < num_constraints; ++j) {
+				double sum = 0;
+				for (size_t k = 0; k < n; ++k) {
+					sum += m_A(n + i, k) * Y(k, j);
+				}
+				S(i, j) = sum;
+			}
+
+			double sum = -m_b[n + i];
+			for (size_t k = 0; k < n; ++k) {
+				sum += m_A(n + i, k) * z[k];
+			}
+			r[i] = sum;
+		}
+
+		// Lagrange multipliers go to the tail of m_x.
+		DynamicMatrixCalc<double> mc;
+		mc(S).solve(mc(r)).write(m_x.data() + n);
+		double const* const y = m_x.data() + n;
+
+		// x = z - Y * y
+		for (size_t k = 0; k < n; ++k) {
+			double sum = z[k];
+			for (size_t j = 0; j < num_constraints; ++j) {
+				sum -= Y(k, j) * y[j];
+			}
+			m_x[k] = sum;
+		}
+	} catch (std::runtime_error const&) {
+		return false;
+	}
+
+	return true;
+}
+
 void
 Optimizer::undoLastStep()
 {
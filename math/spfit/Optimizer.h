@@ -84,6 +84,14 @@ public:
 
 	void swap(Optimizer& other);
 private:
+	/**
+	 * Solves m_A * m_x = m_b by factorizing the Hessian part of m_A as
+	 * a band matrix and handling constraints through their Schur complement.
+	 * Returns false if the Hessian isn't banded or isn't positive definite,
+	 * in which case the caller is expected to fall back to a dense solver.
+	 */
+	bool solveBanded();
+
 	void adjustConstraints(double direction);
 
 	size_t m_numVars;
@@ -0,0 +1,220 @@
+/*
+	Scan Tailor - Interactive post-processing tool for scanned pages.
+	Copyright (C)  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "Optimizer.h"
+#include "BandedSymmetricSolver.h"
+#include "QuadraticFunction.h"
+#include "LinearFunction.h"
+#include "MatrixCalc.h"
+#include "MatT.h"
+#include "VecT.h"
+#ifndef Q_MOC_RUN
+#include <boost/test/auto_unit_test.hpp>
+#include <boost/test/floating_point_comparison.hpp>
+#endif
+#include <list>
+#include <stdexcept>
+#include <vector>
+#include <stdlib.h>
+#include <math.h>
+
+namespace spfit
+{
+
+namespace tests
+{
+
+BOOST_AUTO_TEST_SUITE(OptimizerTestSuite);
+
+static double frand(double from, double to)
+{
+	double const rand_0_1 = rand() / double(RAND_MAX);
+	return from + (to - from) * rand_0_1;
+}
+
+/**
+ * A sum of squared differences between variables at most \p reach
+ * positions apart, plus optional attraction of each variable to a point.
+ */
+static QuadraticFunction bandedForce(size_t num_vars, size_t reach, double attraction)
+{
+	QuadraticFunction f(num_vars);
+	for (size_t i = 0; i < num_vars; ++i) {
+		for (size_t j = i + 1; j < num_vars && j <= i + reach; ++j) {
+			// w * (xi - xj)^2
+			double const w = frand(0.5, 2.0);
+			f.A(i, i) += w;
+			f.A(j, j) += w;
+			f.A(i, j) -= w;
+			f.A(j, i) -= w;
+		}
+
+		// attraction * (xi - t)^2
+		double const t = frand(-10, 10);
+		f.A(i, i) += attraction;
+		f.b[i] -= 2.0 * attraction * t;
+		f.c += attraction * t * t;
+	}
+	return f;
+}
+
+static std::list<LinearFunction> randomConstraints(size_t num_vars, size_t num_constraints)
+{
+	std::list<LinearFunction> constraints;
+	for (size_t i = 0; i < num_constraints; ++i) {
+		LinearFunction f(num_vars);
+		for (size_t j = 0; j < num_vars; ++j) {
+			f.a[j] = (rand() & 3) == 0 ? frand(-1, 1) : 0.0;
+		}
+		f.a[i] = 1.0; // Make sure constraints are independent.
+		f.b = frand(-5, 5);
+		constraints.push_back(f);
+	}
+	return constraints;
+}
+
+/**
+ * Minimizes the force subject to constraints by solving
+ * the whole Lagrangian system with a dense solver.
+ */
+static VecT<double> denseSolution(
+	QuadraticFunction const& force, std::list<LinearFunction> const& constraints)
+{
+	size_t const n = force.numVars();
+	size_t const num_dimensions = n + constraints.size();
+	MatT<double> A(num_dimensions, num_dimensions);
+	VecT<double> b(num_dimensions);
+
+	QuadraticFunction::Gradient const grad(force.gradient());
+	for (size_t i = 0; i < n; ++i) {
+		b[i] = -grad.b[i];
+		for (size_t j = 0; j < n; ++j) {
+			A(i, j) = grad.A(i, j);
+		}
+	}
+
+	size_t i = n;
+	std::list<LinearFunction>::const_iterator ctr(constraints.begin());
+	for (; ctr != constraints.end(); ++ctr, ++i) {
+		b[i] = -ctr->b;
+		for (size_t j = 0; j < n; ++j) {
+			A(i, j) = A(j, i) = ctr->a[j];
+		}
+	}
+
+	VecT<double> x(num_dimensions);
+	DynamicMatrixCalc<double> mc;
+	mc(A).solve(mc(b)).write(x.data());
+	return x;
+}
+
+static void checkOptimizer(
+	QuadraticFunction const& force, std::list<LinearFunction> const& constraints)
+{
+	VecT<double> const control(denseSolution(force, constraints));
+
+	Optimizer optimizer(force.numVars());
+	optimizer.setConstraints(constraints);
+	optimizer.addExternalForce(force);
+	optimizer.optimize(1.0);
+
+	for (size_t i = 0; i < force.numVars(); ++i) {
+		BOOST_REQUIRE_SMALL(optimizer.displacementVector()[i] - control[i], 1e-6);
+	}
+}
+
+BOOST_AUTO_TEST_CASE(test_banded_solver)
+{
+	size_t const n = 50;
+	QuadraticFunction const f(bandedForce(n, 3, 1.0));
+	MatT<double> A(f.gradient().A);
+	BOOST_REQUIRE_EQUAL(BandedSymmetricSolver::halfBandwidth(A.data(), n, n), 3u);
+
+	VecT<double> x(n);
+	for (size_t i = 0; i < n; ++i) {
+		x[i] = frand(-10, 10);
+	}
+	VecT<double> b(n);
+	for (size_t i = 0; i < n; ++i) {
+		for (size_t j = 0; j < n; ++j) {
+			b[i] += A(i, j) * x[j];
+		}
+	}
+
+	BandedSymmetricSolver const solver(A.data(), n, n, 3);
+	solver.solve(b.data());
+	for (size_t i = 0; i < n; ++i) {
+		BOOST_REQUIRE_SMALL(b[i] - x[i], 1e-9);
+	}
+}
+
+BOOST_AUTO_TEST_CASE(test_banded_solver_scale)
+{
+	// Positive definite, however small its elements are.
+	double const A[] = {
+		2e-12, -1e-12, 0,
+		-1e-12, 2e-12, -1e-12,
+		0, -1e-12, 2e-12
+	};
+	double x[] = { 1e-12, 0, 1e-12 };
+	BandedSymmetricSolver const solver(A, 3, 3, 1);
+	solver.solve(x);
+	for (size_t i = 0; i < 3; ++i) {
+		BOOST_REQUIRE_CLOSE(x[i], 1.0, 1e-9);
+	}
+
+	// Singular up to rounding errors, however large its elements are.
+	double const B[] = {
+		1e12, 1e12, 0,
+		1e12, 1e12 + 1, 0,
+		0, 0, 1e12
+	};
+	BOOST_CHECK_THROW(BandedSymmetricSolver(B, 3, 3, 1), std::runtime_error);
+}
+
+BOOST_AUTO_TEST_CASE(test_unconstrained)
+{
+	checkOptimizer(bandedForce(60, 4, 0.1), std::list<LinearFunction>());
+}
+
+BOOST_AUTO_TEST_CASE(test_constrained)
+{
+	for (int i = 0; i < 10; ++i) {
+		checkOptimizer(bandedForce(60, 4, 0.1), randomConstraints(60, 3));
+	}
+}
+
+BOOST_AUTO_TEST_CASE(test_singular_hessian)
+{
+	// Without attraction, the force doesn't change if all variables
+	// are shifted by the same amount, so the Hessian is singular.
+	// The constraints make the whole system solvable though.
+	checkOptimizer(bandedForce(60, 2, 0.0), randomConstraints(60, 2));
+}
+
+BOOST_AUTO_TEST_CASE(test_dense_hessian)
+{
+	checkOptimizer(bandedForce(20, 19, 0.1), randomConstraints(20, 2));
+}
+
+BOOST_AUTO_TEST_SUITE_END();
+
+} // namespace tests
+
+} // namespace spfit
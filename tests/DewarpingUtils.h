@@ -0,0 +1,46 @@
+/*
+	Scan Tailor - Interactive post-processing tool for scanned pages.
+	Copyright (C)  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef DEWARPING_TESTS_UTILS_H_
+#define DEWARPING_TESTS_UTILS_H_
+
+#include <QPointF>
+#include <vector>
+
+namespace dewarping
+{
+
+namespace tests
+{
+
+namespace utils
+{
+
+/**
+ * \brief A wavy, roughly horizontal curve across a 400 pixels wide image.
+ *
+ * Two of these at different \p y make a distortion model for tests.
+ */
+std::vector<QPointF> curvedLine(double y, double amplitude);
+
+} // namespace utils
+
+} // namespace tests
+
+} // namespace dewarping
+
+#endif
@@ -0,0 +1,127 @@
+/*
+	Scan Tailor - Interactive post-processing tool for scanned pages.
+	Copyright (C)  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "dewarping/CylindricalSurfaceDewarper.h"
+#include "DewarpingUtils.h"
+#include "VecNT.h"
+#include <QPointF>
+#ifndef Q_MOC_RUN
+#include <boost/test/auto_unit_test.hpp>
+#endif
+#include <vector>
+#include <stdlib.h>
+#include <math.h>
+
+namespace dewarping
+{
+
+namespace tests
+{
+
+BOOST_AUTO_TEST_SUITE(CylindricalSurfaceDewarperTestSuite);
+
+namespace
+{
+
+double randomUnit()
+{
+	return rand() / double(RAND_MAX);
+}
+
+double distance(QPointF const& p1, QPointF const& p2)
+{
+	return sqrt(Vec2d(p1 - p2).squaredNorm());
+}
+
+} // anonymous namespace
+
+BOOST_AUTO_TEST_CASE(test_generatrix_table_accuracy)
+{
+	double const max_img_error = 0.1;
+
+	CylindricalSurfaceDewarper const exact(
+		utils::curvedLine(40, 30), utils::curvedLine(260, 20), 2.0
+	);
+	CylindricalSurfaceDewarper table(exact);
+	table.buildGeneratrixTable(0.0, 1.0, max_img_error);
+
+	CylindricalSurfaceDewarper::State exact_state;
+	CylindricalSurfaceDewarper::State table_state;
+	for (int i = 0; i < 2000; ++i) {
+		QPointF const crv_pt(randomUnit(), randomUnit());
+
+		CylindricalSurfaceDewarper::Generatrix const exact_gtx(
+			exact.mapGeneratrix(crv_pt.x(), exact_state)
+		);
+		CylindricalSurfaceDewarper::Generatrix const table_gtx(
+			table.mapGeneratrix(crv_pt.x(), table_state)
+		);
+		QPointF const exact_img_pt(
+			exact_gtx.imgLine.pointAt(exact_gtx.pln2img(crv_pt.y()))
+		);
+		QPointF const table_img_pt(
+			table_gtx.imgLine.pointAt(table_gtx.pln2img(crv_pt.y()))
+		);
+		BOOST_REQUIRE_LE(distance(exact_img_pt, table_img_pt), max_img_error);
+
+		QPointF const img_pt(table.mapToWarpedSpace(crv_pt));
+		BOOST_REQUIRE_LE(distance(img_pt, exact.mapToWarpedSpace(crv_pt)), max_img_error);
+
+		// Map back through both dewarpers and compare in image coordinates,
+		// as that's where the error bound applies.
+		QPointF const exact_crv_pt(exact.mapToDewarpedSpace(img_pt));
+		QPointF const table_crv_pt(table.mapToDewarpedSpace(img_pt));
+		BOOST_REQUIRE_EQUAL(exact_crv_pt.x(), table_crv_pt.x());
+		BOOST_REQUIRE_LE(
+			distance(
+				exact.mapToWarpedSpace(exact_crv_pt),
+				exact.mapToWarpedSpace(table_crv_pt)
+			), 2.0 * max_img_error
+		);
+	}
+}
+
+BOOST_AUTO_TEST_CASE(test_outside_of_table_is_exact)
+{
+	CylindricalSurfaceDewarper const exact(
+		utils::curvedLine(40, 30), utils::curvedLine(260, 20), 2.0
+	);
+	CylindricalSurfaceDewarper table(exact);
+	table.buildGeneratrixTable(0.25, 0.75, 0.1);
+
+	double const crv_xs[] = { 0.0, 0.1, 0.2, 0.8, 0.9, 1.0 };
+	for (int i = 0; i < int(sizeof(crv_xs) / sizeof(crv_xs[0])); ++i) {
+		QPointF const crv_pt(crv_xs[i], 0.3);
+		QPointF const exact_img_pt(exact.mapToWarpedSpace(crv_pt));
+		QPointF const table_img_pt(table.mapToWarpedSpace(crv_pt));
+		BOOST_REQUIRE_EQUAL(exact_img_pt.x(), table_img_pt.x());
+		BOOST_REQUIRE_EQUAL(exact_img_pt.y(), table_img_pt.y());
+
+		QPointF const exact_crv_pt(exact.mapToDewarpedSpace(exact_img_pt));
+		QPointF const table_crv_pt(table.mapToDewarpedSpace(exact_img_pt));
+		BOOST_REQUIRE_EQUAL(exact_crv_pt.x(), table_crv_pt.x());
+		BOOST_REQUIRE_EQUAL(exact_crv_pt.y(), table_crv_pt.y());
+	}
+}
+
+BOOST_AUTO_TEST_SUITE_END();
+
+} // namespace tests
+
+} // namespace dewarping
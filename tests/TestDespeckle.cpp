@@ -0,0 +1,226 @@
+/*
+	Scan Tailor - Interactive post-processing tool for scanned pages.
+	Copyright (C)  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "Despeckle.h"
+#include "TaskStatus.h"
+#include "Dpi.h"
+#include "imageproc/BinaryImage.h"
+#include "imageproc/BWColor.h"
+#include <QRect>
+#ifndef Q_MOC_RUN
+#include <boost/test/auto_unit_test.hpp>
+#endif
+#include <string.h>
+
+namespace Tests
+{
+
+using namespace imageproc;
+
+BOOST_AUTO_TEST_SUITE(DespeckleTestSuite);
+
+namespace
+{
+
+class NeverCancelled : public TaskStatus
+{
+public:
+	virtual void cancel() {}
+
+	virtual bool isCancelled() const { return false; }
+
+	virtual void throwIfCancelled() const {}
+};
+
+/**
+ * Makes an image from a null-terminated list of rows,
+ * with 'x' standing for black pixels.
+ */
+BinaryImage makeImage(char const* const* rows)
+{
+	int height = 0;
+	while (rows[height]) {
+		++height;
+	}
+	int const width = strlen(rows[0]);
+
+	BinaryImage image(width, height, WHITE);
+	for (int y = 0; y < height; ++y) {
+		for (int x = 0; x < width; ++x) {
+			if (rows[y][x] == 'x') {
+				image.fill(QRect(x, y, 1, 1), BLACK);
+			}
+		}
+	}
+	return image;
+}
+
+/*
+ * Two big components, a frame like the letter O and a solid block,
+ * with speckles of 1 to 9 pixels at various distances from them.
+ * The expected results at 300 dpi were produced by the implementation
+ * that preceded the run-based component statistics.
+ */
+
+char const* const input[] = {
+	"................................................................",
+	"..x.............................................................",
+	".........................................................xx.....",
+	"......xxxxxxxxxxxxxxxxxx..........xx............................",
+	"......xxxxxxxxxxxxxxxxxx..........xx............................",
+	"......xxxx..........xxxx........................................",
+	"......xxxx..........xxxx.....xxxxxxxxx..........................",
+	"......xxxx..........xxxx.....xxxxxxxxx..........................",
+	"......xxxx..........xxxx.....xxxxxxxxx..........................",
+	"......xxxx..........xxxx.....xxxxxxxxx..........................",
+	"......xxxx..........xxxx.....xxxxxxxxx.......xx.................",
+	"......xxxx..........xxxx.....xxxxxxxxx.......xx.................",
+	"......xxxx..........xxxx.....xxxxxxxxx..........................",
+	"......xxxx....xx....xxxx.....xxxxxxxxx..........................",
+	"......xxxx....xx....xxxx........................................",
+	"......xxxx..........xxxx...xxx..................................",
+	"......xxxx..........xxxx...xxx..................................",
+	"......xxxxxxxxxxxxxxxxxx...xxx..................................",
+	"......xxxxxxxxxxxxxxxxxx........................................",
+	"...........................................x....................",
+	".......xx.......................................................",
+	"..........................x.....................................",
+	"............................................................x...",
+	"................................................................",
+	0
+};
+
+char const* const cautious[] = {
+	"................................................................",
+	"..x.............................................................",
+	".........................................................xx.....",
+	"......xxxxxxxxxxxxxxxxxx..........xx............................",
+	"......xxxxxxxxxxxxxxxxxx..........xx............................",
+	"......xxxx..........xxxx........................................",
+	"......xxxx..........xxxx.....xxxxxxxxx..........................",
+	"......xxxx..........xxxx.....xxxxxxxxx..........................",
+	"......xxxx..........xxxx.....xxxxxxxxx..........................",
+	"......xxxx..........xxxx.....xxxxxxxxx..........................",
+	"......xxxx..........xxxx.....xxxxxxxxx.......xx.................",
+	"......xxxx..........xxxx.....xxxxxxxxx.......xx.................",
+	"......xxxx..........xxxx.....xxxxxxxxx..........................",
+	"......xxxx....xx....xxxx.....xxxxxxxxx..........................",
+	"......xxxx....xx....xxxx........................................",
+	"......xxxx..........xxxx...xxx..................................",
+	"......xxxx..........xxxx...xxx..................................",
+	"......xxxxxxxxxxxxxxxxxx...xxx..................................",
+	"......xxxxxxxxxxxxxxxxxx........................................",
+	"...........................................x....................",
+	".......xx.......................................................",
+	"..........................x.....................................",
+	"................................................................",
+	"................................................................",
+	0
+};
+
+char const* const normal[] = {
+	"................................................................",
+	"..x.............................................................",
+	"................................................................",
+	"......xxxxxxxxxxxxxxxxxx..........xx............................",
+	"......xxxxxxxxxxxxxxxxxx..........xx............................",
+	"......xxxx..........xxxx........................................",
+	"......xxxx..........xxxx.....xxxxxxxxx..........................",
+	"......xxxx..........xxxx.....xxxxxxxxx..........................",
+	"......xxxx..........xxxx.....xxxxxxxxx..........................",
+	"......xxxx..........xxxx.....xxxxxxxxx..........................",
+	"......xxxx..........xxxx.....xxxxxxxxx.......xx.................",
+	"......xxxx..........xxxx.....xxxxxxxxx.......xx.................",
+	"......xxxx..........xxxx.....xxxxxxxxx..........................",
+	"......xxxx....xx....xxxx.....xxxxxxxxx..........................",
+	"......xxxx....xx....xxxx........................................",
+	"......xxxx..........xxxx...xxx..................................",
+	"......xxxx..........xxxx...xxx..................................",
+	"......xxxxxxxxxxxxxxxxxx...xxx..................................",
+	"......xxxxxxxxxxxxxxxxxx........................................",
+	"................................................................",
+	".......xx.......................................................",
+	"..........................x.....................................",
+	"................................................................",
+	"................................................................",
+	0
+};
+
+char const* const aggressive[] = {
+	"................................................................",
+	"................................................................",
+	"................................................................",
+	"......xxxxxxxxxxxxxxxxxx..........xx............................",
+	"......xxxxxxxxxxxxxxxxxx..........xx............................",
+	"......xxxx..........xxxx........................................",
+	"......xxxx..........xxxx.....xxxxxxxxx..........................",
+	"......xxxx..........xxxx.....xxxxxxxxx..........................",
+	"......xxxx..........xxxx.....xxxxxxxxx..........................",
+	"......xxxx..........xxxx.....xxxxxxxxx..........................",
+	"......xxxx..........xxxx.....xxxxxxxxx..........................",
+	"......xxxx..........xxxx.....xxxxxxxxx..........................",
+	"......xxxx..........xxxx.....xxxxxxxxx..........................",
+	"......xxxx....xx....xxxx.....xxxxxxxxx..........................",
+	"......xxxx....xx....xxxx........................................",
+	"......xxxx..........xxxx...xxx..................................",
+	"......xxxx..........xxxx...xxx..................................",
+	"......xxxxxxxxxxxxxxxxxx...xxx..................................",
+	"......xxxxxxxxxxxxxxxxxx........................................",
+	"................................................................",
+	".......xx.......................................................",
+	"..........................x.....................................",
+	"................................................................",
+	"................................................................",
+	0
+};
+
+bool despecklesTo(Despeckle::Level const level, char const* const* expected)
+{
+	BinaryImage const result(
+		Despeckle::despeckle(makeImage(input), Dpi(300, 300), level, NeverCancelled())
+	);
+	return result == makeImage(expected);
+}
+
+} // anonymous namespace
+
+BOOST_AUTO_TEST_CASE(test_cautious)
+{
+	BOOST_CHECK(despecklesTo(Despeckle::CAUTIOUS, cautious));
+}
+
+BOOST_AUTO_TEST_CASE(test_normal)
+{
+	BOOST_CHECK(despecklesTo(Despeckle::NORMAL, normal));
+}
+
+BOOST_AUTO_TEST_CASE(test_aggressive)
+{
+	BOOST_CHECK(despecklesTo(Despeckle::AGGRESSIVE, aggressive));
+}
+
+BOOST_AUTO_TEST_CASE(test_in_place)
+{
+	BinaryImage image(makeImage(input));
+	Despeckle::despeckleInPlace(image, Dpi(300, 300), Despeckle::AGGRESSIVE, NeverCancelled());
+	BOOST_CHECK(image == makeImage(aggressive));
+}
+
+BOOST_AUTO_TEST_SUITE_END();
+
+} // namespace Tests
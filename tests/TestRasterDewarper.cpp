@@ -0,0 +1,122 @@
+/*
+	Scan Tailor - Interactive post-processing tool for scanned pages.
+	Copyright (C)  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "dewarping/RasterDewarper.h"
+#include "dewarping/CylindricalSurfaceDewarper.h"
+#include "imageproc/GrayImage.h"
+#include "imageproc/tests/Utils.h"
+#include "DewarpingUtils.h"
+#include <QImage>
+#include <QSize>
+#include <QRectF>
+#include <QColor>
+#ifndef Q_MOC_RUN
+#include <boost/test/auto_unit_test.hpp>
+#endif
+#include <stdint.h>
+#include <stdlib.h>
+
+namespace dewarping
+{
+
+namespace tests
+{
+
+BOOST_AUTO_TEST_SUITE(RasterDewarperTestSuite);
+
+namespace
+{
+
+QImage randomRgbImage(QSize const size, QImage::Format const format)
+{
+	QImage image(size, format);
+	for (int y = 0; y < size.height(); ++y) {
+		uint32_t* line = (uint32_t*)image.scanLine(y);
+		for (int x = 0; x < size.width(); ++x) {
+			uint32_t const rgb = (rand() & 0xffff) | ((rand() & 0xff) << 16);
+			line[x] = (format == QImage::Format_ARGB32 ? uint32_t(rand() & 0xff) << 24 : 0xff000000) | rgb;
+		}
+	}
+	return image;
+}
+
+QImage randomGrayImage(QSize const size)
+{
+	imageproc::GrayImage image(size);
+	uint8_t* line = image.data();
+	for (int y = 0; y < size.height(); ++y, line += image.stride()) {
+		for (int x = 0; x < size.width(); ++x) {
+			line[x] = rand() & 0xff;
+		}
+	}
+	return image.toQImage();
+}
+
+class DewarpOp
+{
+public:
+	typedef QImage result_type;
+
+	DewarpOp(QImage const& src, QSize dst_size,
+		CylindricalSurfaceDewarper const& model, QRectF model_domain)
+	: m_rSrc(src), m_dstSize(dst_size), m_rModel(model), m_modelDomain(model_domain) {}
+
+	result_type operator()() const {
+		return RasterDewarper::dewarp(
+			m_rSrc, m_dstSize, m_rModel, m_modelDomain, QColor(Qt::white)
+		);
+	}
+private:
+	QImage const& m_rSrc;
+	QSize m_dstSize;
+	CylindricalSurfaceDewarper const& m_rModel;
+	QRectF m_modelDomain;
+};
+
+} // anonymous namespace
+
+BOOST_AUTO_TEST_CASE(test_parallel_matches_serial)
+{
+	using imageproc::tests::utils::sameForAnyThreadCount;
+
+	CylindricalSurfaceDewarper const model(
+		utils::curvedLine(40.0, 25.0), utils::curvedLine(260.0, 15.0), 2.0
+	);
+	QSize const src_size(400, 300);
+	QSize const dst_size(357, 281);
+	QRectF const model_domain(0, 0, dst_size.width(), dst_size.height());
+
+	QImage const sources[] = {
+		randomGrayImage(src_size),
+		randomRgbImage(src_size, QImage::Format_RGB32),
+		randomRgbImage(src_size, QImage::Format_ARGB32)
+	};
+
+	for (int i = 0; i < 3; ++i) {
+		DewarpOp const op(sources[i], dst_size, model, model_domain);
+		BOOST_REQUIRE(op().size() == dst_size);
+		BOOST_CHECK(sameForAnyThreadCount(op));
+	}
+}
+
+BOOST_AUTO_TEST_SUITE_END();
+
+} // namespace tests
+
+} // namespace dewarping
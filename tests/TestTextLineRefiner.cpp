@@ -0,0 +1,118 @@
+/*
+	Scan Tailor - Interactive post-processing tool for scanned pages.
+	Copyright (C)  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "dewarping/TextLineRefiner.h"
+#include "imageproc/GrayImage.h"
+#include "imageproc/tests/Utils.h"
+#include "Dpi.h"
+#include "VecNT.h"
+#include <QSize>
+#include <QPointF>
+#ifndef Q_MOC_RUN
+#include <boost/test/auto_unit_test.hpp>
+#endif
+#include <list>
+#include <vector>
+#include <stdint.h>
+#include <math.h>
+
+namespace dewarping
+{
+
+namespace tests
+{
+
+BOOST_AUTO_TEST_SUITE(TextLineRefinerTestSuite);
+
+namespace
+{
+
+typedef std::list<std::vector<QPointF> > Polylines;
+
+/**
+ * Dark wavy bands on a white background, at y = 60, 120, ..., 240.
+ */
+imageproc::GrayImage wavyTextLines(QSize const size)
+{
+	imageproc::GrayImage image(size);
+	uint8_t* line = image.data();
+	for (int y = 0; y < size.height(); ++y, line += image.stride()) {
+		for (int x = 0; x < size.width(); ++x) {
+			double const offset = y - 8.0 * sin(x * 0.02);
+			double const phase = fmod(offset + 1000.0, 60.0);
+			bool const ink = offset > 40 && offset < 260 && phase < 10.0;
+			line[x] = ink ? 30 : 230;
+		}
+	}
+	return image;
+}
+
+/**
+ * Straight lines near the bands of wavyTextLines().
+ */
+Polylines initialPolylines()
+{
+	Polylines polylines;
+	for (int y = 64; y < 260; y += 60) {
+		std::vector<QPointF> polyline;
+		for (int x = 20; x <= 380; x += 40) {
+			polyline.push_back(QPointF(x, y));
+		}
+		polylines.push_back(polyline);
+	}
+	return polylines;
+}
+
+class RefineOp
+{
+public:
+	typedef Polylines result_type;
+
+	RefineOp(imageproc::GrayImage const& image, Polylines const& polylines)
+	: m_rImage(image), m_rPolylines(polylines) {}
+
+	result_type operator()() const {
+		Polylines polylines(m_rPolylines);
+		TextLineRefiner const refiner(m_rImage, Dpi(200, 200), Vec2f(0, 1));
+		refiner.refine(polylines, /*iterations=*/100, 0);
+		return polylines;
+	}
+private:
+	imageproc::GrayImage const& m_rImage;
+	Polylines const& m_rPolylines;
+};
+
+} // anonymous namespace
+
+BOOST_AUTO_TEST_CASE(test_thread_count_independence)
+{
+	using imageproc::tests::utils::sameForAnyThreadCount;
+
+	imageproc::GrayImage const image(wavyTextLines(QSize(400, 300)));
+	Polylines const polylines(initialPolylines());
+	RefineOp const op(image, polylines);
+
+	BOOST_REQUIRE(op().size() == polylines.size());
+	BOOST_CHECK(sameForAnyThreadCount(op));
+}
+
+BOOST_AUTO_TEST_SUITE_END();
+
+} // namespace tests
+
+} // namespace dewarping